@@ -426,13 +426,16 @@ static void parse_config_line(struct wsbrd_conf *config, struct parser_info *inf
         { "tun_autoconf",                  &config->tun_autoconf,                     conf_set_bool,        NULL },
         { "neighbor_proxy",                config->neighbor_proxy,                    conf_set_string,      (void *)sizeof(config->neighbor_proxy) },
         { "color_output",                  &config->color_output,                     conf_set_enum,        &valid_tristate },
+        { "tickless",                      &config->tickless,                         conf_set_bool,        NULL },
         { "use_tap",                       NULL,                                      conf_deprecated,      NULL },
         { "ipv6_prefix",                   &config->ipv6_prefix,                      conf_set_netmask,     NULL },
         { "storage_prefix",                config->storage_prefix,                    conf_set_string,      (void *)sizeof(config->storage_prefix) },
+        { "storage_mmap",                  &config->storage_mmap,                     conf_set_bool,        NULL },
         { "trace",                         &g_enabled_traces,                         conf_set_flags,       &valid_traces },
         { "internal_dhcp",                 &config->internal_dhcp,                    conf_set_bool,        NULL },
         { "radius_server",                 &config->radius_server,                    conf_set_netaddr,     NULL },
         { "radius_secret",                 config->radius_secret,                     conf_set_string,      (void *)sizeof(config->radius_secret) },
+        { "tls_workers",                   &config->tls_workers,                      conf_set_number,      &valid_unsigned },
         { "key",                           &config->tls_own,                          conf_set_key,         NULL },
         { "certificate",                   &config->tls_own,                          conf_set_cert,        NULL },
         { "authority",                     &config->tls_ca,                           conf_set_cert,        NULL },
@@ -27,6 +27,7 @@
 struct wsbrd_conf {
     bool list_rf_configs;
     int color_output;
+    bool tickless;
 
     char cpc_instance[PATH_MAX];
 
@@ -55,12 +56,14 @@ struct wsbrd_conf {
     uint8_t ipv6_prefix[16];
 
     char storage_prefix[PATH_MAX];
+    bool storage_mmap;
     arm_certificate_entry_s tls_own;
     arm_certificate_entry_s tls_ca;
     uint8_t ws_gtk[4][16];
     bool ws_gtk_force[4];
     struct sockaddr_storage radius_server;
     char radius_secret[256];
+    int  tls_workers;
 
     int  tx_power;
     int  ws_pan_id;
@@ -12,6 +12,7 @@
  */
 #include "nsconfig.h"
 #include <errno.h>
+#include <time.h>
 #include <arpa/inet.h>
 #include <systemd/sd-bus.h>
 #include "app_wsbrd/tun.h"
@@ -26,6 +27,7 @@
 #include "stack/source/6lowpan/ws/ws_cfg_settings.h"
 #include "stack/source/nwk_interface/protocol.h"
 #include "stack/source/security/protocols/sec_prot_keys.h"
+#include "stack/source/security/protocols/tls_sec_prot/tls_sec_prot_lib.h"
 #include "stack/source/common_protocols/icmpv6.h"
 
 #include "commandline_values.h"
@@ -212,24 +214,164 @@ static int dbus_revoke_apply(sd_bus_message *m, void *userdata, sd_bus_error *re
     return 0;
 }
 
+/*
+ * The topology is cached, so the DBus clients do not trigger a computation of
+ * the RPL paths. Each change of a node is tagged with a generation number. The
+ * removed nodes are kept (as tombstones) to allow to send deltas.
+ *
+ * Building the cache requires to compute the whole routing table. A DBus
+ * request always gets an up-to-date cache, but the main loop only refreshes it
+ * (to send NodesChanged) once per DBUS_TOPOLOGY_SIGNAL_INTERVAL_MS.
+ */
+#define DBUS_TOPOLOGY_SIGNAL_INTERVAL_MS 1000
+
+struct dbus_node {
+    uint8_t eui64[8];
+    uint8_t parent[8];
+    uint32_t generation;        // Generation of the last change
+    bool removed;
+};
+
+static struct {
+    struct dbus_node *nodes;    // Sorted by EUI-64
+    int nodes_len;
+    int removed_len;
+    uint32_t generation;
+    uint32_t min_generation;    // Deltas from older generations are lost
+    uint32_t signaled_generation;
+    uint64_t update_ms;         // Time of the last routing table computation
+    bool dirty;
+} dbus_topology = {
+    .dirty = true,
+};
+
 void dbus_emit_nodes_change(struct wsbr_ctxt *ctxt)
 {
-    sd_bus_emit_properties_changed(ctxt->dbus,
-                       "/com/silabs/Wisun/BorderRouter",
-                       "com.silabs.Wisun.BorderRouter",
-                       "Nodes", NULL);
+    // The change is processed by dbus_flush_nodes_change() or by the next DBus
+    // request
+    dbus_topology.dirty = true;
+}
+
+static uint64_t dbus_now_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000ull + now.tv_nsec / 1000000;
 }
 
 static int route_info_compare(const void *obj_a, const void *obj_b)
 {
     const bbr_route_info_t *a = obj_a, *b = obj_b;
-    int ret;
 
-    ret = memcmp(a->parent, b->parent, sizeof(a->parent));
-    if (ret)
-        return ret;
-    ret = memcmp(a->target, b->target, sizeof(a->target));
-    return ret;
+    return memcmp(a->target, b->target, sizeof(a->target));
+}
+
+static int dbus_topology_get_routes(int rcp_if_id, bbr_route_info_t **table)
+{
+    int size = min(max(2 * dbus_topology.nodes_len, 64), UINT16_MAX);
+    int len, i;
+
+    for (;;) {
+        *table = realloc(*table, size * sizeof(bbr_route_info_t));
+        FATAL_ON(!*table, 2, "%s: realloc: %m", __func__);
+        len = ws_bbr_routing_table_get(rcp_if_id, *table, size);
+        if (len < size || size == UINT16_MAX)
+            break;
+        size = min(2 * size, UINT16_MAX);
+    }
+    // Dirty hack to retrive the MAC from the EUI64
+    for (i = 0; i < len; i++) {
+        (*table)[i].parent[0] ^= 0x02;
+        (*table)[i].target[0] ^= 0x02;
+    }
+    if (len > 0)
+        qsort(*table, len, sizeof(bbr_route_info_t), route_info_compare);
+    return len;
+}
+
+// Merge the current routing table into the cache. Return true if a node has
+// changed. If the routing table is not available, the cache is left untouched
+// and stays dirty.
+static bool dbus_topology_update(int rcp_if_id)
+{
+    uint32_t generation = dbus_topology.generation + 1;
+    bbr_route_info_t *table = NULL;
+    struct dbus_node *nodes, *old;
+    int len, i, j, k, cmp;
+    bool changed = false;
+
+    dbus_topology.update_ms = dbus_now_ms();
+    len = dbus_topology_get_routes(rcp_if_id, &table);
+    if (len < 0) {
+        free(table);
+        return false;
+    }
+    dbus_topology.dirty = false;
+    nodes = malloc(max(dbus_topology.nodes_len + len, 1) * sizeof(struct dbus_node));
+    FATAL_ON(!nodes, 2, "%s: malloc: %m", __func__);
+    dbus_topology.removed_len = 0;
+    for (i = 0, j = 0, k = 0; i < dbus_topology.nodes_len || j < len; k++) {
+        old = i < dbus_topology.nodes_len ? &dbus_topology.nodes[i] : NULL;
+        if (!old)
+            cmp = 1;
+        else if (j == len)
+            cmp = -1;
+        else
+            cmp = memcmp(old->eui64, table[j].target, 8);
+        if (cmp < 0) {
+            nodes[k] = *old;
+            if (!old->removed) {
+                nodes[k].removed = true;
+                nodes[k].generation = generation;
+                changed = true;
+            }
+            dbus_topology.removed_len++;
+            i++;
+            continue;
+        }
+        if (cmp > 0) {
+            memcpy(nodes[k].eui64, table[j].target, 8);
+            memcpy(nodes[k].parent, table[j].parent, 8);
+            nodes[k].removed = false;
+            nodes[k].generation = generation;
+            changed = true;
+            j++;
+            continue;
+        }
+        nodes[k] = *old;
+        if (old->removed || memcmp(old->parent, table[j].parent, 8)) {
+            memcpy(nodes[k].parent, table[j].parent, 8);
+            nodes[k].removed = false;
+            nodes[k].generation = generation;
+            changed = true;
+        }
+        i++;
+        j++;
+    }
+    free(table);
+    free(dbus_topology.nodes);
+    dbus_topology.nodes = nodes;
+    dbus_topology.nodes_len = k;
+    if (changed)
+        dbus_topology.generation = generation;
+    return changed;
+}
+
+// Forget the tombstones when they outnumber the nodes. The clients late of
+// more than this generation will receive the full list.
+static void dbus_topology_compact(void)
+{
+    int i, j;
+
+    if (dbus_topology.removed_len <= max(dbus_topology.nodes_len - dbus_topology.removed_len, 64))
+        return;
+    for (i = 0, j = 0; i < dbus_topology.nodes_len; i++)
+        if (!dbus_topology.nodes[i].removed)
+            dbus_topology.nodes[j++] = dbus_topology.nodes[i];
+    dbus_topology.nodes_len = j;
+    dbus_topology.removed_len = 0;
+    dbus_topology.min_generation = dbus_topology.generation;
 }
 
 static int sd_bus_message_append_node(
@@ -303,50 +445,192 @@ static int sd_bus_message_append_node(
     return ret;
 }
 
+static void sd_bus_message_append_topology_node(sd_bus_message *m, const char *property,
+                                                const struct dbus_node *node, const uint8_t prefix[8])
+{
+    uint8_t ipv6[3][16] = { 0 };
+
+    memcpy(ipv6[0] + 0, ADDR_LINK_LOCAL_PREFIX, 8);
+    memcpy(ipv6[0] + 8, node->eui64, 8);
+    ipv6[0][8] ^= 0x02;
+    memcpy(ipv6[1] + 0, prefix, 8);
+    memcpy(ipv6[1] + 8, node->eui64, 8);
+    ipv6[1][8] ^= 0x02;
+    sd_bus_message_append_node(m, property, node->eui64, node->parent, ipv6, false);
+}
+
+static void sd_bus_message_append_br_node(sd_bus_message *m, const char *property)
+{
+    uint8_t ipv6[3][16] = { 0 };
+
+    tun_addr_get_link_local(g_ctxt.config.tun_dev, ipv6[0]);
+    tun_addr_get_global_unicast(g_ctxt.config.tun_dev, ipv6[1]);
+    sd_bus_message_append_node(m, property, g_ctxt.hw_mac, NULL, ipv6, true);
+}
+
+// Append the nodes changed since the generation "since" (or all the nodes if
+// full is set), then the EUI-64 of the nodes removed since this generation.
+// Only the entries [offset, offset + count[ are appended (count 0 means no
+// limit). The border router counts as the first entry of a full list.
+static void sd_bus_message_append_topology(sd_bus_message *m, const char *property,
+                                           const uint8_t prefix[8], uint32_t since, bool full,
+                                           uint32_t offset, uint32_t count)
+{
+    const struct dbus_node *node;
+    uint32_t index = 0;
+    int ret, i;
+
+    ret = sd_bus_message_open_container(m, 'a', "(aya{sv})");
+    WARN_ON(ret < 0, "%s: %s", property, strerror(-ret));
+    if (full) {
+        if (offset == 0)
+            sd_bus_message_append_br_node(m, property);
+        index++;
+    }
+    for (i = 0; i < dbus_topology.nodes_len; i++) {
+        node = &dbus_topology.nodes[i];
+        if (node->removed || (!full && node->generation <= since))
+            continue;
+        if (index >= offset && (!count || index - offset < count))
+            sd_bus_message_append_topology_node(m, property, node, prefix);
+        index++;
+    }
+    ret = sd_bus_message_close_container(m);
+    WARN_ON(ret < 0, "%s: %s", property, strerror(-ret));
+    ret = sd_bus_message_open_container(m, 'a', "ay");
+    WARN_ON(ret < 0, "%s: %s", property, strerror(-ret));
+    for (i = 0; i < dbus_topology.nodes_len && !full; i++) {
+        node = &dbus_topology.nodes[i];
+        if (!node->removed || node->generation <= since)
+            continue;
+        if (index >= offset && (!count || index - offset < count)) {
+            ret = sd_bus_message_append_array(m, 'y', node->eui64, 8);
+            WARN_ON(ret < 0, "%s: %s", property, strerror(-ret));
+        }
+        index++;
+    }
+    ret = sd_bus_message_close_container(m);
+    WARN_ON(ret < 0, "%s: %s", property, strerror(-ret));
+}
+
+int dbus_flush_nodes_change(struct wsbr_ctxt *ctxt)
+{
+    sd_bus_message *m = NULL;
+    bbr_information_t br_info;
+    uint64_t now_ms;
+    int ret;
+
+    if (!ctxt->dbus)
+        return -1;
+    if (ws_bbr_info_get(ctxt->rcp_if_id, &br_info))
+        return -1;
+    if (dbus_topology.dirty) {
+        now_ms = dbus_now_ms();
+        if (now_ms < dbus_topology.update_ms + DBUS_TOPOLOGY_SIGNAL_INTERVAL_MS)
+            return dbus_topology.update_ms + DBUS_TOPOLOGY_SIGNAL_INTERVAL_MS - now_ms;
+        dbus_topology_update(ctxt->rcp_if_id);
+    }
+    // The cache may have been updated by a DBus request
+    if (dbus_topology.signaled_generation == dbus_topology.generation)
+        return dbus_topology.dirty ? DBUS_TOPOLOGY_SIGNAL_INTERVAL_MS : -1;
+    sd_bus_emit_properties_changed(ctxt->dbus,
+                       "/com/silabs/Wisun/BorderRouter",
+                       "com.silabs.Wisun.BorderRouter",
+                       "Nodes", "NodesGeneration", NULL);
+    ret = sd_bus_message_new_signal(ctxt->dbus, &m,
+                                    "/com/silabs/Wisun/BorderRouter",
+                                    "com.silabs.Wisun.BorderRouter",
+                                    "NodesChanged");
+    if (ret < 0) {
+        WARN("%s: %s", __func__, strerror(-ret));
+        dbus_topology.signaled_generation = dbus_topology.generation;
+        return dbus_topology.dirty ? DBUS_TOPOLOGY_SIGNAL_INTERVAL_MS : -1;
+    }
+    ret = sd_bus_message_append(m, "u", dbus_topology.generation);
+    WARN_ON(ret < 0, "%s: %s", __func__, strerror(-ret));
+    sd_bus_message_append_topology(m, "NodesChanged", br_info.prefix,
+                                   dbus_topology.signaled_generation, false, 0, 0);
+    ret = sd_bus_send(ctxt->dbus, m, NULL);
+    WARN_ON(ret < 0, "%s: %s", __func__, strerror(-ret));
+    sd_bus_message_unref(m);
+    dbus_topology.signaled_generation = dbus_topology.generation;
+    dbus_topology_compact();
+    return dbus_topology.dirty ? DBUS_TOPOLOGY_SIGNAL_INTERVAL_MS : -1;
+}
+
 int dbus_get_nodes(sd_bus *bus, const char *path, const char *interface,
                        const char *property, sd_bus_message *reply,
                        void *userdata, sd_bus_error *ret_error)
 {
     int rcp_if_id = *(int *)userdata;
-    bbr_route_info_t table[4096];
-    uint8_t ipv6[3][16] = { 0 };
     bbr_information_t br_info;
-    int ret, len, i;
+    const struct dbus_node *node;
+    int ret, i;
 
     ret = ws_bbr_info_get(rcp_if_id, &br_info);
     if (ret)
         return sd_bus_error_set_errno(ret_error, EAGAIN);
-    len = ws_bbr_routing_table_get(rcp_if_id, table, ARRAY_SIZE(table));
-    if (len < 0)
-        return sd_bus_error_set_errno(ret_error, EAGAIN);
-    // Dirty hack to retrive the MAC from the EUI64
-    for (i = 0; i < len; i++) {
-        table[i].parent[0] ^= 0x02;
-        table[i].target[0] ^= 0x02;
-    }
-    qsort(table, len, sizeof(table[0]), route_info_compare);
+    if (dbus_topology.dirty)
+        dbus_topology_update(rcp_if_id);
     ret = sd_bus_message_open_container(reply, 'a', "(aya{sv})");
     WARN_ON(ret < 0, "%s: %s", property, strerror(-ret));
-    tun_addr_get_link_local(g_ctxt.config.tun_dev, ipv6[0]);
-    tun_addr_get_global_unicast(g_ctxt.config.tun_dev, ipv6[1]);
-    ret = sd_bus_message_append_node(reply, property, g_ctxt.hw_mac, NULL, ipv6, true);
-    for (i = 0; i < len; i++) {
-        memcpy(ipv6[0] + 0, ADDR_LINK_LOCAL_PREFIX, 8);
-        memcpy(ipv6[0] + 8, table[i].target, 8);
-        ipv6[0][8] ^= 0x02;
-        memcpy(ipv6[1] + 0, br_info.prefix, 8);
-        memcpy(ipv6[1] + 8, table[i].target, 8);
-        ipv6[1][8] ^= 0x02;
-        sd_bus_message_append_node(
-            reply, property, table[i].target, table[i].parent,
-            ipv6, false
-        );
+    sd_bus_message_append_br_node(reply, property);
+    for (i = 0; i < dbus_topology.nodes_len; i++) {
+        node = &dbus_topology.nodes[i];
+        if (!node->removed)
+            sd_bus_message_append_topology_node(reply, property, node, br_info.prefix);
     }
     ret = sd_bus_message_close_container(reply);
     WARN_ON(ret < 0, "d %s: %s", property, strerror(-ret));
     return 0;
 }
 
+int dbus_get_nodes_generation(sd_bus *bus, const char *path, const char *interface,
+                              const char *property, sd_bus_message *reply,
+                              void *userdata, sd_bus_error *ret_error)
+{
+    int rcp_if_id = *(int *)userdata;
+    int ret;
+
+    if (dbus_topology.dirty)
+        dbus_topology_update(rcp_if_id);
+    ret = sd_bus_message_append(reply, "u", dbus_topology.generation);
+    WARN_ON(ret < 0, "%s: %s", property, strerror(-ret));
+    return 0;
+}
+
+static int dbus_get_nodes_since(sd_bus_message *m, void *userdata, sd_bus_error *ret_error)
+{
+    struct wsbr_ctxt *ctxt = userdata;
+    sd_bus_message *reply = NULL;
+    bbr_information_t br_info;
+    uint32_t since, offset, count;
+    bool full;
+    int ret;
+
+    ret = sd_bus_message_read(m, "uuu", &since, &offset, &count);
+    if (ret < 0)
+        return sd_bus_error_set_errno(ret_error, -ret);
+    ret = ws_bbr_info_get(ctxt->rcp_if_id, &br_info);
+    if (ret)
+        return sd_bus_error_set_errno(ret_error, EAGAIN);
+    if (dbus_topology.dirty)
+        dbus_topology_update(ctxt->rcp_if_id);
+    full = !since || since < dbus_topology.min_generation || since > dbus_topology.generation;
+    ret = sd_bus_message_new_method_return(m, &reply);
+    if (ret < 0)
+        return sd_bus_error_set_errno(ret_error, -ret);
+    ret = sd_bus_message_append(reply, "ub", dbus_topology.generation, full);
+    WARN_ON(ret < 0, "%s", strerror(-ret));
+    sd_bus_message_append_topology(reply, "GetNodesSince", br_info.prefix,
+                                   since, full, offset, count);
+    ret = sd_bus_send(NULL, reply, NULL);
+    sd_bus_message_unref(reply);
+    if (ret < 0)
+        return sd_bus_error_set_errno(ret_error, -ret);
+    return 0;
+}
+
 int dbus_get_hw_address(sd_bus *bus, const char *path, const char *interface,
                         const char *property, sd_bus_message *reply,
                         void *userdata, sd_bus_error *ret_error)
@@ -373,6 +657,22 @@ int dbus_get_ws_pan_id(sd_bus *bus, const char *path, const char *interface,
     return 0;
 }
 
+int dbus_get_tls_handshakes(sd_bus *bus, const char *path, const char *interface,
+                            const char *property, sd_bus_message *reply,
+                            void *userdata, sd_bus_error *ret_error)
+{
+    uint32_t full, resumed;
+    int ret;
+
+    tls_sec_prot_lib_handshakes_get(&full, &resumed);
+    if (!strcmp(property, "TlsResumedHandshakes"))
+        ret = sd_bus_message_append(reply, "u", resumed);
+    else
+        ret = sd_bus_message_append(reply, "u", full);
+    WARN_ON(ret < 0, "%s: %s", property, strerror(-ret));
+    return 0;
+}
+
 int wsbrd_get_ws_domain(sd_bus *bus, const char *path, const char *interface,
                         const char *property, sd_bus_message *reply,
                         void *userdata, sd_bus_error *ret_error)
@@ -423,6 +723,9 @@ static const sd_bus_vtable dbus_vtable[] = {
                       dbus_revoke_node, 0),
         SD_BUS_METHOD("RevokeApply", NULL, NULL,
                       dbus_revoke_apply, 0),
+        SD_BUS_METHOD("GetNodesSince", "uuu", "uba(aya{sv})aay",
+                      dbus_get_nodes_since, 0),
+        SD_BUS_SIGNAL("NodesChanged", "ua(aya{sv})aay", 0),
         SD_BUS_PROPERTY("Gtks", "aay", dbus_get_gtks,
                         offsetof(struct wsbr_ctxt, rcp_if_id),
                         SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
@@ -432,6 +735,9 @@ static const sd_bus_vtable dbus_vtable[] = {
         SD_BUS_PROPERTY("Nodes", "a(aya{sv})", dbus_get_nodes,
                         offsetof(struct wsbr_ctxt, rcp_if_id),
                         SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION),
+        SD_BUS_PROPERTY("NodesGeneration", "u", dbus_get_nodes_generation,
+                        offsetof(struct wsbr_ctxt, rcp_if_id),
+                        SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
         SD_BUS_PROPERTY("HwAddress", "ay", dbus_get_hw_address,
                         offsetof(struct wsbr_ctxt, hw_mac),
                         0),
@@ -453,6 +759,28 @@ static const sd_bus_vtable dbus_vtable[] = {
         SD_BUS_PROPERTY("WisunPanId", "q", dbus_get_ws_pan_id,
                         offsetof(struct wsbr_ctxt, rcp_if_id),
                         SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("TlsFullHandshakes", "u", dbus_get_tls_handshakes,
+                        0, 0),
+        SD_BUS_PROPERTY("TlsResumedHandshakes", "u", dbus_get_tls_handshakes,
+                        0, 0),
+        SD_BUS_PROPERTY("MplTotalMemory", "u", NULL,
+                        offsetof(struct wsbr_ctxt, stats.mpl_total_memory),
+                        0),
+        SD_BUS_PROPERTY("MplUsedMemory", "u", NULL,
+                        offsetof(struct wsbr_ctxt, stats.mpl_used_memory),
+                        0),
+        SD_BUS_PROPERTY("MplEvictedMessages", "u", NULL,
+                        offsetof(struct wsbr_ctxt, stats.mpl_message_evicted),
+                        0),
+        SD_BUS_PROPERTY("LlcMessagePoolUsed", "q", NULL,
+                        offsetof(struct wsbr_ctxt, stats.llc_message_pool_used),
+                        0),
+        SD_BUS_PROPERTY("LlcMessagePoolPeak", "q", NULL,
+                        offsetof(struct wsbr_ctxt, stats.llc_message_pool_peak),
+                        0),
+        SD_BUS_PROPERTY("LlcMessagePoolOverflow", "u", NULL,
+                        offsetof(struct wsbr_ctxt, stats.llc_message_pool_overflow),
+                        0),
         SD_BUS_VTABLE_END
 };
 
@@ -501,8 +829,7 @@ void dbus_register(struct wsbr_ctxt *ctxt)
 int dbus_process(struct wsbr_ctxt *ctxt)
 {
     BUG_ON(!ctxt->dbus);
-    sd_bus_process(ctxt->dbus, NULL);
-    return 0;
+    return sd_bus_process(ctxt->dbus, NULL);
 }
 
 int dbus_get_fd(struct wsbr_ctxt *ctxt)
@@ -19,6 +19,8 @@ struct wsbr_ctxt;
 
 void dbus_emit_keys_change(struct wsbr_ctxt *ctxt);
 void dbus_emit_nodes_change(struct wsbr_ctxt *ctxt);
+// Return the delay (in ms) before the next call is needed, or -1
+int dbus_flush_nodes_change(struct wsbr_ctxt *ctxt);
 void dbus_register(struct wsbr_ctxt *ctxt);
 int dbus_get_fd(struct wsbr_ctxt *ctxt);
 int dbus_process(struct wsbr_ctxt *ctxt);
@@ -36,6 +38,11 @@ static inline void dbus_emit_nodes_change(struct wsbr_ctxt *ctxt)
     /* empty */
 }
 
+static inline int dbus_flush_nodes_change(struct wsbr_ctxt *ctxt)
+{
+    return -1;
+}
+
 static inline void dbus_register(struct wsbr_ctxt *ctxt)
 {
     WARN("support for DBus is disabled");
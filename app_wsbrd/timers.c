@@ -1,25 +1,110 @@
+#include "nsconfig.h"
 #include <sys/timerfd.h>
+#include <errno.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "stack-scheduler/source/timer_sys.h"
 #include "stack/source/nwk_interface/protocol_timer.h"
+#include "stack/source/nwk_interface/protocol.h"
 #include "common/log.h"
 #include "timers.h"
 #include "wsbr.h"
 
+#define WSBR_TIMER_TICK_MS 50
+
+static uint64_t wsbr_timer_now_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000ull + now.tv_nsec / 1000000;
+}
+
+static void wsbr_timer_replay_ticks(uint64_t ticks)
+{
+    uint16_t chunk;
+
+    // protocol_timer_cb() only accepts 16 bit values
+    while (ticks) {
+        chunk = min(ticks, (uint64_t)UINT16_MAX);
+        system_timer_tick_update(chunk);
+        protocol_timer_cb(chunk);
+        ticks -= chunk;
+    }
+}
+
 void wsbr_common_timer_init(struct wsbr_ctxt *ctxt)
 {
     int ret;
     struct itimerspec parms = {
-        .it_value.tv_nsec = 50 * 1000 * 1000,
-        .it_interval.tv_nsec = 50 * 1000 * 1000,
+        .it_value.tv_nsec = WSBR_TIMER_TICK_MS * 1000 * 1000,
+        .it_interval.tv_nsec = WSBR_TIMER_TICK_MS * 1000 * 1000,
     };
 
     timer_sys_init();
     ctxt->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
     FATAL_ON(ctxt->timerfd < 0, 2, "timerfd_create: %m");
-    ret = timerfd_settime(ctxt->timerfd, 0, &parms, NULL);
+    if (ctxt->config.tickless) {
+        ctxt->timer_ref_ms = wsbr_timer_now_ms();
+        ctxt->timer_deadline_ms = 0;
+        wsbr_common_timer_rearm(ctxt);
+    } else {
+        ret = timerfd_settime(ctxt->timerfd, 0, &parms, NULL);
+        FATAL_ON(ret < 0, 2, "timerfd_settime: %m");
+    }
+}
+
+/*
+ * In tickless mode, the timerfd is a one-shot timer armed on the next tick
+ * where timer_sys or protocol_timer has something to do. Since any callback
+ * may schedule a new timer, this function has to be called before each wait
+ * on the timerfd. It does not issue any syscall if the deadline is unchanged.
+ *
+ * The stack core timer (protocol_core_cb) re-arms itself every 100ms, but its
+ * ticks are only replayed when one of the fast timers of the stack is due.
+ * The slow timers of the stack still run once per second.
+ */
+void wsbr_common_timer_rearm(struct wsbr_ctxt *ctxt)
+{
+    struct itimerspec parms = { };
+    uint64_t deadline_ms;
+    uint32_t next;
+    int ret;
+
+    if (!ctxt->config.tickless)
+        return;
+    next = timer_sys_next_expiry();
+    next = min(next, protocol_timer_next_expiry(PROTOCOL_TIMER_MULTICAST_TIM));
+    next = min(next, protocol_core_timer_next_expiry());
+    if (next == UINT32_MAX)
+        deadline_ms = 0;
+    else
+        deadline_ms = ctxt->timer_ref_ms + max(next, 1u) * WSBR_TIMER_TICK_MS;
+    if (deadline_ms == ctxt->timer_deadline_ms)
+        return;
+    // A zeroed it_value disarms the timer
+    parms.it_value.tv_sec = deadline_ms / 1000;
+    parms.it_value.tv_nsec = (deadline_ms % 1000) * 1000 * 1000;
+    ret = timerfd_settime(ctxt->timerfd, TFD_TIMER_ABSTIME, &parms, NULL);
     FATAL_ON(ret < 0, 2, "timerfd_settime: %m");
+    ctxt->timer_deadline_ms = deadline_ms;
+}
+
+/*
+ * In tickless mode, the ticks elapsed since the last wake up have to be
+ * replayed before running any callback, otherwise the timers armed by the
+ * callback would be shortened by the time spent sleeping.
+ */
+void wsbr_common_timer_sync(struct wsbr_ctxt *ctxt)
+{
+    uint64_t ticks;
+
+    if (!ctxt->config.tickless)
+        return;
+    ticks = (wsbr_timer_now_ms() - ctxt->timer_ref_ms) / WSBR_TIMER_TICK_MS;
+    ctxt->timer_ref_ms += ticks * WSBR_TIMER_TICK_MS;
+    wsbr_timer_replay_ticks(ticks);
 }
 
 void wsbr_common_timer_process(struct wsbr_ctxt *ctxt)
@@ -28,10 +113,18 @@ void wsbr_common_timer_process(struct wsbr_ctxt *ctxt)
     int ret;
 
     ret = read(ctxt->timerfd, &val, sizeof(val));
-    WARN_ON(ret < sizeof(val), "cancelled timer?");
-    WARN_ON(val != 1, "missing timers: %u", (unsigned int)val - 1);
-    system_timer_tick_update(1);
-    protocol_timer_cb(1);
+    if (!ctxt->config.tickless) {
+        WARN_ON(ret < sizeof(val), "cancelled timer?");
+        WARN_ON(val != 1, "missing timers: %u", (unsigned int)val - 1);
+        system_timer_tick_update(1);
+        protocol_timer_cb(1);
+        return;
+    }
+    // The timer may have been re-armed between poll() and read()
+    WARN_ON(ret < 0 && errno != EAGAIN, "read: %m");
+    ctxt->timer_deadline_ms = 0;
+    wsbr_common_timer_sync(ctxt);
+    wsbr_common_timer_rearm(ctxt);
 }
 
 void wsbr_spinel_replay_timers(struct spinel_buffer *buf)
@@ -13,6 +13,7 @@
 #include "nsconfig.h"
 #include <ifaddrs.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
@@ -28,6 +29,7 @@
 #include <arpa/inet.h>
 #include "common/log.h"
 #include "common_protocols/icmpv6.h"
+#include "stack-services/ns_list.h"
 #include "stack/mac/platform/arm_hal_phy.h"
 #include "stack/ethernet_mac_api.h"
 
@@ -52,7 +54,123 @@ ssize_t wsbr_tun_write(uint8_t *buf, uint16_t len)
     return ret;
 }
 
-static int tun_addr_get(const char *if_name, uint8_t ip[static 16], bool gua)
+/*
+ * Proxy NDP entries and host routes of the nodes are installed through a
+ * single netlink socket. The requests of an iteration of the main loop are
+ * sent together by wsbr_tun_nl_flush(). The kernel only replies on failure,
+ * the replies are read asynchronously by wsbr_tun_nl_read().
+ *
+ * The entries installed by the daemon are mirrored, so a registration of a
+ * known node does not reach the kernel. The socket is subscribed to the
+ * neighbor, route and link changes: an entry removed behind the daemon (or
+ * flushed when its interface goes down) is forgotten, so the next
+ * registration of the node installs it again.
+ *
+ * The same socket is subscribed to the IPv6 address changes, to keep a copy of
+ * the addresses of the TUN and neighbor proxy interfaces.
+ */
+#define TUN_NL_INDEX_SIZE 256
+#define TUN_NL_BATCH_SIZE 16384
+#define TUN_NL_ADDR_MAX 8
+
+struct tun_nl_addrs {
+    int len;
+    uint8_t addr[TUN_NL_ADDR_MAX][16];  // In the order of the kernel, newest first
+};
+
+struct tun_nl_node {
+    uint8_t addr[16];
+    uint32_t neigh_seq;         // Sequence number of the proxy NDP request, 0 if none
+    uint32_t route_seq;         // Sequence number of the route request, 0 if none
+    ns_list_link_t link;
+};
+
+typedef NS_LIST_HEAD(struct tun_nl_node, link) tun_nl_node_list_t;
+
+static struct {
+    struct nl_sock *sock;
+    int proxy_ifindex;          // 0 if there is no neighbor proxy
+    int tun_ifindex;
+    tun_nl_node_list_t nodes[TUN_NL_INDEX_SIZE];
+    uint8_t batch[TUN_NL_BATCH_SIZE];
+    int batch_len;
+    struct tun_nl_addrs tun_addrs;
+    struct tun_nl_addrs proxy_addrs;
+    bool addrs_loaded;
+} tun_nl;
+
+static struct tun_nl_addrs *tun_nl_addrs_get(int ifindex, const char *if_name)
+{
+    if (!tun_nl.addrs_loaded)
+        return NULL;
+    if (tun_nl.tun_ifindex && (ifindex == tun_nl.tun_ifindex ||
+                               (if_name && !strcmp(if_name, g_ctxt.config.tun_dev))))
+        return &tun_nl.tun_addrs;
+    if (tun_nl.proxy_ifindex && (ifindex == tun_nl.proxy_ifindex ||
+                                 (if_name && !strcmp(if_name, g_ctxt.config.neighbor_proxy))))
+        return &tun_nl.proxy_addrs;
+    return NULL;
+}
+
+// The kernel puts a new address first among the addresses of the same scope.
+// Since the lookups only split link-local and other addresses, a new address is
+// inserted at the head. The initial load keeps the order of getifaddrs().
+static void tun_nl_addrs_add(struct tun_nl_addrs *addrs, const uint8_t addr[16], bool head)
+{
+    for (int i = 0; i < addrs->len; i++)
+        if (!memcmp(addrs->addr[i], addr, 16))
+            return;
+    if (addrs->len == TUN_NL_ADDR_MAX) {
+        WARN("too many addresses, ignoring %s", tr_ipv6(addr));
+        return;
+    }
+    if (head) {
+        memmove(addrs->addr[1], addrs->addr[0], addrs->len * 16);
+        memcpy(addrs->addr[0], addr, 16);
+    } else {
+        memcpy(addrs->addr[addrs->len], addr, 16);
+    }
+    addrs->len++;
+}
+
+static bool tun_nl_addrs_del(struct tun_nl_addrs *addrs, const uint8_t addr[16])
+{
+    for (int i = 0; i < addrs->len; i++) {
+        if (!memcmp(addrs->addr[i], addr, 16)) {
+            memmove(addrs->addr[i], addrs->addr[i + 1], (addrs->len - i - 1) * 16);
+            addrs->len--;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Initial content of the cache. The subscription to the changes has to be
+// done before.
+static void tun_nl_addrs_load(void)
+{
+    struct tun_nl_addrs *addrs;
+    struct ifaddrs *ifaddr, *ifa;
+
+    tun_nl.addrs_loaded = false;
+    if (getifaddrs(&ifaddr) < 0) {
+        WARN("getifaddrs: %m");
+        return;
+    }
+    tun_nl.tun_addrs.len = 0;
+    tun_nl.proxy_addrs.len = 0;
+    tun_nl.addrs_loaded = true;
+    for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET6)
+            continue;
+        addrs = tun_nl_addrs_get(0, ifa->ifa_name);
+        if (addrs)
+            tun_nl_addrs_add(addrs, ((struct sockaddr_in6 *)ifa->ifa_addr)->sin6_addr.s6_addr, false);
+    }
+    freeifaddrs(ifaddr);
+}
+
+static int tun_addr_get_uncached(const char *if_name, uint8_t ip[static 16], bool gua)
 {
     struct sockaddr_in6 *ipv6;
     struct ifaddrs *ifaddr, *ifa;
@@ -87,6 +205,21 @@ static int tun_addr_get(const char *if_name, uint8_t ip[static 16], bool gua)
     return -2;
 }
 
+static int tun_addr_get(const char *if_name, uint8_t ip[static 16], bool gua)
+{
+    struct tun_nl_addrs *addrs = tun_nl_addrs_get(0, if_name);
+
+    if (!addrs)
+        return tun_addr_get_uncached(if_name, ip, gua);
+    for (int i = 0; i < addrs->len; i++) {
+        if (gua == IN6_IS_ADDR_LINKLOCAL((struct in6_addr *)addrs->addr[i]))
+            continue;
+        memcpy(ip, addrs->addr[i], 16);
+        return 0;
+    }
+    return -2;
+}
+
 int tun_addr_get_link_local(const char *if_name, uint8_t ip[static 16])
 {
     return tun_addr_get(if_name, ip, false);
@@ -97,85 +230,375 @@ int tun_addr_get_global_unicast(const char *if_name, uint8_t ip[static 16])
     return tun_addr_get(if_name, ip, true);
 }
 
-void tun_add_node_to_proxy_neightbl(protocol_interface_info_entry_t *if_entry, uint8_t address[16])
+
+static int tun_nl_addr_cb(struct nlmsghdr *hdr)
 {
-    struct wsbr_ctxt *ctxt = &g_ctxt;
-    char ipv6_addr_to_str[128] = { };
-    struct rtnl_neigh *nl_neigh;
-    struct rtnl_link *link;
-    struct nl_addr *src_ipv6_nl_addr;
-    struct nl_cache *cache;
-    struct nl_sock *sock;
-    int ifindex;
+    struct tun_nl_addrs *addrs;
+    struct ifaddrmsg *ifa;
+    struct nlattr *attr;
+
+    if (!nlmsg_valid_hdr(hdr, sizeof(struct ifaddrmsg)))
+        return NL_SKIP;
+    ifa = nlmsg_data(hdr);
+    if (ifa->ifa_family != AF_INET6)
+        return NL_SKIP;
+    addrs = tun_nl_addrs_get(ifa->ifa_index, NULL);
+    attr = nlmsg_find_attr(hdr, sizeof(struct ifaddrmsg), IFA_ADDRESS);
+    if (!addrs || !attr || nla_len(attr) != 16)
+        return NL_SKIP;
+    if (hdr->nlmsg_type == RTM_NEWADDR) {
+        tun_nl_addrs_add(addrs, nla_data(attr), true);
+    } else if (tun_nl_addrs_del(addrs, nla_data(attr)) && addrs == &tun_nl.tun_addrs) {
+        // The stack keeps using the addresses found at startup (see
+        // tun_autoconf in examples/wsbrd.conf)
+        WARN("%s removed from %s, not supported", tr_ipv6(nla_data(attr)), g_ctxt.config.tun_dev);
+    }
+    return NL_OK;
+}
 
-    if (strlen(ctxt->config.neighbor_proxy) == 0)
-        return;
+static tun_nl_node_list_t *tun_nl_node_list(const uint8_t addr[16])
+{
+    uint32_t hash = 2166136261u;
 
-    inet_ntop(AF_INET6, address, ipv6_addr_to_str, INET6_ADDRSTRLEN);
+    for (int i = 0; i < 16; i++) {
+        hash ^= addr[i];
+        hash *= 16777619u;
+    }
+    return &tun_nl.nodes[hash % TUN_NL_INDEX_SIZE];
+}
 
-    sock = nl_socket_alloc();
-    if (nl_connect(sock, NETLINK_ROUTE))
-        FATAL(2, "nl_connect");
-    if (rtnl_link_get_kernel(sock, 0, ctxt->config.neighbor_proxy, &link)) {
-        ERROR("rtnl_link_get_kernel %s", ctxt->config.neighbor_proxy);
+static struct tun_nl_node *tun_nl_node_get(const uint8_t addr[16], bool create)
+{
+    tun_nl_node_list_t *list = tun_nl_node_list(addr);
+    struct tun_nl_node *node;
+
+    ns_list_foreach(struct tun_nl_node, entry, list)
+        if (!memcmp(entry->addr, addr, 16))
+            return entry;
+    if (!create)
+        return NULL;
+    node = calloc(1, sizeof(struct tun_nl_node));
+    FATAL_ON(!node, 2, "%s: calloc: %m", __func__);
+    memcpy(node->addr, addr, 16);
+    ns_list_add_to_end(list, node);
+    return node;
+}
+
+static void tun_nl_node_del(struct tun_nl_node *node)
+{
+    if (node->neigh_seq || node->route_seq)
         return;
+    ns_list_remove(tun_nl_node_list(node->addr), node);
+    free(node);
+}
+
+static void tun_nl_node_forget(struct tun_nl_node *node, bool neigh, bool route)
+{
+    if (neigh)
+        node->neigh_seq = 0;
+    if (route)
+        node->route_seq = 0;
+    tun_nl_node_del(node);
+}
+
+static int tun_nl_neigh_cb(struct nlmsghdr *hdr)
+{
+    struct tun_nl_node *node;
+    struct nlattr *attr;
+    struct ndmsg *ndm;
+
+    if (!nlmsg_valid_hdr(hdr, sizeof(struct ndmsg)))
+        return NL_SKIP;
+    ndm = nlmsg_data(hdr);
+    if (ndm->ndm_family != AF_INET6 || !(ndm->ndm_flags & NTF_PROXY) ||
+        !tun_nl.proxy_ifindex || ndm->ndm_ifindex != tun_nl.proxy_ifindex)
+        return NL_SKIP;
+    attr = nlmsg_find_attr(hdr, sizeof(struct ndmsg), NDA_DST);
+    if (!attr || nla_len(attr) != 16)
+        return NL_SKIP;
+    node = tun_nl_node_get(nla_data(attr), false);
+    if (node)
+        tun_nl_node_forget(node, true, false);
+    return NL_OK;
+}
+
+static int tun_nl_route_cb(struct nlmsghdr *hdr)
+{
+    struct tun_nl_node *node;
+    struct nlattr *attr;
+    struct rtmsg *rtm;
+
+    if (!nlmsg_valid_hdr(hdr, sizeof(struct rtmsg)))
+        return NL_SKIP;
+    rtm = nlmsg_data(hdr);
+    if (rtm->rtm_family != AF_INET6 || rtm->rtm_dst_len != 128)
+        return NL_SKIP;
+    attr = nlmsg_find_attr(hdr, sizeof(struct rtmsg), RTA_OIF);
+    if (!tun_nl.tun_ifindex || !attr || nla_get_u32(attr) != tun_nl.tun_ifindex)
+        return NL_SKIP;
+    attr = nlmsg_find_attr(hdr, sizeof(struct rtmsg), RTA_DST);
+    if (!attr || nla_len(attr) != 16)
+        return NL_SKIP;
+    node = tun_nl_node_get(nla_data(attr), false);
+    if (node)
+        tun_nl_node_forget(node, false, true);
+    return NL_OK;
+}
+
+// The kernel flushes the proxy entries and the routes of an interface which
+// goes down, without notifying each of them
+static int tun_nl_link_cb(struct nlmsghdr *hdr)
+{
+    struct ifinfomsg *ifi;
+    bool neigh, route;
+
+    if (!nlmsg_valid_hdr(hdr, sizeof(struct ifinfomsg)))
+        return NL_SKIP;
+    ifi = nlmsg_data(hdr);
+    if (hdr->nlmsg_type == RTM_NEWLINK && (ifi->ifi_flags & IFF_UP))
+        return NL_SKIP;
+    neigh = tun_nl.proxy_ifindex && ifi->ifi_index == tun_nl.proxy_ifindex;
+    route = tun_nl.tun_ifindex && ifi->ifi_index == tun_nl.tun_ifindex;
+    if (!neigh && !route)
+        return NL_SKIP;
+    for (int i = 0; i < TUN_NL_INDEX_SIZE; i++) {
+        ns_list_foreach_safe(struct tun_nl_node, node, &tun_nl.nodes[i]) {
+            tun_nl_node_forget(node, neigh, route);
+        }
     }
+    return NL_OK;
+}
 
-    ifindex = rtnl_link_get_ifindex(link);
-    rtnl_link_put(link);
-    link = rtnl_link_alloc();
-    rtnl_link_set_ifindex(link, ifindex);
-    rtnl_neigh_alloc_cache(sock, &cache);
-    nl_addr_parse(ipv6_addr_to_str, AF_INET6, &src_ipv6_nl_addr);
-    nl_neigh = rtnl_neigh_get(cache, ifindex, src_ipv6_nl_addr);
+static int tun_nl_valid_cb(struct nl_msg *msg, void *arg)
+{
+    struct nlmsghdr *hdr = nlmsg_hdr(msg);
+
+    switch (hdr->nlmsg_type) {
+        case RTM_NEWADDR:
+        case RTM_DELADDR:
+            return tun_nl_addr_cb(hdr);
+        case RTM_DELNEIGH:
+            return tun_nl_neigh_cb(hdr);
+        case RTM_DELROUTE:
+            return tun_nl_route_cb(hdr);
+        case RTM_NEWLINK:
+        case RTM_DELLINK:
+            return tun_nl_link_cb(hdr);
+        default:
+            return NL_SKIP;
+    }
+}
 
-    if (nl_neigh != NULL)
+void wsbr_tun_nl_flush(struct wsbr_ctxt *ctxt)
+{
+    int ret;
+
+    if (!tun_nl.batch_len)
         return;
+    ret = nl_sendto(tun_nl.sock, tun_nl.batch, tun_nl.batch_len);
+    if (ret < 0)
+        WARN("nl_sendto: %s", nl_geterror(ret));
+    tun_nl.batch_len = 0;
+}
+
+// Return the sequence number of the request
+static uint32_t tun_nl_queue(struct nl_msg *msg)
+{
+    struct nlmsghdr *hdr;
+    uint32_t seq;
+    int len;
+
+    nl_complete_msg(tun_nl.sock, msg);
+    hdr = nlmsg_hdr(msg);
+    len = NLMSG_ALIGN(hdr->nlmsg_len);
+    if (tun_nl.batch_len + len > sizeof(tun_nl.batch))
+        wsbr_tun_nl_flush(&g_ctxt);
+    BUG_ON(len > sizeof(tun_nl.batch));
+    memcpy(tun_nl.batch + tun_nl.batch_len, hdr, hdr->nlmsg_len);
+    memset(tun_nl.batch + tun_nl.batch_len + hdr->nlmsg_len, 0, len - hdr->nlmsg_len);
+    tun_nl.batch_len += len;
+    seq = hdr->nlmsg_seq;
+    nlmsg_free(msg);
+    return seq;
+}
+
+static struct nl_addr *tun_nl_addr(const uint8_t address[16])
+{
+    struct nl_addr *addr = nl_addr_build(AF_INET6, address, 16);
 
+    FATAL_ON(!addr, 2, "%s: nl_addr_build", __func__);
+    return addr;
+}
+
+static uint32_t tun_nl_queue_neigh(const uint8_t address[16], bool add)
+{
+    struct rtnl_neigh *nl_neigh;
+    struct nl_addr *dst;
+    struct nl_msg *msg;
+    int err;
+
+    dst = tun_nl_addr(address);
     nl_neigh = rtnl_neigh_alloc();
-    rtnl_neigh_set_ifindex(nl_neigh, ifindex);
-    rtnl_neigh_set_dst(nl_neigh, src_ipv6_nl_addr);
+    rtnl_neigh_set_ifindex(nl_neigh, tun_nl.proxy_ifindex);
+    rtnl_neigh_set_dst(nl_neigh, dst);
     rtnl_neigh_set_flags(nl_neigh, NTF_PROXY);
     rtnl_neigh_set_flags(nl_neigh, NTF_ROUTER);
-    rtnl_neigh_add(sock, nl_neigh, NLM_F_CREATE);
+    if (add)
+        err = rtnl_neigh_build_add_request(nl_neigh, NLM_F_REPLACE, &msg);
+    else
+        err = rtnl_neigh_build_delete_request(nl_neigh, 0, &msg);
+    FATAL_ON(err < 0, 2, "%s: %s", __func__, nl_geterror(err));
     rtnl_neigh_put(nl_neigh);
+    nl_addr_put(dst);
+    return tun_nl_queue(msg);
 }
 
-void tun_add_ipv6_direct_route(protocol_interface_info_entry_t *if_entry, uint8_t address[16])
+static uint32_t tun_nl_queue_route(const uint8_t address[16], bool add)
 {
-    struct wsbr_ctxt *ctxt = &g_ctxt;
-    char ipv6_addr_to_str[128] = { };
     struct rtnl_nexthop* nl_nexthop;
     struct rtnl_route *nl_route;
-    struct rtnl_link *link;
-    struct nl_addr *ipv6_nl_addr;
-    struct nl_sock *sock;
-    int ifindex;
+    struct nl_addr *dst;
+    struct nl_msg *msg;
+    int err;
 
-    if (strlen(ctxt->config.neighbor_proxy) == 0)
-        return;
+    dst = tun_nl_addr(address);
+    nl_route = rtnl_route_alloc();
+    rtnl_route_set_iif(nl_route, AF_INET6);
+    rtnl_route_set_dst(nl_route, dst);
+    nl_nexthop = rtnl_route_nh_alloc();
+    rtnl_route_nh_set_ifindex(nl_nexthop, tun_nl.tun_ifindex);
+    rtnl_route_add_nexthop(nl_route, nl_nexthop);
+    if (add)
+        err = rtnl_route_build_add_request(nl_route, NLM_F_REPLACE, &msg);
+    else
+        err = rtnl_route_build_del_request(nl_route, 0, &msg);
+    FATAL_ON(err < 0, 2, "%s: %s", __func__, nl_geterror(err));
+    rtnl_route_put(nl_route);
+    nl_addr_put(dst);
+    return tun_nl_queue(msg);
+}
 
-    inet_ntop(AF_INET6, address, ipv6_addr_to_str, INET6_ADDRSTRLEN);
+// Forget the entries whose installation failed, so the next registration of
+// the node retries
+static int tun_nl_error_cb(struct sockaddr_nl *nla, struct nlmsgerr *nlerr, void *arg)
+{
+    uint32_t seq = nlerr->msg.nlmsg_seq;
+
+    WARN("netlink %s: %s", nlerr->msg.nlmsg_type == RTM_NEWNEIGH || nlerr->msg.nlmsg_type == RTM_DELNEIGH ?
+         "neighbour" : "route", strerror(-nlerr->error));
+    if (nlerr->msg.nlmsg_type != RTM_NEWNEIGH && nlerr->msg.nlmsg_type != RTM_NEWROUTE)
+        return NL_SKIP;
+    for (int i = 0; i < TUN_NL_INDEX_SIZE; i++) {
+        ns_list_foreach_safe(struct tun_nl_node, node, &tun_nl.nodes[i]) {
+            if (node->neigh_seq == seq)
+                node->neigh_seq = 0;
+            else if (node->route_seq == seq)
+                node->route_seq = 0;
+            else
+                continue;
+            tun_nl_node_del(node);
+            return NL_SKIP;
+        }
+    }
+    return NL_SKIP;
+}
 
-    sock = nl_socket_alloc();
-    if (nl_connect(sock, NETLINK_ROUTE))
-        FATAL(2, "nl_connect");
-    if (rtnl_link_get_kernel(sock, 0, ctxt->config.tun_dev, &link)){
-        ERROR("rtnl_link_get_kernel %s", ctxt->config.tun_dev);
+int wsbr_tun_nl_read(struct wsbr_ctxt *ctxt)
+{
+    int ret;
+
+    ret = nl_recvmsgs_default(tun_nl.sock);
+    if (ret == -NLE_NOMEM) {
+        // Some address changes may have been lost
+        WARN("nl_recvmsgs: %s", nl_geterror(ret));
+        tun_nl_addrs_load();
+    } else if (ret < 0 && ret != -NLE_AGAIN) {
+        WARN("nl_recvmsgs: %s", nl_geterror(ret));
+    }
+    return 0;
+}
+
+int wsbr_tun_nl_get_fd(struct wsbr_ctxt *ctxt)
+{
+    if (!tun_nl.sock)
+        return -1;
+    return nl_socket_get_fd(tun_nl.sock);
+}
+
+static void wsbr_tun_nl_init(struct wsbr_ctxt *ctxt)
+{
+    struct rtnl_link *link;
+    int one = 1;
+    int err;
+
+    for (int i = 0; i < TUN_NL_INDEX_SIZE; i++)
+        ns_list_init(&tun_nl.nodes[i]);
+    tun_nl.sock = nl_socket_alloc();
+    FATAL_ON(!tun_nl.sock, 2, "nl_socket_alloc");
+    err = nl_connect(tun_nl.sock, NETLINK_ROUTE);
+    FATAL_ON(err < 0, 2, "nl_connect: %s", nl_geterror(err));
+    // The replies of a whole batch may be queued before they are read
+    err = nl_socket_set_buffer_size(tun_nl.sock, 1024 * 1024, 0);
+    WARN_ON(err < 0, "nl_socket_set_buffer_size: %s", nl_geterror(err));
+    // Do not copy the requests in the error replies
+    err = setsockopt(nl_socket_get_fd(tun_nl.sock), SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
+    WARN_ON(err < 0, "setsockopt NETLINK_CAP_ACK: %m");
+    nl_socket_disable_auto_ack(tun_nl.sock);
+    nl_socket_disable_seq_check(tun_nl.sock);
+    nl_socket_set_nonblocking(tun_nl.sock);
+    nl_socket_modify_err_cb(tun_nl.sock, NL_CB_CUSTOM, tun_nl_error_cb, NULL);
+    nl_socket_modify_cb(tun_nl.sock, NL_CB_VALID, NL_CB_CUSTOM, tun_nl_valid_cb, NULL);
+    err = nl_socket_add_memberships(tun_nl.sock, RTNLGRP_IPV6_IFADDR, RTNLGRP_NEIGH,
+                                    RTNLGRP_IPV6_ROUTE, RTNLGRP_LINK, 0);
+    FATAL_ON(err < 0, 2, "nl_socket_add_memberships: %s", nl_geterror(err));
+    if (!strlen(ctxt->config.neighbor_proxy))
+        return;
+    if (rtnl_link_get_kernel(tun_nl.sock, 0, ctxt->config.neighbor_proxy, &link)) {
+        ERROR("rtnl_link_get_kernel %s", ctxt->config.neighbor_proxy);
         return;
     }
-    ifindex = rtnl_link_get_ifindex(link);
+    tun_nl.proxy_ifindex = rtnl_link_get_ifindex(link);
     rtnl_link_put(link);
-    link = rtnl_link_alloc();
-    rtnl_link_set_ifindex(link, ifindex);
-    nl_addr_parse(ipv6_addr_to_str, AF_INET6, &ipv6_nl_addr);
-    nl_route = rtnl_route_alloc();
-    rtnl_route_set_iif(nl_route, AF_INET6);
-    rtnl_route_set_dst(nl_route, ipv6_nl_addr);
-    nl_nexthop = rtnl_route_nh_alloc();
-    rtnl_route_nh_set_ifindex(nl_nexthop, ifindex);
-    rtnl_route_add_nexthop(nl_route, nl_nexthop);
-    rtnl_route_add(sock, nl_route, 0);
+}
+
+void tun_add_node_to_proxy_neightbl(protocol_interface_info_entry_t *if_entry, uint8_t address[16])
+{
+    struct tun_nl_node *node;
+
+    if (!tun_nl.proxy_ifindex)
+        return;
+    node = tun_nl_node_get(address, true);
+    if (!node->neigh_seq)
+        node->neigh_seq = tun_nl_queue_neigh(address, true);
+}
+
+void tun_add_ipv6_direct_route(protocol_interface_info_entry_t *if_entry, uint8_t address[16])
+{
+    struct tun_nl_node *node;
+
+    if (!strlen(g_ctxt.config.neighbor_proxy) || !tun_nl.tun_ifindex)
+        return;
+    node = tun_nl_node_get(address, true);
+    if (!node->route_seq)
+        node->route_seq = tun_nl_queue_route(address, true);
+}
+
+void tun_del_node(const uint8_t address[16])
+{
+    struct tun_nl_node *node;
+
+    if (!tun_nl.sock)
+        return;
+    node = tun_nl_node_get(address, false);
+    if (!node)
+        return;
+    if (node->neigh_seq)
+        tun_nl_queue_neigh(address, false);
+    if (node->route_seq)
+        tun_nl_queue_route(address, false);
+    node->neigh_seq = 0;
+    node->route_seq = 0;
+    tun_nl_node_del(node);
 }
 
 static void tun_addr_add(struct nl_sock *sock, int ifindex, const uint8_t ipv6_prefix[static 8], const uint8_t hw_mac_addr[static 8], bool register_proxy_ndp)
@@ -229,7 +652,7 @@ static int wsbr_tun_open(char *devname, const uint8_t hw_mac[static 8], uint8_t
 
     if (devname && *devname)
         strcpy(ifr.ifr_name, devname);
-    fd = open("/dev/net/tun", O_RDWR);
+    fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
     if (fd < 0)
         FATAL(2, "tun open: %m");
     if (ioctl(fd, TUNSETIFF, &ifr))
@@ -278,6 +701,7 @@ static int wsbr_tun_open(char *devname, const uint8_t hw_mac[static 8], uint8_t
     rtnl_link_put(link);
 
     nl_socket_free(sock);
+    tun_nl.tun_ifindex = ifindex;
     return fd;
 }
 
@@ -331,9 +755,13 @@ void wsbr_tun_join_mcast_group(int sock_mcast, const char *if_name, const uint8_
 
 void wsbr_tun_init(struct wsbr_ctxt *ctxt)
 {
+    // Needed by wsbr_tun_open() to register the proxy NDP entry of the border
+    // router
+    wsbr_tun_nl_init(ctxt);
     ctxt->tun_fd = wsbr_tun_open(ctxt->config.tun_dev, ctxt->hw_mac,
                                  ctxt->config.ipv6_prefix, ctxt->config.tun_autoconf,
                                  strlen(ctxt->config.neighbor_proxy));
+    tun_nl_addrs_load();
     // It is also possible to use Netlink interface through DEVCONF_ACCEPT_RA
     // but this API is not mapped in libnl-route.
     wbsr_dev_enable_option(ctxt->config.tun_dev, "accept_ra", '0');
@@ -358,31 +786,75 @@ static bool is_icmpv6_type_supported_by_wisun(uint8_t iv6t)
         return false;
 }
 
-void wsbr_tun_read(struct wsbr_ctxt *ctxt)
+// Maximum number of frames queued in the adaptation layer before the TUN is not
+// read anymore
+#define WSBR_TUN_QUEUE_MAX 2
+
+static bool wsbr_tun_queue_full(struct wsbr_ctxt *ctxt)
 {
-    uint8_t buf[1504]; // Max ethernet frame size + TUN header
-    ssize_t len;
+    return lowpan_adaptation_queue_size(ctxt->rcp_if_id) > WSBR_TUN_QUEUE_MAX;
+}
+
+/*
+ * The TUN is removed from the polled fds while the adaptation layer is
+ * congested. The queue is emptied by the TX confirmations from the RCP, so
+ * this function has to be called once they have been processed.
+ */
+void wsbr_tun_resume(struct wsbr_ctxt *ctxt)
+{
+    if (!ctxt->tun_paused || wsbr_tun_queue_full(ctxt))
+        return;
+    ctxt->tun_paused = false;
+    wsbr_fds_set_enabled(&ctxt->fds, ctxt->tun_fd, true);
+}
+
+/*
+ * Read one IPv6 packet from the TUN and send it to the stack. Return a positive
+ * value if a packet has been consumed, so the caller can drain the TUN.
+ */
+int wsbr_tun_read(struct wsbr_ctxt *ctxt)
+{
+    const size_t buf_len = 1504; // Max ethernet frame size + TUN header
     uint8_t ip_version, next_header, icmpv6_type;
     buffer_t * buffer_to_6lowpan = NULL;
     protocol_interface_info_entry_t *cur = protocol_stack_interface_info_get_by_id(ctxt->rcp_if_id);
+    uint8_t *buf;
+    ssize_t len;
 
-    if (lowpan_adaptation_queue_size(ctxt->rcp_if_id) > 2)
-        return;
-    len = read(ctxt->tun_fd, buf, sizeof(buf));
-    ip_version = ((unsigned char) buf[0]) >> 4;
-
-    if (ip_version != 6) {
-        WARN("unsupported ip version (received packet was not IPv6)");
-        return;
+    if (wsbr_tun_queue_full(ctxt)) {
+        ctxt->tun_paused = true;
+        wsbr_fds_set_enabled(&ctxt->fds, ctxt->tun_fd, false);
+        return 0;
     }
 
-    buffer_to_6lowpan = buffer_get_minimal(len);
+    // The packet is read directly in the buffer_t, with the default headroom
+    // for the lower layers
+    buffer_to_6lowpan = buffer_get(buf_len);
     if (!buffer_to_6lowpan)
         FATAL(1,"could not allocate tun buffer_t");
+    buf = buffer_data_pointer(buffer_to_6lowpan);
+    len = read(ctxt->tun_fd, buf, buf_len);
+    if (len <= 0) {
+        if (len < 0 && errno != EAGAIN)
+            WARN("tun read: %m");
+        buffer_free(buffer_to_6lowpan);
+        return 0;
+    }
+    buffer_data_length_set(buffer_to_6lowpan, len);
 
-    buffer_to_6lowpan->interface = cur;
+    ip_version = ((unsigned char) buf[0]) >> 4;
+    if (ip_version != 6) {
+        WARN("unsupported ip version (received packet was not IPv6)");
+        buffer_free(buffer_to_6lowpan);
+        return 1;
+    }
+    if (len < 40) {
+        WARN("tun read: truncated IPv6 header");
+        buffer_free(buffer_to_6lowpan);
+        return 1;
+    }
 
-    buffer_data_add(buffer_to_6lowpan, buf, len);
+    buffer_to_6lowpan->interface = cur;
     buffer_to_6lowpan->payload_length = len;
 
     next_header = buf[6];
@@ -397,7 +869,7 @@ void wsbr_tun_read(struct wsbr_ctxt *ctxt)
     if (addr_is_ipv6_multicast(buffer_to_6lowpan->dst_sa.address)) {
         if(!addr_am_group_member_on_interface(cur, buffer_to_6lowpan->dst_sa.address)) {
             buffer_free(buffer_to_6lowpan);
-            return;
+            return 1;
         }
     }
 
@@ -408,10 +880,11 @@ void wsbr_tun_read(struct wsbr_ctxt *ctxt)
         icmpv6_type = buf[40];
         if (!is_icmpv6_type_supported_by_wisun(icmpv6_type)) {
             buffer_free(buffer_to_6lowpan);
-            return;
+            return 1;
         }
     }
 
     buffer_to_6lowpan->info = (buffer_info_t)(B_DIR_DOWN | B_FROM_IPV6_FWD | B_TO_IPV6_FWD);
     protocol_push(buffer_to_6lowpan);
+    return 1;
 }
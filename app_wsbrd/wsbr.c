@@ -11,6 +11,7 @@
  * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
  */
 #include "nsconfig.h"
+#include <errno.h>
 #include <poll.h>
 #include <unistd.h>
 #include <signal.h>
@@ -37,9 +38,11 @@
 #include "stack/source/6lowpan/mac/mac_helper.h"
 #include "stack/source/6lowpan/ws/ws_common_defines.h"
 #include "stack/source/6lowpan/ws/ws_regulation.h"
+#include "stack/source/6lowpan/ws/ws_pae_nvm_store.h"
 #include "stack/source/core/ns_address_internal.h"
 #include "stack/source/nwk_interface/protocol_abstract.h"
 #include "stack/source/security/kmp/kmp_socket_if.h"
+#include "stack/source/security/protocols/tls_sec_prot/tls_sec_prot_worker.h"
 #include "stack/source/dhcpv6_client/dhcpv6_client_api.h"
 #include "stack/source/libdhcpv6/libdhcpv6.h"
 
@@ -50,23 +53,10 @@
 #include "libwsbrd.h"
 #include "wsbr.h"
 #include "timers.h"
+#include "wsbr_fds.h"
 #include "dbus.h"
 #include "tun.h"
 
-enum {
-    POLLFD_TUN,
-    POLLFD_RCP,
-    POLLFD_DBUS,
-    POLLFD_EVENT,
-    POLLFD_TIMER,
-    POLLFD_DHCP_SERVER,
-    POLLFD_BR_EAPOL_RELAY,
-    POLLFD_EAPOL_RELAY,
-    POLLFD_PAE_AUTH,
-    POLLFD_RADIUS,
-    POLLFD_COUNT,
-};
-
 // See warning in wsbr.h
 struct wsbr_ctxt g_ctxt = {
     .mac_api.mac_initialize = wsbr_mac_init,
@@ -326,8 +316,10 @@ static int wsbr_uart_tx(struct os_ctxt *os_ctxt, const void *buf, unsigned int b
 
     ret = uart_tx(os_ctxt, buf, buf_len);
     // Old firmware may merge close Rx events
-    if (fw_api_older_than(ctxt, 0, 4, 0))
+    if (fw_api_older_than(ctxt, 0, 4, 0)) {
+        uart_tx_flush(os_ctxt);
         usleep(20000);
+    }
     return ret;
 }
 
@@ -399,72 +391,125 @@ static void wsbr_rcp_init(struct wsbr_ctxt *ctxt)
     ctxt->rcp_init_state |= RCP_INIT_DONE;
 }
 
-static void wsbr_fds_init(struct wsbr_ctxt *ctxt, struct pollfd *fds)
+static int wsbr_dbus_cb(struct wsbr_ctxt *ctxt, int fd)
 {
-    fds[POLLFD_DBUS].fd = dbus_get_fd(ctxt);
-    fds[POLLFD_DBUS].events = POLLIN;
-    fds[POLLFD_RCP].fd = ctxt->os_ctxt->trig_fd;
-    fds[POLLFD_RCP].events = POLLIN;
-    fds[POLLFD_TUN].fd = ctxt->tun_fd;
-    fds[POLLFD_TUN].events = POLLIN;
-    fds[POLLFD_EVENT].fd = ctxt->os_ctxt->event_fd[0];
-    fds[POLLFD_EVENT].events = POLLIN;
-    fds[POLLFD_TIMER].fd = ctxt->timerfd;
-    fds[POLLFD_TIMER].events = POLLIN;
-    fds[POLLFD_DHCP_SERVER].fd = dhcp_service_get_server_socket_fd();
-    fds[POLLFD_DHCP_SERVER].events = POLLIN;
-    fds[POLLFD_BR_EAPOL_RELAY].fd = ws_bbr_eapol_relay_get_socket_fd();
-    fds[POLLFD_BR_EAPOL_RELAY].events = POLLIN;
-    fds[POLLFD_EAPOL_RELAY].fd = ws_bbr_eapol_auth_relay_get_socket_fd();
-    fds[POLLFD_EAPOL_RELAY].events = POLLIN;
-    fds[POLLFD_PAE_AUTH].fd = kmp_socket_if_get_pae_socket_fd();
-    fds[POLLFD_PAE_AUTH].events = POLLIN;
-    fds[POLLFD_RADIUS].fd = kmp_socket_if_get_radius_sockfd();
-    fds[POLLFD_RADIUS].events = POLLIN;
+    return dbus_process(ctxt);
 }
 
-static void wsbr_poll(struct wsbr_ctxt *ctxt, struct pollfd *fds)
+/*
+ * The sockets below are edge-triggered, so their callbacks are called until
+ * recv() returns EAGAIN. A 0-length datagram or an error reported by the
+ * socket (eg. ICMP port unreachable) does not mean that the socket is empty.
+ */
+static int wsbr_socket_drain(ssize_t ret)
+{
+    if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+    if (ret < 0 && errno != EINTR)
+        WARN("recv: %m");
+    return 1;
+}
+
+static int wsbr_dhcp_server_cb(struct wsbr_ctxt *ctxt, int fd)
+{
+    return wsbr_socket_drain(recv_dhcp_server_msg());
+}
+
+static int wsbr_br_eapol_relay_cb(struct wsbr_ctxt *ctxt, int fd)
+{
+    return wsbr_socket_drain(ws_bbr_eapol_relay_socket_cb(fd));
+}
+
+static int wsbr_eapol_relay_cb(struct wsbr_ctxt *ctxt, int fd)
+{
+    return wsbr_socket_drain(ws_bbr_eapol_auth_relay_socket_cb(fd));
+}
+
+static int wsbr_pae_auth_cb(struct wsbr_ctxt *ctxt, int fd)
+{
+    return wsbr_socket_drain(kmp_socket_if_pae_socket_cb(fd));
+}
+
+static int wsbr_radius_cb(struct wsbr_ctxt *ctxt, int fd)
+{
+    return wsbr_socket_drain(kmp_socket_if_radius_socket_cb(fd));
+}
+
+static int wsbr_tun_cb(struct wsbr_ctxt *ctxt, int fd)
+{
+    return wsbr_tun_read(ctxt);
+}
+
+static int wsbr_tun_nl_cb(struct wsbr_ctxt *ctxt, int fd)
+{
+    return wsbr_tun_nl_read(ctxt);
+}
+
+static int wsbr_event_cb(struct wsbr_ctxt *ctxt, int fd)
 {
     uint64_t val;
-    int ret;
 
+    read(fd, &val, sizeof(val));
+    WARN_ON(val != 'W');
+    eventOS_scheduler_run_until_idle();
+    return 0;
+}
+
+static int wsbr_rcp_cb(struct wsbr_ctxt *ctxt, int fd)
+{
+    rcp_rx(ctxt);
+    // Some frames may be already buffered, they are not signalled by the fd
+    return ctxt->os_ctxt->uart_next_frame_ready;
+}
+
+static int wsbr_timer_cb(struct wsbr_ctxt *ctxt, int fd)
+{
+    wsbr_common_timer_process(ctxt);
+    return 0;
+}
+
+static void wsbr_fds_setup(struct wsbr_ctxt *ctxt)
+{
+    struct wsbr_fds *fds = &ctxt->fds;
+
+    wsbr_fds_init(fds);
+    wsbr_fds_register(fds, dbus_get_fd(ctxt),                       0,            wsbr_dbus_cb);
+    wsbr_fds_register(fds, ctxt->os_ctxt->trig_fd,                  0,            wsbr_rcp_cb);
+    wsbr_fds_register(fds, ctxt->tun_fd,                            0,            wsbr_tun_cb);
+    wsbr_fds_register(fds, wsbr_tun_nl_get_fd(ctxt),                0,            wsbr_tun_nl_cb);
+    wsbr_fds_register(fds, ctxt->os_ctxt->event_fd[0],              0,            wsbr_event_cb);
+    wsbr_fds_register(fds, ctxt->timerfd,                           0,            wsbr_timer_cb);
+    wsbr_fds_register(fds, dhcp_service_get_server_socket_fd(),     WSBR_FD_EDGE, wsbr_dhcp_server_cb);
+    wsbr_fds_register(fds, ws_bbr_eapol_relay_get_socket_fd(),      WSBR_FD_EDGE, wsbr_br_eapol_relay_cb);
+    wsbr_fds_register(fds, ws_bbr_eapol_auth_relay_get_socket_fd(), WSBR_FD_EDGE, wsbr_eapol_relay_cb);
+    wsbr_fds_register(fds, kmp_socket_if_get_pae_socket_fd(),       WSBR_FD_EDGE, wsbr_pae_auth_cb);
+    wsbr_fds_register(fds, kmp_socket_if_get_radius_sockfd(),       WSBR_FD_EDGE, wsbr_radius_cb);
+}
+
+static void wsbr_poll(struct wsbr_ctxt *ctxt)
+{
+    int timeout_ms;
+
+    // Coalesce the topology changes of the previous iterations in a single
+    // signal
+    timeout_ms = dbus_flush_nodes_change(ctxt);
+    wsbr_common_timer_rearm(ctxt);
+    // Frames queued during the previous iteration must be sent before sleeping
+    uart_tx_flush(ctxt->os_ctxt);
+    wsbr_tun_nl_flush(ctxt);
+    // A frame may have been buffered by a rcp_rx() called outside of the main
+    // loop (eg. during a synchronous wait)
     if (ctxt->os_ctxt->uart_next_frame_ready)
-        ret = poll(fds, POLLFD_COUNT, 0);
-    else
-        ret = poll(fds, POLLFD_COUNT, -1);
-    FATAL_ON(ret < 0, 2, "poll: %m");
-
-    if (fds[POLLFD_DBUS].revents & POLLIN)
-        dbus_process(ctxt);
-    if (fds[POLLFD_DHCP_SERVER].revents & POLLIN)
-        recv_dhcp_server_msg();
-    if (fds[POLLFD_BR_EAPOL_RELAY].revents & POLLIN)
-        ws_bbr_eapol_relay_socket_cb(fds[POLLFD_BR_EAPOL_RELAY].fd);
-    if (fds[POLLFD_EAPOL_RELAY].revents & POLLIN)
-        ws_bbr_eapol_auth_relay_socket_cb(fds[POLLFD_EAPOL_RELAY].fd);
-    if (fds[POLLFD_PAE_AUTH].revents & POLLIN)
-        kmp_socket_if_pae_socket_cb(fds[POLLFD_PAE_AUTH].fd);
-    if (fds[POLLFD_RADIUS].revents & POLLIN)
-        kmp_socket_if_radius_socket_cb(fds[POLLFD_RADIUS].fd);
-    if (fds[POLLFD_TUN].revents & POLLIN)
-        wsbr_tun_read(ctxt);
-    if (fds[POLLFD_EVENT].revents & POLLIN) {
-        read(ctxt->os_ctxt->event_fd[0], &val, sizeof(val));
-        WARN_ON(val != 'W');
-        eventOS_scheduler_run_until_idle();
-    }
-    if (fds[POLLFD_RCP].revents & POLLIN ||
-        fds[POLLFD_RCP].revents & POLLERR ||
-        ctxt->os_ctxt->uart_next_frame_ready)
-        rcp_rx(ctxt);
-    if (fds[POLLFD_TIMER].revents & POLLIN)
-        wsbr_common_timer_process(ctxt);
+        wsbr_fds_set_pending(&ctxt->fds, ctxt->os_ctxt->trig_fd);
+    wsbr_fds_dispatch(&ctxt->fds, ctxt, timeout_ms);
+    // TX confirmations received during this iteration may have freed some
+    // room in the adaptation layer
+    wsbr_tun_resume(ctxt);
 }
 
 int wsbr_main(int argc, char *argv[])
 {
     struct wsbr_ctxt *ctxt = &g_ctxt;
-    struct pollfd fds[POLLFD_COUNT];
 
     INFO("Silicon Labs Wi-SUN border router %s", version_daemon_str);
     signal(SIGINT, kill_handler);
@@ -482,7 +527,10 @@ int wsbr_main(int argc, char *argv[])
     platform_critical_init();
     eventOS_scheduler_os_init(ctxt->os_ctxt);
     eventOS_scheduler_init();
+    if (tls_sec_prot_worker_init(ctxt->config.tls_workers))
+        FATAL(1, "cannot start TLS workers");
     ns_file_system_set_root_path(ctxt->config.storage_prefix[0] ? ctxt->config.storage_prefix : NULL);
+    ws_pae_nvm_store_mmap_enable(ctxt->config.storage_mmap);
     if (ctxt->config.uart_dev[0]) {
         ctxt->rcp_tx = wsbr_uart_tx;
         ctxt->rcp_rx = uart_rx;
@@ -504,6 +552,7 @@ int wsbr_main(int argc, char *argv[])
 
     if (net_init_core())
         BUG("net_init_core");
+    protocol_stats_start(&ctxt->stats);
 
     ctxt->rcp_if_id = arm_nwk_interface_lowpan_init(&ctxt->mac_api, "ws0");
     if (ctxt->rcp_if_id < 0)
@@ -515,10 +564,13 @@ int wsbr_main(int argc, char *argv[])
 
     dbus_register(ctxt);
 
-    wsbr_fds_init(ctxt, fds);
+    wsbr_fds_setup(ctxt);
+    // From now, the frames sent to the RCP are written once per iteration of
+    // the main loop
+    ctxt->os_ctxt->uart_tx_batch = true;
 
     while (true)
-        wsbr_poll(ctxt, fds);
+        wsbr_poll(ctxt);
 
     return 0;
 }
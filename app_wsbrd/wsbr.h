@@ -27,9 +27,11 @@ typedef struct sd_bus sd_bus;
 #include "stack/mac/mac_api.h"
 #include "stack/mac/fhss_config.h"
 #include "stack/net_interface.h"
+#include "stack/nwk_stats_api.h"
 #include "stack/source/mac/rf_driver_storage.h"
 
 #include "commandline.h"
+#include "wsbr_fds.h"
 
 struct spinel_buffer;
 struct phy_device_driver_s;
@@ -41,10 +43,15 @@ struct wsbr_ctxt {
     struct wsbrd_conf config;
     sd_bus *dbus;
 
+    struct wsbr_fds fds;
+
     int timerfd;
+    uint64_t timer_ref_ms;      // CLOCK_MONOTONIC time of the last accounted tick
+    uint64_t timer_deadline_ms; // Currently armed deadline (tickless mode)
 
     int  tun_if_id;
     int  tun_fd;
+    bool tun_paused;
     int  sock_mcast;
 
     uint32_t rcp_init_state;
@@ -71,6 +78,8 @@ struct wsbr_ctxt {
 
     uint8_t phy_operating_modes[16]; // 15 possible phy_mode_id + 1 sentinel value
 
+    nwk_stats_t stats;
+
     // For DebugPing dbus interface
     int ping_socket_fd;
 };
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2021-2022 Silicon Laboratories Inc. (www.silabs.com)
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of the Silicon Labs Master Software License
+ * Agreement (MSLA) available at [1].  This software is distributed to you in
+ * Object Code format and/or Source Code format and is governed by the sections
+ * of the MSLA applicable to Object Code, Source Code and Modified Open Source
+ * Code. By using this software, you agree to the terms of the MSLA.
+ *
+ * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
+ */
+#include <sys/epoll.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common/log.h"
+#include "common/utils.h"
+#include "timers.h"
+#include "wsbr_fds.h"
+
+// Maximum number of consecutive calls of a callback during one iteration
+#define WSBR_FDS_BATCH 16
+
+void wsbr_fds_init(struct wsbr_fds *fds)
+{
+    memset(fds, 0, sizeof(*fds));
+    fds->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    FATAL_ON(fds->epoll_fd < 0, 2, "epoll_create1: %m");
+}
+
+static void wsbr_fds_grow(struct wsbr_fds *fds, int fd)
+{
+    int len = fds->handlers_len;
+
+    if (fd < len)
+        return;
+    while (len <= fd)
+        len = len ? len * 2 : 16;
+    fds->handlers = realloc(fds->handlers, len * sizeof(*fds->handlers));
+    fds->pending = realloc(fds->pending, len * sizeof(*fds->pending));
+    FATAL_ON(!fds->handlers || !fds->pending, 2, "realloc: %m");
+    memset(fds->handlers + fds->handlers_len, 0, (len - fds->handlers_len) * sizeof(*fds->handlers));
+    fds->handlers_len = len;
+}
+
+void wsbr_fds_register(struct wsbr_fds *fds, int fd, int flags, wsbr_fd_cb process)
+{
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data.fd = fd,
+    };
+    int ret;
+
+    if (fd < 0)
+        return;
+    wsbr_fds_grow(fds, fd);
+    BUG_ON(fds->handlers[fd].registered, "fd %d already registered", fd);
+    if (flags & WSBR_FD_EDGE)
+        event.events |= EPOLLET;
+    ret = epoll_ctl(fds->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    FATAL_ON(ret < 0, 2, "epoll_ctl: %m");
+    fds->handlers[fd].process = process;
+    fds->handlers[fd].flags = flags;
+    fds->handlers[fd].registered = true;
+    fds->handlers[fd].disabled = false;
+}
+
+void wsbr_fds_unregister(struct wsbr_fds *fds, int fd)
+{
+    int ret;
+
+    if (fd < 0 || fd >= fds->handlers_len || !fds->handlers[fd].registered)
+        return;
+    ret = epoll_ctl(fds->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    FATAL_ON(ret < 0, 2, "epoll_ctl: %m");
+    // The fd may still be referenced by the pending list. Since the handler is
+    // not registered anymore, it will be ignored.
+    fds->handlers[fd].registered = false;
+    fds->handlers[fd].process = NULL;
+}
+
+/*
+ * Mark fd as ready even if epoll does not report it. Useful when data has
+ * already been read and buffered out of the fd.
+ */
+void wsbr_fds_set_pending(struct wsbr_fds *fds, int fd)
+{
+    struct wsbr_fd_handler *handler;
+
+    BUG_ON(fd < 0 || fd >= fds->handlers_len || !fds->handlers[fd].registered);
+    handler = &fds->handlers[fd];
+    if (handler->pending)
+        return;
+    handler->pending = true;
+    fds->pending[fds->pending_len++] = fd;
+}
+
+/*
+ * Stop (or restart) watching fd without forgetting its callback. Useful to
+ * apply backpressure when the consumer of the data is congested.
+ */
+void wsbr_fds_set_enabled(struct wsbr_fds *fds, int fd, bool enabled)
+{
+    struct epoll_event event = {
+        .events = enabled ? EPOLLIN : 0,
+        .data.fd = fd,
+    };
+    struct wsbr_fd_handler *handler;
+    int ret;
+
+    BUG_ON(fd < 0 || fd >= fds->handlers_len || !fds->handlers[fd].registered);
+    handler = &fds->handlers[fd];
+    if (handler->disabled == !enabled)
+        return;
+    if (enabled && handler->flags & WSBR_FD_EDGE)
+        event.events |= EPOLLET;
+    ret = epoll_ctl(fds->epoll_fd, EPOLL_CTL_MOD, fd, &event);
+    FATAL_ON(ret < 0, 2, "epoll_ctl: %m");
+    handler->disabled = !enabled;
+}
+
+static void wsbr_fds_run(struct wsbr_fds *fds, struct wsbr_ctxt *ctxt, int fd)
+{
+    struct wsbr_fd_handler *handler = &fds->handlers[fd];
+    int i;
+
+    // A callback is never called when its fd may be empty (unless it returned
+    // a positive value)
+    if (handler->last_run == fds->iteration)
+        return;
+    handler->last_run = fds->iteration;
+    for (i = 0; i < WSBR_FDS_BATCH; i++) {
+        // The callback may unregister or disable the fd
+        if (!handler->registered || handler->disabled)
+            return;
+        if (handler->process(ctxt, fd) <= 0)
+            return;
+    }
+    wsbr_fds_set_pending(fds, fd);
+}
+
+void wsbr_fds_dispatch(struct wsbr_fds *fds, struct wsbr_ctxt *ctxt, int timeout_ms)
+{
+    struct epoll_event events[32];
+    int pending[max(fds->pending_len, 1)];
+    int pending_len = fds->pending_len;
+    int ret, fd, i;
+
+    // Callbacks which did not consume all their data during the previous
+    // iteration run again, but without preventing the other fds to be served.
+    memcpy(pending, fds->pending, pending_len * sizeof(*pending));
+    fds->pending_len = 0;
+    for (i = 0; i < pending_len; i++)
+        fds->handlers[pending[i]].pending = false;
+    fds->iteration++;
+
+    ret = epoll_wait(fds->epoll_fd, events, ARRAY_SIZE(events), pending_len ? 0 : timeout_ms);
+    FATAL_ON(ret < 0 && errno != EINTR, 2, "epoll_wait: %m");
+    wsbr_common_timer_sync(ctxt);
+    for (i = 0; i < ret; i++) {
+        fd = events[i].data.fd;
+        if (fd >= fds->handlers_len || !fds->handlers[fd].registered)
+            continue;
+        wsbr_fds_run(fds, ctxt, fd);
+    }
+    for (i = 0; i < pending_len; i++) {
+        fd = pending[i];
+        if (!fds->handlers[fd].registered)
+            continue;
+        wsbr_fds_run(fds, ctxt, fd);
+    }
+}
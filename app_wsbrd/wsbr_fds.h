@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2021-2022 Silicon Laboratories Inc. (www.silabs.com)
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of the Silicon Labs Master Software License
+ * Agreement (MSLA) available at [1].  This software is distributed to you in
+ * Object Code format and/or Source Code format and is governed by the sections
+ * of the MSLA applicable to Object Code, Source Code and Modified Open Source
+ * Code. By using this software, you agree to the terms of the MSLA.
+ *
+ * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
+ */
+#ifndef WSBR_FDS_H
+#define WSBR_FDS_H
+
+#include <stdbool.h>
+
+struct wsbr_ctxt;
+
+/*
+ * Callback called when a file descriptor is readable. It has to return a
+ * positive value if it has consumed some data and may be called again (ie. the
+ * file descriptor may still contain data). In this case, the callback is
+ * called again, up to a budget after which the file descriptor is rescheduled
+ * for the next iteration of the main loop.
+ * Callbacks of file descriptors registered with WSBR_FD_EDGE must drain their
+ * file descriptor (they have to return 0 only once read() returns EAGAIN).
+ */
+typedef int (*wsbr_fd_cb)(struct wsbr_ctxt *ctxt, int fd);
+
+enum {
+    WSBR_FD_EDGE = 0x01,
+};
+
+struct wsbr_fd_handler {
+    wsbr_fd_cb process;
+    bool registered;
+    bool disabled;
+    bool pending;
+    int flags;
+    unsigned int last_run;
+};
+
+struct wsbr_fds {
+    int epoll_fd;
+    struct wsbr_fd_handler *handlers; // indexed by fd
+    int handlers_len;
+    int *pending;
+    int pending_len;
+    unsigned int iteration;
+};
+
+void wsbr_fds_init(struct wsbr_fds *fds);
+void wsbr_fds_register(struct wsbr_fds *fds, int fd, int flags, wsbr_fd_cb process);
+void wsbr_fds_unregister(struct wsbr_fds *fds, int fd);
+void wsbr_fds_set_pending(struct wsbr_fds *fds, int fd);
+void wsbr_fds_set_enabled(struct wsbr_fds *fds, int fd, bool enabled);
+void wsbr_fds_dispatch(struct wsbr_fds *fds, struct wsbr_ctxt *ctxt, int timeout_ms);
+
+#endif
@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include "common/bus_uart.h"
 #include "common/log.h"
 #include "common/os_types.h"
 #include "common/named_values.h"
@@ -239,6 +240,8 @@ static void handle_crc_error(struct wsbr_ctxt *ctxt, uint16_t crc, uint32_t fram
     int extra_frame;
     int i;
 
+    // The frames below must not be sent again before their first transmission
+    uart_tx_flush(ctxt->os_ctxt);
     for (i = 0; i < buffers_len; i++) {
         if (buffers[i].crc == crc) {
             if (buffers[i].frame_len < frame_len) {
@@ -220,7 +220,7 @@ void kill_handler(int signal)
     exit(0);
 }
 
-static void wsbr_fds_init(struct wsbr_ctxt *ctxt, struct pollfd *fds)
+static void wsrouter_fds_init(struct wsbr_ctxt *ctxt, struct pollfd *fds)
 {
     fds[POLLFD_RCP].fd = ctxt->os_ctxt->trig_fd;
     fds[POLLFD_RCP].events = POLLIN;
@@ -235,12 +235,14 @@ static void wsbr_poll(struct wsbr_ctxt *ctxt, struct pollfd *fds)
     uint64_t val;
     int ret;
 
+    wsbr_common_timer_rearm(ctxt);
     if (ctxt->os_ctxt->uart_next_frame_ready)
         ret = poll(fds, POLLFD_COUNT, 0);
     else
         ret = poll(fds, POLLFD_COUNT, -1);
     if (ret < 0)
         FATAL(2, "poll: %m");
+    wsbr_common_timer_sync(ctxt);
 
     if (fds[POLLFD_EVENT].revents & POLLIN) {
         read(ctxt->os_ctxt->event_fd[0], &val, sizeof(val));
@@ -297,7 +299,7 @@ int main(int argc, char *argv[])
     if (eventOS_event_handler_create(&wsbr_tasklet, ARM_LIB_TASKLET_INIT_EVENT) < 0)
         BUG("eventOS_event_handler_create");
 
-    wsbr_fds_init(ctxt, fds);
+    wsrouter_fds_init(ctxt, fds);
 
     while (true)
         wsbr_poll(ctxt, fds);
@@ -92,9 +92,11 @@ pub trait ComSilabsWisunBorderRouter {
     fn remove_root_certificate(&self, arg0: &str) -> Result<(), dbus::Error>;
     fn revoke_node(&self, arg0: Vec<u8>) -> Result<(), dbus::Error>;
     fn revoke_apply(&self) -> Result<(), dbus::Error>;
+    fn get_nodes_since(&self, arg0: u32, arg1: u32, arg2: u32) -> Result<(u32, bool, Vec<(Vec<u8>, arg::PropMap)>, Vec<Vec<u8>>), dbus::Error>;
     fn gtks(&self) -> Result<Vec<Vec<u8>>, dbus::Error>;
     fn gaks(&self) -> Result<Vec<Vec<u8>>, dbus::Error>;
     fn nodes(&self) -> Result<Vec<(Vec<u8>, arg::PropMap)>, dbus::Error>;
+    fn nodes_generation(&self) -> Result<u32, dbus::Error>;
     fn hw_address(&self) -> Result<Vec<u8>, dbus::Error>;
     fn wisun_network_name(&self) -> Result<String, dbus::Error>;
     fn wisun_size(&self) -> Result<String, dbus::Error>;
@@ -102,6 +104,14 @@ pub trait ComSilabsWisunBorderRouter {
     fn wisun_mode(&self) -> Result<u32, dbus::Error>;
     fn wisun_class(&self) -> Result<u32, dbus::Error>;
     fn wisun_pan_id(&self) -> Result<u16, dbus::Error>;
+    fn tls_full_handshakes(&self) -> Result<u32, dbus::Error>;
+    fn tls_resumed_handshakes(&self) -> Result<u32, dbus::Error>;
+    fn mpl_total_memory(&self) -> Result<u32, dbus::Error>;
+    fn mpl_used_memory(&self) -> Result<u32, dbus::Error>;
+    fn mpl_evicted_messages(&self) -> Result<u32, dbus::Error>;
+    fn llc_message_pool_used(&self) -> Result<u16, dbus::Error>;
+    fn llc_message_pool_peak(&self) -> Result<u16, dbus::Error>;
+    fn llc_message_pool_overflow(&self) -> Result<u32, dbus::Error>;
 }
 
 impl<'a, T: blocking::BlockingSender, C: ::std::ops::Deref<Target=T>> ComSilabsWisunBorderRouter for blocking::Proxy<'a, C> {
@@ -126,6 +136,10 @@ impl<'a, T: blocking::BlockingSender, C: ::std::ops::Deref<Target=T>> ComSilabsW
         self.method_call("com.silabs.Wisun.BorderRouter", "RevokeApply", ())
     }
 
+    fn get_nodes_since(&self, arg0: u32, arg1: u32, arg2: u32) -> Result<(u32, bool, Vec<(Vec<u8>, arg::PropMap)>, Vec<Vec<u8>>), dbus::Error> {
+        self.method_call("com.silabs.Wisun.BorderRouter", "GetNodesSince", (arg0, arg1, arg2, ))
+    }
+
     fn gtks(&self) -> Result<Vec<Vec<u8>>, dbus::Error> {
         <Self as blocking::stdintf::org_freedesktop_dbus::Properties>::get(&self, "com.silabs.Wisun.BorderRouter", "Gtks")
     }
@@ -138,6 +152,10 @@ impl<'a, T: blocking::BlockingSender, C: ::std::ops::Deref<Target=T>> ComSilabsW
         <Self as blocking::stdintf::org_freedesktop_dbus::Properties>::get(&self, "com.silabs.Wisun.BorderRouter", "Nodes")
     }
 
+    fn nodes_generation(&self) -> Result<u32, dbus::Error> {
+        <Self as blocking::stdintf::org_freedesktop_dbus::Properties>::get(&self, "com.silabs.Wisun.BorderRouter", "NodesGeneration")
+    }
+
     fn hw_address(&self) -> Result<Vec<u8>, dbus::Error> {
         <Self as blocking::stdintf::org_freedesktop_dbus::Properties>::get(&self, "com.silabs.Wisun.BorderRouter", "HwAddress")
     }
@@ -165,4 +183,66 @@ impl<'a, T: blocking::BlockingSender, C: ::std::ops::Deref<Target=T>> ComSilabsW
     fn wisun_pan_id(&self) -> Result<u16, dbus::Error> {
         <Self as blocking::stdintf::org_freedesktop_dbus::Properties>::get(&self, "com.silabs.Wisun.BorderRouter", "WisunPanId")
     }
+
+    fn tls_full_handshakes(&self) -> Result<u32, dbus::Error> {
+        <Self as blocking::stdintf::org_freedesktop_dbus::Properties>::get(&self, "com.silabs.Wisun.BorderRouter", "TlsFullHandshakes")
+    }
+
+    fn tls_resumed_handshakes(&self) -> Result<u32, dbus::Error> {
+        <Self as blocking::stdintf::org_freedesktop_dbus::Properties>::get(&self, "com.silabs.Wisun.BorderRouter", "TlsResumedHandshakes")
+    }
+
+    fn mpl_total_memory(&self) -> Result<u32, dbus::Error> {
+        <Self as blocking::stdintf::org_freedesktop_dbus::Properties>::get(&self, "com.silabs.Wisun.BorderRouter", "MplTotalMemory")
+    }
+
+    fn mpl_used_memory(&self) -> Result<u32, dbus::Error> {
+        <Self as blocking::stdintf::org_freedesktop_dbus::Properties>::get(&self, "com.silabs.Wisun.BorderRouter", "MplUsedMemory")
+    }
+
+    fn mpl_evicted_messages(&self) -> Result<u32, dbus::Error> {
+        <Self as blocking::stdintf::org_freedesktop_dbus::Properties>::get(&self, "com.silabs.Wisun.BorderRouter", "MplEvictedMessages")
+    }
+
+    fn llc_message_pool_used(&self) -> Result<u16, dbus::Error> {
+        <Self as blocking::stdintf::org_freedesktop_dbus::Properties>::get(&self, "com.silabs.Wisun.BorderRouter", "LlcMessagePoolUsed")
+    }
+
+    fn llc_message_pool_peak(&self) -> Result<u16, dbus::Error> {
+        <Self as blocking::stdintf::org_freedesktop_dbus::Properties>::get(&self, "com.silabs.Wisun.BorderRouter", "LlcMessagePoolPeak")
+    }
+
+    fn llc_message_pool_overflow(&self) -> Result<u32, dbus::Error> {
+        <Self as blocking::stdintf::org_freedesktop_dbus::Properties>::get(&self, "com.silabs.Wisun.BorderRouter", "LlcMessagePoolOverflow")
+    }
+}
+
+#[derive(Debug)]
+pub struct ComSilabsWisunBorderRouterNodesChanged {
+    pub arg0: u32,
+    pub arg1: Vec<(Vec<u8>, arg::PropMap)>,
+    pub arg2: Vec<Vec<u8>>,
+}
+
+impl arg::AppendAll for ComSilabsWisunBorderRouterNodesChanged {
+    fn append(&self, i: &mut arg::IterAppend) {
+        arg::RefArg::append(&self.arg0, i);
+        arg::RefArg::append(&self.arg1, i);
+        arg::RefArg::append(&self.arg2, i);
+    }
+}
+
+impl arg::ReadAll for ComSilabsWisunBorderRouterNodesChanged {
+    fn read(i: &mut arg::Iter) -> Result<Self, arg::TypeMismatchError> {
+        Ok(ComSilabsWisunBorderRouterNodesChanged {
+            arg0: i.read()?,
+            arg1: i.read()?,
+            arg2: i.read()?,
+        })
+    }
+}
+
+impl dbus::message::SignalArgs for ComSilabsWisunBorderRouterNodesChanged {
+    const NAME: &'static str = "NodesChanged";
+    const INTERFACE: &'static str = "com.silabs.Wisun.BorderRouter";
 }
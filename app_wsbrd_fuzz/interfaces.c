@@ -1,6 +1,7 @@
 #include <stdint.h>
 #include <assert.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 #include "nsconfig.h"
 #include "stack/source/core/ns_address_internal.h"
@@ -81,6 +82,8 @@ void __wrap_wsbr_tun_init(struct wsbr_ctxt *ctxt)
 
     ret = pipe(g_fuzz_ctxt.tun_pipe);
     FATAL_ON(ret < 0, 2, "pipe: %m");
+    ret = fcntl(g_fuzz_ctxt.tun_pipe[0], F_SETFL, O_NONBLOCK);
+    FATAL_ON(ret < 0, 2, "fcntl: %m");
     ctxt->tun_fd = g_fuzz_ctxt.tun_pipe[0];
 
     memcpy(g_fuzz_ctxt.tun_gua, g_ctxt.config.ipv6_prefix, 8);
@@ -138,7 +141,7 @@ void fuzz_replay_socket_init(struct fuzz_ctxt *ctxt)
     }
 }
 
-static void fuzz_capture_socket(int fd, void *buf, size_t size)
+static void fuzz_capture_socket(int fd, void *buf, ssize_t size)
 {
     struct fuzz_ctxt *ctxt = &g_fuzz_ctxt;
     int i;
@@ -192,6 +195,9 @@ int __wrap_socket(int domain, int type, int protocol)
     BUG_ON(g_fuzz_ctxt.socket_pipe_count >= IF_SOCKET_COUNT);
     ret = pipe(g_fuzz_ctxt.socket_pipes[g_fuzz_ctxt.socket_pipe_count]);
     FATAL_ON(ret < 0, 2, "pipe: %m");
+    // Socket callbacks drain their fd until EAGAIN
+    ret = fcntl(g_fuzz_ctxt.socket_pipes[g_fuzz_ctxt.socket_pipe_count][0], F_SETFL, O_NONBLOCK);
+    FATAL_ON(ret < 0, 2, "fcntl: %m");
 
     return g_fuzz_ctxt.socket_pipes[g_fuzz_ctxt.socket_pipe_count++][0];
 }
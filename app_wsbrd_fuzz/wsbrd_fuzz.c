@@ -1,4 +1,5 @@
 #include <sys/eventfd.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "stack-scheduler/source/timer_sys.h"
@@ -39,6 +40,8 @@ int __wrap_uart_open(const char *device, int bitrate, bool hardflow)
     }
     if (g_fuzz_ctxt.capture_enabled || g_fuzz_ctxt.replay_count)
         FATAL_ON(!g_ctxt.config.tun_autoconf, 1, "tun_autoconf set to false while using capture/replay");
+    if (g_fuzz_ctxt.capture_enabled || g_fuzz_ctxt.replay_count)
+        FATAL_ON(g_ctxt.config.tickless, 1, "tickless set to true while using capture/replay");
 
     if (g_fuzz_ctxt.replay_count)
         return g_fuzz_ctxt.replay_fds[g_fuzz_ctxt.replay_i++];
@@ -135,9 +138,9 @@ ssize_t __wrap_read(int fd, void *buf, size_t count)
             if (g_fuzz_ctxt.timer_counter)
                 fuzz_trigger_timer();
         }
-    } else if (fd == g_ctxt.tun_fd && ctxt->capture_enabled) {
+    } else if (fd == g_ctxt.tun_fd && ctxt->capture_enabled && size > 0) {
         fuzz_capture_timers(ctxt);
-        fuzz_capture_interface(ctxt, IF_TUN, buf, count);
+        fuzz_capture_interface(ctxt, IF_TUN, buf, size);
     } else if (fd == g_ctxt.os_ctxt->data_fd && !size && ctxt->replay_i < ctxt->replay_count) {
         // Read from the next replay file
         g_ctxt.os_ctxt->data_fd = ctxt->replay_fds[ctxt->replay_i++];
@@ -161,6 +164,21 @@ ssize_t __wrap_write(int fd, const void *buf, size_t count)
     return __real_write(fd, buf, count);
 }
 
+ssize_t __real_writev(int fd, const struct iovec *iov, int iovcnt);
+ssize_t __wrap_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    ssize_t size = 0;
+    int i;
+
+    if (fd == g_ctxt.os_ctxt->data_fd && g_fuzz_ctxt.replay_count) {
+        for (i = 0; i < iovcnt; i++)
+            size += iov[i].iov_len;
+        return size;
+    }
+
+    return __real_writev(fd, iov, iovcnt);
+}
+
 int main(int argc, char *argv[])
 {
     struct fuzz_ctxt *ctxt = &g_fuzz_ctxt;
@@ -10,22 +10,92 @@
  *
  * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
  */
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <stdbool.h>
-#include <poll.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
 #include <sys/un.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/timerfd.h>
 #include <sys/resource.h>
 #include "common/log.h"
 #include "common/utils.h"
 
 #define MAX_NODES 4096
+#define MAX_DELAYS 16
+
+#define EPOLL_LISTEN UINT32_MAX
+#define EPOLL_TIMER  (UINT32_MAX - 1)
+
+// Nodes given with --group are all linked together, with the --loss and
+// --delay given before
+struct group {
+    uint64_t mask[MAX_NODES / 64];
+    uint8_t loss;
+    uint8_t delay;
+};
+
+struct link {
+    uint16_t dst;
+    uint8_t loss;           // Percentage of dropped frames
+    uint8_t delay;          // Index in ctxt->queues
+};
+
+// A frame is the "xx" header and the packet following it, or a lone packet
+struct frame {
+    int refcnt;
+    int count;
+    struct iovec iov[2];
+    uint8_t data[];
+};
+
+struct pending {
+    struct pending *next;
+    uint64_t deadline_ms;
+    uint32_t dst_gen;
+    uint16_t dst;
+    struct frame *frame;
+};
+
+// Links with the same delay share a queue, so the deadlines are in order
+struct delay_queue {
+    int delay_ms;
+    struct pending *head;
+    struct pending **tail;
+};
+
+struct node {
+    int fd;                 // -1 if not connected
+    uint32_t gen;           // Incremented on each disconnection
+    int pos;                // Position in ctxt->connected
+    int links_len;
+    struct link *links;
+};
 
 struct ctxt {
     struct sockaddr_un addr;
-    uint64_t node_graph[MAX_NODES][MAX_NODES / 64];
+    int epoll_fd;
+    int listen_fd;
+    int timer_fd;
+    int max_nodes;
+    bool full_mesh;
+    struct link mesh_link;  // Parameters of all the links without --group
+    struct group *groups;
+    int groups_len;
+    struct delay_queue queues[MAX_DELAYS];
+    int queues_len;
+    struct node nodes[MAX_NODES];
+    uint16_t connected[MAX_NODES];
+    int connected_len;
+};
+
+static struct ctxt g_ctxt = {
+    .addr.sun_family = AF_UNIX,
 };
 
 static int increase_limit_fd()
@@ -40,6 +110,14 @@ static int increase_limit_fd()
     return rlimit.rlim_cur;
 }
 
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
 static int bitmap_get(int shift, uint64_t *in, int size)
 {
     int word_nr = shift / 64;
@@ -60,17 +138,6 @@ static int bitmap_set(int shift, uint64_t *out, int size)
     return 0;
 }
 
-static int bitmap_clr(int shift, uint64_t *out, int size)
-{
-    int word_nr = shift / 64;
-    int bit_nr = shift % 64;
-
-    if (word_nr >= size)
-        return -1;
-    out[word_nr] &= ~(1ULL << bit_nr);
-    return 0;
-}
-
 static int bitmap_parse(char *str, uint64_t *out, int size)
 {
     char *range;
@@ -98,67 +165,149 @@ static int bitmap_parse(char *str, uint64_t *out, int size)
     return 0;
 }
 
-static void graph_apply_mask(uint64_t node_graph[MAX_NODES][MAX_NODES / 64], uint64_t mask[MAX_NODES / 64])
+static int delay_queue_get(struct ctxt *ctxt, int delay_ms)
 {
-    int i, j;
+    int i;
 
-    for (i = 0; i < MAX_NODES; i++)
-        if (bitmap_get(i, mask, MAX_NODES / 64))
-            for (j = 0; j < MAX_NODES; j++)
-                if (bitmap_get(j, mask, MAX_NODES / 64))
-                    bitmap_set(j, node_graph[i], MAX_NODES / 64);
+    for (i = 0; i < ctxt->queues_len; i++)
+        if (ctxt->queues[i].delay_ms == delay_ms)
+            return i;
+    FATAL_ON(i == MAX_DELAYS, 1, "Too many different delays");
+    ctxt->queues[i].delay_ms = delay_ms;
+    ctxt->queues[i].head = NULL;
+    ctxt->queues[i].tail = &ctxt->queues[i].head;
+    return ctxt->queues_len++;
+}
+
+static void node_add_link(struct node *node, int16_t *pos, int dst, const struct group *group)
+{
+    if (pos[dst] < 0) {
+        pos[dst] = node->links_len++;
+        node->links[pos[dst]].dst = dst;
+    }
+    // The last group wins
+    node->links[pos[dst]].loss = group->loss;
+    node->links[pos[dst]].delay = group->delay;
+}
+
+// Turn the groups into the adjacency list of each node
+static void graph_build(struct ctxt *ctxt)
+{
+    static int16_t pos[MAX_NODES];
+    struct link *links = malloc(MAX_NODES * sizeof(struct link));
+    struct node *node;
+    uint64_t word;
+    int i, j, k, w;
+
+    FATAL_ON(!links, 1, "malloc: %m");
+    memset(pos, 0xFF, sizeof(pos));
+    for (i = 0; i < MAX_NODES; i++) {
+        node = &ctxt->nodes[i];
+        node->links = links;
+        node->links_len = 0;
+        for (k = 0; k < ctxt->groups_len; k++) {
+            if (!bitmap_get(i, ctxt->groups[k].mask, MAX_NODES / 64))
+                continue;
+            for (w = 0; w < MAX_NODES / 64; w++) {
+                for (word = ctxt->groups[k].mask[w]; word; word &= word - 1) {
+                    j = w * 64 + __builtin_ctzll(word);
+                    if (j != i)
+                        node_add_link(node, pos, j, &ctxt->groups[k]);
+                }
+            }
+        }
+        for (j = 0; j < node->links_len; j++)
+            pos[links[j].dst] = -1;
+        if (node->links_len) {
+            node->links = malloc(node->links_len * sizeof(struct link));
+            FATAL_ON(!node->links, 1, "malloc: %m");
+            memcpy(node->links, links, node->links_len * sizeof(struct link));
+        } else {
+            node->links = NULL;
+        }
+    }
+    free(links);
 }
 
 static int graph_get_num_nodes(struct ctxt *ctxt)
 {
     int max = 0;
-    int i, j;
+    int i;
 
     for (i = 0; i < MAX_NODES; i++)
-        for (j = 0; j < MAX_NODES; j++)
-            if (bitmap_get(j, ctxt->node_graph[i], MAX_NODES / 64))
-                max = i;
+        if (ctxt->nodes[i].links_len)
+            max = i;
     return max + 1;
 }
 
 static void graph_dump(struct ctxt *ctxt)
 {
     int max = graph_get_num_nodes(ctxt);
+    uint64_t row[MAX_NODES / 64];
     int i, j;
 
     for (i = 0; i < max; i++) {
+        memset(row, 0, sizeof(row));
+        for (j = 0; j < ctxt->nodes[i].links_len; j++)
+            bitmap_set(ctxt->nodes[i].links[j].dst, row, MAX_NODES / 64);
         printf("%02x ", i);
         for (j = 0; j < max; j++)
-            printf("%s", bitmap_get(j, ctxt->node_graph[i], MAX_NODES / 64) ? "x" : "-");
+            printf("%s", bitmap_get(j, row, MAX_NODES / 64) ? "x" : "-");
         printf("\n");
     }
 }
 
 void print_help(FILE *stream, int exit_code) {
     fprintf(stream, "broadcast server to create networks of wshwsim\n");
+    fprintf(stream, "\n");
+    fprintf(stream, "Usage:\n");
+    fprintf(stream, "  wssimserver [OPTIONS] SOCKET\n");
+    fprintf(stream, "\n");
+    fprintf(stream, "  -g, --group=NODES     Link together the nodes in NODES (eg. 0-3,7). Without groups,\n");
+    fprintf(stream, "                          all the nodes are linked together\n");
+    fprintf(stream, "  -L, --loss=PERCENT    Drop this percentage of the frames on the links of the\n");
+    fprintf(stream, "                          next groups\n");
+    fprintf(stream, "  -D, --delay=MS        Delay the frames on the links of the next groups\n");
+    fprintf(stream, "  -l, --dump            Print the graph\n");
+    fprintf(stream, "  -h, --help            Print this help\n");
     exit(exit_code);
 }
 
 void parse_commandline(struct ctxt *ctxt, int argc, char *argv[])
 {
-    const char *opts_short = "hlg:";
+    const char *opts_short = "hlg:L:D:";
     static const struct option opts_long[] = {
         { "group", required_argument, 0,  'g' },
+        { "loss",  required_argument, 0,  'L' },
+        { "delay", required_argument, 0,  'D' },
         { "dump",  no_argument,       0,  'l' },
         { "help",  no_argument,       0,  'h' },
         { 0,       0,                 0,   0  }
     };
-    uint64_t mask[MAX_NODES / 64];
-    bool dump = false, has_filter = false;
-    int opt, i, ret;
+    struct group *group;
+    int loss = 0, delay = 0;
+    bool dump = false;
+    char *endptr;
+    int opt, ret;
 
     while ((opt = getopt_long(argc, argv, opts_short, opts_long, NULL)) != -1) {
         switch (opt) {
             case 'g':
-                ret = bitmap_parse(optarg, mask, MAX_NODES / 64);
+                ctxt->groups = realloc(ctxt->groups, (ctxt->groups_len + 1) * sizeof(struct group));
+                FATAL_ON(!ctxt->groups, 1, "realloc: %m");
+                group = &ctxt->groups[ctxt->groups_len++];
+                ret = bitmap_parse(optarg, group->mask, MAX_NODES / 64);
                 FATAL_ON(ret, 1, "Bad mask: %s", optarg);
-                graph_apply_mask(ctxt->node_graph, mask);
-                has_filter = true;
+                group->loss = loss;
+                group->delay = delay_queue_get(ctxt, delay);
+                break;
+            case 'L':
+                loss = strtol(optarg, &endptr, 0);
+                FATAL_ON(*endptr || loss < 0 || loss > 100, 1, "Bad loss: %s", optarg);
+                break;
+            case 'D':
+                delay = strtol(optarg, &endptr, 0);
+                FATAL_ON(*endptr || delay < 0, 1, "Bad delay: %s", optarg);
                 break;
             case 'l':
                 dump = true;
@@ -173,12 +322,14 @@ void parse_commandline(struct ctxt *ctxt, int argc, char *argv[])
                 break;
         }
     }
-    if (!has_filter)
-        memset(ctxt->node_graph, 0xFF, sizeof(ctxt->node_graph));
-    for (i = 0; i < MAX_NODES; i++)
-        bitmap_clr(i, ctxt->node_graph[i], MAX_NODES / 64);
+    if (!ctxt->groups_len) {
+        ctxt->full_mesh = true;
+        ctxt->mesh_link.loss = loss;
+        ctxt->mesh_link.delay = delay_queue_get(ctxt, delay);
+    }
+    graph_build(ctxt);
     if (dump) {
-        FATAL_ON(!has_filter, 1, "No graph to dump");
+        FATAL_ON(ctxt->full_mesh, 1, "No graph to dump");
         graph_dump(ctxt);
     }
     if (optind >= argc)
@@ -189,80 +340,251 @@ void parse_commandline(struct ctxt *ctxt, int argc, char *argv[])
     strcpy(ctxt->addr.sun_path, argv[optind]);
 }
 
-static void broadcast(uint64_t *node_graph, struct pollfd *fds, int fds_len, void *buf, int buf_len)
+static struct frame *frame_new(uint8_t bufs[2][4096], int *lens, int count)
 {
-    int j;
-    int ret;
+    struct frame *frame = malloc(sizeof(struct frame) + lens[0] + (count > 1 ? lens[1] : 0));
+    uint8_t *ptr;
+    int i;
 
-    for (j = 0; j < fds_len; j++) {
-        if (fds[j].fd >= 0 && bitmap_get(j, node_graph, MAX_NODES / 64)) {
-            ret = write(fds[j].fd, buf, buf_len);
-            FATAL_ON(ret != buf_len, 1, "write: %m");
-        }
+    FATAL_ON(!frame, 1, "malloc: %m");
+    frame->refcnt = 1;
+    frame->count = count;
+    ptr = frame->data;
+    for (i = 0; i < count; i++) {
+        memcpy(ptr, bufs[i], lens[i]);
+        frame->iov[i].iov_base = ptr;
+        frame->iov[i].iov_len = lens[i];
+        ptr += lens[i];
     }
+    return frame;
 }
 
-int main(int argc, char **argv)
+static void frame_put(struct frame *frame)
+{
+    if (!--frame->refcnt)
+        free(frame);
+}
+
+static void node_send(struct node *node, struct frame *frame)
+{
+    struct mmsghdr msgs[2] = { };
+    int i, ret;
+
+    for (i = 0; i < frame->count; i++) {
+        msgs[i].msg_hdr.msg_iov = &frame->iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    ret = sendmmsg(node->fd, msgs, frame->count, 0);
+    FATAL_ON(ret != frame->count, 1, "sendmmsg: %m");
+}
+
+static void timer_update(struct ctxt *ctxt)
+{
+    struct itimerspec its = { };
+    uint64_t deadline = 0;
+    int i, ret;
+
+    for (i = 0; i < ctxt->queues_len; i++)
+        if (ctxt->queues[i].head && (!deadline || ctxt->queues[i].head->deadline_ms < deadline))
+            deadline = ctxt->queues[i].head->deadline_ms;
+    // A zero it_value disarms the timer
+    its.it_value.tv_sec = deadline / 1000;
+    its.it_value.tv_nsec = deadline % 1000 * 1000000;
+    ret = timerfd_settime(ctxt->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+    FATAL_ON(ret < 0, 1, "timerfd_settime: %m");
+}
+
+static void link_send(struct ctxt *ctxt, const struct link *link, struct frame *frame, uint64_t now)
+{
+    struct delay_queue *queue = &ctxt->queues[link->delay];
+    struct node *dst = &ctxt->nodes[link->dst];
+    struct pending *pending;
+
+    if (dst->fd < 0)
+        return;
+    if (link->loss && rand() % 100 < link->loss)
+        return;
+    if (!queue->delay_ms) {
+        node_send(dst, frame);
+        return;
+    }
+    pending = malloc(sizeof(struct pending));
+    FATAL_ON(!pending, 1, "malloc: %m");
+    pending->next = NULL;
+    pending->deadline_ms = now + queue->delay_ms;
+    pending->dst = link->dst;
+    pending->dst_gen = dst->gen;
+    pending->frame = frame;
+    frame->refcnt++;
+    *queue->tail = pending;
+    queue->tail = &pending->next;
+}
+
+static void broadcast(struct ctxt *ctxt, int src, struct frame *frame)
 {
-    char buf[4096];
+    struct node *node = &ctxt->nodes[src];
+    uint64_t now = now_ms();
+    struct link link;
     int i;
-    int on = 1;
-    int ret, len;
-    int fd_limit;
-    struct pollfd fds[MAX_NODES + 1] = { };
-    struct ctxt ctxt = {
-        .addr.sun_family = AF_UNIX
-    };
 
-    fd_limit = min(increase_limit_fd(), ARRAY_SIZE(fds));
-    parse_commandline(&ctxt, argc, argv);
-    for (i = 0; i < fd_limit; i++)
-        fds[i].fd = -1;
-
-    fds[0].events = POLLIN;
-    fds[0].fd = socket(AF_UNIX, SOCK_SEQPACKET, 0); // use SOCK_SEQPACKET or SOCK_STREAM
-    FATAL_ON(fds[0].fd < 0, 1, "socket: %s: %m", ctxt.addr.sun_path);
-    ret = setsockopt(fds[0].fd, SOL_SOCKET, SO_REUSEADDR, (char *)&on, sizeof(on));
-    FATAL_ON(ret < 0, 1, "setsockopt: %s: %m", ctxt.addr.sun_path);
-    ret = bind(fds[0].fd, (struct sockaddr *)&ctxt.addr, sizeof(ctxt.addr));
-    FATAL_ON(ret < 0, 1, "bind: %s: %m", ctxt.addr.sun_path);
-    ret = listen(fds[0].fd, 4096);
-    FATAL_ON(ret < 0, 1, "listen: %s: %m", ctxt.addr.sun_path);
+    if (ctxt->full_mesh) {
+        link = ctxt->mesh_link;
+        for (i = 0; i < ctxt->connected_len; i++) {
+            if (ctxt->connected[i] == src)
+                continue;
+            link.dst = ctxt->connected[i];
+            link_send(ctxt, &link, frame, now);
+        }
+    } else {
+        for (i = 0; i < node->links_len; i++)
+            link_send(ctxt, &node->links[i], frame, now);
+    }
+    timer_update(ctxt);
+}
+
+static void timer_expired(struct ctxt *ctxt)
+{
+    uint64_t now = now_ms();
+    struct delay_queue *queue;
+    struct pending *pending;
+    struct node *dst;
+    uint64_t val;
+    int i, ret;
 
-    while (true) {
-        ret = poll(fds, fd_limit, -1);
-        FATAL_ON(ret < 0, 1, "poll: %m");
-        if (fds[0].revents) {
-            for (i = 0; i < fd_limit; i++) {
-                if (fds[i].fd == -1) {
-                    fds[i].events = POLLIN;
-                    fds[i].fd = accept(fds[0].fd, NULL, NULL);
-                    DEBUG("Connect fd %d", fds[i].fd);
-                    FATAL_ON(fds[i].fd < 0, 1, "accept: %m");
-                    break;
-                }
-            }
-            if (i == fd_limit)
-                FATAL(1, "can't accept new node %d %d", i, fd_limit);
+    // The timer may have been re-armed by a previous event of the same batch
+    ret = read(ctxt->timer_fd, &val, sizeof(val));
+    FATAL_ON(ret < 0 && errno != EAGAIN, 1, "read: %m");
+    for (i = 0; i < ctxt->queues_len; i++) {
+        queue = &ctxt->queues[i];
+        while (queue->head && queue->head->deadline_ms <= now) {
+            pending = queue->head;
+            queue->head = pending->next;
+            if (!queue->head)
+                queue->tail = &queue->head;
+            dst = &ctxt->nodes[pending->dst];
+            if (dst->fd >= 0 && dst->gen == pending->dst_gen)
+                node_send(dst, pending->frame);
+            frame_put(pending->frame);
+            free(pending);
         }
-        for (i = 1; i < fd_limit; i++) {
-            if (fds[i].revents) {
-                len = read(fds[i].fd, buf, sizeof(buf));
-                if (len < 1) {
-                    DEBUG("Disconnect fd %d", fds[i].fd);
-                    close(fds[i].fd);
-                    fds[i].fd = -1;
-                    fds[i].events = 0;
-                } else {
-                    broadcast(ctxt.node_graph[i - 1], fds + 1, fd_limit - 1, buf, len);
-                    if (len == 6 && buf[0] == 'x' && buf[1] == 'x') {
-                        len = read(fds[i].fd, buf, sizeof(buf));
-                        broadcast(ctxt.node_graph[i - 1], fds + 1, fd_limit - 1, buf, len);
-                    }
-                }
-            }
+    }
+    timer_update(ctxt);
+}
+
+static void node_connect(struct ctxt *ctxt)
+{
+    struct epoll_event ev = { .events = EPOLLIN };
+    struct node *node;
+    int fd, i, ret;
+
+    fd = accept(ctxt->listen_fd, NULL, NULL);
+    FATAL_ON(fd < 0, 1, "accept: %m");
+    for (i = 0; i < ctxt->max_nodes; i++)
+        if (ctxt->nodes[i].fd < 0)
+            break;
+    if (i == ctxt->max_nodes)
+        FATAL(1, "can't accept new node %d %d", i, ctxt->max_nodes);
+    DEBUG("Connect fd %d", fd);
+    node = &ctxt->nodes[i];
+    node->fd = fd;
+    node->pos = ctxt->connected_len;
+    ctxt->connected[ctxt->connected_len++] = i;
+    // The generation allows to detect the events of a previous connection
+    ev.data.u64 = (uint64_t)node->gen << 32 | i;
+    ret = epoll_ctl(ctxt->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    FATAL_ON(ret < 0, 1, "epoll_ctl: %m");
+}
+
+static void node_disconnect(struct ctxt *ctxt, int id)
+{
+    struct node *node = &ctxt->nodes[id];
+    int last;
+
+    DEBUG("Disconnect fd %d", node->fd);
+    epoll_ctl(ctxt->epoll_fd, EPOLL_CTL_DEL, node->fd, NULL);
+    close(node->fd);
+    node->fd = -1;
+    node->gen++;
+    last = ctxt->connected[--ctxt->connected_len];
+    ctxt->connected[node->pos] = last;
+    ctxt->nodes[last].pos = node->pos;
+}
+
+static void node_recv(struct ctxt *ctxt, int id)
+{
+    struct node *node = &ctxt->nodes[id];
+    uint8_t bufs[2][4096];
+    struct frame *frame;
+    int count = 1;
+    int lens[2];
+
+    lens[0] = read(node->fd, bufs[0], sizeof(bufs[0]));
+    if (lens[0] < 1) {
+        node_disconnect(ctxt, id);
+        return;
+    }
+    if (lens[0] == 6 && bufs[0][0] == 'x' && bufs[0][1] == 'x') {
+        lens[1] = read(node->fd, bufs[1], sizeof(bufs[1]));
+        if (lens[1] < 1) {
+            node_disconnect(ctxt, id);
+            return;
         }
+        count = 2;
     }
+    frame = frame_new(bufs, lens, count);
+    broadcast(ctxt, id, frame);
+    frame_put(frame);
 }
 
+int main(int argc, char **argv)
+{
+    struct epoll_event evs[64];
+    struct epoll_event ev = { .events = EPOLLIN };
+    struct ctxt *ctxt = &g_ctxt;
+    uint32_t id, gen;
+    int on = 1;
+    int ret, i;
+
+    // The listening socket and the timer take a fd each
+    ctxt->max_nodes = min(increase_limit_fd() - 2, MAX_NODES);
+    parse_commandline(ctxt, argc, argv);
+    for (i = 0; i < MAX_NODES; i++)
+        ctxt->nodes[i].fd = -1;
 
+    ctxt->epoll_fd = epoll_create1(0);
+    FATAL_ON(ctxt->epoll_fd < 0, 1, "epoll_create1: %m");
+    ctxt->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    FATAL_ON(ctxt->timer_fd < 0, 1, "timerfd_create: %m");
+    ev.data.u64 = EPOLL_TIMER;
+    ret = epoll_ctl(ctxt->epoll_fd, EPOLL_CTL_ADD, ctxt->timer_fd, &ev);
+    FATAL_ON(ret < 0, 1, "epoll_ctl: %m");
+
+    ctxt->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0); // use SOCK_SEQPACKET or SOCK_STREAM
+    FATAL_ON(ctxt->listen_fd < 0, 1, "socket: %s: %m", ctxt->addr.sun_path);
+    ret = setsockopt(ctxt->listen_fd, SOL_SOCKET, SO_REUSEADDR, (char *)&on, sizeof(on));
+    FATAL_ON(ret < 0, 1, "setsockopt: %s: %m", ctxt->addr.sun_path);
+    ret = bind(ctxt->listen_fd, (struct sockaddr *)&ctxt->addr, sizeof(ctxt->addr));
+    FATAL_ON(ret < 0, 1, "bind: %s: %m", ctxt->addr.sun_path);
+    ret = listen(ctxt->listen_fd, 4096);
+    FATAL_ON(ret < 0, 1, "listen: %s: %m", ctxt->addr.sun_path);
+    ev.data.u64 = EPOLL_LISTEN;
+    ret = epoll_ctl(ctxt->epoll_fd, EPOLL_CTL_ADD, ctxt->listen_fd, &ev);
+    FATAL_ON(ret < 0, 1, "epoll_ctl: %m");
+
+    while (true) {
+        ret = epoll_wait(ctxt->epoll_fd, evs, ARRAY_SIZE(evs), -1);
+        FATAL_ON(ret < 0 && errno != EINTR, 1, "epoll_wait: %m");
+        for (i = 0; i < ret; i++) {
+            id = (uint32_t)evs[i].data.u64;
+            gen = evs[i].data.u64 >> 32;
+            if (id == EPOLL_LISTEN)
+                node_connect(ctxt);
+            else if (id == EPOLL_TIMER)
+                timer_expired(ctxt);
+            // A previous event of the batch may have disconnected the node,
+            // and its slot may have been reused by a new connection
+            else if (ctxt->nodes[id].fd >= 0 && ctxt->nodes[id].gen == gen)
+                node_recv(ctxt, id);
+        }
+    }
+}
@@ -11,9 +11,11 @@
  * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
  */
 #include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
 #include <termios.h>
 #include <sys/file.h>
+#include <sys/uio.h>
 
 #include "stack-services/common_functions.h"
 #include "crc.h"
@@ -93,14 +95,46 @@ static int uart_tx_append(uint8_t *buf, uint8_t byte)
     }
 }
 
+/*
+ * Copy in to out, escaping 0x7D and 0x7E. The input is scanned 8 bytes at a
+ * time, so the runs without special bytes (ie. most of the frame) are copied
+ * in bulk.
+ */
+static size_t uart_tx_stuff(uint8_t *out, const uint8_t *in, size_t in_len)
+{
+    // See "Determine if a word has a zero byte" from
+    // https://graphics.stanford.edu/~seander/bithacks.html
+#define HAS_ZERO_BYTE(v) (((v) - 0x0101010101010101ULL) & ~(v) & 0x8080808080808080ULL)
+    size_t in_pos = 0, out_pos = 0, run;
+    uint64_t word;
+
+    while (in_pos < in_len) {
+        run = in_pos;
+        while (run + sizeof(word) <= in_len) {
+            memcpy(&word, in + run, sizeof(word));
+            if (HAS_ZERO_BYTE(word ^ 0x7D7D7D7D7D7D7D7DULL) ||
+                HAS_ZERO_BYTE(word ^ 0x7E7E7E7E7E7E7E7EULL))
+                break;
+            run += sizeof(word);
+        }
+        while (run < in_len && in[run] != 0x7D && in[run] != 0x7E)
+            run++;
+        memcpy(out + out_pos, in + in_pos, run - in_pos);
+        out_pos += run - in_pos;
+        in_pos = run;
+        if (in_pos < in_len)
+            out_pos += uart_tx_append(out + out_pos, in[in_pos++]);
+    }
+    return out_pos;
+#undef HAS_ZERO_BYTE
+}
+
 size_t uart_encode_hdlc(uint8_t *out, const uint8_t *in, size_t in_len, uint16_t crc)
 {
     uint8_t crc_bytes[2];
     int frame_len;
 
-    frame_len = 0;
-    for (int i = 0; i < in_len; i++)
-        frame_len += uart_tx_append(out + frame_len, in[i]);
+    frame_len = uart_tx_stuff(out, in, in_len);
     common_write_16_bit_inverse(crc, crc_bytes);
     frame_len += uart_tx_append(out + frame_len, crc_bytes[0]);
     frame_len += uart_tx_append(out + frame_len, crc_bytes[1]);
@@ -108,96 +142,165 @@ size_t uart_encode_hdlc(uint8_t *out, const uint8_t *in, size_t in_len, uint16_t
     return frame_len;
 }
 
+/*
+ * Write the frames queued by uart_tx() with a single system call.
+ */
+void uart_tx_flush(struct os_ctxt *ctxt)
+{
+    const int buffers_len = ARRAY_SIZE(ctxt->retransmission_buffers);
+    struct iovec iov[ARRAY_SIZE(ctxt->retransmission_buffers)];
+    struct retransmission_frame *slot;
+    ssize_t total_len = 0;
+    ssize_t ret;
+    int i;
+
+    if (!ctxt->uart_tx_pending)
+        return;
+    for (i = 0; i < ctxt->uart_tx_pending; i++) {
+        slot = &ctxt->retransmission_buffers[(ctxt->retransmission_index - ctxt->uart_tx_pending + 1 + i + buffers_len) % buffers_len];
+        iov[i].iov_base = slot->frame;
+        iov[i].iov_len = slot->frame_len;
+        total_len += slot->frame_len;
+    }
+    ret = writev(ctxt->data_fd, iov, ctxt->uart_tx_pending);
+    BUG_ON(ret != total_len, "writev: %m");
+    ctxt->uart_tx_pending = 0;
+}
+
 int uart_tx(struct os_ctxt *ctxt, const void *buf, unsigned int buf_len)
 {
+    struct retransmission_frame *slot;
     uint16_t crc = crc16(buf, buf_len);
-    uint8_t *frame = malloc(buf_len * 2 + 3);
     int frame_len;
-    int ret;
 
-    frame_len = uart_encode_hdlc(frame, buf, buf_len, crc);
+    BUG_ON(buf_len * 2 + 3 > sizeof(slot->frame));
+    // The slot which is about to be reused may not have been written yet
+    if (ctxt->uart_tx_pending == ARRAY_SIZE(ctxt->retransmission_buffers))
+        uart_tx_flush(ctxt);
+    ctxt->retransmission_index = (ctxt->retransmission_index + 1) % ARRAY_SIZE(ctxt->retransmission_buffers);
+    slot = &ctxt->retransmission_buffers[ctxt->retransmission_index];
+    frame_len = uart_encode_hdlc(slot->frame, buf, buf_len, crc);
+    slot->frame_len = frame_len;
+    slot->crc = crc;
     TRACE(TR_BUS, "bus tx: %s (%d bytes)",
-          tr_bytes(frame, frame_len, NULL, 128, DELIM_SPACE | ELLIPSIS_STAR), frame_len);
+          tr_bytes(slot->frame, frame_len, NULL, 128, DELIM_SPACE | ELLIPSIS_STAR), frame_len);
     TRACE(TR_HDLC, "hdlc tx: %s (%d bytes)",
           tr_bytes(buf, buf_len, NULL, 128, DELIM_SPACE | ELLIPSIS_STAR), buf_len);
-    ret = write(ctxt->data_fd, frame, frame_len);
-    BUG_ON(ret != frame_len, "write: %m");
-    
-    ctxt->retransmission_index = (ctxt->retransmission_index + 1) % ARRAY_SIZE(ctxt->retransmission_buffers);
-    memcpy(ctxt->retransmission_buffers[ctxt->retransmission_index].frame, frame, frame_len);
-    ctxt->retransmission_buffers[ctxt->retransmission_index].frame_len = frame_len;
-    ctxt->retransmission_buffers[ctxt->retransmission_index].crc = crc;
-
-    free(frame);
 
+    ctxt->uart_tx_pending++;
+    if (!ctxt->uart_tx_batch)
+        uart_tx_flush(ctxt);
     return frame_len;
 }
 
+static void uart_rx_read(struct os_ctxt *ctxt)
+{
+    int ret;
+
+    // Data is only moved when the end of the buffer is reached, so the cost
+    // is amortized over all the frames received meanwhile
+    if (ctxt->uart_rx_end == sizeof(ctxt->uart_rx_buf)) {
+        if (!ctxt->uart_rx_start) {
+            WARN("uart: frame too long, %d bytes dropped", ctxt->uart_rx_end);
+            ctxt->uart_rx_scan = ctxt->uart_rx_end = 0;
+        } else {
+            memmove(ctxt->uart_rx_buf, ctxt->uart_rx_buf + ctxt->uart_rx_start,
+                    ctxt->uart_rx_end - ctxt->uart_rx_start);
+            ctxt->uart_rx_scan -= ctxt->uart_rx_start;
+            ctxt->uart_rx_end -= ctxt->uart_rx_start;
+            ctxt->uart_rx_start = 0;
+        }
+    }
+    ret = read(ctxt->data_fd,
+               ctxt->uart_rx_buf + ctxt->uart_rx_end,
+               sizeof(ctxt->uart_rx_buf) - ctxt->uart_rx_end);
+    FATAL_ON(ret < 0, 2, "read: %m");
+    FATAL_ON(!ret, 2, "read: Empty read");
+    TRACE(TR_BUS, "bus rx: %s (%d bytes)",
+           tr_bytes(ctxt->uart_rx_buf + ctxt->uart_rx_end, ret, NULL, 128, DELIM_SPACE | ELLIPSIS_STAR), ret);
+    ctxt->uart_rx_end += ret;
+}
+
 /*
- * Returns the next HDLC frame if available, terminator included.
+ * Look for the end of the frame starting at uart_rx_start. The search resumes
+ * where the previous one stopped, so each byte is only scanned once.
  */
-size_t uart_rx_hdlc(struct os_ctxt *ctxt, uint8_t *buf, size_t buf_len)
+static uint8_t *uart_rx_find_delimiter(struct os_ctxt *ctxt)
+{
+    uint8_t *delim;
+
+    while (ctxt->uart_rx_start < ctxt->uart_rx_end && ctxt->uart_rx_buf[ctxt->uart_rx_start] == 0x7E)
+        ctxt->uart_rx_start++;
+    if (ctxt->uart_rx_scan < ctxt->uart_rx_start)
+        ctxt->uart_rx_scan = ctxt->uart_rx_start;
+    delim = memchr(ctxt->uart_rx_buf + ctxt->uart_rx_scan, 0x7E, ctxt->uart_rx_end - ctxt->uart_rx_scan);
+    if (delim)
+        ctxt->uart_rx_scan = delim - ctxt->uart_rx_buf;
+    else
+        ctxt->uart_rx_scan = ctxt->uart_rx_end;
+    return delim;
+}
+
+/*
+ * Returns the next HDLC frame if available, terminator included. The frame
+ * points inside uart_rx_buf and is valid until the next call.
+ */
+static size_t uart_rx_frame(struct os_ctxt *ctxt, const uint8_t **frame)
 {
-    int frame_start, frame_len;
-    int ret, i;
+    uint8_t *delim;
+    size_t frame_len;
 
     if (!ctxt->uart_next_frame_ready) {
-        ret = read(ctxt->data_fd,
-                   ctxt->uart_rx_buf + ctxt->uart_rx_buf_len,
-                   sizeof(ctxt->uart_rx_buf) - ctxt->uart_rx_buf_len);
-        FATAL_ON(ret < 0, 2, "read: %m");
-        FATAL_ON(!ret, 2, "read: Empty read");
-        TRACE(TR_BUS, "bus rx: %s (%d bytes)",
-               tr_bytes(ctxt->uart_rx_buf + ctxt->uart_rx_buf_len, ret, NULL, 128, DELIM_SPACE | ELLIPSIS_STAR), ret);
-        ctxt->uart_rx_buf_len += ret;
+        // The answer of the RCP may depend on the frames not sent yet
+        uart_tx_flush(ctxt);
+        uart_rx_read(ctxt);
     }
 
-    i = 0;
-    while (ctxt->uart_rx_buf[i] == 0x7E && i < ctxt->uart_rx_buf_len)
-        i++;
-    frame_start = i;
-    while (ctxt->uart_rx_buf[i] != 0x7E && i < ctxt->uart_rx_buf_len)
-        i++;
-    frame_len = i - frame_start + 1;
-    BUG_ON(ctxt->uart_next_frame_ready && i >= ctxt->uart_rx_buf_len);
-    if (i >= ctxt->uart_rx_buf_len)
+    delim = uart_rx_find_delimiter(ctxt);
+    BUG_ON(ctxt->uart_next_frame_ready && !delim);
+    if (!delim)
         return 0;
+    *frame = ctxt->uart_rx_buf + ctxt->uart_rx_start;
+    frame_len = delim + 1 - *frame;
+    ctxt->uart_rx_start += frame_len;
 
-    BUG_ON(buf_len < frame_len);
-    memcpy(buf, ctxt->uart_rx_buf + frame_start, frame_len);
-
-    while (ctxt->uart_rx_buf[i] == 0x7E && i < ctxt->uart_rx_buf_len)
-        i++;
-    memmove(ctxt->uart_rx_buf, ctxt->uart_rx_buf + i, ctxt->uart_rx_buf_len - i);
-    ctxt->uart_rx_buf_len -= i;
-
-    i = 0;
-    ctxt->uart_next_frame_ready = false;
-    while (i < ctxt->uart_rx_buf_len) {
-        if (ctxt->uart_rx_buf[i] == 0x7E) {
-            ctxt->uart_next_frame_ready = true;
-            break;
-        }
-        i++;
-    }
+    ctxt->uart_next_frame_ready = uart_rx_find_delimiter(ctxt);
+    if (ctxt->uart_rx_start == ctxt->uart_rx_end)
+        ctxt->uart_rx_start = ctxt->uart_rx_scan = ctxt->uart_rx_end = 0;
+    return frame_len;
+}
+
+size_t uart_rx_hdlc(struct os_ctxt *ctxt, uint8_t *buf, size_t buf_len)
+{
+    const uint8_t *frame;
+    size_t frame_len;
 
+    frame_len = uart_rx_frame(ctxt, &frame);
+    if (!frame_len)
+        return 0;
+    BUG_ON(buf_len < frame_len);
+    memcpy(buf, frame, frame_len);
     return frame_len;
 }
 
 size_t uart_decode_hdlc(uint8_t *out, size_t out_len, const uint8_t *in, size_t in_len)
 {
-    int i = 0, frame_len = 0;
+    const uint8_t *end = in + in_len - 1; // Terminator excluded
+    const uint8_t *esc;
+    size_t frame_len = 0, run;
 
-    while (i < in_len - 1) {
-        BUG_ON(frame_len > out_len);
-        if (in[i] == 0x7D) {
-            i++;
-            out[frame_len++] = in[i] ^ 0x20;
-        } else {
-            BUG_ON(in[i] == 0x7E);
-            out[frame_len++] = in[i];
+    while (in < end) {
+        esc = memchr(in, 0x7D, end - in);
+        run = (esc ? esc : end) - in;
+        BUG_ON(frame_len + run > out_len);
+        memcpy(out + frame_len, in, run);
+        frame_len += run;
+        in += run;
+        if (esc) {
+            BUG_ON(frame_len >= out_len);
+            in++;
+            out[frame_len++] = *in++ ^ 0x20;
         }
-        i++;
     }
     if (frame_len <= 2) {
         WARN("frame length < 2, frame dropped");
@@ -209,17 +312,18 @@ size_t uart_decode_hdlc(uint8_t *out, size_t out_len, const uint8_t *in, size_t
             return 0;
         }
     }
-    TRACE(TR_HDLC, "hdlc rx: %s (%d bytes)",
+    TRACE(TR_HDLC, "hdlc rx: %s (%zu bytes)",
         tr_bytes(out, frame_len, NULL, 128, DELIM_SPACE | ELLIPSIS_STAR), frame_len);
     return frame_len;
 }
 
 int uart_rx(struct os_ctxt *ctxt, void *buf, unsigned int buf_len)
 {
-    uint8_t frame[4096];
+    const uint8_t *frame;
     size_t frame_len;
 
-    frame_len = uart_rx_hdlc(ctxt, frame, sizeof(frame));
+    // The frame is decoded directly from the receive buffer
+    frame_len = uart_rx_frame(ctxt, &frame);
     if (!frame_len)
         return 0;
     frame_len = uart_decode_hdlc(buf, buf_len, frame, frame_len);
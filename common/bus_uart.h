@@ -21,6 +21,7 @@ struct os_ctxt;
 
 int uart_open(const char *device, int bitrate, bool hardflow);
 int uart_tx(struct os_ctxt *ctxt, const void *buf, unsigned int len);
+void uart_tx_flush(struct os_ctxt *ctxt);
 int uart_rx(struct os_ctxt *ctxt, void *buf, unsigned int len);
 
 // These functions are exported for debug purposes
@@ -5,6 +5,9 @@
 #include <stdint.h>
 
 uint16_t crc16(const uint8_t *data, int len);
+// Continue the computation of a CRC. crc16(data, len) is equivalent to
+// crc16_update(0, data, len), so a CRC can be computed chunk by chunk.
+uint16_t crc16_update(uint16_t crc, const uint8_t *data, int len);
 bool crc_check(const uint8_t *data, int len, uint16_t expected_crc);
 
 #endif
@@ -23,7 +23,7 @@ struct slist;
 
 
 struct retransmission_frame {
-    uint8_t frame[2048];
+    uint8_t frame[2 * 2048 + 3]; // Room for the worst case of HDLC stuffing
     uint16_t frame_len;
     uint16_t crc;
 };
@@ -33,8 +33,12 @@ struct os_ctxt {
     int     data_fd;
     int     spi_recv_window;
     bool    uart_next_frame_ready;
-    int     uart_rx_buf_len;
-    uint8_t uart_rx_buf[2048];
+    // Received data is between uart_rx_start and uart_rx_end. Bytes before
+    // uart_rx_scan are known not to contain a frame delimiter.
+    int     uart_rx_start;
+    int     uart_rx_scan;
+    int     uart_rx_end;
+    uint8_t uart_rx_buf[4096];
 #ifdef HAVE_LIBCPC
     cpc_endpoint_t cpc_ep;
 #endif
@@ -43,8 +47,13 @@ struct os_ctxt {
     
     // For retransmission in case of crc error on the rcp
     // FIXME: rename this and the structure / naive circular buffer : rearch
+    // The frames are also encoded in place in these buffers before being sent.
+    // If uart_tx_batch is set, the uart_tx_pending last frames are not written
+    // until uart_tx_flush() is called.
     int retransmission_index;
     struct retransmission_frame retransmission_buffers[15]; // spinel header range from 1 to 15
+    int uart_tx_pending;
+    bool uart_tx_batch;
 };
 
 // This global variable is necessary for various API of nanostack. Beside this
@@ -152,6 +152,21 @@ bool trickle_timer(trickle_t *t, const trickle_params_t *params, uint16_t ticks)
     return transmit;
 }
 
+/* trickle_timer() handles at most one interval per call */
+uint32_t trickle_timer_next_expiry(const trickle_t *t, const trickle_params_t *params)
+{
+    if (!trickle_running(t, params)) {
+        return UINT32_MAX;
+    }
+    if (t->now < t->t) {
+        return t->t - t->now;
+    }
+    if (t->now < t->I) {
+        return t->I - t->now;
+    }
+    return 1;
+}
+
 /* Stop the timer (by setting e to infinite) */
 void trickle_stop(trickle_t *t)
 {
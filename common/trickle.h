@@ -77,6 +77,11 @@ void trickle_inconsistent_heard(trickle_t *t, const trickle_params_t *params);
  */
 bool trickle_timer(trickle_t *t, const trickle_params_t *params, uint16_t ticks);
 
+/* Return the number of ticks before trickle_timer() has something to do, or
+ * UINT32_MAX if the timer is not running
+ */
+uint32_t trickle_timer_next_expiry(const trickle_t *t, const trickle_params_t *params);
+
 /* Return max time after n count expiration period 0 return 1 Imin - 1 period */
 uint32_t trickle_timer_max(const trickle_params_t *params, uint8_t trickle_timer_expiration);
 
@@ -42,8 +42,34 @@ static_assert(1000 % EVENTOS_EVENT_TIMER_HZ == 0, "Need whole number of ms per t
 // atomicity on 16-bit platforms
 static volatile uint32_t timer_sys_ticks;
 
+/*
+ * Pending timers are stored in a hierarchical timing wheel. Level 0 has one
+ * slot per tick for the next 256 ticks. Each upper level has 64 slots and
+ * covers 64 times the range of the level below. When level 0 wraps, the
+ * matching slot of level 1 is redistributed in the lower level (and so on for
+ * upper levels). Thus, insertion and cancellation are O(1) and each timer is
+ * moved at most once per level.
+ */
+#define TIMER_WHEEL_L0_BITS 8
+#define TIMER_WHEEL_LN_BITS 6
+#define TIMER_WHEEL_LEVELS  5 // 8 + 4 * 6 = 32 bits
+#define TIMER_WHEEL_L0_SIZE (1u << TIMER_WHEEL_L0_BITS)
+#define TIMER_WHEEL_LN_SIZE (1u << TIMER_WHEEL_LN_BITS)
+#define TIMER_WHEEL_L0_MASK (TIMER_WHEEL_L0_SIZE - 1)
+#define TIMER_WHEEL_LN_MASK (TIMER_WHEEL_LN_SIZE - 1)
+#define TIMER_WHEEL_SHIFT(level) (TIMER_WHEEL_L0_BITS + ((level) - 1) * TIMER_WHEEL_LN_BITS)
+
+typedef NS_LIST_HEAD(sys_timer_struct_s, event.link) sys_timer_list_t;
+
 static NS_LIST_DEFINE(system_timer_free, sys_timer_struct_s, event.link);
-static NS_LIST_DEFINE(system_timer_list, sys_timer_struct_s, event.link);
+static sys_timer_list_t timer_wheel_l0[TIMER_WHEEL_L0_SIZE];
+static sys_timer_list_t timer_wheel_ln[TIMER_WHEEL_LEVELS - 1][TIMER_WHEEL_LN_SIZE];
+// Non-empty slots of level 0, allow to find the next expiry quickly
+static uint32_t timer_wheel_l0_map[TIMER_WHEEL_L0_SIZE / 32];
+// Number of timers stored in levels 1 and above
+static uint32_t timer_wheel_ln_count;
+// Used to keep request order of timers scheduled at the same tick
+static uint32_t timer_sys_seq;
 
 
 static sys_timer_struct_s *sys_timer_dynamically_allocate(void);
@@ -51,11 +77,105 @@ static void timer_sys_add(sys_timer_struct_s *timer);
 
 void timer_sys_init(void)
 {
+    for (int i = 0; i < TIMER_WHEEL_L0_SIZE; i++)
+        ns_list_init(&timer_wheel_l0[i]);
+    for (int i = 0; i < TIMER_WHEEL_LEVELS - 1; i++)
+        for (int j = 0; j < TIMER_WHEEL_LN_SIZE; j++)
+            ns_list_init(&timer_wheel_ln[i][j]);
     for (uint8_t i = 0; i < ST_MAX; i++) {
         ns_list_add_to_start(&system_timer_free, &startup_sys_timer_pool[i]);
     }
 }
 
+/*-------------------TIMING WHEEL FUNCTIONS--------------------------*/
+
+static sys_timer_list_t *timer_wheel_slot(uint8_t level, uint8_t slot)
+{
+    if (!level)
+        return &timer_wheel_l0[slot];
+    return &timer_wheel_ln[level - 1][slot];
+}
+
+/* Called internally with lock held. base is the next tick to process. */
+static void timer_wheel_insert(sys_timer_struct_s *timer, uint32_t base)
+{
+    uint32_t delta = timer->launch_time - base;
+    sys_timer_struct_s *prev;
+    sys_timer_list_t *list;
+    uint8_t level;
+
+    if (delta < TIMER_WHEEL_L0_SIZE) {
+        timer->wheel_level = 0;
+        timer->wheel_slot = timer->launch_time & TIMER_WHEEL_L0_MASK;
+        list = &timer_wheel_l0[timer->wheel_slot];
+        // All the timers of a level 0 slot expire at the same tick. However,
+        // timers cascaded from upper levels may have been requested before
+        // the ones already present.
+        prev = ns_list_get_last(list);
+        while (prev && TICKS_BEFORE(timer->seq, prev->seq))
+            prev = ns_list_get_previous(list, prev);
+        if (prev)
+            ns_list_add_after(list, prev, timer);
+        else
+            ns_list_add_to_start(list, timer);
+        timer_wheel_l0_map[timer->wheel_slot / 32] |= 1u << (timer->wheel_slot % 32);
+        return;
+    }
+    for (level = 1; level < TIMER_WHEEL_LEVELS - 1; level++)
+        if (delta < 1u << TIMER_WHEEL_SHIFT(level + 1))
+            break;
+    timer->wheel_level = level;
+    timer->wheel_slot = (timer->launch_time >> TIMER_WHEEL_SHIFT(level)) & TIMER_WHEEL_LN_MASK;
+    ns_list_add_to_end(timer_wheel_slot(level, timer->wheel_slot), timer);
+    timer_wheel_ln_count++;
+}
+
+/* Called internally with lock held */
+static void timer_wheel_remove(sys_timer_struct_s *timer)
+{
+    sys_timer_list_t *list = timer_wheel_slot(timer->wheel_level, timer->wheel_slot);
+
+    ns_list_remove(list, timer);
+    if (timer->wheel_level)
+        timer_wheel_ln_count--;
+    else if (ns_list_is_empty(list))
+        timer_wheel_l0_map[timer->wheel_slot / 32] &= ~(1u << (timer->wheel_slot % 32));
+}
+
+/* Called internally with lock held. Return the slot index processed. */
+static uint8_t timer_wheel_cascade(uint8_t level, uint32_t ticks)
+{
+    uint8_t slot = (ticks >> TIMER_WHEEL_SHIFT(level)) & TIMER_WHEEL_LN_MASK;
+    sys_timer_list_t *list = &timer_wheel_ln[level - 1][slot];
+
+    ns_list_foreach_safe(sys_timer_struct_s, cur, list) {
+        ns_list_remove(list, cur);
+        timer_wheel_ln_count--;
+        timer_wheel_insert(cur, ticks);
+    }
+    return slot;
+}
+
+/* Called internally with lock held. Return the first non-empty slot of level 0
+ * starting from start (wrapping around), or -1 if level 0 is empty. */
+static int timer_wheel_l0_next(uint8_t start)
+{
+    uint32_t word;
+    int i, idx;
+
+    for (i = 0; i <= ARRAY_SIZE(timer_wheel_l0_map); i++) {
+        idx = (start / 32 + i) % ARRAY_SIZE(timer_wheel_l0_map);
+        word = timer_wheel_l0_map[idx];
+        if (i == 0)
+            word &= ~0u << (start % 32);
+        else if (i == ARRAY_SIZE(timer_wheel_l0_map))
+            word &= (1u << (start % 32)) - 1;
+        if (word)
+            return idx * 32 + __builtin_ctz(word);
+    }
+    return -1;
+}
+
 
 
 /*-------------------SYSTEM TIMER FUNCTIONS--------------------------*/
@@ -106,26 +226,16 @@ void timer_sys_event_cancel_critical(struct arm_event_storage *event)
     timer->period = 0;
     // If its unqueued it is on my timer list, otherwise it is in event-loop.
     if (event->state == ARM_LIB_EVENT_UNQUEUED) {
-        ns_list_remove(&system_timer_list, timer);
+        timer_wheel_remove(timer);
     }
 }
 
 /* Called internally with lock held */
 static void timer_sys_add(sys_timer_struct_s *timer)
 {
-    uint32_t at = timer->launch_time;
-
-    // Find first timer scheduled to run after us, and insert before it.
-    // (This means timers scheduled for same time run in order of request)
-    ns_list_foreach(sys_timer_struct_s, t, &system_timer_list) {
-        if (TICKS_BEFORE(at, t->launch_time)) {
-            ns_list_add_before(&system_timer_list, t, timer);
-            return;
-        }
-    }
-
-    // Didn't insert before another timer, so must be last.
-    ns_list_add_to_end(&system_timer_list, timer);
+    // Timers scheduled for same time run in order of request
+    timer->seq = timer_sys_seq++;
+    timer_wheel_insert(timer, timer_sys_ticks + 1);
 }
 
 /* Called internally with lock held */
@@ -196,22 +306,52 @@ int8_t eventOS_event_timer_request(uint8_t event_id, uint8_t event_type, int8_t
 
 void system_timer_tick_update(uint32_t ticks)
 {
+    sys_timer_list_t *list;
+    uint8_t slot, level;
+
     platform_enter_critical();
-    //Keep runtime time
-    timer_sys_ticks += ticks;
-    ns_list_foreach_safe(sys_timer_struct_s, cur, &system_timer_list) {
-        if (TICKS_BEFORE_OR_AT(cur->launch_time, timer_sys_ticks)) {
+    while (ticks--) {
+        //Keep runtime time
+        timer_sys_ticks++;
+        slot = timer_sys_ticks & TIMER_WHEEL_L0_MASK;
+        if (!slot && timer_wheel_ln_count)
+            for (level = 1; level < TIMER_WHEEL_LEVELS; level++)
+                if (timer_wheel_cascade(level, timer_sys_ticks))
+                    break;
+        list = &timer_wheel_l0[slot];
+        ns_list_foreach_safe(sys_timer_struct_s, cur, list) {
+            BUG_ON(cur->launch_time != timer_sys_ticks);
             // Unthread from our list
-            ns_list_remove(&system_timer_list, cur);
+            ns_list_remove(list, cur);
             // Make it an event (can't fail - no allocation)
             // event system will call our timer_sys_event_free on event delivery.
             eventOS_event_send_timer_allocated(&cur->event);
-        } else {
-            // List is ordered, so as soon as we see a later event, we're done.
+        }
+        timer_wheel_l0_map[slot / 32] &= ~(1u << (slot % 32));
+        if (!timer_wheel_ln_count && timer_wheel_l0_next(0) < 0) {
+            // Nothing left to schedule, no need to walk the wheel
+            timer_sys_ticks += ticks;
             break;
         }
     }
-
     platform_exit_critical();
 }
 
+uint32_t timer_sys_next_expiry(void)
+{
+    sys_timer_struct_s *timer;
+    uint32_t ret = UINT32_MAX;
+    int slot;
+
+    platform_enter_critical();
+    slot = timer_wheel_l0_next((timer_sys_ticks + 1) & TIMER_WHEEL_L0_MASK);
+    if (slot >= 0) {
+        timer = ns_list_get_first(&timer_wheel_l0[slot]);
+        ret = timer->launch_time - timer_sys_ticks;
+    }
+    // Timers of the upper levels cannot expire before the next cascade
+    if (timer_wheel_ln_count)
+        ret = min(ret, TIMER_WHEEL_L0_SIZE - (timer_sys_ticks & TIMER_WHEEL_L0_MASK));
+    platform_exit_critical();
+    return ret;
+}
@@ -22,6 +22,9 @@ typedef struct sys_timer_struct_s {
     arm_event_storage_t event;
     uint32_t launch_time; // tick value
     uint32_t period;
+    uint32_t seq;         // request order, for timers with same launch_time
+    uint8_t wheel_level;  // position in the timing wheel
+    uint8_t wheel_slot;
 } sys_timer_struct_s;
 
 
@@ -45,4 +48,12 @@ void timer_sys_event_cancel_critical(struct arm_event_storage *event);
  * */
 void system_timer_tick_update(uint32_t ticks);
 
+/**
+ * Number of ticks before the first pending timer expires
+ *
+ * \return 0 if a timer is overdue, UINT32_MAX if no timer is pending
+ *
+ * */
+uint32_t timer_sys_next_expiry(void);
+
 #endif /*_PL_NANO_TIMER_SYS_H_*/
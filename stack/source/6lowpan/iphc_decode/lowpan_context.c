@@ -150,3 +150,16 @@ void lowpan_context_timer(lowpan_context_list_t *list, uint_fast16_t ticks)
     }
 }
 
+/* ticks is in 1/10s */
+uint32_t lowpan_context_timer_next_expiry(const lowpan_context_list_t *list)
+{
+    uint32_t ret = UINT32_MAX;
+
+    ns_list_foreach(const lowpan_context_t, ctx, list) {
+        if (ctx->lifetime < ret) {
+            ret = ctx->lifetime ? ctx->lifetime : 1;
+        }
+    }
+    return ret;
+}
+
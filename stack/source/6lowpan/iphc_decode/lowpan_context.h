@@ -78,6 +78,17 @@ void lowpan_context_list_free(lowpan_context_list_t *list);
  *
  */
 void lowpan_context_timer(lowpan_context_list_t *list, uint_fast16_t ticks);
+
+/**
+ * \brief Get the number of ticks before a lowpan context expires
+ *
+ * \param list pointer to linked list for context
+ *
+ * \return ticks in 1/10s, UINT32_MAX if the list is empty
+ *
+ */
+uint32_t lowpan_context_timer_next_expiry(const lowpan_context_list_t *list);
+
 /**
  * \brief Get Context entry from the list by context ID
  *
@@ -930,7 +930,7 @@ bool nd_ns_aro_handler(protocol_interface_info_entry_t *cur_interface, const uin
     if (neigh->type != IP_NEIGHBOUR_REGISTERED) {
         neigh->type = IP_NEIGHBOUR_TENTATIVE;
         neigh->lifetime = TENTATIVE_NCE_LIFETIME;
-        memcpy(nce_eui64, aro_out->eui64, 8);
+        ipv6_neighbour_set_eui64(&cur_interface->ipv6_neighbour_cache, neigh, aro_out->eui64);
     }
 
     /* Set the LL address, ensure it's marked STALE */
@@ -1542,6 +1542,17 @@ void nd_object_timer(protocol_interface_info_entry_t *cur_interface, uint16_t ti
     }
 }
 
+// The ND timers are processed on every tick while an object exists
+uint32_t nd_object_timer_next_expiry(struct protocol_interface_info_entry *cur_interface)
+{
+    ns_list_foreach(nd_router_t, cur, &nd_router_list) {
+        if (cur_interface->nwk_id == cur->nwk_id) {
+            return 1;
+        }
+    }
+    return UINT32_MAX;
+}
+
 uint32_t nd_object_time_to_next_nd_reg(void)
 {
     uint32_t ret_val = 0;
@@ -1318,14 +1318,14 @@ int ws_bbr_eapol_auth_relay_get_socket_fd()
     return ws_bootstrap_6lbr_eapol_auth_relay_get_socket_fd();
 }
 
-void ws_bbr_eapol_relay_socket_cb(int fd)
+int ws_bbr_eapol_relay_socket_cb(int fd)
 {
-    ws_bootstrap_6lbr_eapol_relay_socket_cb(fd);
+    return ws_bootstrap_6lbr_eapol_relay_socket_cb(fd);
 }
 
-void ws_bbr_eapol_auth_relay_socket_cb(int fd)
+int ws_bbr_eapol_auth_relay_socket_cb(int fd)
 {
-    ws_bootstrap_6lbr_eapol_auth_relay_socket_cb(fd);
+    return ws_bootstrap_6lbr_eapol_auth_relay_socket_cb(fd);
 }
 
 int ws_bbr_radius_address_set(int8_t interface_id, const struct sockaddr_storage *address)
@@ -22,6 +22,7 @@
 #include "common/rand.h"
 #include "common/ws_regdb.h"
 #include "common/trickle.h"
+#include "common/utils.h"
 #include "stack-services/ns_trace.h"
 #include "stack-services/common_functions.h"
 #include "service_libs/utils/ns_time.h"
@@ -467,6 +468,17 @@ void ws_nud_active_timer(protocol_interface_info_entry_t *cur, uint16_t ticks)
     }
 }
 
+/* Entry timers are in milliseconds */
+uint32_t ws_nud_active_timer_next_expiry(protocol_interface_info_entry_t *cur)
+{
+    uint32_t ret = UINT32_MAX;
+
+    ns_list_foreach(ws_nud_table_entry_t, entry, &cur->ws_info->active_nud_process) {
+        ret = min(ret, max((entry->timer + 99) / 100, 1u));
+    }
+    return ret;
+}
+
 static fhss_ws_neighbor_timing_info_t *ws_bootstrap_get_neighbor_info(const fhss_api_t *api, uint8_t eui64[8])
 {
     protocol_interface_info_entry_t *cur = protocol_stack_interface_info_get_by_fhss_api(api);
@@ -3032,6 +3044,30 @@ void ws_bootstrap_trickle_timer(protocol_interface_info_entry_t *cur, uint16_t t
     }
 }
 
+uint32_t ws_bootstrap_trickle_timer_next_expiry(protocol_interface_info_entry_t *cur)
+{
+    const trickle_params_t *params = &cur->ws_info->trickle_params_pan_discovery;
+    uint32_t ret = UINT32_MAX;
+
+    if (cur->ws_info->trickle_pas_running) {
+        ret = min(ret, trickle_timer_next_expiry(&cur->ws_info->trickle_pan_advertisement_solicit, params));
+    }
+    if (cur->ws_info->trickle_pcs_running) {
+        ret = min(ret, max(cur->ws_info->pan_config_sol_max_timeout, 1u));
+        ret = min(ret, trickle_timer_next_expiry(&cur->ws_info->trickle_pan_config_solicit, params));
+    }
+    if (cur->ws_info->trickle_pa_running) {
+        ret = min(ret, trickle_timer_next_expiry(&cur->ws_info->trickle_pan_advertisement, params));
+    }
+    if (cur->ws_info->trickle_pc_running) {
+        if (cur->ws_info->trickle_pc_consistency_block_period) {
+            ret = min(ret, cur->ws_info->trickle_pc_consistency_block_period);
+        }
+        ret = min(ret, trickle_timer_next_expiry(&cur->ws_info->trickle_pan_config, params));
+    }
+    return ret;
+}
+
 void ws_bootstrap_asynch_trickle_stop(protocol_interface_info_entry_t *cur)
 {
     cur->ws_info->trickle_pas_running = false;
@@ -23,6 +23,7 @@
 #include "common/bits.h"
 #include "common/parsers.h"
 #include "common/rand.h"
+#include "common/utils.h"
 #include "common/ws_regdb.h"
 #include "stack-services/ns_trace.h"
 #include "stack-services/common_functions.h"
@@ -229,6 +230,15 @@ void ws_common_fast_timer(protocol_interface_info_entry_t *cur, uint16_t ticks)
     ws_llc_fast_timer(cur, ticks);
 }
 
+uint32_t ws_common_fast_timer_next_expiry(protocol_interface_info_entry_t *cur)
+{
+    uint32_t ret = ws_bootstrap_trickle_timer_next_expiry(cur);
+
+    ret = min(ret, ws_nud_active_timer_next_expiry(cur));
+    ret = min(ret, ws_llc_fast_timer_next_expiry(cur));
+    return ret;
+}
+
 void ws_common_create_ll_address(uint8_t *ll_address, const uint8_t *mac64)
 {
     memcpy(ll_address, ADDR_LINK_LOCAL_PREFIX, 8);
@@ -264,7 +274,7 @@ void ws_common_neighbor_remove(protocol_interface_info_entry_t *cur, const uint8
     ws_bootstrap_neighbor_remove(cur, ll_address);
 }
 
-uint8_t ws_common_temporary_entry_size(uint8_t mac_table_size)
+uint8_t ws_common_temporary_entry_size(uint16_t mac_table_size)
 {
     if (mac_table_size >= 128) {
         return (WS_RPL_CANDIDATE_PARENT_COUNT + WS_LARGE_TEMPORARY_NEIGHBOUR_ENTRIES);
@@ -303,8 +313,8 @@ static void ws_common_neighbour_address_reg_link_update(protocol_interface_info_
 
 uint8_t ws_common_allow_child_registration(protocol_interface_info_entry_t *interface, const uint8_t *eui64, uint16_t aro_timeout)
 {
-    uint8_t child_count = 0;
-    uint8_t max_child_count = mac_neighbor_info(interface)->list_total_size - ws_common_temporary_entry_size(mac_neighbor_info(interface)->list_total_size);
+    uint16_t child_count = 0;
+    uint16_t max_child_count = mac_neighbor_info(interface)->list_total_size - ws_common_temporary_entry_size(mac_neighbor_info(interface)->list_total_size);
 
     if (aro_timeout == 0) {
         //DeRegister Address Reg
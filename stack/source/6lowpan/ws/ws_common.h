@@ -165,6 +165,8 @@ int8_t ws_common_allocate_and_init(protocol_interface_info_entry_t *cur);
 void ws_common_seconds_timer(protocol_interface_info_entry_t *cur, uint32_t seconds);
 
 void ws_common_fast_timer(protocol_interface_info_entry_t *cur, uint16_t ticks);
+// Number of ticks before ws_common_fast_timer() has something to do
+uint32_t ws_common_fast_timer_next_expiry(protocol_interface_info_entry_t *cur);
 
 void ws_common_create_ll_address(uint8_t *ll_address, const uint8_t *mac64);
 
@@ -200,7 +202,7 @@ void ws_common_primary_parent_update(protocol_interface_info_entry_t *interface,
 
 void ws_common_secondary_parent_update(protocol_interface_info_entry_t *interface);
 
-uint8_t ws_common_temporary_entry_size(uint8_t mac_table_size);
+uint8_t ws_common_temporary_entry_size(uint16_t mac_table_size);
 
 void ws_common_border_router_alive_update(protocol_interface_info_entry_t *interface);
 
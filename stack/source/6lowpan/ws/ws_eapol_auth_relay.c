@@ -132,7 +132,7 @@ static eapol_auth_relay_t *ws_eapol_auth_relay_get(protocol_interface_info_entry
     return g_eapol_auth_relay;
 }
 
-void ws_eapol_auth_relay_socket_cb(int fd)
+int ws_eapol_auth_relay_socket_cb(int fd)
 {
     ssize_t socket_data_len;
     uint8_t data[2048];
@@ -143,17 +143,17 @@ void ws_eapol_auth_relay_socket_cb(int fd)
     socklen_t sockaddr_len = sizeof(struct sockaddr_in6);
     eapol_auth_relay_t *eapol_auth_relay = g_eapol_auth_relay;
 
+    socket_data_len = recvfrom(fd, data, sizeof(data), MSG_DONTWAIT, (struct sockaddr *) &sockaddr, &sockaddr_len);
+    if (socket_data_len <= 0)
+        return socket_data_len;
+
     if (!eapol_auth_relay) {
-        return;
+        return socket_data_len;
     }
 
-    socket_data_len = recvfrom(fd, data, sizeof(data), 0, (struct sockaddr *) &sockaddr, &sockaddr_len);
-    if (socket_data_len <= 0)
-        return;
-
     socket_pdu = malloc(socket_data_len);
     if (!socket_pdu)
-        return;
+        return socket_data_len;
 
     memcpy(socket_pdu, data, socket_data_len);
 
@@ -179,7 +179,7 @@ void ws_eapol_auth_relay_socket_cb(int fd)
          */
         if (data_len == 1 && !addr_ipv6_equal(relay_ip_addr.address, eapol_auth_relay->relay_addr.address)) {
             free(socket_pdu);
-            return;
+            return socket_data_len;
         }
         ws_eapol_relay_lib_send_to_relay(eapol_auth_relay->socket_id, eui_64, &relay_ip_addr,
                                          ptr, data_len);
@@ -191,6 +191,7 @@ void ws_eapol_auth_relay_socket_cb(int fd)
                                         ptr + 8, socket_data_len - 8);
         free(socket_pdu);
     }
+    return socket_data_len;
 }
 
 static int8_t ws_eapol_auth_relay_send_to_kmp(eapol_auth_relay_t *eapol_auth_relay, const uint8_t *eui_64, const uint8_t *ip_addr, uint16_t port, const void *data, uint16_t data_len)
@@ -183,61 +183,70 @@ static int8_t ws_eapol_relay_eapol_pdu_receive(protocol_interface_info_entry_t *
     return 0;
 }
 
+static void ws_eapol_relay_socket_pdu_forward(eapol_relay_t *eapol_relay, uint8_t *socket_pdu, uint16_t data_len)
+{
+    // EAPOL PDU data length is zero (message contains only supplicant EUI-64 and KMP ID)
+    if (data_len == 9) {
+        ws_eapol_pdu_mpx_eui64_purge(eapol_relay->interface_ptr, socket_pdu);
+        free(socket_pdu);
+        return;
+    }
+
+    //First 8 byte is EUID64 and rsr payload
+    if (ws_eapol_pdu_send_to_mpx(eapol_relay->interface_ptr, socket_pdu, socket_pdu + 8, data_len - 8, socket_pdu, NULL, 0) < 0) {
+        free(socket_pdu);
+    }
+}
+
 #ifdef HAVE_WS_BORDER_ROUTER
-void ws_eapol_relay_socket_cb(int fd)
-#else
-static void ws_eapol_relay_socket_cb(void *cb)
-#endif
+int ws_eapol_relay_socket_cb(int fd)
 {
+    eapol_relay_t *eapol_relay = g_eapol_relay;
     uint8_t *socket_pdu = NULL;
     ssize_t data_len;
-#ifdef HAVE_WS_BORDER_ROUTER
     uint8_t data[2048];
 
-    data_len = recv(fd, data, sizeof(data), 0);
+    data_len = recv(fd, data, sizeof(data), MSG_DONTWAIT);
     if (data_len <= 0)
-        return;
+        return data_len;
+
+    if (!eapol_relay) {
+        return data_len;
+    }
+    socket_pdu = malloc(data_len);
+    if (!socket_pdu)
+        return data_len;
+
+    memcpy(socket_pdu, data, data_len);
+    ws_eapol_relay_socket_pdu_forward(eapol_relay, socket_pdu, data_len);
+    return data_len;
+}
 #else
+static void ws_eapol_relay_socket_cb(void *cb)
+{
     socket_callback_t *cb_data = cb;
+    eapol_relay_t *eapol_relay = g_eapol_relay;
+    uint8_t *socket_pdu = NULL;
     ns_address_t src_addr;
 
     if (cb_data->event_type != SOCKET_DATA) {
         return;
     }
 
-    data_len = cb_data->d_len;
-#endif
-
-    eapol_relay_t *eapol_relay = g_eapol_relay;
-
     if (!eapol_relay) {
         return;
     }
-    socket_pdu = malloc(data_len);
+    socket_pdu = malloc(cb_data->d_len);
     if (!socket_pdu)
         return;
 
-#ifdef HAVE_WS_BORDER_ROUTER
-    memcpy(socket_pdu, data, data_len);
-#else
     if (socket_recvfrom(cb_data->socket_id, socket_pdu, cb_data->d_len, 0, &src_addr) != cb_data->d_len) {
         free(socket_pdu);
         return;
     }
-#endif
-
-    // EAPOL PDU data length is zero (message contains only supplicant EUI-64 and KMP ID)
-    if (data_len == 9) {
-        ws_eapol_pdu_mpx_eui64_purge(eapol_relay->interface_ptr, socket_pdu);
-        free(socket_pdu);
-        return;
-    }
-
-    //First 8 byte is EUID64 and rsr payload
-    if (ws_eapol_pdu_send_to_mpx(eapol_relay->interface_ptr, socket_pdu, socket_pdu + 8, data_len - 8, socket_pdu, NULL, 0) < 0) {
-        free(socket_pdu);
-    }
+    ws_eapol_relay_socket_pdu_forward(eapol_relay, socket_pdu, cb_data->d_len);
 }
+#endif
 
 #endif /* HAVE_EAPOL_RELAY */
 
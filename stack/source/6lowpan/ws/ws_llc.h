@@ -230,6 +230,7 @@ void ws_llc_hopping_schedule_config(struct protocol_interface_info_entry *interf
 void ws_llc_timer_seconds(struct protocol_interface_info_entry *interface, uint16_t seconds_update);
 
 void ws_llc_fast_timer(struct protocol_interface_info_entry *interface, uint16_t ticks);
+uint32_t ws_llc_fast_timer_next_expiry(struct protocol_interface_info_entry *interface);
 
 bool ws_llc_eapol_relay_forward_filter(struct protocol_interface_info_entry *interface, const uint8_t *joiner_eui64, uint8_t mac_sequency, uint32_t rx_timestamp);
 
@@ -33,6 +33,7 @@
 #include "stack/ws_management_api.h"
 
 #include "nwk_interface/protocol.h"
+#include "nwk_interface/protocol_stats.h"
 #include "security/pana/pana_eap_header.h"
 #include "security/eapol/eapol_helper.h"
 #include "6lowpan/mac/mac_helper.h"
@@ -53,6 +54,10 @@
 #define TRACE_GROUP "wllc"
 
 #define LLC_MESSAGE_QUEUE_LIST_SIZE_MAX   16 //Do not config over 30 never
+/* Room for the active messages and a few pending EAPOL ones. Messages which
+ * do not fit are allocated from the heap. */
+#define LLC_MESSAGE_POOL_SIZE             (LLC_MESSAGE_QUEUE_LIST_SIZE_MAX + 8)
+#define LLC_MESSAGE_POOL_IE_BUFFER_SIZE   256
 #define MPX_USER_SIZE 2
 
 typedef struct {
@@ -99,6 +104,7 @@ typedef struct {
     unsigned        mpx_id: 5;          /**< MPX sequence */
     bool            ack_requested: 1;   /**< ACK requested */
     bool            eapol_temporary: 1; /**< EAPOL TX entry index used */
+    bool            pooled: 1;          /**< Allocated from llc_message_pool */
     unsigned        dst_address_type: 2; /**<  Destination address type */
     unsigned        src_address_type: 2; /**<  Source address type */
     uint8_t         msg_handle;         /**< LLC genetaed unique MAC handle */
@@ -115,6 +121,11 @@ typedef struct {
 
 typedef NS_LIST_HEAD(llc_message_t, link) llc_message_list_t;
 
+typedef union {
+    llc_message_t   message;
+    uint8_t         storage[sizeof(llc_message_t) + LLC_MESSAGE_POOL_IE_BUFFER_SIZE];
+} llc_message_slot_t;
+
 typedef struct {
     ws_neighbor_temp_class_t        neighbour_temporary_table[MAX_NEIGH_TEMPORAY_LIST_SIZE];
     ws_neighbor_temp_list_t         active_multicast_temp_neigh;
@@ -134,10 +145,15 @@ typedef struct {
 
     uint8_t                         mac_handle_base;                /**< Mac handle id base this will be updated by 1 after use */
     uint8_t                         llc_message_list_size;          /**< llc_message_list list size */
+    uint8_t                         llc_message_pool_used;          /**< Messages allocated from llc_message_pool */
     uint16_t                        edfe_rx_wait_timer;
+    uint16_t                        mpx_id_used;                    /**< Bitfield of MPX ids of active messages */
     mpx_class_t                     mpx_data_base;                  /**< MPX data be including USER API Class and user call backs */
 
     llc_message_list_t              llc_message_list;               /**< Active Message list */
+    llc_message_t                   *llc_message_table[256];        /**< Active messages by MAC handle */
+    llc_message_list_t              llc_message_free_list;          /**< Free entries of llc_message_pool */
+    llc_message_slot_t              llc_message_pool[LLC_MESSAGE_POOL_SIZE];
     llc_ie_params_t                 ie_params;                      /**< LLC IE header and Payload data configuration */
     temp_entriest_t                 *temp_entries;
 
@@ -158,8 +174,7 @@ static uint16_t ws_wp_nested_message_length(wp_nested_ie_sub_list_t requested_li
 static uint16_t ws_wh_headers_length(wh_ie_sub_list_t requested_list, llc_ie_params_t *params);
 
 /** LLC message local functions */
-static llc_message_t *llc_message_discover_by_mac_handle(uint8_t handle, llc_message_list_t *list);
-static llc_message_t *llc_message_discover_by_mpx_id(uint8_t handle, llc_message_list_t *list);
+static llc_message_t *llc_message_discover_by_mac_handle(uint8_t handle, llc_data_base_t *llc_base);
 static llc_message_t *llc_message_discover_mpx_user_id(uint8_t handle, uint16_t user_id, llc_message_list_t *list);
 static void llc_message_free(llc_message_t *message, llc_data_base_t *llc_base);
 static void llc_message_id_allocate(llc_message_t *message, llc_data_base_t *llc_base, bool mpx_user);
@@ -216,24 +231,9 @@ int8_t  ws_test_drop_edfe_data_frames(int8_t interface_id, uint8_t number_of_dro
 }
 
 /** Discover Message by message handle id */
-static llc_message_t *llc_message_discover_by_mac_handle(uint8_t handle, llc_message_list_t *list)
+static llc_message_t *llc_message_discover_by_mac_handle(uint8_t handle, llc_data_base_t *llc_base)
 {
-    ns_list_foreach(llc_message_t, message, list) {
-        if (message->msg_handle == handle) {
-            return message;
-        }
-    }
-    return NULL;
-}
-
-static llc_message_t *llc_message_discover_by_mpx_id(uint8_t handle, llc_message_list_t *list)
-{
-    ns_list_foreach(llc_message_t, message, list) {
-        if ((message->message_type == WS_FT_DATA || message->message_type == WS_FT_EAPOL) && message->mpx_id == handle) {
-            return message;
-        }
-    }
-    return NULL;
+    return llc_base->llc_message_table[handle];
 }
 
 
@@ -258,10 +258,25 @@ static llc_message_t *llc_message_discover_mpx_user_id(uint8_t handle, uint16_t
 
 
 //Free message and delete from list
+static void llc_message_release(llc_message_t *message, llc_data_base_t *llc_base)
+{
+    if (message->pooled) {
+        ns_list_add_to_start(&llc_base->llc_message_free_list, message);
+        llc_base->llc_message_pool_used--;
+        protocol_stats_update(STATS_LLC_MESSAGE_POOL_USED, llc_base->llc_message_pool_used);
+    } else {
+        free(message);
+    }
+}
+
 static void llc_message_free(llc_message_t *message, llc_data_base_t *llc_base)
 {
     ns_list_remove(&llc_base->llc_message_list, message);
-    free(message);
+    llc_base->llc_message_table[message->msg_handle] = NULL;
+    if (message->message_type == WS_FT_DATA || message->message_type == WS_FT_EAPOL) {
+        llc_base->mpx_id_used &= ~(1u << message->mpx_id);
+    }
+    llc_message_release(message, llc_base);
     llc_base->llc_message_list_size--;
     random_early_detection_aq_calc(llc_base->interface_ptr->llc_random_early_detection, llc_base->llc_message_list_size);
 }
@@ -269,27 +284,21 @@ static void llc_message_free(llc_message_t *message, llc_data_base_t *llc_base)
 static void llc_message_id_allocate(llc_message_t *message, llc_data_base_t *llc_base, bool mpx_user)
 {
     //Guarantee
-    while (1) {
-        if (llc_message_discover_by_mac_handle(llc_base->mac_handle_base, &llc_base->llc_message_list)) {
-            llc_base->mac_handle_base++;
-        } else {
-            break;
-        }
+    while (llc_base->llc_message_table[llc_base->mac_handle_base]) {
+        llc_base->mac_handle_base++;
     }
     if (mpx_user) {
-        while (1) {
-            if (llc_message_discover_by_mpx_id(llc_base->mpx_data_base.mpx_id, &llc_base->llc_message_list)) {
-                llc_base->mpx_data_base.mpx_id++;
-            } else {
-                break;
-            }
+        while (llc_base->mpx_id_used & (1u << llc_base->mpx_data_base.mpx_id)) {
+            llc_base->mpx_data_base.mpx_id++;
         }
     }
 
-    //Storage handle and update base
+    //Storage handle and update base, the caller adds the message to llc_message_list
     message->msg_handle = llc_base->mac_handle_base++;
+    llc_base->llc_message_table[message->msg_handle] = message;
     if (mpx_user) {
         message->mpx_id = llc_base->mpx_data_base.mpx_id++;
+        llc_base->mpx_id_used |= 1u << message->mpx_id;
     }
 }
 
@@ -299,9 +308,22 @@ static llc_message_t *llc_message_allocate(uint16_t ie_buffer_size, llc_data_bas
         return NULL;
     }
 
-    llc_message_t *message = malloc(sizeof(llc_message_t) + ie_buffer_size);
-    if (!message) {
-        return NULL;
+    llc_message_t *message = NULL;
+    if (ie_buffer_size <= LLC_MESSAGE_POOL_IE_BUFFER_SIZE) {
+        message = ns_list_get_first(&llc_base->llc_message_free_list);
+    }
+    if (message) {
+        ns_list_remove(&llc_base->llc_message_free_list, message);
+        llc_base->llc_message_pool_used++;
+        protocol_stats_update(STATS_LLC_MESSAGE_POOL_USED, llc_base->llc_message_pool_used);
+        message->pooled = true;
+    } else {
+        message = malloc(sizeof(llc_message_t) + ie_buffer_size);
+        if (!message) {
+            return NULL;
+        }
+        protocol_stats_update(STATS_LLC_MESSAGE_POOL_OVERFLOW, 1);
+        message->pooled = false;
     }
     message->ack_requested = false;
     message->eapol_temporary = false;
@@ -470,6 +492,10 @@ static llc_data_base_t *ws_llc_base_allocate(void)
     base->temp_entries = temp_entries;
 
     ns_list_init(&base->llc_message_list);
+    ns_list_init(&base->llc_message_free_list);
+    for (int i = 0; i < LLC_MESSAGE_POOL_SIZE; i++) {
+        ns_list_add_to_end(&base->llc_message_free_list, &base->llc_message_pool[i].message);
+    }
 
     ns_list_add_to_end(&llc_data_base_list, base);
     return base;
@@ -494,7 +520,7 @@ static void ws_llc_mac_confirm_cb(const mac_api_t *api, const mcps_data_conf_t *
     }
 
     protocol_interface_info_entry_t *interface = base->interface_ptr;
-    llc_message_t *message = llc_message_discover_by_mac_handle(data->msduHandle, &base->llc_message_list);
+    llc_message_t *message = llc_message_discover_by_mac_handle(data->msduHandle, base);
     if (!message) {
         return;
     }
@@ -1533,7 +1559,7 @@ static void ws_llc_clean(llc_data_base_t *base)
 
     ns_list_foreach_safe(llc_message_t, message, &base->temp_entries->llc_eap_pending_list) {
         ns_list_remove(&base->temp_entries->llc_eap_pending_list, message);
-        free(message);
+        llc_message_release(message, base);
     }
     base->temp_entries->llc_eap_pending_list_size = 0;
     base->temp_entries->active_eapol_session = false;
@@ -1743,7 +1769,7 @@ static void ws_llc_mcps_edfe_handler(const mac_api_t *api, mcps_edfe_response_t
 
         llc_message_t *message = NULL;
         if (response_message->use_message_handle_to_discover) {
-            message = llc_message_discover_by_mac_handle(response_message->message_handle, &base->llc_message_list);
+            message = llc_message_discover_by_mac_handle(response_message->message_handle, base);
         }
 
         if (!message) {
@@ -2151,6 +2177,16 @@ void ws_llc_fast_timer(struct protocol_interface_info_entry *interface, uint16_t
     }
 }
 
+/* EDFE timer is in milliseconds */
+uint32_t ws_llc_fast_timer_next_expiry(struct protocol_interface_info_entry *interface)
+{
+    llc_data_base_t *base = ws_llc_discover_by_interface(interface);
+    if (!base || !base->edfe_rx_wait_timer) {
+        return UINT32_MAX;
+    }
+    return base->edfe_rx_wait_timer > 100 ? (base->edfe_rx_wait_timer + 99) / 100 : 1;
+}
+
 void ws_llc_timer_seconds(struct protocol_interface_info_entry *interface, uint16_t seconds_update)
 {
     llc_data_base_t *base = ws_llc_discover_by_interface(interface);
@@ -39,6 +39,7 @@
 #include "security/protocols/eap_tls_sec_prot/auth_eap_tls_sec_prot.h"
 #include "security/protocols/eap_tls_sec_prot/radius_eap_tls_sec_prot.h"
 #include "security/protocols/tls_sec_prot/tls_sec_prot.h"
+#include "security/protocols/tls_sec_prot/tls_sec_prot_lib.h"
 #include "security/protocols/fwh_sec_prot/auth_fwh_sec_prot.h"
 #include "security/protocols/gkh_sec_prot/auth_gkh_sec_prot.h"
 #include "security/protocols/radius_sec_prot/radius_client_sec_prot.h"
@@ -457,6 +458,9 @@ int8_t ws_pae_auth_node_keys_remove(protocol_interface_info_entry_t *interface_p
         ret_value = 0;
     }
 
+    // Revoked supplicant must do a full handshake
+    tls_sec_prot_lib_session_delete(eui_64);
+
     return ret_value;
 }
 
@@ -727,9 +731,17 @@ void ws_pae_auth_fast_timer(uint16_t ticks)
             ws_pae_auth_timer_stop(pae_auth);
         }
     }
+}
 
-    // Update key storage fast timer
-    ws_pae_key_storage_fast_timer(ticks);
+// The KMP timers are processed on every tick while they are running
+uint32_t ws_pae_auth_fast_timer_next_expiry(void)
+{
+    ns_list_foreach(pae_auth_t, pae_auth, &pae_auth_list) {
+        if (ws_pae_auth_timer_running(pae_auth)) {
+            return 1;
+        }
+    }
+    return UINT32_MAX;
 }
 
 void ws_pae_auth_slow_timer(uint16_t seconds)
@@ -103,6 +103,14 @@ int8_t ws_pae_auth_delete(protocol_interface_info_entry_t *interface_ptr);
  */
 void ws_pae_auth_fast_timer(uint16_t ticks);
 
+/**
+ * ws_pae_auth_fast_timer_next_expiry ticks before the fast timer has something to do
+ *
+ * \return 1 while authenticator timers are running, UINT32_MAX otherwise
+ *
+ */
+uint32_t ws_pae_auth_fast_timer_next_expiry(void);
+
 /**
  * ws_pae_auth_slow_timer PAE authenticator slow call
  *
@@ -298,6 +306,7 @@ void ws_pae_auth_cb_register(protocol_interface_info_entry_t *interface_ptr, ws_
 #define ws_pae_auth_node_access_revoke_start(interface_ptr) -1
 #define ws_pae_auth_node_limit_set(interface_ptr, limit)
 #define ws_pae_auth_fast_timer NULL
+#define ws_pae_auth_fast_timer_next_expiry NULL
 #define ws_pae_auth_slow_timer NULL
 #define ws_pae_auth_radius_address_set(interface_ptr, remote_addr) -1
 
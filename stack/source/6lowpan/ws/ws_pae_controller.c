@@ -50,6 +50,7 @@
 
 typedef int8_t ws_pae_delete(protocol_interface_info_entry_t *interface_ptr);
 typedef void ws_pae_timer(uint16_t ticks);
+typedef uint32_t ws_pae_timer_next_expiry(void);
 typedef int8_t ws_pae_br_addr_write(protocol_interface_info_entry_t *interface_ptr, const uint8_t *eui_64);
 typedef int8_t ws_pae_br_addr_read(protocol_interface_info_entry_t *interface_ptr, uint8_t *eui_64);
 typedef void ws_pae_gtks_updated(protocol_interface_info_entry_t *interface_ptr);
@@ -94,6 +95,7 @@ typedef struct {
     ws_pae_controller_ip_addr_get *ip_addr_get;                      /**< IP address get callback */
     ws_pae_delete *pae_delete;                                       /**< PAE delete callback */
     ws_pae_timer *pae_fast_timer;                                    /**< PAE fast timer callback */
+    ws_pae_timer_next_expiry *pae_fast_timer_next_expiry;            /**< PAE fast timer next expiry callback */
     ws_pae_timer *pae_slow_timer;                                    /**< PAE slow timer callback */
     ws_pae_br_addr_write *pae_br_addr_write;                         /**< PAE Border router EUI-64 write callback */
     ws_pae_br_addr_read *pae_br_addr_read;                           /**< PAE Border router EUI-64 read callback */
@@ -784,6 +786,7 @@ static void ws_pae_controller_data_init(pae_controller_t *controller)
     controller->target_pan_id = 0xffff;
     controller->pae_delete = NULL;
     controller->pae_fast_timer = NULL;
+    controller->pae_fast_timer_next_expiry = NULL;
     controller->pae_slow_timer = NULL;
     controller->pae_br_addr_write = NULL;
     controller->pae_br_addr_read = NULL;
@@ -951,6 +954,7 @@ int8_t ws_pae_controller_supp_init(protocol_interface_info_entry_t *interface_pt
 
     controller->pae_delete = ws_pae_supp_delete;
     controller->pae_fast_timer = ws_pae_supp_fast_timer;
+    controller->pae_fast_timer_next_expiry = ws_pae_supp_fast_timer_next_expiry;
     controller->pae_slow_timer = ws_pae_supp_slow_timer;
     controller->pae_br_addr_write = ws_pae_supp_border_router_addr_write;
     controller->pae_br_addr_read = ws_pae_supp_border_router_addr_read;
@@ -986,6 +990,7 @@ int8_t ws_pae_controller_auth_init(protocol_interface_info_entry_t *interface_pt
 
     controller->pae_delete = ws_pae_auth_delete;
     controller->pae_fast_timer = ws_pae_auth_fast_timer;
+    controller->pae_fast_timer_next_expiry = ws_pae_auth_fast_timer_next_expiry;
     controller->pae_slow_timer = ws_pae_auth_slow_timer;
     controller->pae_gtks_updated = ws_pae_auth_gtks_updated;
     controller->pae_nw_key_index_update = ws_pae_auth_nw_key_index_update;
@@ -1116,6 +1121,7 @@ int8_t ws_pae_controller_certificate_chain_set(const arm_certificate_chain_entry
 
         // Updates the length of own certificates
         entry->certs.own_cert_chain_len = sec_prot_certs_cert_chain_entry_len_get(&entry->certs.own_cert_chain);
+        sec_prot_certs_updated(&entry->certs);
     }
 
     return 0;
@@ -1143,6 +1149,7 @@ int8_t ws_pae_controller_own_certificate_add(const arm_certificate_entry_s *cert
         }
         // Updates the length of own certificates
         entry->certs.own_cert_chain_len = sec_prot_certs_cert_chain_entry_len_get(&entry->certs.own_cert_chain);
+        sec_prot_certs_updated(&entry->certs);
     }
 
     return ret;
@@ -1153,6 +1160,7 @@ int8_t ws_pae_controller_own_certificates_remove(void)
     ns_list_foreach(pae_controller_t, entry, &pae_controller_list) {
         sec_prot_certs_chain_entry_init(&entry->certs.own_cert_chain);
         entry->certs.own_cert_chain_len = 0;
+        sec_prot_certs_updated(&entry->certs);
     }
 
     return 0;
@@ -1175,6 +1183,7 @@ int8_t ws_pae_controller_trusted_certificate_add(const arm_certificate_entry_s *
             continue;
         }
         sec_prot_certs_chain_list_add(&entry->certs.trusted_cert_chain_list, trusted_cert);
+        sec_prot_certs_updated(&entry->certs);
         ret = 0;
     }
 
@@ -1196,6 +1205,7 @@ int8_t ws_pae_controller_trusted_certificate_remove(const arm_certificate_entry_
         cert_chain_entry_t *removed_cert = sec_prot_certs_chain_list_entry_find(&entry->certs.trusted_cert_chain_list, trusted_cert);
         if (removed_cert) {
             sec_prot_certs_chain_list_entry_delete(&entry->certs.trusted_cert_chain_list, removed_cert);
+            sec_prot_certs_updated(&entry->certs);
             ret = 0;
         }
     }
@@ -1209,6 +1219,7 @@ int8_t ws_pae_controller_trusted_certificates_remove(void)
 {
     ns_list_foreach(pae_controller_t, entry, &pae_controller_list) {
         sec_prot_certs_chain_list_delete(&entry->certs.trusted_cert_chain_list);
+        sec_prot_certs_updated(&entry->certs);
     }
 
     return 0;
@@ -1232,6 +1243,7 @@ int8_t ws_pae_controller_certificate_revocation_list_add(const arm_cert_revocati
         }
 
         sec_prot_certs_revocat_lists_add(&entry->certs.cert_revocat_lists, cert_revoc_list);
+        sec_prot_certs_updated(&entry->certs);
         ret = 0;
     }
 
@@ -1253,6 +1265,7 @@ int8_t ws_pae_controller_certificate_revocation_list_remove(const arm_cert_revoc
         cert_revocat_list_entry_t *removed_cert_revoc_list = sec_prot_certs_revocat_lists_entry_find(&entry->certs.cert_revocat_lists, cert_revoc_list);
         if (removed_cert_revoc_list) {
             sec_prot_certs_revocat_lists_entry_delete(&entry->certs.cert_revocat_lists, removed_cert_revoc_list);
+            sec_prot_certs_updated(&entry->certs);
             ret = 0;
         }
     }
@@ -1705,6 +1718,24 @@ void ws_pae_controller_fast_timer(uint16_t ticks)
     }
 }
 
+uint32_t ws_pae_controller_fast_timer_next_expiry(void)
+{
+    uint32_t ret = UINT32_MAX;
+    uint32_t next;
+
+    ns_list_foreach(pae_controller_t, entry, &pae_controller_list) {
+        if (!entry->pae_fast_timer) {
+            continue;
+        }
+        // Without next expiry, the fast timer runs on every tick
+        next = entry->pae_fast_timer_next_expiry ? entry->pae_fast_timer_next_expiry() : 1;
+        if (next < ret) {
+            ret = next;
+        }
+    }
+    return ret;
+}
+
 void ws_pae_controller_slow_timer(uint16_t seconds)
 {
     ns_list_foreach(pae_controller_t, entry, &pae_controller_list) {
@@ -684,6 +684,14 @@ int8_t ws_pae_controller_auth_cb_register(protocol_interface_info_entry_t *inter
  */
 void ws_pae_controller_fast_timer(uint16_t ticks);
 
+/**
+ * ws_pae_controller_fast_timer_next_expiry ticks before the fast timer has something to do
+ *
+ * \return ticks, UINT32_MAX if no timer is running
+ *
+ */
+uint32_t ws_pae_controller_fast_timer_next_expiry(void);
+
 /**
  * ws_pae_controller_slow_timer PAE controller slow timer call
  *
@@ -0,0 +1,489 @@
+/*
+ * Copyright (c) 2022 Silicon Laboratories Inc. (www.silabs.com)
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of the Silicon Labs Master Software License
+ * Agreement (MSLA) available at [1].  This software is distributed to you in
+ * Object Code format and/or Source Code format and is governed by the sections
+ * of the MSLA applicable to Object Code, Source Code and Modified Open Source
+ * Code. By using this software, you agree to the terms of the MSLA.
+ *
+ * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
+ */
+#include "nsconfig.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include "common/crc.h"
+#include "common/log.h"
+#include "common/utils.h"
+#include "stack-services/ns_list.h"
+#include "stack-services/ns_trace.h"
+#include "stack-services/common_functions.h"
+
+#include "6lowpan/ws/ws_pae_key_journal.h"
+
+#define TRACE_GROUP "wskj"
+
+// Type, length, CRC
+#define KEY_JOURNAL_RECORD_OVERHEAD 6
+#define KEY_JOURNAL_TYPE_VERSION    0
+
+typedef struct ws_pae_key_journal_job {
+    bool rewrite;
+    size_t len;
+    size_t size;
+    uint8_t *buf;
+    ns_list_link_t link;
+} ws_pae_key_journal_job_t;
+
+typedef NS_LIST_HEAD(ws_pae_key_journal_job_t, link) ws_pae_key_journal_job_list_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t queue_cond;      // Signaled when a commit is queued
+    pthread_cond_t idle_cond;       // Signaled when the queued commits are written
+    ws_pae_key_journal_job_list_t queue;
+    bool busy;
+    bool thread_started;
+    bool failed;                    // The journal misses some commits, only a rewrite can fix it
+    size_t disk_size;               // Size of the journal on disk
+    char *path;
+    char *tmp_path;
+    uint32_t version;
+    int fd;                         // Only accessed by the I/O thread
+    ws_pae_key_journal_job_t *pending;
+    size_t size;
+} ws_pae_key_journal = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .queue_cond = PTHREAD_COND_INITIALIZER,
+    .idle_cond = PTHREAD_COND_INITIALIZER,
+    .queue = NS_LIST_INIT(ws_pae_key_journal.queue),
+    .fd = -1,
+};
+
+static void ws_pae_key_journal_job_reserve(ws_pae_key_journal_job_t *job, size_t len)
+{
+    if (job->len + len <= job->size)
+        return;
+    job->size = max(2 * job->size, job->len + len);
+    job->buf = realloc(job->buf, job->size);
+    FATAL_ON(!job->buf, 2, "%s: realloc: %m", __func__);
+}
+
+static void ws_pae_key_journal_job_put(ws_pae_key_journal_job_t *job, uint16_t type, const void *data, uint16_t len)
+{
+    uint8_t *ptr;
+
+    ws_pae_key_journal_job_reserve(job, len + KEY_JOURNAL_RECORD_OVERHEAD);
+    ptr = job->buf + job->len;
+    ptr = common_write_16_bit(type, ptr);
+    ptr = common_write_16_bit(len, ptr);
+    memcpy(ptr, data, len);
+    ptr += len;
+    ptr = common_write_16_bit(crc16(job->buf + job->len, len + 4), ptr);
+    job->len = ptr - job->buf;
+}
+
+static ws_pae_key_journal_job_t *ws_pae_key_journal_job_new(bool rewrite)
+{
+    ws_pae_key_journal_job_t *job = calloc(1, sizeof(ws_pae_key_journal_job_t));
+    uint8_t version[4];
+
+    FATAL_ON(!job, 2, "%s: calloc: %m", __func__);
+    job->rewrite = rewrite;
+    if (rewrite) {
+        common_write_32_bit(ws_pae_key_journal.version, version);
+        ws_pae_key_journal_job_put(job, KEY_JOURNAL_TYPE_VERSION, version, sizeof(version));
+    }
+    return job;
+}
+
+static void ws_pae_key_journal_job_free(ws_pae_key_journal_job_t *job)
+{
+    free(job->buf);
+    free(job);
+}
+
+static int ws_pae_key_journal_write_all(int fd, const uint8_t *buf, size_t len)
+{
+    ssize_t ret;
+
+    while (len) {
+        ret = write(fd, buf, len);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0)
+            return -1;
+        buf += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+static void ws_pae_key_journal_sync_dir(const char *path)
+{
+    const char *sep = strrchr(path, '/');
+    char dir[sep ? sep - path + 2 : 2];
+    int fd;
+
+    if (sep) {
+        memcpy(dir, path, sep - path + 1);
+        dir[sep - path + 1] = '\0';
+    } else {
+        strcpy(dir, ".");
+    }
+    fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+        return;
+    fsync(fd);
+    close(fd);
+}
+
+// On failure, the journal is left untouched
+static int ws_pae_key_journal_rewrite(ws_pae_key_journal_job_list_t *jobs, size_t *size)
+{
+    int fd;
+
+    fd = open(ws_pae_key_journal.tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        WARN("%s: open %s: %m", __func__, ws_pae_key_journal.tmp_path);
+        return -1;
+    }
+    *size = 0;
+    ns_list_foreach(ws_pae_key_journal_job_t, job, jobs) {
+        if (ws_pae_key_journal_write_all(fd, job->buf, job->len) < 0) {
+            WARN("%s: write %s: %m", __func__, ws_pae_key_journal.tmp_path);
+            goto err;
+        }
+        *size += job->len;
+    }
+    if (fdatasync(fd) < 0) {
+        WARN("%s: fdatasync %s: %m", __func__, ws_pae_key_journal.tmp_path);
+        goto err;
+    }
+    close(fd);
+    if (rename(ws_pae_key_journal.tmp_path, ws_pae_key_journal.path) < 0) {
+        WARN("%s: rename %s: %m", __func__, ws_pae_key_journal.path);
+        unlink(ws_pae_key_journal.tmp_path);
+        return -1;
+    }
+    ws_pae_key_journal_sync_dir(ws_pae_key_journal.path);
+    // The journal has been replaced, the next append must reopen it
+    if (ws_pae_key_journal.fd >= 0)
+        close(ws_pae_key_journal.fd);
+    ws_pae_key_journal.fd = -1;
+    return 0;
+err:
+    close(fd);
+    unlink(ws_pae_key_journal.tmp_path);
+    return -1;
+}
+
+// On failure, the journal is truncated back to its previous end when possible
+static int ws_pae_key_journal_append_jobs(ws_pae_key_journal_job_list_t *jobs, size_t *size)
+{
+    ws_pae_key_journal_job_t *header;
+    off_t offset;
+
+    if (ws_pae_key_journal.fd < 0) {
+        ws_pae_key_journal.fd = open(ws_pae_key_journal.path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+        if (ws_pae_key_journal.fd < 0) {
+            WARN("%s: open %s: %m", __func__, ws_pae_key_journal.path);
+            return -1;
+        }
+    }
+    offset = lseek(ws_pae_key_journal.fd, 0, SEEK_END);
+    if (offset < 0) {
+        WARN("%s: lseek %s: %m", __func__, ws_pae_key_journal.path);
+        goto err_close;
+    }
+    // The journal may have been removed behind our back
+    if (!offset) {
+        header = ws_pae_key_journal_job_new(true);
+        ns_list_add_to_start(jobs, header);
+    }
+    ns_list_foreach(ws_pae_key_journal_job_t, job, jobs) {
+        if (ws_pae_key_journal_write_all(ws_pae_key_journal.fd, job->buf, job->len) < 0) {
+            WARN("%s: write %s: %m", __func__, ws_pae_key_journal.path);
+            goto err_truncate;
+        }
+    }
+    // Group commit: a single flush for all the queued commits
+    if (fdatasync(ws_pae_key_journal.fd) < 0) {
+        WARN("%s: fdatasync %s: %m", __func__, ws_pae_key_journal.path);
+        goto err_truncate;
+    }
+    *size = lseek(ws_pae_key_journal.fd, 0, SEEK_END);
+    return 0;
+err_truncate:
+    // Do not leave a partial record that would hide the next ones on load
+    if (ftruncate(ws_pae_key_journal.fd, offset) < 0)
+        WARN("%s: ftruncate %s: %m", __func__, ws_pae_key_journal.path);
+err_close:
+    close(ws_pae_key_journal.fd);
+    ws_pae_key_journal.fd = -1;
+    return -1;
+}
+
+static void ws_pae_key_journal_write(ws_pae_key_journal_job_list_t *jobs)
+{
+    ws_pae_key_journal_job_t *rewrite = NULL;
+    bool failed;
+    size_t size;
+    int ret;
+
+    ns_list_foreach(ws_pae_key_journal_job_t, job, jobs)
+        if (job->rewrite)
+            rewrite = job;
+    // Everything queued before the last rewrite is already part of it
+    if (rewrite) {
+        ns_list_foreach_safe(ws_pae_key_journal_job_t, job, jobs) {
+            if (job == rewrite)
+                break;
+            ns_list_remove(jobs, job);
+            ws_pae_key_journal_job_free(job);
+        }
+        ret = ws_pae_key_journal_rewrite(jobs, &size);
+    } else {
+        pthread_mutex_lock(&ws_pae_key_journal.lock);
+        failed = ws_pae_key_journal.failed;
+        pthread_mutex_unlock(&ws_pae_key_journal.lock);
+        // Appending after a failed commit would store a journal with a hole
+        if (failed)
+            ret = 1;
+        else
+            ret = ws_pae_key_journal_append_jobs(jobs, &size);
+    }
+    pthread_mutex_lock(&ws_pae_key_journal.lock);
+    if (!ret)
+        ws_pae_key_journal.disk_size = size;
+    if (ret < 0)
+        ws_pae_key_journal.failed = true;
+    else if (rewrite)
+        ws_pae_key_journal.failed = false;
+    pthread_mutex_unlock(&ws_pae_key_journal.lock);
+    ns_list_foreach_safe(ws_pae_key_journal_job_t, job, jobs) {
+        ns_list_remove(jobs, job);
+        ws_pae_key_journal_job_free(job);
+    }
+}
+
+static void *ws_pae_key_journal_thread(void *arg)
+{
+    ws_pae_key_journal_job_list_t jobs = NS_LIST_INIT(jobs);
+
+    pthread_mutex_lock(&ws_pae_key_journal.lock);
+    for (;;) {
+        while (ns_list_is_empty(&ws_pae_key_journal.queue))
+            pthread_cond_wait(&ws_pae_key_journal.queue_cond, &ws_pae_key_journal.lock);
+        ns_list_concatenate(&jobs, &ws_pae_key_journal.queue);
+        ws_pae_key_journal.busy = true;
+        pthread_mutex_unlock(&ws_pae_key_journal.lock);
+
+        ws_pae_key_journal_write(&jobs);
+
+        pthread_mutex_lock(&ws_pae_key_journal.lock);
+        ws_pae_key_journal.busy = false;
+        if (ns_list_is_empty(&ws_pae_key_journal.queue))
+            pthread_cond_broadcast(&ws_pae_key_journal.idle_cond);
+    }
+    return NULL;
+}
+
+void ws_pae_key_journal_init(const char *path, uint32_t version)
+{
+    pthread_t thread;
+    int ret;
+
+    ws_pae_key_journal_sync();
+    free(ws_pae_key_journal.path);
+    free(ws_pae_key_journal.tmp_path);
+    ws_pae_key_journal.path = NULL;
+    ws_pae_key_journal.tmp_path = NULL;
+    if (ws_pae_key_journal.fd >= 0)
+        close(ws_pae_key_journal.fd);
+    ws_pae_key_journal.fd = -1;
+    if (ws_pae_key_journal.pending)
+        ws_pae_key_journal_job_free(ws_pae_key_journal.pending);
+    ws_pae_key_journal.pending = NULL;
+    ws_pae_key_journal.size = 0;
+    ws_pae_key_journal.disk_size = 0;
+    ws_pae_key_journal.failed = false;
+    if (!path)
+        return;
+
+    ws_pae_key_journal.version = version;
+    ws_pae_key_journal.path = strdup(path);
+    FATAL_ON(!ws_pae_key_journal.path, 2, "%s: strdup: %m", __func__);
+    ws_pae_key_journal.tmp_path = malloc(strlen(path) + sizeof(".tmp"));
+    FATAL_ON(!ws_pae_key_journal.tmp_path, 2, "%s: malloc: %m", __func__);
+    sprintf(ws_pae_key_journal.tmp_path, "%s.tmp", path);
+    if (!ws_pae_key_journal.thread_started) {
+        ret = pthread_create(&thread, NULL, ws_pae_key_journal_thread, NULL);
+        FATAL_ON(ret, 2, "pthread_create: %s", strerror(ret));
+        pthread_detach(thread);
+        ws_pae_key_journal.thread_started = true;
+    }
+}
+
+int ws_pae_key_journal_load(ws_pae_key_journal_replay *replay, void *ctx)
+{
+    uint16_t type, len;
+    uint8_t *buf = MAP_FAILED;
+    size_t offset = 0;
+    struct stat st;
+    int fd, ret;
+
+    if (!ws_pae_key_journal.path)
+        return -1;
+    ws_pae_key_journal_sync();
+    fd = open(ws_pae_key_journal.path, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) < 0 || !st.st_size)
+        goto err;
+    // Records are replayed in place, without copying the journal
+    buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (buf == MAP_FAILED)
+        goto err;
+    madvise(buf, st.st_size, MADV_SEQUENTIAL);
+
+    while (offset + KEY_JOURNAL_RECORD_OVERHEAD <= st.st_size) {
+        type = common_read_16_bit(buf + offset);
+        len = common_read_16_bit(buf + offset + 2);
+        if (offset + len + KEY_JOURNAL_RECORD_OVERHEAD > st.st_size)
+            break;
+        if (!crc_check(buf + offset, len + 4, common_read_16_bit(buf + offset + len + 4)))
+            break;
+        if (!offset) {
+            if (type != KEY_JOURNAL_TYPE_VERSION || len != 4 ||
+                common_read_32_bit(buf + 4) != ws_pae_key_journal.version) {
+                tr_warn("KeyJ %s: unsupported version", ws_pae_key_journal.path);
+                goto err;
+            }
+        } else if (replay(ctx, type, buf + offset + 4, len) < 0) {
+            break;
+        }
+        offset += len + KEY_JOURNAL_RECORD_OVERHEAD;
+    }
+    if (!offset)
+        goto err;
+    if (offset != st.st_size) {
+        tr_warn("KeyJ %s: dropped %zu corrupted bytes", ws_pae_key_journal.path, (size_t)st.st_size - offset);
+        if (ftruncate(fd, offset) < 0 || fdatasync(fd) < 0)
+            WARN("%s: ftruncate %s: %m", __func__, ws_pae_key_journal.path);
+    }
+    ws_pae_key_journal.size = offset;
+    ws_pae_key_journal.disk_size = offset;
+    tr_info("KeyJ %s loaded, size: %zu", ws_pae_key_journal.path, offset);
+    ret = 0;
+    goto out;
+err:
+    ret = -1;
+out:
+    if (buf != MAP_FAILED)
+        munmap(buf, st.st_size);
+    close(fd);
+    return ret;
+}
+
+void ws_pae_key_journal_remove(void)
+{
+    if (!ws_pae_key_journal.path)
+        return;
+    ws_pae_key_journal_sync();
+    // The I/O thread is idle, its file descriptor can be closed from here
+    if (ws_pae_key_journal.fd >= 0)
+        close(ws_pae_key_journal.fd);
+    ws_pae_key_journal.fd = -1;
+    if (ws_pae_key_journal.pending)
+        ws_pae_key_journal_job_free(ws_pae_key_journal.pending);
+    ws_pae_key_journal.pending = NULL;
+    ws_pae_key_journal.size = 0;
+    ws_pae_key_journal.disk_size = 0;
+    ws_pae_key_journal.failed = false;
+    unlink(ws_pae_key_journal.path);
+}
+
+void ws_pae_key_journal_append(uint16_t type, const void *data, uint16_t len)
+{
+    BUG_ON(type == KEY_JOURNAL_TYPE_VERSION);
+    if (!ws_pae_key_journal.path)
+        return;
+    if (!ws_pae_key_journal.pending)
+        ws_pae_key_journal.pending = ws_pae_key_journal_job_new(false);
+    ws_pae_key_journal_job_put(ws_pae_key_journal.pending, type, data, len);
+}
+
+void ws_pae_key_journal_commit(bool rewrite)
+{
+    ws_pae_key_journal_job_t *job = ws_pae_key_journal.pending;
+
+    if (!ws_pae_key_journal.path)
+        return;
+    if (rewrite) {
+        // Prepend the version record to the new journal
+        job = ws_pae_key_journal_job_new(true);
+        if (ws_pae_key_journal.pending) {
+            ws_pae_key_journal_job_reserve(job, ws_pae_key_journal.pending->len);
+            memcpy(job->buf + job->len, ws_pae_key_journal.pending->buf, ws_pae_key_journal.pending->len);
+            job->len += ws_pae_key_journal.pending->len;
+            ws_pae_key_journal_job_free(ws_pae_key_journal.pending);
+        }
+        ws_pae_key_journal.size = 0;
+    } else if (!job) {
+        return;
+    }
+    ws_pae_key_journal.pending = NULL;
+    ws_pae_key_journal.size += job->len;
+
+    pthread_mutex_lock(&ws_pae_key_journal.lock);
+    ns_list_add_to_end(&ws_pae_key_journal.queue, job);
+    pthread_cond_signal(&ws_pae_key_journal.queue_cond);
+    pthread_mutex_unlock(&ws_pae_key_journal.lock);
+}
+
+size_t ws_pae_key_journal_size(void)
+{
+    size_t size = ws_pae_key_journal.size;
+
+    pthread_mutex_lock(&ws_pae_key_journal.lock);
+    // The expected size is wrong once a commit has been lost
+    if (ws_pae_key_journal.failed)
+        size = ws_pae_key_journal.disk_size;
+    pthread_mutex_unlock(&ws_pae_key_journal.lock);
+    if (ws_pae_key_journal.pending)
+        size += ws_pae_key_journal.pending->len;
+    return size;
+}
+
+bool ws_pae_key_journal_failed(void)
+{
+    bool failed;
+
+    pthread_mutex_lock(&ws_pae_key_journal.lock);
+    failed = ws_pae_key_journal.failed;
+    pthread_mutex_unlock(&ws_pae_key_journal.lock);
+    return failed;
+}
+
+int ws_pae_key_journal_sync(void)
+{
+    bool failed;
+
+    if (!ws_pae_key_journal.thread_started)
+        return 0;
+    pthread_mutex_lock(&ws_pae_key_journal.lock);
+    while (!ns_list_is_empty(&ws_pae_key_journal.queue) || ws_pae_key_journal.busy)
+        pthread_cond_wait(&ws_pae_key_journal.idle_cond, &ws_pae_key_journal.lock);
+    failed = ws_pae_key_journal.failed;
+    pthread_mutex_unlock(&ws_pae_key_journal.lock);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2022 Silicon Laboratories Inc. (www.silabs.com)
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of the Silicon Labs Master Software License
+ * Agreement (MSLA) available at [1].  This software is distributed to you in
+ * Object Code format and/or Source Code format and is governed by the sections
+ * of the MSLA applicable to Object Code, Source Code and Modified Open Source
+ * Code. By using this software, you agree to the terms of the MSLA.
+ *
+ * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
+ */
+#ifndef WS_PAE_KEY_JOURNAL_H_
+#define WS_PAE_KEY_JOURNAL_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Append-only journal of records, written from an I/O thread.
+ *
+ * Each record is framed as [type][length][payload][CRC-16], the first record
+ * of the file carries the version given to ws_pae_key_journal_init(). Records
+ * appended on the main thread are queued by ws_pae_key_journal_commit(). The
+ * I/O thread writes all the queued commits at once and calls fdatasync() once
+ * for all of them. A commit with rewrite set replaces the whole journal: it is
+ * written to a temporary file which is then renamed over the journal, so the
+ * journal is always either the old or the new one.
+ *
+ * On load, a truncated or corrupted tail (e.g. after a power loss during a
+ * write) is dropped and the file is truncated after the last valid record.
+ *
+ * When a commit cannot be written, the journal is truncated back to its last
+ * complete commit (or left untouched for a rewrite) and marked as failed: the
+ * next appends are dropped until a rewrite succeeds.
+ */
+
+// Return a negative value to stop the replay
+typedef int ws_pae_key_journal_replay(void *ctx, uint16_t type, const uint8_t *data, uint16_t len);
+
+// With path NULL, the journal is disabled and all the calls are no-ops.
+void ws_pae_key_journal_init(const char *path, uint32_t version);
+// Return -1 if there is no journal or if it has another version.
+int ws_pae_key_journal_load(ws_pae_key_journal_replay *replay, void *ctx);
+void ws_pae_key_journal_remove(void);
+
+void ws_pae_key_journal_append(uint16_t type, const void *data, uint16_t len);
+void ws_pae_key_journal_commit(bool rewrite);
+// Size of the journal once all the commits are written
+size_t ws_pae_key_journal_size(void);
+// True when a commit has been lost, the next commit must be a rewrite
+bool ws_pae_key_journal_failed(void);
+// Wait for all the commits to be written, return -1 if the journal has failed
+int ws_pae_key_journal_sync(void);
+
+#endif
@@ -19,9 +19,10 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
-#include "common/rand.h"
 #include "stack-services/ns_list.h"
 #include "stack-services/ns_trace.h"
+#include "stack-services/common_functions.h"
+#include "service_libs/utils/ns_file_system.h"
 #include "stack/mac/fhss_config.h"
 
 #include "nwk_interface/protocol.h"
@@ -40,6 +41,7 @@
 #include "6lowpan/ws/ws_pae_nvm_store.h"
 #include "6lowpan/ws/ws_pae_nvm_data.h"
 #include "6lowpan/ws/ws_pae_time.h"
+#include "6lowpan/ws/ws_pae_key_journal.h"
 
 #include "6lowpan/ws/ws_pae_key_storage.h"
 
@@ -48,6 +50,19 @@
 #define KEY_STORAGE_INDEX_FILE                        "key_storage_index"
 #define KEY_STORAGE_FILE                              "key_storage_00"
 #define KEY_STORAGE_FILE_LEN                          sizeof(KEY_STORAGE_FILE)
+#define KEY_STORAGE_JOURNAL_FILE                      "key_storage_journal"
+
+// Journal format changes with the layout of the entries, which are stored as is
+#define KEY_STORAGE_JOURNAL_VERSION                   (0x00010000 | sizeof(sec_prot_keys_storage_t))
+
+// Journal records: array header and array entry, both prefixed by the array offset
+#define KEY_STORAGE_JOURNAL_ARRAY                     1
+#define KEY_STORAGE_JOURNAL_ARRAY_LEN                 (1 + 2 + 4 + 8)
+#define KEY_STORAGE_JOURNAL_ENTRY                     2
+#define KEY_STORAGE_JOURNAL_ENTRY_LEN                 (1 + 2 + sizeof(sec_prot_keys_storage_t))
+
+// Compact the journal when it exceeds twice the size of its live records plus this margin
+#define KEY_STORAGE_JOURNAL_COMPACT_MARGIN            65536
 
 // Storage array header size
 #define STORAGE_ARRAY_HEADER_LEN                      sizeof(key_storage_nvm_tlv_entry_t)
@@ -58,9 +73,6 @@
 /* Force key storage reference time update, if reference time differs more 31 days */
 #define KEY_STORAGE_REF_TIME_UPDATE_FORCE_THRESHOLD   GTK_DEFAULT_LIFETIME + 86400
 
-// Base scatter timer value, 3 seconds */
-#define KEY_STORAGE_SCATTER_TIMER_BASE_VALUE          30
-
 typedef enum {
     WRITE_SET = 0,
     TIME_SET,
@@ -88,7 +100,8 @@ typedef struct {
     uint16_t free_entries;                              /**< Free entries in array */
     bool allocated : 1;                                 /**< Allocated */
     bool modified : 1;                                  /**< Array modified */
-    bool pending_storing : 1;                           /**< Entry is pending storing to NVM */
+    bool header_dirty : 1;                              /**< Header is pending storing to NVM */
+    uint8_t dirty[];                                    /**< Bitfield of entries pending storing to NVM */
 } key_storage_array_t;
 
 typedef struct {
@@ -96,11 +109,9 @@ typedef struct {
     uint8_t storages_empty;                             /**< Number of empty i.e. to be allocated storages */
     uint16_t storage_default_size;                      /**< Default size for storages */
     uint16_t replace_index;                             /**< Index to replace when storages are full */
-    uint64_t store_bitfield;                            /**< Bitfield of stored files */
     uint16_t store_timer_timeout;                       /**< Storing timing timeout */
     uint16_t store_timer;                               /**< Storing timer */
     uint32_t restart_cnt;                               /**< Re-start counter */
-    uint32_t scatter_timer;                             /**< NVM storing scatter timer */
 } key_storage_params_t;
 
 static key_storage_params_t key_storage_params;
@@ -113,10 +124,14 @@ static void ws_pae_key_storage_list_all_free(void);
 static sec_prot_keys_storage_t *ws_pae_key_storage_get(const void *instance, const uint8_t *eui64, key_storage_array_t **key_storage_array, bool return_free);
 static sec_prot_keys_storage_t *ws_pae_key_storage_replace(const void *instance, key_storage_array_t **key_storage_array);
 static void ws_pae_key_storage_trace(uint16_t field_set, sec_prot_keys_storage_t *key_storage, key_storage_array_t *key_storage_array);
-static void ws_pae_key_storage_scatter_timer_timeout(void);
-static void ws_pae_key_storage_fast_timer_start(void);
+static void ws_pae_key_storage_entry_modified(key_storage_array_t *key_storage_array, const sec_prot_keys_storage_t *key_storage);
+static void ws_pae_key_storage_array_modified(key_storage_array_t *key_storage_array);
+static void ws_pae_key_storage_array_loaded(key_storage_array_t *key_storage_array);
+static bool ws_pae_key_storage_legacy_read(void);
+static void ws_pae_key_storage_legacy_remove(void);
+static void ws_pae_key_storage_journal_snapshot(void);
+static size_t ws_pae_key_storage_journal_snapshot_size(void);
 static void ws_pae_key_storage_timer_expiry_set(void);
-static void ws_pae_key_storage_fast_timer_ticks_set(void);
 static int8_t ws_pae_key_storage_array_time_update_entry(uint64_t time_difference, sec_prot_keys_storage_t *storage_array_entry);
 static int8_t ws_pae_key_storage_array_time_check_and_update_all(key_storage_array_t *key_storage_array, bool modified);
 static int8_t ws_pae_key_storage_array_counters_check_and_update_all(key_storage_array_t *key_storage_array);
@@ -166,19 +181,30 @@ void ws_pae_key_storage_init(void)
         key_storage_params.store_timer_timeout = DEFAULT_STORING_INTERVAL;
     }
     key_storage_params.replace_index = 0;
-    key_storage_params.store_bitfield = 0,
     key_storage_params.restart_cnt = 0;
-    key_storage_params.scatter_timer = 0;
+
+    const char *root_path = ns_file_system_get_root_path();
+    if (!root_path) {
+        ws_pae_key_journal_init(NULL, 0);
+        return;
+    }
+    char path[strlen(root_path) + sizeof(KEY_STORAGE_JOURNAL_FILE)];
+    strcpy(path, root_path);
+    strcat(path, KEY_STORAGE_JOURNAL_FILE);
+    ws_pae_key_journal_init(path, KEY_STORAGE_JOURNAL_VERSION);
 }
 
 void ws_pae_key_storage_delete(void)
 {
+    // Waits for the stored data to be on NVM
+    ws_pae_key_journal_sync();
     ws_pae_key_storage_list_all_free();
 }
 
 static int8_t ws_pae_key_storage_allocate(const void *instance, uint16_t key_storage_size, void *new_storage_array)
 {
-    key_storage_array_t *key_storage_array = malloc(sizeof(key_storage_array_t));
+    uint16_t entries = (key_storage_size - STORAGE_ARRAY_HEADER_LEN) / sizeof(sec_prot_keys_storage_t);
+    key_storage_array_t *key_storage_array = malloc(sizeof(key_storage_array_t) + (entries + 7) / 8);
     if (!key_storage_array) {
         return -1;
     }
@@ -196,16 +222,19 @@ static int8_t ws_pae_key_storage_allocate(const void *instance, uint16_t key_sto
     }
     key_storage_array->storage_array = (sec_prot_keys_storage_t *)(((uint8_t *)key_storage_array->storage_array_handle) + STORAGE_ARRAY_HEADER_LEN);
     key_storage_array->size = key_storage_size;
-    key_storage_array->entries = (key_storage_size - STORAGE_ARRAY_HEADER_LEN) / sizeof(sec_prot_keys_storage_t);
+    key_storage_array->entries = entries;
     key_storage_array->free_entries = key_storage_array->entries;
     key_storage_array->instance = instance;
-    key_storage_array->modified = false;
-    key_storage_array->pending_storing = false;
 
     ws_pae_nvm_store_key_storage_tlv_create((nvm_tlv_t *) key_storage_array->storage_array_handle, key_storage_array->size);
 
     ws_pae_key_storage_clear(key_storage_array);
 
+    // Empty entries are implicit on the journal, only the header needs to be stored
+    memset(key_storage_array->dirty, 0, (entries + 7) / 8);
+    key_storage_array->modified = false;
+    key_storage_array->header_dirty = true;
+
     ns_list_add_to_end(&key_storage_array_list, key_storage_array);
 
     tr_info("KeyS new %s, array: %p entries: %i", key_storage_array->allocated ? "allocated" : "static", (void *) key_storage_array->storage_array, key_storage_array->entries);
@@ -226,6 +255,22 @@ static void ws_pae_key_storage_clear(key_storage_array_t *key_storage_array)
         }
         storage_array[index].eui_64_set = false;
     }
+    ws_pae_key_storage_array_modified(key_storage_array);
+}
+
+static void ws_pae_key_storage_entry_modified(key_storage_array_t *key_storage_array, const sec_prot_keys_storage_t *key_storage)
+{
+    uint16_t index = key_storage - key_storage_array->storage_array;
+
+    key_storage_array->dirty[index / 8] |= 1u << (index % 8);
+    key_storage_array->modified = true;
+}
+
+static void ws_pae_key_storage_array_modified(key_storage_array_t *key_storage_array)
+{
+    memset(key_storage_array->dirty, 0xff, (key_storage_array->entries + 7) / 8);
+    key_storage_array->header_dirty = true;
+    key_storage_array->modified = true;
 }
 
 static void ws_pae_key_storage_list_all_free(void)
@@ -302,7 +347,7 @@ bool ws_pae_key_storage_supp_delete(const void *instance, const uint8_t *eui64)
             if (memcmp(&storage_array[index].ptk_eui_64, eui64, 8) == 0) {
                 memset(&storage_array[index], 0, sizeof(sec_prot_keys_storage_t));
                 tr_info("KeyS delete array: %p i: %i eui64: %s", (void *) entry->storage_array, index, trace_array(eui64, 8));
-                entry->modified = true;
+                ws_pae_key_storage_entry_modified(entry, &storage_array[index]);
                 deleted = true;
             }
         }
@@ -319,6 +364,7 @@ bool ws_pae_key_storage_supp_delete(const void *instance, const uint8_t *eui64)
 static sec_prot_keys_storage_t *ws_pae_key_storage_replace(const void *instance, key_storage_array_t **key_storage_array)
 {
     uint16_t replace_index = key_storage_params.replace_index;
+    key_storage_array_t *replace_array = NULL;
     sec_prot_keys_storage_t *storage_array = NULL;
     uint16_t storage_array_index = 0;
 
@@ -332,9 +378,7 @@ static sec_prot_keys_storage_t *ws_pae_key_storage_replace(const void *instance,
             replace_index -= entry->entries;
             continue;
         }
-        if (key_storage_array) {
-            *key_storage_array = entry;
-        }
+        replace_array = entry;
         // Sets array and index and sets replace index to next
         storage_array = (sec_prot_keys_storage_t *) entry->storage_array;
         storage_array_index = replace_index;
@@ -354,9 +398,7 @@ static sec_prot_keys_storage_t *ws_pae_key_storage_replace(const void *instance,
         if (key_storage_array_entry == NULL) {
             return NULL;
         }
-        if (key_storage_array) {
-            *key_storage_array = key_storage_array_entry;
-        }
+        replace_array = key_storage_array_entry;
         storage_array = (sec_prot_keys_storage_t *) key_storage_array_entry->storage_array;
         storage_array_index = 0;
         key_storage_params.replace_index = 1;
@@ -364,8 +406,13 @@ static sec_prot_keys_storage_t *ws_pae_key_storage_replace(const void *instance,
         tr_info("KeyS replace array: %p i: %i eui64: %s", (void *) key_storage_array_entry->storage_array, storage_array_index, trace_array(key_storage_array_entry->storage_array[storage_array_index].ptk_eui_64, 8));
     }
 
+    if (key_storage_array) {
+        *key_storage_array = replace_array;
+    }
+
     // Deletes any previous data
     memset(&storage_array[storage_array_index], 0, sizeof(sec_prot_keys_storage_t));
+    ws_pae_key_storage_entry_modified(replace_array, &storage_array[storage_array_index]);
 
     return &storage_array[storage_array_index];
 }
@@ -434,7 +481,7 @@ int8_t ws_pae_key_storage_supp_write(const void *instance, supp_entry_t *pae_sup
 
     if (key_storage->pmk_set != sec_keys->pmk_set ||
             memcmp(key_storage->pmk, sec_keys->pmk, PMK_LEN) != 0) {
-        key_storage_array->modified = true;
+        ws_pae_key_storage_entry_modified(key_storage_array, key_storage);
         key_storage->pmk_set = sec_keys->pmk_set;
         memcpy(key_storage->pmk, sec_keys->pmk, PMK_LEN);
         field_set |= 1u << PMK_SET;
@@ -442,7 +489,7 @@ int8_t ws_pae_key_storage_supp_write(const void *instance, supp_entry_t *pae_sup
 
     if (key_storage->ptk_set != sec_keys->ptk_set ||
             memcmp(key_storage->ptk, sec_keys->ptk, PTK_LEN) != 0) {
-        key_storage_array->modified = true;
+        ws_pae_key_storage_entry_modified(key_storage_array, key_storage);
         key_storage->ptk_set = sec_keys->ptk_set;
         memcpy(key_storage->ptk, sec_keys->ptk, PTK_LEN);
         field_set |= 1u << PTK_SET;
@@ -450,21 +497,21 @@ int8_t ws_pae_key_storage_supp_write(const void *instance, supp_entry_t *pae_sup
 
     if (key_storage->eui_64_set != true ||
             memcmp(key_storage->ptk_eui_64, eui_64, 8) != 0) {
-        key_storage_array->modified = true;
+        ws_pae_key_storage_entry_modified(key_storage_array, key_storage);
         key_storage->eui_64_set = true;
         memcpy(key_storage->ptk_eui_64, eui_64, 8);
         field_set |= 1u << EUI64_SET;
     }
 
     if (key_storage->ptk_eui_64_set != sec_keys->ptk_eui_64_set) {
-        key_storage_array->modified = true;
+        ws_pae_key_storage_entry_modified(key_storage_array, key_storage);
         key_storage->ptk_eui_64_set = sec_keys->ptk_eui_64_set;
         field_set |= 1u << PTKEUI64_SET;
     }
 
     if (key_storage->ins_gtk_hash_set != sec_keys->ins_gtk_hash_set ||
             memcmp(key_storage->ins_gtk_hash, sec_keys->ins_gtk_hash, sizeof(sec_keys->ins_gtk_hash)) != 0) {
-        key_storage_array->modified = true;
+        ws_pae_key_storage_entry_modified(key_storage_array, key_storage);
         key_storage->ins_gtk_hash_set = sec_keys->ins_gtk_hash_set;
         memcpy(key_storage->ins_gtk_hash, sec_keys->ins_gtk_hash, sizeof(sec_keys->ins_gtk_hash));
         field_set |= 1u << GTKHASH_SET;
@@ -483,7 +530,7 @@ int8_t ws_pae_key_storage_supp_write(const void *instance, supp_entry_t *pae_sup
         uint16_t short_time = ws_pae_time_to_short_convert(pmk_lifetime);
         // Compares the time from active supplicant entry to stored one, and if time
         if (!key_storage->pmk_lifetime_set || !ws_pae_time_from_short_time_compare(key_storage->pmk_lifetime, short_time)) {
-            key_storage_array->modified = true;
+            ws_pae_key_storage_entry_modified(key_storage_array, key_storage);
             key_storage->pmk_lifetime_set = true;
             key_storage->pmk_lifetime = short_time;
             field_set |= 1u << PMKLTIME_SET;
@@ -502,7 +549,7 @@ int8_t ws_pae_key_storage_supp_write(const void *instance, supp_entry_t *pae_sup
         }
         uint16_t short_time = ws_pae_time_to_short_convert(ptk_lifetime);
         if (!key_storage->ptk_lifetime_set || !ws_pae_time_from_short_time_compare(key_storage->ptk_lifetime, short_time)) {
-            key_storage_array->modified = true;
+            ws_pae_key_storage_entry_modified(key_storage_array, key_storage);
             key_storage->ptk_lifetime_set = true;
             key_storage->ptk_lifetime = short_time;
             field_set |= 1u << PTKLTIME_SET;
@@ -659,114 +706,230 @@ static void ws_pae_key_storage_trace(uint16_t field_set, sec_prot_keys_storage_t
            );
 }
 
-int8_t ws_pae_key_storage_store(void)
+static void ws_pae_key_storage_journal_array(key_storage_array_t *key_storage_array, uint8_t entry_offset)
+{
+    uint8_t data[KEY_STORAGE_JOURNAL_ARRAY_LEN];
+    uint8_t *ptr = data;
+
+    *ptr++ = entry_offset;
+    ptr = common_write_16_bit(key_storage_array->entries, ptr);
+    ptr = common_write_32_bit(key_storage_array->storage_array_handle->reference_restart_cnt, ptr);
+    ptr = common_write_64_bit(key_storage_array->storage_array_handle->reference_time, ptr);
+    ws_pae_key_journal_append(KEY_STORAGE_JOURNAL_ARRAY, data, ptr - data);
+}
+
+static void ws_pae_key_storage_journal_entry(key_storage_array_t *key_storage_array, uint8_t entry_offset, uint16_t index)
+{
+    uint8_t data[KEY_STORAGE_JOURNAL_ENTRY_LEN];
+    uint8_t *ptr = data;
+
+    *ptr++ = entry_offset;
+    ptr = common_write_16_bit(index, ptr);
+    memcpy(ptr, &key_storage_array->storage_array[index], sizeof(sec_prot_keys_storage_t));
+    ptr += sizeof(sec_prot_keys_storage_t);
+    ws_pae_key_journal_append(KEY_STORAGE_JOURNAL_ENTRY, data, ptr - data);
+}
+
+static bool ws_pae_key_storage_journal_deltas(key_storage_array_t *key_storage_array, uint8_t entry_offset)
+{
+    bool stored = false;
+
+    if (key_storage_array->header_dirty) {
+        ws_pae_key_storage_journal_array(key_storage_array, entry_offset);
+        key_storage_array->header_dirty = false;
+        stored = true;
+    }
+    for (uint16_t index = 0; index < key_storage_array->entries; index++) {
+        if (!(key_storage_array->dirty[index / 8] & (1u << (index % 8)))) {
+            continue;
+        }
+        ws_pae_key_storage_journal_entry(key_storage_array, entry_offset, index);
+        stored = true;
+    }
+    memset(key_storage_array->dirty, 0, (key_storage_array->entries + 7) / 8);
+    return stored;
+}
+
+static void ws_pae_key_storage_journal_snapshot(void)
 {
     uint8_t entry_offset = 0;
-    uint64_t store_bitfield = 0;
-    bool start_scatter_timer = false;
 
     ns_list_foreach(key_storage_array_t, entry, &key_storage_array_list) {
-        // Bitfield is set for all entries (also that are non-modified in this write)
-        store_bitfield |= ((uint64_t) 1) << entry_offset;
+        ws_pae_key_storage_journal_array(entry, entry_offset);
+        for (uint16_t index = 0; index < entry->entries; index++) {
+            if (entry->storage_array[index].eui_64_set) {
+                ws_pae_key_storage_journal_entry(entry, entry_offset, index);
+            }
+        }
+        memset(entry->dirty, 0, (entry->entries + 7) / 8);
+        entry->header_dirty = false;
+        entry_offset++;
+    }
+    ws_pae_key_journal_commit(true);
+    tr_info("KeyS journal compacted, size: %zu", ws_pae_key_journal_size());
+}
+
+static size_t ws_pae_key_storage_journal_snapshot_size(void)
+{
+    size_t size = 0;
 
+    ns_list_foreach(key_storage_array_t, entry, &key_storage_array_list) {
+        size += KEY_STORAGE_JOURNAL_ARRAY_LEN + 6;
+        for (uint16_t index = 0; index < entry->entries; index++) {
+            if (entry->storage_array[index].eui_64_set) {
+                size += KEY_STORAGE_JOURNAL_ENTRY_LEN + 6;
+            }
+        }
+    }
+    return size;
+}
+
+int8_t ws_pae_key_storage_store(void)
+{
+    uint8_t entry_offset = 0;
+    bool stored = false;
+
+    // Rewrites the journal instead of appending to it once it is mostly made
+    // of overwritten records, or when a previous write has failed
+    bool compact = ws_pae_key_journal_failed() ||
+                   ws_pae_key_journal_size() > 2 * ws_pae_key_storage_journal_snapshot_size() + KEY_STORAGE_JOURNAL_COMPACT_MARGIN;
+
+    ns_list_foreach(key_storage_array_t, entry, &key_storage_array_list) {
         /* Checks whether array reference time needs to be updated */
         int8_t ret_value = ws_pae_key_storage_array_time_check_and_update_all(entry, entry->modified);
-        if (ret_value == 1) {
-            entry->modified = true;
-        } else if (ret_value < 0) {
+        if (ret_value < 0) {
             // On error clears the whole array
             ws_pae_key_storage_clear(entry);
-            entry->modified = true;
         }
 
-        /* On large network there could be different time thresholds for entries full / all updated
-           and half empty entries/not all updated where it is likely that data will still be modified */
-        if (!entry->modified) {
-            entry_offset++;
-            // If not pending for storing; skips file write
-            continue;
+        // Only the modified entries are appended to the journal
+        if (!compact && ws_pae_key_storage_journal_deltas(entry, entry_offset)) {
+            stored = true;
         }
-
-        entry->pending_storing = true;
-        start_scatter_timer = true;
-
-        // Item is pending for storing, reset modified flag
         entry->modified = false;
         entry_offset++;
     }
 
-    tr_info("KeyS storage store, bitf: %"PRIx64, store_bitfield);
-
-    if (start_scatter_timer) {
-        ws_pae_key_storage_fast_timer_start();
-    }
-
-    if (key_storage_params.store_bitfield != store_bitfield) {
-        key_storage_params.store_bitfield = store_bitfield;
-        nvm_tlv_t *tlv = ws_pae_nvm_store_generic_tlv_allocate_and_create(
-                             PAE_NVM_KEY_STORAGE_INDEX_TAG, PAE_NVM_KEY_STORAGE_INDEX_LEN);
-        ws_pae_nvm_store_key_storage_index_tlv_create(tlv, key_storage_params.store_bitfield);
-        ws_pae_nvm_store_tlv_file_write(KEY_STORAGE_INDEX_FILE, tlv);
-        ws_pae_nvm_store_generic_tlv_free(tlv);
+    if (compact) {
+        ws_pae_key_storage_journal_snapshot();
+    } else if (stored) {
+        ws_pae_key_journal_commit(false);
+        tr_info("KeyS journal stored, size: %zu", ws_pae_key_journal_size());
     }
 
     return 0;
 }
 
-static void ws_pae_key_storage_scatter_timer_timeout(void)
+static int ws_pae_key_storage_journal_replay(void *ctx, uint16_t type, const uint8_t *data, uint16_t len)
 {
+    key_storage_array_t *key_storage_array = NULL;
     uint8_t entry_offset = 0;
-    bool pending_entry = false;
+    uint16_t index;
 
+    if (type != KEY_STORAGE_JOURNAL_ARRAY && type != KEY_STORAGE_JOURNAL_ENTRY) {
+        return -1;
+    }
+    if (len != (type == KEY_STORAGE_JOURNAL_ARRAY ? KEY_STORAGE_JOURNAL_ARRAY_LEN : KEY_STORAGE_JOURNAL_ENTRY_LEN)) {
+        return -1;
+    }
+
+    // Allocates the arrays up to the one of the record
     ns_list_foreach(key_storage_array_t, entry, &key_storage_array_list) {
-        if (!entry->pending_storing) {
-            entry_offset++;
-            continue;
+        if (entry_offset++ == data[0]) {
+            key_storage_array = entry;
+            break;
         }
-        pending_entry = true;
+    }
+    while (!key_storage_array && key_storage_params.storages_empty > 0) {
+        if (ws_pae_key_storage_allocate(NULL, key_storage_params.storage_default_size, NULL) < 0) {
+            break;
+        }
+        key_storage_params.storages_empty--;
+        if (entry_offset++ == data[0]) {
+            key_storage_array = ns_list_get_last(&key_storage_array_list);
+        }
+    }
+    if (!key_storage_array) {
+        tr_warn("KeyS journal array %i not available", data[0]);
+        return 0;
+    }
 
-        char filename[KEY_STORAGE_FILE_LEN];
-        ws_pae_key_storage_filename_set(filename, entry_offset);
-        tr_info("KeyS write array: %p file: %s", (void *) entry->storage_array, filename);
-        nvm_tlv_t *tlv = (nvm_tlv_t *) entry->storage_array_handle;
-        ws_pae_nvm_store_tlv_file_write(filename, tlv);
+    if (type == KEY_STORAGE_JOURNAL_ARRAY) {
+        key_storage_array->storage_array_handle->reference_restart_cnt = common_read_32_bit(data + 3);
+        key_storage_array->storage_array_handle->reference_time = common_read_64_bit(data + 7);
+        return 0;
+    }
 
-        // Item has been stored, reset pending storing and modified flag
-        entry->pending_storing = false;
-        entry->modified = false;
-        break;
+    index = common_read_16_bit(data + 1);
+    if (index >= key_storage_array->entries) {
+        return 0;
     }
+    memcpy(&key_storage_array->storage_array[index], data + 3, sizeof(sec_prot_keys_storage_t));
+    return 0;
+}
 
-    if (pending_entry) {
-        ws_pae_key_storage_fast_timer_ticks_set();
-        return;
+static void ws_pae_key_storage_array_loaded(key_storage_array_t *key_storage_array)
+{
+    // Calculate time difference between storage array reference time and current time
+    uint32_t time_difference;
+    if (ws_pae_time_diff_calc(ws_pae_current_time_get(), key_storage_array->storage_array_handle->reference_time, &time_difference, false) < 0) {
+        tr_error("KeyS read array time err: %"PRIi64", ref: %"PRIi64", diff: %"PRIi32, ws_pae_current_time_get(), key_storage_array->storage_array_handle->reference_time, time_difference);
+        ws_pae_key_storage_clear(key_storage_array);
     }
 
-    tr_info("KeyS all pending entries stored");
+    // Checks and updates PMK counters
+    if (ws_pae_key_storage_array_counters_check_and_update_all(key_storage_array) < 0) {
+        tr_error("KeyS read array cnt err");
+        // On error clears the whole array
+        ws_pae_key_storage_clear(key_storage_array);
+    }
 }
 
 void ws_pae_key_storage_read(uint32_t restart_cnt)
 {
-    key_storage_params.store_bitfield = 0;
     key_storage_params.restart_cnt = restart_cnt;
 
+    if (ws_pae_key_journal_load(ws_pae_key_storage_journal_replay, NULL) >= 0) {
+        ns_list_foreach(key_storage_array_t, entry, &key_storage_array_list) {
+            // Loaded data is already on the journal
+            memset(entry->dirty, 0, (entry->entries + 7) / 8);
+            entry->header_dirty = false;
+            entry->modified = false;
+            ws_pae_key_storage_array_loaded(entry);
+        }
+        return;
+    }
+
+    // No journal yet, migrates the key storage files to it
+    bool migrate = ws_pae_key_storage_legacy_read();
+    ws_pae_key_storage_journal_snapshot();
+    if (!migrate)
+        return;
+    // The key storage files are the only copy until the journal is on disk
+    if (ws_pae_key_journal_sync() < 0)
+        tr_error("KeyS journal write failed, key storage files kept");
+    else
+        ws_pae_key_storage_legacy_remove();
+}
+
+static bool ws_pae_key_storage_legacy_read(void)
+{
+    uint64_t store_bitfield = 0;
+
     nvm_tlv_t *tlv = ws_pae_nvm_store_generic_tlv_allocate_and_create(
                          PAE_NVM_KEY_STORAGE_INDEX_TAG, PAE_NVM_KEY_STORAGE_INDEX_LEN);
 
     if (ws_pae_nvm_store_tlv_file_read(KEY_STORAGE_INDEX_FILE, tlv) < 0) {
         ws_pae_nvm_store_generic_tlv_free(tlv);
-        return;
+        return false;
     }
 
-    uint64_t store_bitfield;
-    if (ws_pae_nvm_store_key_storage_index_tlv_read(tlv, &store_bitfield) >= 0) {
-        key_storage_params.store_bitfield = store_bitfield;
-    }
+    ws_pae_nvm_store_key_storage_index_tlv_read(tlv, &store_bitfield);
 
     ws_pae_nvm_store_generic_tlv_free(tlv);
 
-    if (key_storage_params.store_bitfield == 0) {
-        return;
+    if (store_bitfield == 0) {
+        return true;
     }
 
     tr_info("KeyS init store bitf: %"PRIx64, store_bitfield);
@@ -829,26 +992,22 @@ void ws_pae_key_storage_read(uint32_t restart_cnt)
             continue;
         }
 
-        // Calculate time difference between storage array reference time and current time
-        uint32_t time_difference;
-        if (ws_pae_time_diff_calc(ws_pae_current_time_get(), key_storage_array->storage_array_handle->reference_time, &time_difference, false) < 0) {
-            tr_error("KeyS read array time err: %"PRIi64", ref: %"PRIi64", diff: %"PRIi32, ws_pae_current_time_get(), key_storage_array->storage_array_handle->reference_time, time_difference);
-            ws_pae_key_storage_clear(key_storage_array);
-        }
-
-        // Checks and updates PMK counters
-        if (ws_pae_key_storage_array_counters_check_and_update_all(key_storage_array) < 0) {
-            tr_error("KeyS read array cnt err");
-            // On error clears the whole array
-            ws_pae_key_storage_clear(key_storage_array);
-        }
+        ws_pae_key_storage_array_loaded(key_storage_array);
 
         // Entry set, go to next
         key_storage_array = NULL;
     }
+
+    return true;
 }
 
 void ws_pae_key_storage_remove(void)
+{
+    ws_pae_key_journal_remove();
+    ws_pae_key_storage_legacy_remove();
+}
+
+static void ws_pae_key_storage_legacy_remove(void)
 {
     nvm_tlv_t *tlv = ws_pae_nvm_store_generic_tlv_allocate_and_create(
                          PAE_NVM_KEY_STORAGE_INDEX_TAG, PAE_NVM_KEY_STORAGE_INDEX_LEN);
@@ -891,30 +1050,6 @@ void ws_pae_key_storage_timer(uint16_t seconds)
     }
 }
 
-void ws_pae_key_storage_fast_timer(uint16_t ticks)
-{
-    if (key_storage_params.scatter_timer == 0) {
-        return;
-    } else if (key_storage_params.scatter_timer > ticks) {
-        key_storage_params.scatter_timer -= ticks;
-    } else {
-        key_storage_params.scatter_timer = 0;
-        ws_pae_key_storage_scatter_timer_timeout();
-    }
-}
-
-static void ws_pae_key_storage_fast_timer_start(void)
-{
-    ws_pae_key_storage_fast_timer_ticks_set();
-}
-
-static void ws_pae_key_storage_fast_timer_ticks_set(void)
-{
-    // (0.625 - 1,375) * 3 seconds
-    key_storage_params.scatter_timer = rand_randomise_base(KEY_STORAGE_SCATTER_TIMER_BASE_VALUE, 0x5000, 0xB000);
-    tr_info("KeyS scatter timer %"PRIi32, key_storage_params.scatter_timer);
-}
-
 static void ws_pae_key_storage_timer_expiry_set(void)
 {
     // Expire in 30 seconds
@@ -992,10 +1127,12 @@ static int8_t ws_pae_key_storage_array_time_check_and_update_all(key_storage_arr
         }
         // Updates lifetimes on the entry
         ws_pae_key_storage_array_time_update_entry(time_difference, &storage_array[index]);
+        ws_pae_key_storage_entry_modified(key_storage_array, &storage_array[index]);
     }
 
     // Entries are now on current time; update reference time
     key_storage_array->storage_array_handle->reference_time = current_time;
+    key_storage_array->header_dirty = true;
     return 1;
 }
 
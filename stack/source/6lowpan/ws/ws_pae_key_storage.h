@@ -84,7 +84,8 @@ void ws_pae_key_storage_delete(void);
 /**
  * ws_pae_key_storage_store store to NVM
  *
- * Checks whether key storage data has been updated and stores to NVM.
+ * Appends the key storage entries that have been updated to the NVM journal.
+ * Writing is done asynchronously, see ws_pae_key_journal.h.
  *
  * \return < 0 failure
  * \return >= 0 success
@@ -153,14 +154,6 @@ bool ws_pae_key_storage_supp_delete(const void *instance, const uint8_t *eui64);
  */
 void ws_pae_key_storage_timer(uint16_t seconds);
 
-/**
- * ws_pae_key_storage_fast_timer key storage fast timers
- *
- * \param ticks Ticks passed
- *
- */
-void ws_pae_key_storage_fast_timer(uint16_t ticks);
-
 /**
  * ws_pae_key_storage_storing_interval_get gets key storage storing interval
  *
@@ -20,6 +20,11 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common/crc.h"
 #include "stack-services/ns_list.h"
 #include "stack-services/ns_trace.h"
 #include "stack-services/common_functions.h"
@@ -35,12 +40,70 @@
 
 #define MAX_ROOT_PATH_LEN                200
 
+#define NVM_STATE_FILE                   "pae_state"
+#define NVM_STATE_MAGIC                  0x56534e57 // "WNSV"
+#define NVM_STATE_VERSION                1
+#define NVM_STATE_SLOTS                  16
+#define NVM_STATE_NAME_LEN               32
+// The key storage has its own journal, its files are never imported
+#define NVM_STATE_EXCLUDED_PREFIX        "key_storage_"
+// No free slot entry left, the file is written outside of the state file
+#define PAE_NVM_FILE_STATE_FULL          -8
+
+/*
+ * Optional single state file mapped in memory. Each TLV file is stored in a
+ * slot of the mapping. A slot has two copies of the data, the write goes to
+ * the oldest one and is synced before its sequence number is updated. So a
+ * power loss during a write leaves the previous copy usable.
+ *
+ * A slot that must grow is moved to another slot entry: the new copy is
+ * synced before the new entry is published, and the old entry is freed
+ * afterwards. If a power loss leaves both entries, the one with the highest
+ * sequence number is used. Free entries keep their region of the state file,
+ * which is reused by the next slot that fits in it.
+ */
+typedef struct {
+    uint32_t seq;                       /**< 0 if the copy is empty */
+    uint16_t len;                       /**< Length of the data */
+    uint16_t crc;                       /**< CRC of the data */
+} nvm_state_copy_t;
+
+typedef struct {
+    char name[NVM_STATE_NAME_LEN];      /**< File name, empty if the slot is free */
+    uint32_t offset;                    /**< Offset of the first copy in the state file */
+    uint16_t capacity;                  /**< Capacity of each copy */
+    uint16_t reserved;
+    nvm_state_copy_t copy[2];
+} nvm_state_slot_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t slot_count;
+    uint32_t size;                      /**< Used size of the state file */
+    uint32_t reserved;
+    nvm_state_slot_t slot[NVM_STATE_SLOTS];
+} nvm_state_hdr_t;
+
+static struct {
+    bool enabled;
+    int fd;
+    size_t map_size;
+    nvm_state_hdr_t *hdr;
+} ws_pae_nvm_state = {
+    .fd = -1,
+};
+
 static uint16_t ws_pae_nvm_store_path_len_get(const char *file_name);
 static const char *ws_pae_nvm_store_get_root_path(void);
 static int8_t ws_pae_nvm_store_root_path_valid(void);
 static int8_t ws_pae_nvm_store_create_path(char *fast_data_path, const char *file_name);
 static int8_t ws_pae_nvm_store_write(const char *file_name, nvm_tlv_t *tlv);
 static int8_t ws_pae_nvm_store_read(const char *file_name, nvm_tlv_t *tlv);
+static int8_t ws_pae_nvm_store_state_write(const char *file, nvm_tlv_t *tlv);
+static int8_t ws_pae_nvm_store_state_read(const char *file, nvm_tlv_t *tlv);
+static int8_t ws_pae_nvm_store_state_remove(const char *file);
+static bool ws_pae_nvm_store_state_used(const char *file);
 
 void ws_pae_nvm_store_generic_tlv_create(nvm_tlv_t *tlv_entry, uint16_t tag, uint16_t length)
 {
@@ -81,6 +144,20 @@ int8_t ws_pae_nvm_store_tlv_file_write(const char *file, nvm_tlv_t *tlv)
 
     ws_pae_nvm_store_create_path(nw_info_path, file);
 
+    if (ws_pae_nvm_store_state_used(file)) {
+        int8_t ret = ws_pae_nvm_store_state_write(file, tlv);
+        if (ret != PAE_NVM_FILE_STATE_FULL) {
+            return ret;
+        }
+        // No slot left in the state file, falls back to a file
+        ret = ws_pae_nvm_store_write(nw_info_path, tlv);
+        if (ret >= 0) {
+            // A slot too small to hold the new data would hide it
+            ws_pae_nvm_store_state_remove(file);
+        }
+        return ret;
+    }
+
     return ws_pae_nvm_store_write(nw_info_path, tlv);
 }
 
@@ -96,6 +173,21 @@ int8_t ws_pae_nvm_store_tlv_file_read(const char *file, nvm_tlv_t *tlv)
 
     ws_pae_nvm_store_create_path(nw_info_path, file);
 
+    if (ws_pae_nvm_store_state_used(file)) {
+        int8_t ret = ws_pae_nvm_store_state_read(file, tlv);
+        if (ret != PAE_NVM_FILE_CANNOT_OPEN) {
+            return ret;
+        }
+        // Not in the state file yet, imports the file written without it
+        ret = ws_pae_nvm_store_read(nw_info_path, tlv);
+        if (ret < 0 || ws_pae_nvm_store_state_write(file, tlv) < 0) {
+            return ret;
+        }
+        tr_info("NVM imported %s into %s", file, NVM_STATE_FILE);
+        remove(nw_info_path);
+        return ret;
+    }
+
     return ws_pae_nvm_store_read(nw_info_path, tlv);
 }
 
@@ -112,6 +204,11 @@ int8_t ws_pae_nvm_store_tlv_file_remove(const char *file)
     ws_pae_nvm_store_create_path(nw_info_path, file);
 
     int ret = remove(nw_info_path);
+
+    if (ws_pae_nvm_store_state_used(file) && ws_pae_nvm_store_state_remove(file) >= 0) {
+        ret = 0;
+    }
+
     if (ret < 0) {
         return -1;
     }
@@ -197,4 +294,289 @@ static int8_t ws_pae_nvm_store_read(const char *file_name, nvm_tlv_t *tlv)
     return PAE_NVM_FILE_SUCCESS;
 }
 
+void ws_pae_nvm_store_mmap_enable(bool enable)
+{
+    ws_pae_nvm_state.enabled = enable;
+}
+
+static bool ws_pae_nvm_store_state_used(const char *file)
+{
+    if (!ws_pae_nvm_state.enabled) {
+        return false;
+    }
+    if (strlen(file) >= NVM_STATE_NAME_LEN) {
+        return false;
+    }
+    return strncmp(file, NVM_STATE_EXCLUDED_PREFIX, strlen(NVM_STATE_EXCLUDED_PREFIX));
+}
+
+static int8_t ws_pae_nvm_store_state_map(size_t size)
+{
+    void *map;
 
+    if (ws_pae_nvm_state.hdr && ws_pae_nvm_state.map_size >= size) {
+        return 0;
+    }
+    if (ftruncate(ws_pae_nvm_state.fd, size) < 0) {
+        tr_error("NVM state resize error: %m");
+        return -1;
+    }
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, ws_pae_nvm_state.fd, 0);
+    if (map == MAP_FAILED) {
+        tr_error("NVM state mmap error: %m");
+        return -1;
+    }
+    if (ws_pae_nvm_state.hdr) {
+        munmap(ws_pae_nvm_state.hdr, ws_pae_nvm_state.map_size);
+    }
+    ws_pae_nvm_state.hdr = map;
+    ws_pae_nvm_state.map_size = size;
+    return 0;
+}
+
+static nvm_state_hdr_t *ws_pae_nvm_store_state_get(void)
+{
+    struct stat st;
+
+    if (ws_pae_nvm_state.hdr) {
+        return ws_pae_nvm_state.hdr;
+    }
+
+    uint16_t path_len = ws_pae_nvm_store_path_len_get(NVM_STATE_FILE);
+    char state_path[path_len];
+    ws_pae_nvm_store_create_path(state_path, NVM_STATE_FILE);
+
+    ws_pae_nvm_state.fd = open(state_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (ws_pae_nvm_state.fd < 0 || fstat(ws_pae_nvm_state.fd, &st) < 0) {
+        tr_error("NVM open error: %s", state_path);
+        goto err;
+    }
+    if (ws_pae_nvm_store_state_map(st.st_size > sizeof(nvm_state_hdr_t) ? st.st_size : sizeof(nvm_state_hdr_t)) < 0) {
+        goto err;
+    }
+    if (ws_pae_nvm_state.hdr->magic != NVM_STATE_MAGIC ||
+            ws_pae_nvm_state.hdr->version != NVM_STATE_VERSION ||
+            ws_pae_nvm_state.hdr->slot_count != NVM_STATE_SLOTS ||
+            ws_pae_nvm_state.hdr->size > ws_pae_nvm_state.map_size) {
+        if (st.st_size) {
+            tr_warning("NVM state invalid, re-created: %s", state_path);
+        }
+        memset(ws_pae_nvm_state.hdr, 0, sizeof(nvm_state_hdr_t));
+        ws_pae_nvm_state.hdr->magic = NVM_STATE_MAGIC;
+        ws_pae_nvm_state.hdr->version = NVM_STATE_VERSION;
+        ws_pae_nvm_state.hdr->slot_count = NVM_STATE_SLOTS;
+        ws_pae_nvm_state.hdr->size = sizeof(nvm_state_hdr_t);
+        msync(ws_pae_nvm_state.hdr, sizeof(nvm_state_hdr_t), MS_SYNC);
+    }
+    return ws_pae_nvm_state.hdr;
+
+err:
+    if (ws_pae_nvm_state.fd >= 0) {
+        close(ws_pae_nvm_state.fd);
+    }
+    ws_pae_nvm_state.fd = -1;
+    return NULL;
+}
+
+static uint32_t ws_pae_nvm_store_state_slot_seq(const nvm_state_slot_t *slot)
+{
+    return slot->copy[0].seq > slot->copy[1].seq ? slot->copy[0].seq : slot->copy[1].seq;
+}
+
+static nvm_state_slot_t *ws_pae_nvm_store_state_slot_get(nvm_state_hdr_t *hdr, const char *file)
+{
+    nvm_state_slot_t *slot = NULL;
+
+    // A power loss while a slot is moved can leave two entries with the same name
+    for (int i = 0; i < NVM_STATE_SLOTS; i++) {
+        if (hdr->slot[i].name[0] && !strncmp(hdr->slot[i].name, file, NVM_STATE_NAME_LEN)) {
+            if (!slot || ws_pae_nvm_store_state_slot_seq(&hdr->slot[i]) > ws_pae_nvm_store_state_slot_seq(slot)) {
+                slot = &hdr->slot[i];
+            }
+        }
+    }
+    return slot;
+}
+
+/*
+ * Finds a free entry for a slot of len bytes. The smallest free region that
+ * fits is reused, otherwise the entry with the smallest region is taken and
+ * its region is lost.
+ */
+static nvm_state_slot_t *ws_pae_nvm_store_state_slot_free_get(nvm_state_hdr_t *hdr, uint16_t len)
+{
+    nvm_state_slot_t *fit = NULL;
+    nvm_state_slot_t *small = NULL;
+
+    for (int i = 0; i < NVM_STATE_SLOTS; i++) {
+        nvm_state_slot_t *slot = &hdr->slot[i];
+        if (slot->name[0]) {
+            continue;
+        }
+        if (slot->capacity >= len && (!fit || slot->capacity < fit->capacity)) {
+            fit = slot;
+        }
+        if (!small || slot->capacity < small->capacity) {
+            small = slot;
+        }
+    }
+    return fit ? fit : small;
+}
+
+static void ws_pae_nvm_store_state_slot_free(nvm_state_slot_t *slot)
+{
+    memset(slot->name, 0, sizeof(slot->name));
+    slot->copy[0].seq = 0;
+    slot->copy[1].seq = 0;
+}
+
+static void ws_pae_nvm_store_state_sync(const void *addr, size_t len)
+{
+    uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t) addr & ~(page_size - 1);
+
+    msync((void *) start, (uintptr_t) addr + len - start, MS_SYNC);
+}
+
+static int8_t ws_pae_nvm_store_state_write(const char *file, nvm_tlv_t *tlv)
+{
+    uint16_t len = tlv->len + sizeof(nvm_tlv_t);
+    nvm_state_hdr_t *hdr = ws_pae_nvm_store_state_get();
+    nvm_state_slot_t *slot, *old_slot;
+    nvm_state_copy_t *copy;
+    uint32_t seq;
+    uint8_t *data;
+    int index;
+
+    if (!hdr) {
+        return PAE_NVM_FILE_CANNOT_OPEN;
+    }
+    slot = ws_pae_nvm_store_state_slot_get(hdr, file);
+    for (int i = 0; slot && i < NVM_STATE_SLOTS; i++) {
+        if (&hdr->slot[i] != slot && !strncmp(hdr->slot[i].name, file, NVM_STATE_NAME_LEN)) {
+            ws_pae_nvm_store_state_slot_free(&hdr->slot[i]);
+            ws_pae_nvm_store_state_sync(&hdr->slot[i], sizeof(nvm_state_slot_t));
+        }
+    }
+    if (!slot || slot->capacity < len) {
+        uint32_t old_index = slot ? slot - hdr->slot : NVM_STATE_SLOTS;
+        uint32_t offset, slot_index;
+
+        seq = slot ? ws_pae_nvm_store_state_slot_seq(slot) + 1 : 1;
+        slot = ws_pae_nvm_store_state_slot_free_get(hdr, len);
+        if (!slot) {
+            tr_warning("NVM state full: %s", file);
+            return PAE_NVM_FILE_STATE_FULL;
+        }
+        slot_index = slot - hdr->slot;
+        offset = slot->offset;
+        if (slot->capacity < len) {
+            // Allocates the copies at the end of the state file
+            offset = (hdr->size + 7) & ~7;
+            if (ws_pae_nvm_store_state_map(offset + 2 * len) < 0) {
+                return PAE_NVM_FILE_WRITE_ERROR;
+            }
+            hdr = ws_pae_nvm_state.hdr;
+            slot = &hdr->slot[slot_index];
+        }
+
+        // The new copy is on NVM before the entry that points to it
+        data = (uint8_t *) hdr + offset;
+        memcpy(data, tlv, len);
+        ws_pae_nvm_store_state_sync(data, len);
+        memset(slot, 0, sizeof(nvm_state_slot_t));
+        strcpy(slot->name, file);
+        slot->offset = offset;
+        slot->capacity = len;
+        slot->copy[0].len = len;
+        slot->copy[0].crc = crc16(data, len);
+        slot->copy[0].seq = seq;
+        if (hdr->size < offset + 2 * len) {
+            hdr->size = offset + 2 * len;
+        }
+        ws_pae_nvm_store_state_sync(hdr, sizeof(nvm_state_hdr_t));
+
+        // Then the previous entry can go
+        if (old_index < NVM_STATE_SLOTS) {
+            old_slot = &hdr->slot[old_index];
+            ws_pae_nvm_store_state_slot_free(old_slot);
+            ws_pae_nvm_store_state_sync(old_slot, sizeof(nvm_state_slot_t));
+        }
+        return PAE_NVM_FILE_SUCCESS;
+    }
+
+    // Overwrites the oldest copy
+    index = slot->copy[0].seq > slot->copy[1].seq ? 1 : 0;
+    seq = ws_pae_nvm_store_state_slot_seq(slot) + 1;
+    copy = &slot->copy[index];
+    data = (uint8_t *) hdr + slot->offset + index * slot->capacity;
+    copy->seq = 0;
+    memcpy(data, tlv, len);
+    copy->len = len;
+    copy->crc = crc16(data, len);
+    ws_pae_nvm_store_state_sync(data, len);
+    ws_pae_nvm_store_state_sync(hdr, sizeof(nvm_state_hdr_t));
+    copy->seq = seq;
+    ws_pae_nvm_store_state_sync(&copy->seq, sizeof(copy->seq));
+
+    return PAE_NVM_FILE_SUCCESS;
+}
+
+static int8_t ws_pae_nvm_store_state_read(const char *file, nvm_tlv_t *tlv)
+{
+    uint16_t len = tlv->len + sizeof(nvm_tlv_t);
+    nvm_state_hdr_t *hdr = ws_pae_nvm_store_state_get();
+    nvm_state_slot_t *slot;
+    const uint8_t *data;
+    int index;
+
+    if (!hdr) {
+        return PAE_NVM_FILE_CANNOT_OPEN;
+    }
+    slot = ws_pae_nvm_store_state_slot_get(hdr, file);
+    if (!slot || (!slot->copy[0].seq && !slot->copy[1].seq)) {
+        return PAE_NVM_FILE_CANNOT_OPEN;
+    }
+    if ((uint64_t) slot->offset + 2 * slot->capacity > hdr->size) {
+        return PAE_NVM_FILE_READ_ERROR;
+    }
+
+    // Uses the newest copy, or the other one if it is corrupted
+    index = slot->copy[0].seq > slot->copy[1].seq ? 0 : 1;
+    for (int i = 0; i < 2; i++, index ^= 1) {
+        data = (const uint8_t *) hdr + slot->offset + index * slot->capacity;
+        if (!slot->copy[index].seq || slot->copy[index].len > slot->capacity ||
+                !crc_check(data, slot->copy[index].len, slot->copy[index].crc)) {
+            continue;
+        }
+        if (slot->copy[index].len < len) {
+            tr_warning("NVM state cannot be read: %s", file);
+            return PAE_NVM_FILE_READ_ERROR;
+        }
+        memcpy(tlv, data, len);
+        return PAE_NVM_FILE_SUCCESS;
+    }
+    tr_warning("NVM state corrupted: %s", file);
+    return PAE_NVM_FILE_READ_ERROR;
+}
+
+static int8_t ws_pae_nvm_store_state_remove(const char *file)
+{
+    nvm_state_hdr_t *hdr = ws_pae_nvm_store_state_get();
+    nvm_state_slot_t *slot;
+
+    if (!hdr) {
+        return PAE_NVM_FILE_CANNOT_OPEN;
+    }
+    slot = ws_pae_nvm_store_state_slot_get(hdr, file);
+    if (!slot) {
+        return PAE_NVM_FILE_REMOVE_ERROR;
+    }
+    // Frees the duplicate entries left by a power loss as well
+    while (slot) {
+        ws_pae_nvm_store_state_slot_free(slot);
+        ws_pae_nvm_store_state_sync(slot, sizeof(nvm_state_slot_t));
+        slot = ws_pae_nvm_store_state_slot_get(hdr, file);
+    }
+    return PAE_NVM_FILE_SUCCESS;
+}
@@ -17,6 +17,8 @@
 
 #ifndef WS_PAE_NVM_STORE_H_
 #define WS_PAE_NVM_STORE_H_
+#include <stdbool.h>
+#include <stdint.h>
 
 /*
  * Port access entity non-volatile memory (NVM) storage module. Module is used
@@ -114,4 +116,16 @@ int8_t ws_pae_nvm_store_tlv_file_read(const char *file, nvm_tlv_t *tlv);
  */
 int8_t ws_pae_nvm_store_tlv_file_remove(const char *file);
 
+/**
+ * ws_pae_nvm_store_mmap_enable store the TLVs in a single memory mapped file
+ *
+ * When enabled, the TLV files are read from and written to the slots of a
+ * single state file mapped in memory, instead of one file each. Existing
+ * files are imported into the state file when they are first read.
+ *
+ * \param enable true to use the state file
+ *
+ */
+void ws_pae_nvm_store_mmap_enable(bool enable);
+
 #endif
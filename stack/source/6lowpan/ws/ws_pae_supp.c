@@ -779,6 +779,17 @@ void ws_pae_supp_fast_timer(uint16_t ticks)
     }
 }
 
+// The KMP timers are processed on every tick while they are running
+uint32_t ws_pae_supp_fast_timer_next_expiry(void)
+{
+    ns_list_foreach(pae_supp_t, pae_supp, &pae_supp_list) {
+        if (ws_pae_supp_timer_running(pae_supp)) {
+            return 1;
+        }
+    }
+    return UINT32_MAX;
+}
+
 static bool ws_pae_supp_authentication_ongoing(pae_supp_t *pae_supp)
 {
     /* When either bootstrap initial authentication or re-authentication is ongoing */
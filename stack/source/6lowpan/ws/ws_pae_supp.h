@@ -69,6 +69,14 @@ int8_t ws_pae_supp_delete(protocol_interface_info_entry_t *interface_ptr);
  */
 void ws_pae_supp_fast_timer(uint16_t ticks);
 
+/**
+ * ws_pae_supp_fast_timer_next_expiry ticks before the fast timer has something to do
+ *
+ * \return 1 while supplicant timers are running, UINT32_MAX otherwise
+ *
+ */
+uint32_t ws_pae_supp_fast_timer_next_expiry(void);
+
 /**
  * ws_pae_supp_slow_timer PAE supplicant slow timer call
  *
@@ -362,3 +362,15 @@ void mld_fast_timer(protocol_interface_info_entry_t *interface, uint_fast16_t ti
         protocol_push(mld_build(interface, ICMPV6_TYPE_INFO_MCAST_LIST_REPORT, 0, entry->group));
     }
 }
+
+uint32_t mld_fast_timer_next_expiry(protocol_interface_info_entry_t *interface)
+{
+    uint32_t ret = UINT32_MAX;
+
+    ns_list_foreach(if_group_entry_t, entry, &interface->ip_groups) {
+        if (entry->mld_timer && entry->mld_timer < ret) {
+            ret = entry->mld_timer;
+        }
+    }
+    return ret;
+}
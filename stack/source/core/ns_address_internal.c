@@ -872,6 +872,23 @@ void addr_fast_timer(protocol_interface_info_entry_t *cur, uint_fast16_t ticks)
     }
 }
 
+/* ticks is in 1/10s */
+uint32_t addr_fast_timer_next_expiry(struct protocol_interface_info_entry *cur)
+{
+    uint32_t ret = UINT32_MAX;
+
+    if (!(cur->lowpan_info & INTERFACE_NWK_ACTIVE)) {
+        return ret;
+    }
+
+    ns_list_foreach(if_address_entry_t, addr, &cur->ip_addresses) {
+        if (addr->state_timer && addr->state_timer < ret) {
+            ret = addr->state_timer;
+        }
+    }
+    return ret;
+}
+
 void addr_slow_timer(protocol_interface_info_entry_t *cur, uint_fast16_t seconds)
 {
     /* Slow (lifetime) timers run whether the interface is active or not */
@@ -153,6 +153,7 @@ uint8_t addr_check_broadcast(const address_t addr, addrtype_e addr_type);
 
 void address_module_init(void);
 void addr_fast_timer(struct protocol_interface_info_entry *cur, uint_fast16_t ticks);
+uint32_t addr_fast_timer_next_expiry(struct protocol_interface_info_entry *cur);
 void addr_slow_timer(struct protocol_interface_info_entry *cur, uint_fast16_t seconds);
 struct if_address_entry *addr_add(struct protocol_interface_info_entry *cur, const uint8_t address[static 16], uint_fast8_t prefix_len, if_address_source_e source, uint32_t valid_lifetime, uint32_t preferred_lifetime, bool skip_dad);
 int_fast8_t addr_delete(struct protocol_interface_info_entry *cur, const uint8_t address[static 16]);
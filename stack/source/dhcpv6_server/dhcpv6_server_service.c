@@ -345,7 +345,10 @@ int dhcpv6_server_service_set_address_generation_anonymous(int8_t interface, con
 
     }
 
-    serverInfo->anonymousAddress = mode;
+    if (serverInfo->anonymousAddress != mode) {
+        serverInfo->anonymousAddress = mode;
+        libdhcpv6_address_index_rebuild(serverInfo);
+    }
     if (mode) {
         serverInfo->disableAddressList = disable_address_list;
     } else {
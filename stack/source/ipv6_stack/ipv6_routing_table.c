@@ -38,6 +38,7 @@
 #include <stdlib.h>
 #include "common/rand.h"
 #include "common/bits.h"
+#include "common/log.h"
 #include "stack-services/ip6string.h"
 #include "stack-services/ns_trace.h"
 #include "service_libs/etx/etx.h"
@@ -95,6 +96,25 @@ static neighbour_cache_config_t neighbour_cache_config = {NCACHE_MAX_ABSOLUTE, N
 static NS_LIST_DEFINE(ipv6_destination_cache, ipv6_destination_t, link);
 static NS_LIST_DEFINE(ipv6_routing_table, ipv6_route_t, link);
 
+/* Destination cache is indexed by address. In each bucket, entries keep the
+ * same relative order as in ipv6_destination_cache.
+ */
+#define DCACHE_INDEX_SIZE 256
+typedef NS_LIST_HEAD(ipv6_destination_t, index_link) ipv6_destination_bucket_t;
+static ipv6_destination_bucket_t ipv6_destination_index[DCACHE_INDEX_SIZE];
+static uint_fast16_t ipv6_destination_cache_size;
+
+/* The routing table is also indexed by prefix, so lookups do not have to walk
+ * the whole table (the border router has one route per RPL target). Routes are
+ * hashed on their prefix and prefix length. In each bucket, routes keep the
+ * same relative order as in ipv6_routing_table, so ties are resolved exactly
+ * like a walk of the table would.
+ */
+#define IPV6_ROUTE_INDEX_SIZE 1024
+typedef NS_LIST_HEAD(ipv6_route_t, index_link) ipv6_route_bucket_t;
+static ipv6_route_bucket_t ipv6_route_index[IPV6_ROUTE_INDEX_SIZE];
+static unsigned int ipv6_route_index_len_count[129]; // Number of routes per prefix length
+
 static ipv6_destination_t *ipv6_destination_lookup(const uint8_t *address, int8_t interface_id);
 static void ipv6_destination_cache_forget_router(ipv6_neighbour_cache_t *cache, const uint8_t neighbour_addr[16]);
 static void ipv6_destination_cache_forget_neighbour(const ipv6_neighbour_t *neighbour);
@@ -107,6 +127,18 @@ static uint8_t ipv6_route_table_get_max_entries(int8_t interface_id, ipv6_route_
 
 static uint16_t dcache_gc_timer;
 
+// FNV-1a
+static uint32_t ipv6_routing_table_hash(uint32_t seed, const uint8_t *data, int len)
+{
+    uint32_t hash = 2166136261u ^ seed;
+
+    while (len--) {
+        hash ^= *data++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 static uint32_t next_probe_time(ipv6_neighbour_cache_t *cache, uint_fast8_t retrans_num)
 {
     uint32_t t = cache->retrans_timer;
@@ -216,6 +248,36 @@ static void ipv6_neighbour_gone(ipv6_neighbour_cache_t *cache, uint8_t address[s
     ipv6_destination_cache_forget_router(cache, address);
 }
 
+#define ipv6_neighbour_addr_bucket(cache, addr) \
+    (&(cache)->addr_index[ipv6_routing_table_hash(0, addr, 16) % NCACHE_INDEX_SIZE])
+#define ipv6_neighbour_eui64_bucket(cache, eui64) \
+    (&(cache)->eui64_index[ipv6_routing_table_hash(0, eui64, 8) % NCACHE_INDEX_SIZE])
+
+/* Entries are always moved to the start of the list, and the indexes follow */
+static void ipv6_neighbour_move_to_start(ipv6_neighbour_cache_t *cache, ipv6_neighbour_t *entry)
+{
+    if (entry == ns_list_get_first(&cache->list)) {
+        return;
+    }
+    ns_list_remove(&cache->list, entry);
+    ns_list_add_to_start(&cache->list, entry);
+    ns_list_remove(ipv6_neighbour_addr_bucket(cache, entry->ip_address), entry);
+    ns_list_add_to_start(ipv6_neighbour_addr_bucket(cache, entry->ip_address), entry);
+    if (entry->eui64_indexed) {
+        ns_list_remove(ipv6_neighbour_eui64_bucket(cache, ipv6_neighbour_eui64(cache, entry)), entry);
+        ns_list_add_to_start(ipv6_neighbour_eui64_bucket(cache, ipv6_neighbour_eui64(cache, entry)), entry);
+    }
+}
+
+void ipv6_neighbour_cache_alloc(ipv6_neighbour_cache_t *cache)
+{
+    ns_list_init(&cache->list);
+    for (int i = 0; i < NCACHE_INDEX_SIZE; i++) {
+        ns_list_init(&cache->addr_index[i]);
+        ns_list_init(&cache->eui64_index[i]);
+    }
+}
+
 void ipv6_neighbour_cache_init(ipv6_neighbour_cache_t *cache, int8_t interface_id)
 {
     /* Init Double linked Routing Table */
@@ -249,7 +311,7 @@ void ipv6_neighbour_cache_flush(ipv6_neighbour_cache_t *cache)
 
 ipv6_neighbour_t *ipv6_neighbour_lookup(ipv6_neighbour_cache_t *cache, const uint8_t *address)
 {
-    ns_list_foreach(ipv6_neighbour_t, cur, &cache->list) {
+    ns_list_foreach(ipv6_neighbour_t, cur, ipv6_neighbour_addr_bucket(cache, address)) {
         if (addr_ipv6_equal(cur->ip_address, address)) {
             return cur;
         }
@@ -276,6 +338,10 @@ void ipv6_neighbour_entry_remove(ipv6_neighbour_cache_t *cache, ipv6_neighbour_t
      * the entry.
      */
     ns_list_remove(&cache->list, entry);
+    ns_list_remove(ipv6_neighbour_addr_bucket(cache, entry->ip_address), entry);
+    if (entry->eui64_indexed) {
+        ns_list_remove(ipv6_neighbour_eui64_bucket(cache, ipv6_neighbour_eui64(cache, entry)), entry);
+    }
     switch (entry->state) {
         case IP_NEIGHBOUR_NEW:
             break;
@@ -307,20 +373,17 @@ ipv6_neighbour_t *ipv6_neighbour_lookup_or_create(ipv6_neighbour_cache_t *cache,
     ipv6_neighbour_t *entry = NULL;
     ipv6_neighbour_t *garbage_possible_entry = NULL;
 
-    ns_list_foreach(ipv6_neighbour_t, cur, &cache->list) {
+    entry = ipv6_neighbour_lookup(cache, address);
+    if (entry) {
+        ipv6_neighbour_move_to_start(cache, entry);
+        return entry;
+    }
 
+    ns_list_foreach(ipv6_neighbour_t, cur, &cache->list) {
         if (cur->type == IP_NEIGHBOUR_GARBAGE_COLLECTIBLE) {
             garbage_possible_entry = cur;
             count++;
         }
-
-        if (addr_ipv6_equal(cur->ip_address, address)) {
-            if (cur != ns_list_get_first(&cache->list)) {
-                ns_list_remove(&cache->list, cur);
-                ns_list_add_to_start(&cache->list, cur);
-            }
-            return cur;
-        }
     }
 
     if (count >= neighbour_cache_config.max_entries && garbage_possible_entry) {
@@ -341,6 +404,7 @@ ipv6_neighbour_t *ipv6_neighbour_lookup_or_create(ipv6_neighbour_cache_t *cache,
     memcpy(entry->ip_address, address, 16);
     entry->is_router = false;
     entry->from_redirect = false;
+    entry->eui64_indexed = false;
     entry->state = IP_NEIGHBOUR_NEW;
     /*if (tentative && cache->reg_required)
         entry->type = IP_NEIGHBOUR_TENTATIVE;
@@ -351,12 +415,14 @@ ipv6_neighbour_t *ipv6_neighbour_lookup_or_create(ipv6_neighbour_cache_t *cache,
     entry->lifetime = 0;
     entry->retrans_count = 0;
     entry->ll_type = ADDR_NONE;
+    ns_list_add_to_start(&cache->list, entry);
+    ns_list_add_to_start(ipv6_neighbour_addr_bucket(cache, entry->ip_address), entry);
     if (cache->recv_addr_reg) {
         memset(ipv6_neighbour_eui64(cache, entry), 0, 8);
+        ns_list_add_to_start(ipv6_neighbour_eui64_bucket(cache, ipv6_neighbour_eui64(cache, entry)), entry);
+        entry->eui64_indexed = true;
     }
 
-    ns_list_add_to_start(&cache->list, entry);
-
     return entry;
 }
 
@@ -378,10 +444,7 @@ ipv6_neighbour_t *ipv6_neighbour_used(ipv6_neighbour_cache_t *cache, ipv6_neighb
     }
 
     /* Move it to the front of the list */
-    if (entry != ns_list_get_first(&cache->list)) {
-        ns_list_remove(&cache->list, entry);
-        ns_list_add_to_start(&cache->list, entry);
-    }
+    ipv6_neighbour_move_to_start(cache, entry);
 
     /* If the entry is stale, prepare delay timer for active NUD probe */
     if (entry->state == IP_NEIGHBOUR_STALE && cache->send_nud_probes) {
@@ -466,26 +529,40 @@ void ipv6_neighbour_invalidate_ll_addr(ipv6_neighbour_cache_t *cache, addrtype_e
 
 void ipv6_neighbour_delete_registered_by_eui64(ipv6_neighbour_cache_t *cache, const uint8_t *eui64)
 {
-    ns_list_foreach_safe(ipv6_neighbour_t, cur, &cache->list) {
+    if (!cache->recv_addr_reg) {
+        return;
+    }
+    ns_list_foreach_safe(ipv6_neighbour_t, cur, ipv6_neighbour_eui64_bucket(cache, eui64)) {
         if (cur->type != IP_NEIGHBOUR_GARBAGE_COLLECTIBLE && memcmp(ipv6_neighbour_eui64(cache, cur), eui64, 8) == 0) {
             ipv6_neighbour_entry_remove(cache, cur);
         }
     }
 }
 
+/* The EUI-64 of an entry must be changed with this function to keep the index
+ * up to date. As a side effect, the entry is moved to the front of the cache.
+ */
+void ipv6_neighbour_set_eui64(ipv6_neighbour_cache_t *cache, ipv6_neighbour_t *entry, const uint8_t eui64[8])
+{
+    BUG_ON(!cache->recv_addr_reg);
+    BUG_ON(!entry->eui64_indexed);
+    ipv6_neighbour_move_to_start(cache, entry);
+    ns_list_remove(ipv6_neighbour_eui64_bucket(cache, ipv6_neighbour_eui64(cache, entry)), entry);
+    memcpy(ipv6_neighbour_eui64(cache, entry), eui64, 8);
+    ns_list_add_to_start(ipv6_neighbour_eui64_bucket(cache, ipv6_neighbour_eui64(cache, entry)), entry);
+}
+
 bool ipv6_neighbour_has_registered_by_eui64(ipv6_neighbour_cache_t *cache, const uint8_t *eui64)
 {
-    ns_list_foreach_safe(ipv6_neighbour_t, cur, &cache->list) {
-        if (cur->type != IP_NEIGHBOUR_GARBAGE_COLLECTIBLE && memcmp(ipv6_neighbour_eui64(cache, cur), eui64, 8) == 0) {
-            return true;
-        }
-    }
-    return false;
+    return ipv6_neighbour_get_registered_by_eui64(cache, eui64);
 }
 
 ipv6_neighbour_t *ipv6_neighbour_get_registered_by_eui64(ipv6_neighbour_cache_t *cache, const uint8_t *eui64)
 {
-    ns_list_foreach_safe(ipv6_neighbour_t, cur, &cache->list) {
+    if (!cache->recv_addr_reg) {
+        return NULL;
+    }
+    ns_list_foreach(ipv6_neighbour_t, cur, ipv6_neighbour_eui64_bucket(cache, eui64)) {
         if (cur->type != IP_NEIGHBOUR_GARBAGE_COLLECTIBLE && memcmp(ipv6_neighbour_eui64(cache, cur), eui64, 8) == 0) {
             return cur;
         }
@@ -870,6 +947,19 @@ void ipv6_neighbour_cache_fast_timer(ipv6_neighbour_cache_t *cache, uint16_t tic
     }
 }
 
+/* Entry timers are in milliseconds */
+uint32_t ipv6_neighbour_cache_fast_timer_next_expiry(const ipv6_neighbour_cache_t *cache)
+{
+    uint32_t ret = UINT32_MAX;
+
+    ns_list_foreach(const ipv6_neighbour_t, cur, &cache->list) {
+        if (cur->timer && (cur->timer + 99) / 100 < ret) {
+            ret = (cur->timer + 99) / 100;
+        }
+    }
+    return ret;
+}
+
 void ipv6_destination_cache_print(route_print_fn_t *print_fn)
 {
     print_fn("Destination Cache:");
@@ -885,6 +975,18 @@ void ipv6_destination_cache_print(route_print_fn_t *print_fn)
     }
 }
 
+static ipv6_destination_bucket_t *ipv6_destination_index_bucket(const uint8_t *address)
+{
+    static bool init = false;
+
+    if (!init) {
+        for (int i = 0; i < DCACHE_INDEX_SIZE; i++)
+            ns_list_init(&ipv6_destination_index[i]);
+        init = true;
+    }
+    return &ipv6_destination_index[ipv6_routing_table_hash(0, address, 16) % DCACHE_INDEX_SIZE];
+}
+
 static ipv6_destination_t *ipv6_destination_lookup(const uint8_t *address, int8_t interface_id)
 {
     bool is_ll = addr_is_ipv6_link_local(address);
@@ -893,7 +995,7 @@ static ipv6_destination_t *ipv6_destination_lookup(const uint8_t *address, int8_
         return NULL;
     }
 
-    ns_list_foreach(ipv6_destination_t, cur, &ipv6_destination_cache) {
+    ns_list_foreach(ipv6_destination_t, cur, ipv6_destination_index_bucket(address)) {
         if (!addr_ipv6_equal(cur->destination, address)) {
             continue;
         }
@@ -922,7 +1024,7 @@ static ipv6_destination_t *ipv6_destination_lookup(const uint8_t *address, int8_
  */
 ipv6_destination_t *ipv6_destination_lookup_or_create(const uint8_t *address, int8_t interface_id)
 {
-    uint_fast16_t count = 0;
+    ipv6_destination_bucket_t *bucket = ipv6_destination_index_bucket(address);
     ipv6_destination_t *entry = NULL;
     bool interface_specific = addr_ipv6_scope(address, NULL) <= IPV6_SCOPE_REALM_LOCAL;
 
@@ -931,8 +1033,7 @@ ipv6_destination_t *ipv6_destination_lookup_or_create(const uint8_t *address, in
     }
 
     /* Find any existing entry */
-    ns_list_foreach(ipv6_destination_t, cur, &ipv6_destination_cache) {
-        count++;
+    ns_list_foreach(ipv6_destination_t, cur, bucket) {
         if (!addr_ipv6_equal(cur->destination, address)) {
             continue;
         }
@@ -947,7 +1048,7 @@ ipv6_destination_t *ipv6_destination_lookup_or_create(const uint8_t *address, in
 
 
     if (!entry) {
-        if (count > destination_cache_config.max_entries) {
+        if (ipv6_destination_cache_size > destination_cache_config.max_entries) {
             entry = ns_list_get_last(&ipv6_destination_cache);
             ipv6_destination_release(entry);
         }
@@ -974,10 +1075,14 @@ ipv6_destination_t *ipv6_destination_lookup_or_create(const uint8_t *address, in
             entry->interface_id = -1;
         }
         ns_list_add_to_start(&ipv6_destination_cache, entry);
+        ns_list_add_to_start(bucket, entry);
+        ipv6_destination_cache_size++;
     } else if (entry != ns_list_get_first(&ipv6_destination_cache)) {
         /* If there was an entry, and it wasn't at the start, move it */
         ns_list_remove(&ipv6_destination_cache, entry);
         ns_list_add_to_start(&ipv6_destination_cache, entry);
+        ns_list_remove(bucket, entry);
+        ns_list_add_to_start(bucket, entry);
     }
 
     if (addr_ipv6_scope(address, NULL) <= IPV6_SCOPE_LINK_LOCAL) {
@@ -1088,6 +1193,8 @@ static bool ipv6_destination_release(ipv6_destination_t *dest)
 {
     if (--dest->refcount == 0) {
         ns_list_remove(&ipv6_destination_cache, dest);
+        ns_list_remove(ipv6_destination_index_bucket(dest->destination), dest);
+        ipv6_destination_cache_size--;
         tr_debug("Destination cache remove: %s", trace_ipv6(dest->destination));
         free(dest);
         return true;
@@ -1273,6 +1380,24 @@ void trace_debug_print(const char *fmt, ...)
     va_end(ap);
 }
 
+static ipv6_route_bucket_t *ipv6_route_index_bucket(const uint8_t *prefix, uint8_t prefix_len)
+{
+    static bool init = false;
+    uint8_t key[16] = { };
+    uint32_t hash;
+    int i;
+
+    if (!init) {
+        for (i = 0; i < IPV6_ROUTE_INDEX_SIZE; i++)
+            ns_list_init(&ipv6_route_index[i]);
+        init = true;
+    }
+    // Same masking as the prefix stored in ipv6_route_t
+    bitcpy(key, prefix, prefix_len);
+    hash = ipv6_routing_table_hash(prefix_len, key, (prefix_len + 7) / 8);
+    return &ipv6_route_index[hash % IPV6_ROUTE_INDEX_SIZE];
+}
+
 static void ipv6_route_entry_remove(ipv6_route_t *route)
 {
     tr_debug("Deleted route:");
@@ -1285,6 +1410,8 @@ static void ipv6_route_entry_remove(ipv6_route_t *route)
         ipv6_route_source_invalidated[route->info.source] = true;
     }
     ns_list_remove(&ipv6_routing_table, route);
+    ns_list_remove(ipv6_route_index_bucket(route->prefix, route->prefix_len), route);
+    ipv6_route_index_len_count[route->prefix_len]--;
     free(route);
 }
 
@@ -1347,11 +1474,16 @@ static bool ipv6_route_is_better(const ipv6_route_t *a, const ipv6_route_t *b)
     return total_metric(a) < total_metric(b);
 }
 
-/* Find the "best" route regardless of reachability, but respecting the skip flag and predicates */
-static ipv6_route_t *ipv6_route_find_best(const uint8_t *addr, int8_t interface_id, ipv6_route_predicate_fn_t *predicate)
+/* Find the "best" route with a given prefix length */
+static ipv6_route_t *ipv6_route_find_best_len(const uint8_t *addr, uint8_t prefix_len, int8_t interface_id, ipv6_route_predicate_fn_t *predicate)
 {
     ipv6_route_t *best = NULL;
-    ns_list_foreach(ipv6_route_t, route, &ipv6_routing_table) {
+    ns_list_foreach(ipv6_route_t, route, ipv6_route_index_bucket(addr, prefix_len)) {
+        /* Bucket may contain other prefixes */
+        if (route->prefix_len != prefix_len) {
+            continue;
+        }
+
         /* We mustn't be skipping this route */
         if (route->search_skip) {
             continue;
@@ -1394,16 +1526,48 @@ static ipv6_route_t *ipv6_route_find_best(const uint8_t *addr, int8_t interface_
     return best;
 }
 
+/* Find the "best" route regardless of reachability, but respecting the skip flag and predicates */
+static ipv6_route_t *ipv6_route_find_best(const uint8_t *addr, int8_t interface_id, ipv6_route_predicate_fn_t *predicate)
+{
+    ipv6_route_t *best = NULL;
+    int prefix_len;
+
+    /* A valid route always beats the routes with a shorter prefix, so the
+     * prefix lengths are tried from the longest one, and the search stops at
+     * the first length providing a valid route.
+     */
+    for (prefix_len = 128; prefix_len >= 0 && !best; prefix_len--) {
+        if (!ipv6_route_index_len_count[prefix_len]) {
+            continue;
+        }
+        best = ipv6_route_find_best_len(addr, prefix_len, interface_id, predicate);
+    }
+    return best;
+}
+
+/* Clear the search_skip flags set by ipv6_route_choose_next_hop(). Only routes
+ * matching addr can have been skipped.
+ */
+static void ipv6_route_clear_search_skip(const uint8_t *addr)
+{
+    int prefix_len;
+
+    for (prefix_len = 128; prefix_len >= 0; prefix_len--) {
+        if (!ipv6_route_index_len_count[prefix_len]) {
+            continue;
+        }
+        ns_list_foreach(ipv6_route_t, route, ipv6_route_index_bucket(addr, prefix_len)) {
+            route->search_skip = false;
+        }
+    }
+}
+
 ipv6_route_t *ipv6_route_choose_next_hop(const uint8_t *dest, int8_t interface_id, ipv6_route_predicate_fn_t *predicate)
 {
     ipv6_route_t *best = NULL;
     bool reachable = false;
     bool need_to_probe = false;
 
-    ns_list_foreach(ipv6_route_t, route, &ipv6_routing_table) {
-        route->search_skip = false;
-    }
-
     /* Search algorithm from RFC 4191, S3.2:
      *
      * When a type C host does next-hop determination and consults its
@@ -1509,14 +1673,17 @@ ipv6_route_t *ipv6_route_choose_next_hop(const uint8_t *dest, int8_t interface_i
          */
         ns_list_remove(&ipv6_routing_table, best);
         ns_list_add_to_end(&ipv6_routing_table, best);
+        ns_list_remove(ipv6_route_index_bucket(best->prefix, best->prefix_len), best);
+        ns_list_add_to_end(ipv6_route_index_bucket(best->prefix, best->prefix_len), best);
     }
 
+    ipv6_route_clear_search_skip(dest);
     return best;
 }
 
 ipv6_route_t *ipv6_route_lookup_with_info(const uint8_t *prefix, uint8_t prefix_len, int8_t interface_id, const uint8_t *next_hop, ipv6_route_src_t source, void *info, int_fast16_t src_id)
 {
-    ns_list_foreach(ipv6_route_t, r, &ipv6_routing_table) {
+    ns_list_foreach(ipv6_route_t, r, ipv6_route_index_bucket(prefix, prefix_len)) {
         if (interface_id == r->info.interface_id && prefix_len == r->prefix_len && !bitcmp(prefix, r->prefix, prefix_len)) {
             if (source != ROUTE_ANY) {
                 if (source != r->info.source) {
@@ -1658,6 +1825,8 @@ ipv6_route_t *ipv6_route_add_metric(const uint8_t *prefix, uint8_t prefix_len, i
         /* Doesn't matter much where they start off, but put them at the */
         /* beginning so new routes tend to get tried first. */
         ns_list_add_to_start(&ipv6_routing_table, route);
+        ns_list_add_to_start(ipv6_route_index_bucket(route->prefix, route->prefix_len), route);
+        ipv6_route_index_len_count[route->prefix_len]++;
         changed_info = NEW;
     } else { /* updating a route - only lifetime and metric can be changing */
         route->lifetime = lifetime;
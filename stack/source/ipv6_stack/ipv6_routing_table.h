@@ -90,10 +90,13 @@ typedef enum ipv6_route_src {
 
 struct buffer;
 
+#define NCACHE_INDEX_SIZE 256
+
 typedef struct ipv6_neighbour {
     uint8_t                         ip_address[16];             /*!< neighbour IP address */
     bool                            is_router: 1;
     bool                            from_redirect: 1;
+    bool                            eui64_indexed: 1;           /*!< linked in eui64_index of the cache */
     uint8_t                         retrans_count;
     ip_neighbour_cache_state_e      state;
     ip_neighbour_cache_type_e       type;
@@ -101,6 +104,8 @@ typedef struct ipv6_neighbour {
     uint32_t                        timer;                      /* 100ms ticks */
     uint32_t                        lifetime;                   /* seconds */
     ns_list_link_t                  link;                       /*!< List link */
+    ns_list_link_t                  addr_link;                  /*!< Link in addr_index of the cache */
+    ns_list_link_t                  eui64_link;                 /*!< Link in eui64_index of the cache */
     NS_LIST_HEAD_INCOMPLETE(struct buffer) queue;
     uint8_t                         ll_address[];
 } ipv6_neighbour_t;
@@ -135,6 +140,10 @@ typedef struct ipv6_neighbour_cache {
     ipv6_route_interface_info_t             route_if_info;
     //uint8_t                                   num_entries;
     NS_LIST_HEAD(ipv6_neighbour_t, link)    list;
+    // Hash indexes of list, by IPv6 address and by EUI-64 (only if
+    // recv_addr_reg). Entries keep the same relative order as in list.
+    NS_LIST_HEAD(ipv6_neighbour_t, addr_link) addr_index[NCACHE_INDEX_SIZE];
+    NS_LIST_HEAD(ipv6_neighbour_t, eui64_link) eui64_index[NCACHE_INDEX_SIZE];
 } ipv6_neighbour_cache_t;
 
 /* Macros for formatting ipv6 addresses into strings for route printing. */
@@ -146,6 +155,7 @@ typedef struct ipv6_neighbour_cache {
 /* Callback type for route print */
 typedef void (route_print_fn_t)(const char *fmt, ...);
 
+void ipv6_neighbour_cache_alloc(ipv6_neighbour_cache_t *cache);
 void ipv6_neighbour_cache_init(ipv6_neighbour_cache_t *cache, int8_t interface_id);
 void ipv6_neighbour_cache_flush(ipv6_neighbour_cache_t *cache);
 ipv6_neighbour_t *ipv6_neighbour_update(ipv6_neighbour_cache_t *cache, const uint8_t *address, bool solicited);
@@ -161,6 +171,7 @@ bool ipv6_neighbour_addr_is_probably_reachable(ipv6_neighbour_cache_t *cache, co
 bool ipv6_neighbour_ll_addr_match(const ipv6_neighbour_t *entry, addrtype_e ll_type, const uint8_t *ll_address);
 void ipv6_neighbour_invalidate_ll_addr(ipv6_neighbour_cache_t *cache, addrtype_e ll_type, const uint8_t *ll_address);
 void ipv6_neighbour_delete_registered_by_eui64(ipv6_neighbour_cache_t *cache, const uint8_t *eui64);
+void ipv6_neighbour_set_eui64(ipv6_neighbour_cache_t *cache, ipv6_neighbour_t *entry, const uint8_t eui64[8]);
 bool ipv6_neighbour_has_registered_by_eui64(ipv6_neighbour_cache_t *cache, const uint8_t *eui64);
 ipv6_neighbour_t *ipv6_neighbour_get_registered_by_eui64(ipv6_neighbour_cache_t *cache, const uint8_t *eui64);
 void ipv6_neighbour_entry_update_unsolicited(ipv6_neighbour_cache_t *cache, ipv6_neighbour_t *entry, addrtype_e type, const uint8_t *ll_address/*, bool tentative*/);
@@ -169,6 +180,7 @@ void ipv6_neighbour_reachability_confirmation(const uint8_t ip_address[static 16
 void ipv6_neighbour_reachability_problem(const uint8_t ip_address[static 16], int8_t interface_id);
 void ipv6_neighbour_update_from_na(ipv6_neighbour_cache_t *cache, ipv6_neighbour_t *entry, uint8_t flags, addrtype_e ll_type, const uint8_t *ll_address);
 void ipv6_neighbour_cache_fast_timer(ipv6_neighbour_cache_t *cache, uint16_t ticks);
+uint32_t ipv6_neighbour_cache_fast_timer_next_expiry(const ipv6_neighbour_cache_t *cache);
 void ipv6_neighbour_cache_slow_timer(ipv6_neighbour_cache_t *cache, uint8_t seconds);
 void ipv6_neighbour_cache_print(const ipv6_neighbour_cache_t *cache, route_print_fn_t *print_fn);
 void ipv6_router_gone(ipv6_neighbour_cache_t *cache, ipv6_neighbour_t *entry);
@@ -206,6 +218,7 @@ typedef struct ipv6_destination {
 #endif
     ipv6_neighbour_t                *last_neighbour;    // last neighbour used (only for reachability confirmation)
     ns_list_link_t                  link;
+    ns_list_link_t                  index_link;         // see ipv6_destination_index
 } ipv6_destination_t;
 
 #ifndef NO_IPV6_PMTUD
@@ -234,6 +247,7 @@ typedef struct ipv6_route {
     uint32_t            lifetime;           // (seconds); 0xFFFFFFFF means permanent
     uint16_t            probe_timer;
     ns_list_link_t      link;
+    ns_list_link_t      index_link;         // see ipv6_route_index
     uint8_t             prefix[];           // variable length
 } ipv6_route_t;
 
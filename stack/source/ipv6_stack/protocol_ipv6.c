@@ -605,6 +605,12 @@ void ipv6_core_timer_event_handle(protocol_interface_info_entry_t *cur, const ui
     }
 }
 
+// ND_TIMER counts the calls of ipv6_core_timer_event_handle(), not the ticks
+uint32_t ipv6_core_timer_next_expiry(struct protocol_interface_info_entry *cur)
+{
+    return cur->ipv6_configure.ND_TIMER ? 1 : UINT32_MAX;
+}
+
 int ipv6_prefix_register(uint8_t *prefix_64, uint32_t lifetime, uint32_t prefer_lifetime)
 {
     prefix_entry_t *new_entry = icmpv6_prefix_add(&ipv6_prefixs, prefix_64, 64, lifetime, prefer_lifetime, (PIO_L | PIO_A));
@@ -57,6 +57,7 @@ struct buffer;
 struct protocol_interface_info_entry;
 
 void ipv6_core_timer_event_handle(struct protocol_interface_info_entry *cur, uint8_t event);
+uint32_t ipv6_core_timer_next_expiry(struct protocol_interface_info_entry *cur);
 void ipv6_core_slow_timer_event_handle(struct protocol_interface_info_entry *cur);
 
 int ipv6_prefix_register(uint8_t *prefix_64, uint32_t lifetime, uint32_t prefer_lifetime);
@@ -77,6 +78,7 @@ int8_t ipv6_interface_accept_ra(int8_t interface_id, net_ipv6_accept_ra_e accept
 #define ipv6_interface_configure_ipv6_bootstrap_set(nwk_interface_id_e, bootstrap_mode, ipv6_prefix_pointer) -1
 #define ipv6_core_slow_timer_event_handle(cur) ((void)0)
 #define ipv6_core_timer_event_handle(cur, event) ((void)0)
+#define ipv6_core_timer_next_expiry(cur) UINT32_MAX
 #define ipv6_interface_slaac_handler(cur, slaacPrefix, prefixLen, validLifeTime, preferredLifeTime) ((void)0)
 #define ipv6_nd_ra_advert(cur, dest) ((void)0)
 #define ipv6_interface_sitelocal_clone(buf) ((void)0)
@@ -334,7 +334,7 @@ static relay_instance_t *dhcp_service_relay_interface(int8_t  interface_id)
     return result;
 }
 
-void recv_dhcp_server_msg()
+int recv_dhcp_server_msg()
 {
     server_instance_t *srv_ptr = NULL;
     msg_tr_t *msg_tr_ptr;
@@ -347,9 +347,11 @@ void recv_dhcp_server_msg()
     socklen_t src_addr_len = sizeof(struct sockaddr_in6);
     relay_notify_t *neigh_notify = NULL;
 
+    msg_len = recvfrom(dhcp_service->dhcp_server_socket, msg, sizeof(msg), MSG_DONTWAIT, (struct sockaddr *) &src_addr, &src_addr_len);
+    if (msg_len <= 0)
+        return msg_len;
     msg_tr_ptr = dhcp_tr_create();
     msg_ptr = msg;
-    msg_len = recvfrom(dhcp_service->dhcp_server_socket, msg, sizeof(msg), 0, (struct sockaddr *) &src_addr, &src_addr_len);
     memcpy(msg_tr_ptr->addr.address, &(src_addr.sin6_addr), 16);
     msg_type = *msg_ptr;
 
@@ -418,8 +420,8 @@ cleanup:
         //no owner found
         tr_warn("No handler for this message found");
     }
-
-    return;
+    // Message consumed, more may be pending on the socket
+    return 1;
 }
 
 void recv_dhcp_relay_msg(void *cb_res)
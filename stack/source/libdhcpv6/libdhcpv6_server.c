@@ -35,6 +35,9 @@
 
 static NS_LIST_DEFINE(dhcpv6_gua_server_list, dhcpv6_gua_server_entry_s, link);
 
+// Seconds elapsed since start, advanced by libdhcpv6_gua_servers_time_update()
+static uint64_t libdhcpv6_server_time;
+
 bool libdhcpv6_gua_server_list_empty(void)
 {
     return ns_list_is_empty(&dhcpv6_gua_server_list);
@@ -59,6 +62,13 @@ static dhcpv6_gua_server_entry_s *libdhcpv6_server_entry_allocate(void)
     entry->removeCb = NULL;
     entry->addCb = NULL;
     ns_list_init(&entry->allocatedAddressList);
+    entry->allocatedAddressCount = 0;
+    entry->allocatedAddressIndex = NULL;
+    entry->allocatedAddressAddressIndex = NULL;
+    entry->allocatedAddressIndexSize = 0;
+    entry->expiryHeap = NULL;
+    entry->expiryHeapSize = 0;
+    entry->allocatedIdBitmap = NULL;
     ns_list_init(&entry->dnsServerList);
     ns_list_init(&entry->vendorDataList);
     return entry;
@@ -66,24 +76,201 @@ static dhcpv6_gua_server_entry_s *libdhcpv6_server_entry_allocate(void)
 
 static uint16_t libdhcpv6_get_unique_id(dhcpv6_gua_server_entry_s *serverInfo)
 {
-    uint8_t suggested_id = serverInfo->firstUnusedId;
+    uint32_t *bitmap = serverInfo->allocatedIdBitmap;
+    uint32_t id = serverInfo->firstUnusedId;
+    uint32_t word;
+
+    if (!bitmap) {
+        bitmap = calloc(0x10000 / 32, sizeof(uint32_t));
+        if (!bitmap) {
+            return 0;
+        }
+        // IDs below DHCP_ADDRESS_ID_START are never given
+        bitmap[0] = (1u << DHCP_ADDRESS_ID_START) - 1;
+        serverInfo->allocatedIdBitmap = bitmap;
+    }
+    if (id < DHCP_ADDRESS_ID_START) {
+        id = DHCP_ADDRESS_ID_START;
+    }
 
-    do {
-        ns_list_foreach(dhcpv6_allocated_address_entry_t, cur, &serverInfo->allocatedAddressList) {
-            if (serverInfo->firstUnusedId == cur->allocatedID) {
-                serverInfo->firstUnusedId++;
-                if (serverInfo->firstUnusedId == 0) {
-                    serverInfo->firstUnusedId++;
-                }
-                //Start from beginning
-                break;
-            }
+    // Search the first free ID from firstUnusedId, a word at a time, and wrap around once
+    for (int i = 0; i <= 0x10000 / 32; i++) {
+        word = ~bitmap[id / 32] & (0xffffffffu << (id % 32));
+        if (word) {
+            id = (id & ~31u) + __builtin_ctz(word);
+            //return the first free and increase the value for the next time.
+            serverInfo->firstUnusedId = id + 1;
+            return id;
         }
+        id = (id / 32 + 1) * 32 % 0x10000;
+    }
+    return 0;
+}
+
+static void libdhcpv6_allocated_id_set(dhcpv6_gua_server_entry_s *serverInfo, uint16_t id, bool allocated)
+{
+    if (!serverInfo->allocatedIdBitmap || id < DHCP_ADDRESS_ID_START) {
+        return;
+    }
+    if (allocated) {
+        serverInfo->allocatedIdBitmap[id / 32] |= 1u << (id % 32);
+    } else {
+        serverInfo->allocatedIdBitmap[id / 32] &= ~(1u << (id % 32));
+    }
+}
+
+static uint8_t libdhcpv6_link_id_length(uint16_t linkType)
+{
+    if (linkType == DHCPV6_DUID_HARDWARE_EUI64_TYPE ||
+            linkType == DHCPV6_DUID_HARDWARE_IEEE_802_NETWORKS_TYPE) {
+        return 8;
+    }
+    return 6;
+}
+
+static uint32_t libdhcpv6_address_index_hash(uint32_t hash, const uint8_t *data, uint8_t length)
+{
+    for (int i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static dhcpv6_allocated_address_index_t *libdhcpv6_address_index_bucket(dhcpv6_gua_server_entry_s *serverInfo, const uint8_t *linkId, uint16_t linkType)
+{
+    uint8_t type[2] = { linkType >> 8, linkType };
+    uint32_t hash;
 
-    } while (suggested_id != serverInfo->firstUnusedId);
-    //return the first free and increase the value for the next time.
-    serverInfo->firstUnusedId = suggested_id + 1;
-    return suggested_id;
+    hash = libdhcpv6_address_index_hash(2166136261u, type, sizeof(type));
+    hash = libdhcpv6_address_index_hash(hash, linkId, libdhcpv6_link_id_length(linkType));
+    return &serverInfo->allocatedAddressIndex[hash & (serverInfo->allocatedAddressIndexSize - 1)];
+}
+
+// The prefix is the same for all the addresses of a server, only the interface ID is hashed
+static dhcpv6_allocated_address_address_index_t *libdhcpv6_address_address_index_bucket(dhcpv6_gua_server_entry_s *serverInfo, const uint8_t *address)
+{
+    uint32_t hash = libdhcpv6_address_index_hash(2166136261u, address + 8, 8);
+
+    return &serverInfo->allocatedAddressAddressIndex[hash & (serverInfo->allocatedAddressIndexSize - 1)];
+}
+
+/*
+ * Both indexes start with DHCP_ADDRESS_INDEX_SIZE_MIN buckets and are doubled
+ * while there are more than 2 addresses per bucket, up to half of
+ * maxSupportedClients buckets.
+ */
+static void libdhcpv6_address_index_fill(dhcpv6_gua_server_entry_s *serverInfo)
+{
+    uint8_t address[16];
+
+    for (uint32_t i = 0; i < serverInfo->allocatedAddressIndexSize; i++) {
+        ns_list_init(&serverInfo->allocatedAddressIndex[i]);
+        ns_list_init(&serverInfo->allocatedAddressAddressIndex[i]);
+    }
+    ns_list_foreach(dhcpv6_allocated_address_entry_t, cur, &serverInfo->allocatedAddressList) {
+        ns_list_add_to_end(libdhcpv6_address_index_bucket(serverInfo, cur->linkId, cur->linkType), cur);
+        libdhcpv6_allocated_address_write(address, cur, serverInfo);
+        ns_list_add_to_end(libdhcpv6_address_address_index_bucket(serverInfo, address), cur);
+    }
+}
+
+static int libdhcpv6_address_index_resize(dhcpv6_gua_server_entry_s *serverInfo, uint32_t size)
+{
+    dhcpv6_allocated_address_index_t *index;
+    dhcpv6_allocated_address_address_index_t *address_index;
+
+    index = malloc(size * sizeof(*index));
+    address_index = malloc(size * sizeof(*address_index));
+    if (!index || !address_index) {
+        free(index);
+        free(address_index);
+        return -1;
+    }
+    free(serverInfo->allocatedAddressIndex);
+    free(serverInfo->allocatedAddressAddressIndex);
+    serverInfo->allocatedAddressIndex = index;
+    serverInfo->allocatedAddressAddressIndex = address_index;
+    serverInfo->allocatedAddressIndexSize = size;
+    libdhcpv6_address_index_fill(serverInfo);
+    return 0;
+}
+
+void libdhcpv6_address_index_rebuild(dhcpv6_gua_server_entry_s *serverInfo)
+{
+    libdhcpv6_address_index_fill(serverInfo);
+}
+
+static int libdhcpv6_address_index_grow(dhcpv6_gua_server_entry_s *serverInfo)
+{
+    uint32_t size = serverInfo->allocatedAddressIndexSize;
+
+    if (!size) {
+        return libdhcpv6_address_index_resize(serverInfo, DHCP_ADDRESS_INDEX_SIZE_MIN);
+    }
+    if (serverInfo->allocatedAddressCount < 2 * size || 2 * size > serverInfo->maxSupportedClients / 2) {
+        return 0;
+    }
+    // Keeps the current index if there is no memory for a larger one
+    libdhcpv6_address_index_resize(serverInfo, 2 * size);
+    return 0;
+}
+
+/*
+ * Each allocated address is in a min-heap of the server, keyed by its next
+ * event: the end of the preferred lifetime then the end of the valid
+ * lifetime. So a time update only looks at the addresses that expire.
+ */
+static uint64_t libdhcpv6_address_next_expiry(const dhcpv6_allocated_address_entry_t *entry)
+{
+    return entry->preferredExpiry ? entry->preferredExpiry : entry->expiry;
+}
+
+static void libdhcpv6_expiry_heap_set(dhcpv6_gua_server_entry_s *serverInfo, uint32_t i, dhcpv6_allocated_address_entry_t *entry)
+{
+    serverInfo->expiryHeap[i] = entry;
+    entry->heapIndex = i;
+}
+
+static void libdhcpv6_expiry_heap_sift(dhcpv6_gua_server_entry_s *serverInfo, uint32_t i)
+{
+    dhcpv6_allocated_address_entry_t **heap = serverInfo->expiryHeap;
+    dhcpv6_allocated_address_entry_t *entry = heap[i];
+    uint64_t expiry = libdhcpv6_address_next_expiry(entry);
+    uint32_t child;
+
+    while (i > 0 && libdhcpv6_address_next_expiry(heap[(i - 1) / 2]) > expiry) {
+        libdhcpv6_expiry_heap_set(serverInfo, i, heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        child = 2 * i + 1;
+        if (child >= serverInfo->allocatedAddressCount) {
+            break;
+        }
+        if (child + 1 < serverInfo->allocatedAddressCount &&
+                libdhcpv6_address_next_expiry(heap[child + 1]) < libdhcpv6_address_next_expiry(heap[child])) {
+            child++;
+        }
+        if (libdhcpv6_address_next_expiry(heap[child]) >= expiry) {
+            break;
+        }
+        libdhcpv6_expiry_heap_set(serverInfo, i, heap[child]);
+        i = child;
+    }
+    libdhcpv6_expiry_heap_set(serverInfo, i, entry);
+}
+
+static void libdhcpv6_expiry_heap_remove(dhcpv6_gua_server_entry_s *serverInfo, dhcpv6_allocated_address_entry_t *entry)
+{
+    uint32_t last = serverInfo->allocatedAddressCount - 1;
+    uint32_t i = entry->heapIndex;
+
+    serverInfo->allocatedAddressCount--;
+    if (i != last) {
+        libdhcpv6_expiry_heap_set(serverInfo, i, serverInfo->expiryHeap[last]);
+        libdhcpv6_expiry_heap_sift(serverInfo, i);
+    }
 }
 
 static uint16_t libdhcpv6_address_id_allocate(dhcpv6_gua_server_entry_s *serverInfo)
@@ -114,35 +301,41 @@ static void libdhcpv6_gen_suffics_from_allocated_id(uint8_t *ptr, uint8_t *serve
 
 static void libdhcpv6_address_list_entry_free(dhcpv6_gua_server_entry_s *server_info, dhcpv6_allocated_address_entry_t *entry)
 {
+    uint8_t address[16];
+
     ns_list_remove(&server_info->allocatedAddressList, entry);
+    ns_list_remove(libdhcpv6_address_index_bucket(server_info, entry->linkId, entry->linkType), entry);
+    libdhcpv6_allocated_address_write(address, entry, server_info);
+    ns_list_remove(libdhcpv6_address_address_index_bucket(server_info, address), entry);
+    libdhcpv6_expiry_heap_remove(server_info, entry);
+    libdhcpv6_allocated_id_set(server_info, entry->allocatedID, false);
     free(entry);
 }
 
 void libdhcpv6_gua_servers_time_update(uint32_t timeUpdateInSeconds)
 {
+    dhcpv6_allocated_address_entry_t *address;
+
+    libdhcpv6_server_time += timeUpdateInSeconds;
     //Check All allocated server inside this loop
     ns_list_foreach(dhcpv6_gua_server_entry_s, cur, &dhcpv6_gua_server_list) {
-        //Check All allocated address in this module
-        ns_list_foreach_safe(dhcpv6_allocated_address_entry_t, address, &cur->allocatedAddressList) {
-            //Update
-            if (address->preferredLifetime) {
-                if (address->preferredLifetime <= timeUpdateInSeconds) {
-                    //Stop use this address for leasequery and delete Route or address map
-                    address->preferredLifetime = 0;
-                    if (cur->removeCb) {
-                        uint8_t ipAddress[16];
-                        libdhcpv6_allocated_address_write(ipAddress, address, cur);
-                        cur->removeCb(cur->interfaceId, ipAddress, cur->guaPrefix);
-                    }
-                } else {
-                    address->preferredLifetime -= timeUpdateInSeconds;
-                }
+        //Check the allocated addresses which expire
+        while (cur->allocatedAddressCount) {
+            address = cur->expiryHeap[0];
+            if (libdhcpv6_address_next_expiry(address) > libdhcpv6_server_time) {
+                break;
             }
-
-            if (address->lifetime <= timeUpdateInSeconds) {
-                libdhcpv6_address_list_entry_free(cur, address);
+            if (address->preferredExpiry) {
+                //Stop use this address for leasequery and delete Route or address map
+                address->preferredExpiry = 0;
+                libdhcpv6_expiry_heap_sift(cur, 0);
+                if (cur->removeCb) {
+                    uint8_t ipAddress[16];
+                    libdhcpv6_allocated_address_write(ipAddress, address, cur);
+                    cur->removeCb(cur->interfaceId, ipAddress, cur->guaPrefix);
+                }
             } else {
-                address->lifetime -= timeUpdateInSeconds;
+                libdhcpv6_address_list_entry_free(cur, address);
             }
         }
     }
@@ -246,6 +439,10 @@ void libdhcpv6_gua_server_free_by_prefix_and_interfaceid(uint8_t *prefix, int8_t
             ns_list_foreach_safe(dhcpv6_allocated_address_entry_t, cur, &serverInfo->allocatedAddressList) {
                 libdhcpv6_address_list_entry_free(serverInfo, cur);
             }
+            free(serverInfo->expiryHeap);
+            free(serverInfo->allocatedIdBitmap);
+            free(serverInfo->allocatedAddressIndex);
+            free(serverInfo->allocatedAddressAddressIndex);
 
             ns_list_foreach_safe(dhcpv6_dns_server_data_t, cur, &serverInfo->dnsServerList) {
                 //DNS Server Info Remove
@@ -269,13 +466,15 @@ void libdhcpv6_gua_server_free_by_prefix_and_interfaceid(uint8_t *prefix, int8_t
 
 static void libdhcpv6_address_entry_lifetime_set(dhcpv6_allocated_address_entry_t *entry, uint32_t validLifetime)
 {
+    uint32_t preferredLifetime;
+
     if (validLifetime != 0xffffffff) {
-        entry->lifetime = validLifetime;
-        entry->preferredLifetime = (validLifetime >> 1);
+        preferredLifetime = (validLifetime >> 1);
     } else {
-        entry->lifetime = 0xffffffff;
-        entry->preferredLifetime = 0xffffffff;
+        preferredLifetime = 0xffffffff;
     }
+    entry->expiry = libdhcpv6_server_time + validLifetime;
+    entry->preferredExpiry = preferredLifetime ? libdhcpv6_server_time + preferredLifetime : 0;
 }
 
 void libdhcpv6_allocated_address_write(uint8_t *ptr, dhcpv6_allocated_address_entry_t *address, dhcpv6_gua_server_entry_s *serverInfo)
@@ -306,34 +505,45 @@ static void libdhcpv6_generate_address_entry(dhcpv6_allocated_address_t *address
     address->T0 = cur->T0;
     address->T1 = cur->T1;
     address->iaID = cur->iaID;
-    address->lifetime = cur->lifetime;
-    address->preferredLifetime = cur->preferredLifetime;
+    address->lifetime = cur->expiry - libdhcpv6_server_time;
+    address->preferredLifetime = cur->preferredExpiry ? cur->preferredExpiry - libdhcpv6_server_time : 0;
     address->linkType = cur->linkType;
 }
 
-static void libdhcpv6_address_list_entry_add_to_list(dhcpv6_gua_server_entry_s *serverInfo, dhcpv6_allocated_address_entry_t *allocated)
+static int libdhcpv6_address_list_entry_add_to_list(dhcpv6_gua_server_entry_s *serverInfo, dhcpv6_allocated_address_entry_t *allocated)
 {
-    if (allocated->allocatedID != 0) {
-        // If we have allocated ID we sort by it if it is 0 we dont do any sorting
-        ns_list_foreach_safe(dhcpv6_allocated_address_entry_t, cur, &serverInfo->allocatedAddressList) {
-            if (cur->allocatedID > allocated->allocatedID) {
-                //Add before new allocated
-                ns_list_add_before(&serverInfo->allocatedAddressList, cur, allocated);
-                return;
-            }
+    dhcpv6_allocated_address_entry_t **heap;
+    uint8_t address[16];
+
+    if (libdhcpv6_address_index_grow(serverInfo) < 0) {
+        return -1;
+    }
+    if (serverInfo->allocatedAddressCount == serverInfo->expiryHeapSize) {
+        heap = realloc(serverInfo->expiryHeap, (serverInfo->expiryHeapSize * 2 + 16) * sizeof(*heap));
+        if (!heap) {
+            return -1;
         }
+        serverInfo->expiryHeap = heap;
+        serverInfo->expiryHeapSize = serverInfo->expiryHeapSize * 2 + 16;
     }
+    libdhcpv6_expiry_heap_set(serverInfo, serverInfo->allocatedAddressCount++, allocated);
+    libdhcpv6_expiry_heap_sift(serverInfo, allocated->heapIndex);
+    ns_list_add_to_end(libdhcpv6_address_index_bucket(serverInfo, allocated->linkId, allocated->linkType), allocated);
+    libdhcpv6_allocated_address_write(address, allocated, serverInfo);
+    ns_list_add_to_end(libdhcpv6_address_address_index_bucket(serverInfo, address), allocated);
+    libdhcpv6_allocated_id_set(serverInfo, allocated->allocatedID, true);
     ns_list_add_to_end(&serverInfo->allocatedAddressList, allocated);
+    return 0;
 }
 
 void libdhcpv6_address_delete(dhcpv6_gua_server_entry_s *serverInfo, const uint8_t *address)
 {
     uint8_t device_address[16];
-    if (memcmp(serverInfo->guaPrefix, address, 8)) {
+    if (memcmp(serverInfo->guaPrefix, address, 8) || !serverInfo->allocatedAddressIndexSize) {
         return;
     }
 
-    ns_list_foreach_safe(dhcpv6_allocated_address_entry_t, cur, &serverInfo->allocatedAddressList) {
+    ns_list_foreach(dhcpv6_allocated_address_entry_t, cur, libdhcpv6_address_address_index_bucket(serverInfo, address)) {
         libdhcpv6_allocated_address_write(device_address, cur, serverInfo);
         if (memcmp(address, device_address, 16) == 0) {
             libdhcpv6_address_list_entry_free(serverInfo, cur);
@@ -342,6 +552,19 @@ void libdhcpv6_address_delete(dhcpv6_gua_server_entry_s *serverInfo, const uint8
     }
 }
 
+static dhcpv6_allocated_address_entry_t *libdhcpv6_address_entry_find(dhcpv6_gua_server_entry_s *serverInfo, const uint8_t *linkId, uint16_t linkType)
+{
+    if (!serverInfo->allocatedAddressIndexSize) {
+        return NULL;
+    }
+    ns_list_foreach(dhcpv6_allocated_address_entry_t, cur, libdhcpv6_address_index_bucket(serverInfo, linkId, linkType)) {
+        if (cur->linkType == linkType && memcmp(cur->linkId, linkId, libdhcpv6_link_id_length(linkType)) == 0) {
+            return cur;
+        }
+    }
+    return NULL;
+}
+
 static dhcpv6_allocated_address_entry_t *libdhcpv6_address_list_entry_create(dhcpv6_gua_server_entry_s *serverInfo, dhcpv6_allocated_address_entry_t *source)
 {
     dhcpv6_allocated_address_entry_t *entry;
@@ -353,7 +576,10 @@ static dhcpv6_allocated_address_entry_t *libdhcpv6_address_list_entry_create(dhc
     }
 
     *entry = *source;
-    libdhcpv6_address_list_entry_add_to_list(serverInfo, entry);
+    if (libdhcpv6_address_list_entry_add_to_list(serverInfo, entry) < 0) {
+        free(entry);
+        return NULL;
+    }
     return entry;
 }
 
@@ -361,28 +587,25 @@ static dhcpv6_allocated_address_entry_t *libdhcpv6_address_list_entry_create(dhc
 dhcpv6_allocated_address_t *libdhcpv6_address_allocate(dhcpv6_gua_server_entry_s *serverInfo, uint8_t *linkId, uint16_t linkType, uint32_t iaID, uint32_t T0, uint32_t T1, bool allocateNew)
 {
     dhcpv6_allocated_address_entry_t newEntry;
-    uint16_t duiLength = 6;
-    if (linkType == DHCPV6_DUID_HARDWARE_EUI64_TYPE ||
-            linkType == DHCPV6_DUID_HARDWARE_IEEE_802_NETWORKS_TYPE) {
-        duiLength = 8;
-    }
+    dhcpv6_allocated_address_entry_t *cur;
+    uint16_t duiLength = libdhcpv6_link_id_length(linkType);
 
     // Search if we have old address in list
-    ns_list_foreach(dhcpv6_allocated_address_entry_t, cur, &serverInfo->allocatedAddressList) {
-        if (cur->linkType == linkType && memcmp(cur->linkId, linkId, duiLength) == 0) {
-            cur->iaID = iaID;
-            cur->T0 = T0;
-            cur->T1 = T1;
-            libdhcpv6_address_entry_lifetime_set(cur, serverInfo->validLifetime);
-            libdhcpv6_generate_address_entry(&serverInfo->tempAddressEntry, cur, serverInfo);
-            return &serverInfo->tempAddressEntry;
-        }
+    cur = libdhcpv6_address_entry_find(serverInfo, linkId, linkType);
+    if (cur) {
+        cur->iaID = iaID;
+        cur->T0 = T0;
+        cur->T1 = T1;
+        libdhcpv6_address_entry_lifetime_set(cur, serverInfo->validLifetime);
+        libdhcpv6_expiry_heap_sift(serverInfo, cur->heapIndex);
+        libdhcpv6_generate_address_entry(&serverInfo->tempAddressEntry, cur, serverInfo);
+        return &serverInfo->tempAddressEntry;
     }
     if (!allocateNew) {
         return NULL;
     }
 
-    if (ns_list_count(&serverInfo->allocatedAddressList) >= serverInfo->maxSupportedClients) {
+    if (serverInfo->allocatedAddressCount >= serverInfo->maxSupportedClients) {
         // Maximum supported clients reached
         return NULL;
     }
@@ -398,11 +621,16 @@ dhcpv6_allocated_address_t *libdhcpv6_address_allocate(dhcpv6_gua_server_entry_s
     if (serverInfo->anonymousAddress) {
         // Generate anonymous address id
         newEntry.allocatedID = libdhcpv6_address_id_allocate(serverInfo);
+        if (!newEntry.allocatedID) {
+            return NULL;
+        }
     }
 
     if (!serverInfo->disableAddressList) {
         // Create new List item and add to list
-        libdhcpv6_address_list_entry_create(serverInfo, &newEntry);
+        if (!libdhcpv6_address_list_entry_create(serverInfo, &newEntry)) {
+            return NULL;
+        }
     }
 
     libdhcpv6_generate_address_entry(&serverInfo->tempAddressEntry, &newEntry, serverInfo);
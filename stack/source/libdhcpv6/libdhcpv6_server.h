@@ -33,6 +33,7 @@
 
 #define MAX_SUPPORTED_ADDRESS_LIST_SIZE 0x0000fffd
 #define DHCP_ADDRESS_ID_START 2
+#define DHCP_ADDRESS_INDEX_SIZE_MIN 16 //Hash buckets allocated with the first address
 
 typedef void (dhcp_address_prefer_remove_cb)(int8_t interfaceId, uint8_t *targetAddress, void *prefix_info);
 typedef uint8_t *(dhcp_vendor_data_cb)(int8_t interfaceId, uint8_t *ptr, uint16_t *dhcp_vendor_data_len);
@@ -42,10 +43,13 @@ typedef struct dhcpv6_allocated_address_entry_s {
     uint32_t            iaID;
     uint32_t            T0;
     uint32_t            T1;
-    uint32_t            preferredLifetime;
-    uint32_t            lifetime;
+    uint64_t            preferredExpiry;    /*!< Server time when the address is no longer preferred, 0 if passed */
+    uint64_t            expiry;             /*!< Server time when the address is released */
+    uint32_t            heapIndex;          /*!< Position in the expiry heap of the server */
     uint16_t            linkType;
     uint16_t            allocatedID;
+    ns_list_link_t      indexLink;          /*!< Link entry in the link ID hash bucket */
+    ns_list_link_t      addressIndexLink;   /*!< Link entry in the address hash bucket */
     ns_list_link_t      link;               /*!< List link entry */
 } dhcpv6_allocated_address_entry_t;
 
@@ -77,6 +81,8 @@ typedef struct dhcpv6_allocated_address_s {
 
 
 typedef NS_LIST_HEAD(dhcpv6_allocated_address_entry_t, link) dhcpv6_allocated_address_list_t;
+typedef NS_LIST_HEAD(dhcpv6_allocated_address_entry_t, indexLink) dhcpv6_allocated_address_index_t;
+typedef NS_LIST_HEAD(dhcpv6_allocated_address_entry_t, addressIndexLink) dhcpv6_allocated_address_address_index_t;
 typedef NS_LIST_HEAD(dhcpv6_dns_server_data_t, link) dhcpv6_dns_server_list_t;
 typedef NS_LIST_HEAD(dhcpv6_vendor_data_t, link) dhcpv6_vendor_data_list_t;
 
@@ -104,6 +110,13 @@ typedef struct dhcpv6_gua_server_entry_s {
     dhcp_address_prefer_remove_cb   *removeCb;
     dhcp_address_add_notify_cb *addCb;
     dhcpv6_allocated_address_list_t allocatedAddressList;
+    uint32_t                        allocatedAddressCount;
+    dhcpv6_allocated_address_entry_t **expiryHeap; /*!< Allocated addresses, min-heap by next expiry */
+    uint32_t                        expiryHeapSize;
+    uint32_t                        *allocatedIdBitmap; /*!< Allocated IDs of the anonymous addresses, allocated on first use */
+    dhcpv6_allocated_address_index_t *allocatedAddressIndex; /*!< Allocated addresses by hash of link type and ID */
+    dhcpv6_allocated_address_address_index_t *allocatedAddressAddressIndex; /*!< Allocated addresses by hash of interface ID */
+    uint32_t                        allocatedAddressIndexSize; /*!< Number of buckets of both indexes, a power of 2 */
     dhcpv6_dns_server_list_t dnsServerList;
     dhcpv6_vendor_data_list_t vendorDataList;
     dhcpv6_allocated_address_t  tempAddressEntry;
@@ -117,6 +130,8 @@ void libdhcpv6_gua_server_free_by_prefix_and_interfaceid(uint8_t *prefix, int8_t
 void libdhcpv6_gua_servers_time_update(uint32_t timeUpdateInSeconds);
 void libdhcpv6_allocated_address_write(uint8_t *ptr, dhcpv6_allocated_address_entry_t *address, dhcpv6_gua_server_entry_s *serverInfo);
 void libdhcpv6_address_delete(dhcpv6_gua_server_entry_s *serverInfo, const uint8_t *address);
+// Must be called when the generation of the addresses changes (e.g. anonymousAddress)
+void libdhcpv6_address_index_rebuild(dhcpv6_gua_server_entry_s *serverInfo);
 dhcpv6_gua_server_entry_s *libdhcpv6_server_data_get_by_prefix_and_interfaceid(int8_t interfaceId, const uint8_t *prefixPtr);
 dhcpv6_gua_server_entry_s *libdhcpv6_server_data_get_by_prefix_and_socketinstance(uint16_t socketInstance, uint8_t *prefixPtr);
 dhcpv6_allocated_address_t *libdhcpv6_address_allocate(dhcpv6_gua_server_entry_s *serverInfo, uint8_t *euid64, uint16_t linkType, uint32_t iaID, uint32_t T0, uint32_t T1, bool allocateNew);
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include "common/trickle.h"
 #include "common/rand.h"
+#include "common/utils.h"
 #include "stack-services/ns_list.h"
 #include "stack-services/ns_trace.h"
 #include "stack-services/common_functions.h"
@@ -27,6 +28,7 @@
 #include "core/ns_buffer.h"
 #include "nwk_interface/protocol.h"
 #include "nwk_interface/protocol_timer.h"
+#include "nwk_interface/protocol_stats.h"
 #include "common_protocols/ipv6.h"
 #include "common_protocols/icmpv6.h"
 #include "6lowpan/mac/mac_helper.h"
@@ -49,8 +51,20 @@
 #define MAX_BUFFERED_MESSAGES_SIZE 8192
 #define MAX_BUFFERED_MESSAGE_LIFETIME 600 // 1/10 s ticks
 
+/* Buffered messages are stored in blocks of a few size classes, recycled
+ * through free lists. MAX_BUFFERED_MESSAGES_SIZE bounds the blocks held,
+ * free ones included, so bursts of multicast traffic do not hit the heap.
+ */
+static const uint16_t mpl_slab_class_size[] = {
+    128,    /* Control traffic, compressed in a single 802.15.4 frame */
+    256,
+    640,
+    1280,   /* IPv6 minimum MTU */
+};
+#define MPL_SLAB_CLASS_COUNT ARRAY_SIZE(mpl_slab_class_size)
+#define MPL_SLAB_OVERSIZE 0xFF /* Allocated to the exact size, not recycled */
+
 static bool mpl_timer_running;
-static uint16_t mpl_total_buffered;
 
 const trickle_params_t rfc7731_default_data_message_trickle_params = {
     .Imin = MPL_MS_TO_TICKS(512),   /* RFC 7731 says 10 * expected link latency; ZigBee IP says 512 ms */
@@ -72,9 +86,12 @@ const trickle_params_t rfc7731_default_control_message_trickle_params = {
 typedef struct mpl_data_message {
     bool running;
     bool colour;
+    uint8_t slab_class;
     uint32_t timestamp;
     trickle_t trickle;
-    ns_list_link_t link;
+    struct mpl_seed *seed;
+    ns_list_link_t link;            /* In the seed, or in the slab free list */
+    ns_list_link_t age_link;        /* In mpl_buffered_messages */
     uint16_t mpl_opt_data_offset;   /* offset to option data of MPL option */
     uint8_t message[];
 } mpl_buffered_message_t;
@@ -107,6 +124,14 @@ struct mpl_domain {
 };
 
 static NS_LIST_DEFINE(mpl_domains, mpl_domain_t, link);
+/* All buffered messages, oldest first */
+static NS_LIST_DEFINE(mpl_buffered_messages, mpl_buffered_message_t, age_link);
+
+static struct {
+    NS_LIST_HEAD(mpl_buffered_message_t, link) free[MPL_SLAB_CLASS_COUNT];
+    uint16_t held;                  /* Bytes of blocks allocated, free ones included */
+    uint16_t used;                  /* Bytes of blocks holding a message */
+} mpl_slab;
 
 static void mpl_buffer_delete(mpl_seed_t *seed, mpl_buffered_message_t *message);
 static void mpl_control_reset_or_start(mpl_domain_t *domain);
@@ -124,6 +149,10 @@ static void mpl_init(void)
     }
     mpl_initted = true;
 
+    for (int i = 0; i < MPL_SLAB_CLASS_COUNT; i++) {
+        ns_list_init(&mpl_slab.free[i]);
+    }
+
     ipv6_set_exthdr_provider(ROUTE_MPL, mpl_exthdr_provider);
 }
 
@@ -361,43 +390,112 @@ static mpl_buffered_message_t *mpl_buffer_lookup(mpl_seed_t *seed, uint8_t seque
 
 static void mpl_free_space(void)
 {
-    mpl_seed_t *oldest_seed = NULL;
-    mpl_buffered_message_t *oldest_message = NULL;
+    /* We'll free the oldest message, and those before it in its seed */
+    mpl_buffered_message_t *oldest_message = ns_list_get_first(&mpl_buffered_messages);
 
-    /* We'll free one message - earliest sequence number from one seed */
-    /* Choose which seed by looking at the timestamp - oldest one first */
-    ns_list_foreach(mpl_domain_t, domain, &mpl_domains) {
-        ns_list_foreach(mpl_seed_t, seed, &domain->seeds) {
-            mpl_buffered_message_t *message = ns_list_get_first(&seed->messages);
-            if (!message) {
-                continue;
-            }
-            if (!oldest_message ||
-                    protocol_core_monotonic_time - message->timestamp > protocol_core_monotonic_time - oldest_message->timestamp) {
-                oldest_message = message;
-                oldest_seed = seed;
-            }
+    if (!oldest_message) {
+        return;
+    }
+    protocol_stats_update(STATS_MPL_MESSAGE_EVICTED, 1);
+    mpl_seed_advance_min_sequence(oldest_message->seed, mpl_buffer_sequence(oldest_message) + 1);
+}
+
+static uint16_t mpl_slab_block_size(const mpl_buffered_message_t *message)
+{
+    if (message->slab_class == MPL_SLAB_OVERSIZE) {
+        return mpl_buffer_size(message);
+    }
+    return mpl_slab_class_size[message->slab_class];
+}
+
+/* Give a free block back to the heap, largest class first */
+static bool mpl_slab_release(void)
+{
+    for (int i = MPL_SLAB_CLASS_COUNT - 1; i >= 0; i--) {
+        mpl_buffered_message_t *message = ns_list_get_first(&mpl_slab.free[i]);
+        if (message) {
+            ns_list_remove(&mpl_slab.free[i], message);
+            mpl_slab.held -= mpl_slab_class_size[i];
+            protocol_stats_update(STATS_MPL_MEMORY_FREE, mpl_slab_class_size[i]);
+            free(message);
+            return true;
         }
     }
+    return false;
+}
 
-    if (!oldest_message) {
-        return;
+static mpl_buffered_message_t *mpl_slab_alloc(uint16_t ip_len)
+{
+    mpl_buffered_message_t *message;
+    uint8_t slab_class = MPL_SLAB_OVERSIZE;
+    uint16_t size = ip_len;
+
+    for (int i = 0; i < MPL_SLAB_CLASS_COUNT; i++) {
+        if (ip_len <= mpl_slab_class_size[i]) {
+            slab_class = i;
+            size = mpl_slab_class_size[i];
+            break;
+        }
+    }
+    if (size > MAX_BUFFERED_MESSAGES_SIZE) {
+        return NULL;
     }
 
-    oldest_seed->min_sequence = mpl_buffer_sequence(oldest_message) + 1;
-    mpl_buffer_delete(oldest_seed, oldest_message);
+    for (;;) {
+        if (slab_class != MPL_SLAB_OVERSIZE) {
+            message = ns_list_get_first(&mpl_slab.free[slab_class]);
+            if (message) {
+                ns_list_remove(&mpl_slab.free[slab_class], message);
+                break;
+            }
+        }
+        if (mpl_slab.held + size <= MAX_BUFFERED_MESSAGES_SIZE) {
+            message = malloc(sizeof(mpl_buffered_message_t) + size);
+            if (!message) {
+                return NULL;
+            }
+            message->slab_class = slab_class;
+            mpl_slab.held += size;
+            protocol_stats_update(STATS_MPL_MEMORY_ALLOC, size);
+            break;
+        }
+        /* Each pass either frees a block, or moves one to the free lists */
+        if (!mpl_slab_release()) {
+            tr_debug("MPL MAX buffered message size limit...free space");
+            mpl_free_space();
+        }
+    }
+    mpl_slab.used += size;
+    protocol_stats_update(STATS_MPL_MEMORY_USED, mpl_slab.used);
+    return message;
 }
 
+static void mpl_slab_free(mpl_buffered_message_t *message)
+{
+    uint16_t size = mpl_slab_block_size(message);
+
+    mpl_slab.used -= size;
+    protocol_stats_update(STATS_MPL_MEMORY_USED, mpl_slab.used);
+    if (message->slab_class == MPL_SLAB_OVERSIZE) {
+        mpl_slab.held -= size;
+        protocol_stats_update(STATS_MPL_MEMORY_FREE, size);
+        free(message);
+    } else {
+        ns_list_add_to_start(&mpl_slab.free[message->slab_class], message);
+    }
+}
 
 static mpl_buffered_message_t *mpl_buffer_create(buffer_t *buf, mpl_domain_t *domain, mpl_seed_t *seed, uint8_t sequence, uint8_t hop_limit)
 {
     /* IP layer ensures buffer length == IP length */
     uint16_t ip_len = buffer_data_length(buf);
+    mpl_buffered_message_t *message = mpl_slab_alloc(ip_len);
 
-    while (mpl_total_buffered + ip_len > MAX_BUFFERED_MESSAGES_SIZE) {
-        tr_debug("MPL MAX buffered message size limit...free space");
-        mpl_free_space();
+    if (!message) {
+        tr_debug("No heap for new MPL message");
+        return NULL;
     }
+    memcpy(message->message, buffer_data_pointer(buf), ip_len);
 
     /* As we came in, message sequence was >= min_sequence, but mpl_free_space
      * could end up pushing min_sequence forward. We must take care and
@@ -412,19 +510,15 @@ static mpl_buffered_message_t *mpl_buffer_create(buffer_t *buf, mpl_domain_t *do
      */
     if (common_serial_number_greater_8(seed->min_sequence, sequence)) {
         tr_debug("Can no longer accept %"PRIu8" < %"PRIu8, sequence, seed->min_sequence);
+        mpl_slab_free(message);
         return NULL;
     }
 
-    mpl_buffered_message_t *message = malloc(sizeof(mpl_buffered_message_t) + ip_len);
-    if (!message) {
-        tr_debug("No heap for new MPL message");
-        return NULL;
-    }
-    memcpy(message->message, buffer_data_pointer(buf), ip_len);
     message->message[IPV6_HDROFF_HOP_LIMIT] = hop_limit;
     message->mpl_opt_data_offset = buf->mpl_option_data_offset;
     message->colour = seed->colour;
     message->timestamp = protocol_core_monotonic_time;
+    message->seed = seed;
     /* Make sure trickle structure is initialised */
     trickle_start(&message->trickle, "MPL MSG", &domain->data_trickle_params);
     if (domain->proactive_forwarding) {
@@ -446,7 +540,7 @@ static mpl_buffered_message_t *mpl_buffer_create(buffer_t *buf, mpl_domain_t *do
     if (!inserted) {
         ns_list_add_to_start(&seed->messages, message);
     }
-    mpl_total_buffered += ip_len;
+    ns_list_add_to_end(&mpl_buffered_messages, message);
 
     /* Does MPL spec intend this distinction between start and reset? */
     mpl_control_reset_or_start(domain);
@@ -456,9 +550,9 @@ static mpl_buffered_message_t *mpl_buffer_create(buffer_t *buf, mpl_domain_t *do
 
 static void mpl_buffer_delete(mpl_seed_t *seed, mpl_buffered_message_t *message)
 {
-    mpl_total_buffered -= mpl_buffer_size(message);
     ns_list_remove(&seed->messages, message);
-    free(message);
+    ns_list_remove(&mpl_buffered_messages, message);
+    mpl_slab_free(message);
 }
 
 static void mpl_buffer_transmit(mpl_domain_t *domain, mpl_buffered_message_t *message, bool newest)
@@ -63,6 +63,7 @@ uint8_t check_power_state(uint8_t mode);
 void protocol_push(buffer_t *buf);
 void protocol_init(void);
 void protocol_core_init(void);
+uint32_t protocol_core_timer_next_expiry(void);
 
 #define INTERFACE_BOOTSTRAP_DEFINED     1
 #define INTERFACE_SECURITY_DEFINED      2
@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include "common/rand.h"
 #include "common/bits.h"
+#include "common/utils.h"
 #include "common/hal_interrupt.h"
 #include "stack-services/ns_trace.h"
 #include "stack-services/common_functions.h"
@@ -87,7 +88,7 @@ int protocol_core_buffers_in_event_queue;
 protocol_interface_info_entry_t *protocol_core_multicast_upstream;
 
 typedef struct {
-    uint8_t core_timer_ticks;
+    uint16_t core_timer_ticks;
     bool core_timer_event;
 } lowpan_core_timer_structures_s;
 
@@ -295,6 +296,47 @@ void protocol_core_cb(uint16_t ticksUpdate)
     }
 }
 
+/*
+ * Returns the number of protocol timer ticks before the core timer has
+ * something to do. Most of the fast timers count calls rather than time, so
+ * they are reported as due on the next core tick while they are active. The
+ * slow timers run at least once per second.
+ */
+uint32_t protocol_core_timer_next_expiry(void)
+{
+    uint32_t ticks = protocol_timer_next_expiry(PROTOCOL_TIMER_STACK_TIM);
+    uint32_t next = max(protocol_core_seconds_timer, 1);
+
+    if (ticks == UINT32_MAX || protocol_core_timer_info.core_timer_event)
+        return ticks;
+
+    ns_list_foreach(protocol_interface_info_entry_t, cur, &protocol_interface_info_list) {
+        if (cur->nwk_id == IF_6LoWPAN) {
+            if (cur->lowpan_info & INTERFACE_NWK_ACTIVE) {
+                if (cur->bootstrap_state_machine_cnt) {
+                    next = 1;
+                }
+                next = min(next, nd_object_timer_next_expiry(cur));
+                next = min(next, ws_common_fast_timer_next_expiry(cur));
+                next = min(next, lowpan_context_timer_next_expiry(&cur->lowpan_contexts));
+            }
+        } else if (cur->nwk_id == IF_IPV6) {
+            next = min(next, ipv6_core_timer_next_expiry(cur));
+        }
+
+        next = min(next, ipv6_neighbour_cache_fast_timer_next_expiry(&cur->ipv6_neighbour_cache));
+        next = min(next, addr_fast_timer_next_expiry(cur));
+        next = min(next, mld_fast_timer_next_expiry(cur));
+        if (cur->icmp_tokens < 10) {
+            next = 1;
+        }
+    }
+
+    next = min(next, rpl_control_fast_timer_next_expiry());
+    next = min(next, ws_pae_controller_fast_timer_next_expiry());
+    // PROTOCOL_TIMER_STACK_TIM is re-armed every 100ms (2 ticks)
+    return ticks + (next - 1) * 2;
+}
 
 void protocol_core_init(void)
 {
@@ -425,7 +467,7 @@ static void protocol_core_base_finish_init(protocol_interface_info_entry_t *entr
     ns_list_init(&entry->ip_groups_fwd);
     entry->ip_mcast_fwd_for_scope = IPV6_SCOPE_SITE_LOCAL; // Default for backwards compatibility
 #endif
-    ns_list_init(&entry->ipv6_neighbour_cache.list);
+    ipv6_neighbour_cache_alloc(&entry->ipv6_neighbour_cache);
 }
 
 static protocol_interface_info_entry_t *protocol_interface_class_allocate(nwk_interface_id_e nwk_id)
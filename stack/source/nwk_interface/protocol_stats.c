@@ -160,6 +160,27 @@ void protocol_stats_update(nwk_stats_type_t type, uint16_t update_val)
                     nwk_stats_ptr->adapt_layer_tx_latency_max = update_val;
                 }
                 break;
+            case STATS_MPL_MEMORY_ALLOC:
+                nwk_stats_ptr->mpl_total_memory += update_val;
+                break;
+            case STATS_MPL_MEMORY_FREE:
+                nwk_stats_ptr->mpl_total_memory -= update_val;
+                break;
+            case STATS_MPL_MEMORY_USED:
+                nwk_stats_ptr->mpl_used_memory = update_val;
+                break;
+            case STATS_MPL_MESSAGE_EVICTED:
+                nwk_stats_ptr->mpl_message_evicted += update_val;
+                break;
+            case STATS_LLC_MESSAGE_POOL_USED:
+                nwk_stats_ptr->llc_message_pool_used = update_val;
+                if (nwk_stats_ptr->llc_message_pool_used > nwk_stats_ptr->llc_message_pool_peak) {
+                    nwk_stats_ptr->llc_message_pool_peak = nwk_stats_ptr->llc_message_pool_used;
+                }
+                break;
+            case STATS_LLC_MESSAGE_POOL_OVERFLOW:
+                nwk_stats_ptr->llc_message_pool_overflow += update_val;
+                break;
         }
     }
 }
@@ -46,7 +46,13 @@ typedef enum {
     STATS_ETX_2ND_PARENT,
     STATS_AL_TX_QUEUE_SIZE,
     STATS_AL_TX_CONGESTION_DROP,
-    STATS_AL_TX_LATENCY
+    STATS_AL_TX_LATENCY,
+    STATS_MPL_MEMORY_ALLOC,
+    STATS_MPL_MEMORY_FREE,
+    STATS_MPL_MEMORY_USED,
+    STATS_MPL_MESSAGE_EVICTED,
+    STATS_LLC_MESSAGE_POOL_USED,
+    STATS_LLC_MESSAGE_POOL_OVERFLOW
 
 } nwk_stats_type_t;
 
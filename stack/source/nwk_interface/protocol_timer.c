@@ -80,3 +80,15 @@ void protocol_timer_cb(uint16_t ticks)
         }
     }
 }
+
+// Returns the number of ticks before the protocol timer expires
+uint32_t protocol_timer_next_expiry(protocol_timer_id_e id)
+{
+    uint32_t ret = UINT32_MAX;
+
+    platform_enter_critical();
+    if (protocol_timer[id].ticks)
+        ret = protocol_timer[id].ticks;
+    platform_exit_critical();
+    return ret;
+}
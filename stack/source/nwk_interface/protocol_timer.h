@@ -34,5 +34,6 @@ typedef struct {
 void protocol_timer_cb(uint16_t ticks);
 void protocol_timer_start(protocol_timer_id_e id, void (*passed_fptr)(uint16_t), uint32_t time_ms);
 void protocol_timer_stop(protocol_timer_id_e id);
+uint32_t protocol_timer_next_expiry(protocol_timer_id_e id);
 
 #endif
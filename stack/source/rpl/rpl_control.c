@@ -78,6 +78,7 @@ void rpl_control_set_memory_limits(size_t soft_limit, size_t hard_limit)
  * limiting RPL allocations. Allocation rejected if total would go above the
  * hard limit rpl_alloc_limit. This should normally be avoided by the timers
  * trying to keep allocations below the soft limit rpl_purge_threshold.
+ * Like realloc(), the original block is left untouched on failure.
  */
 void *rpl_realloc(void *p, uint16_t old_size, uint16_t new_size)
 {
@@ -102,10 +103,10 @@ void *rpl_realloc(void *p, uint16_t old_size, uint16_t new_size)
         if (p) {
             memcpy(n, p, old_size < new_size ? old_size : new_size);
         }
+        rpl_free(p, old_size);
     } else {
         protocol_stats_update(STATS_RPL_MEMORY_OVERFLOW, new_size);
     }
-    rpl_free(p, old_size);
     return n;
 }
 
@@ -1857,6 +1858,26 @@ void rpl_control_fast_timer(uint16_t ticks)
 
 }
 
+uint32_t rpl_control_fast_timer_next_expiry(void)
+{
+    uint32_t ret = UINT32_MAX;
+    uint32_t next;
+
+    ns_list_foreach(rpl_domain_t, domain, &rpl_domains) {
+        ns_list_foreach(rpl_instance_t, instance, &domain->instances) {
+            next = rpl_upward_dio_timer_next_expiry(instance);
+            if (next < ret) {
+                ret = next;
+            }
+            next = rpl_downward_dao_timer_next_expiry(instance);
+            if (next < ret) {
+                ret = next;
+            }
+        }
+    }
+    return ret;
+}
+
 #if 0
 static void trace_info_print(const char *fmt, ...)
 {
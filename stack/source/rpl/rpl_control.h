@@ -123,6 +123,8 @@ void rpl_control_set_memory_limits(size_t soft_limit, size_t hard_limit);
 
 /* Timer routines */
 void rpl_control_fast_timer(uint16_t ticks);
+// Number of ticks before rpl_control_fast_timer() has something to do
+uint32_t rpl_control_fast_timer_next_expiry(void);
 void rpl_control_slow_timer(uint16_t seconds);
 
 /* Packet handlers, and other data flow callback indications */
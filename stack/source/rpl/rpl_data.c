@@ -28,6 +28,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include "stack-services/common_functions.h"
+#include "stack-services/ns_list.h"
 #include "stack-services/ns_trace.h"
 
 #include "core/ns_buffer.h"
@@ -48,16 +49,41 @@
 #define TRACE_GROUP "RPLa"
 
 #define RPL_DATA_SR_INIT_SIZE (16*4)
+#define RPL_DATA_SR_CACHE_SIZE 32
+#define RPL_DATA_SR_CACHE_BUCKETS 64
 
 #ifdef HAVE_RPL_ROOT
+typedef struct rpl_srh_info {
+    uint8_t hlen;
+    uint8_t segments;
+    uint8_t cmprI;
+    uint8_t cmprE;
+    uint8_t pad;
+} rpl_srh_info_t;
+
+/* The root keeps the last computed source routes in a LRU cache, so traffic
+ * interleaving destinations does not redo the path walk for every packet.
+ * Entries are only valid for the generation they were computed in, which is
+ * bumped by rpl_data_sr_invalidate().
+ */
 typedef struct rpl_data_sr {
-    rpl_dao_target_t *target;   /* Target - note may be a prefix */
+    rpl_dao_target_t *target;   /* Target - note may be a prefix, NULL if entry unused */
+    uint32_t generation;
     uint16_t iaddr_size;
     uint8_t ihops;          /* Number of intermediate hops (= addresses in SRH) */
-    uint8_t final_dest[16]; /* Final destination (used only temporarily during header construction) */
-    uint8_t iaddr[];        /* Intermediate address list is built backwards, contiguous with final_dest */
+    uint8_t srh_hops;       /* Number of hops used to compute srh_info, 0 if not computed */
+    rpl_srh_info_t srh_info;
+    uint8_t *final_dest;    /* Final destination, iaddr_size + 16 bytes allocated */
+    uint8_t *iaddr;         /* Intermediate address list is built backwards, contiguous with final_dest */
+    ns_list_link_t link;
+    ns_list_link_t bucket_link;
 } rpl_data_sr_t;
 
+static NS_LIST_DEFINE(rpl_data_sr_lru, rpl_data_sr_t, link);
+static NS_LIST_HEAD(rpl_data_sr_t, bucket_link) rpl_data_sr_buckets[RPL_DATA_SR_CACHE_BUCKETS];
+static rpl_data_sr_t rpl_data_sr_cache[RPL_DATA_SR_CACHE_SIZE];
+static uint32_t rpl_data_sr_generation;
+/* Entry of the last call to rpl_data_compute_source_route() */
 static rpl_data_sr_t *rpl_data_sr;
 #endif
 
@@ -701,17 +727,64 @@ not_forwarding_error:
 }
 
 #ifdef HAVE_RPL_ROOT
+static unsigned int rpl_data_sr_bucket_index(const rpl_dao_target_t *target)
+{
+    uintptr_t key = (uintptr_t)target;
+
+    // Targets are allocated with at least 8 bytes alignment
+    key >>= 3;
+    return (key ^ (key >> 6) ^ (key >> 12)) % RPL_DATA_SR_CACHE_BUCKETS;
+}
+
+static rpl_data_sr_t *rpl_data_sr_cache_lookup(const uint8_t *final_dest, const rpl_dao_target_t *target)
+{
+    static bool init = false;
+
+    if (!init) {
+        for (int i = 0; i < RPL_DATA_SR_CACHE_BUCKETS; i++)
+            ns_list_init(&rpl_data_sr_buckets[i]);
+        for (int i = 0; i < RPL_DATA_SR_CACHE_SIZE; i++)
+            ns_list_add_to_end(&rpl_data_sr_lru, &rpl_data_sr_cache[i]);
+        init = true;
+    }
+    ns_list_foreach(rpl_data_sr_t, sr, &rpl_data_sr_buckets[rpl_data_sr_bucket_index(target)]) {
+        if (sr->target == target && sr->generation == rpl_data_sr_generation &&
+            addr_ipv6_equal(sr->final_dest, final_dest)) {
+            return sr;
+        }
+    }
+    return NULL;
+}
+
+/* Recycle the least recently used entry */
+static rpl_data_sr_t *rpl_data_sr_cache_evict(void)
+{
+    rpl_data_sr_t *sr = ns_list_get_last(&rpl_data_sr_lru);
+
+    if (sr->target) {
+        ns_list_remove(&rpl_data_sr_buckets[rpl_data_sr_bucket_index(sr->target)], sr);
+        sr->target = NULL;
+    }
+    if (!sr->final_dest) {
+        sr->final_dest = rpl_alloc(16 + RPL_DATA_SR_INIT_SIZE);
+        if (!sr->final_dest) {
+            return NULL;
+        }
+        sr->iaddr = sr->final_dest + 16;
+        sr->iaddr_size = RPL_DATA_SR_INIT_SIZE;
+    }
+    sr->ihops = 0;
+    sr->srh_hops = 0;
+    return sr;
+}
+
 /* TODO - every target involved here should be non-External. Add checks */
 static bool rpl_data_compute_source_route(const uint8_t *final_dest, rpl_dao_target_t *const target)
 {
-    if (!rpl_data_sr) {
-        rpl_data_sr = rpl_alloc(sizeof(rpl_data_sr_t) + RPL_DATA_SR_INIT_SIZE);
-        if (!rpl_data_sr) {
-            return false;
-        }
-        rpl_data_sr->iaddr_size = RPL_DATA_SR_INIT_SIZE;
-        rpl_data_sr->target = NULL;
-    } else if (rpl_data_sr->target == target && addr_ipv6_equal(rpl_data_sr->final_dest, final_dest)) {
+    rpl_data_sr = rpl_data_sr_cache_lookup(final_dest, target);
+    if (rpl_data_sr) {
+        ns_list_remove(&rpl_data_sr_lru, rpl_data_sr);
+        ns_list_add_to_start(&rpl_data_sr_lru, rpl_data_sr);
         return true;
     }
 
@@ -724,9 +797,11 @@ static bool rpl_data_compute_source_route(const uint8_t *final_dest, rpl_dao_tar
         return false;
     }
 
-    /* Wipe the "data valid" marker */
-    rpl_data_sr->target = NULL;
-    rpl_data_sr->ihops = 0;
+    /* Entry is unused (no "data valid" marker) until the path is complete */
+    rpl_data_sr = rpl_data_sr_cache_evict();
+    if (!rpl_data_sr) {
+        return false;
+    }
 
     /* Final destination written explicitly (last target could be a prefix) */
     memcpy(rpl_data_sr->final_dest, final_dest, 16);
@@ -743,6 +818,10 @@ static bool rpl_data_compute_source_route(const uint8_t *final_dest, rpl_dao_tar
         if (parent == NULL) {
             /* Mark "valid" */
             rpl_data_sr->target = target;
+            rpl_data_sr->generation = rpl_data_sr_generation;
+            ns_list_add_to_start(&rpl_data_sr_buckets[rpl_data_sr_bucket_index(target)], rpl_data_sr);
+            ns_list_remove(&rpl_data_sr_lru, rpl_data_sr);
+            ns_list_add_to_start(&rpl_data_sr_lru, rpl_data_sr);
             return true;
         }
         if (!parent->connected) {
@@ -759,10 +838,12 @@ static bool rpl_data_compute_source_route(const uint8_t *final_dest, rpl_dao_tar
         }
         /* Increase size of table if necessary */
         if (16 * (rpl_data_sr->ihops + 1) > rpl_data_sr->iaddr_size) {
-            rpl_data_sr = rpl_realloc(rpl_data_sr, sizeof(rpl_data_sr_t) + rpl_data_sr->iaddr_size, sizeof(rpl_data_sr_t) + 2 * rpl_data_sr->iaddr_size);
-            if (!rpl_data_sr) {
+            uint8_t *final_dest = rpl_realloc(rpl_data_sr->final_dest, 16 + rpl_data_sr->iaddr_size, 16 + 2 * rpl_data_sr->iaddr_size);
+            if (!final_dest) {
                 return false;
             }
+            rpl_data_sr->final_dest = final_dest;
+            rpl_data_sr->iaddr = final_dest + 16;
             rpl_data_sr->iaddr_size *= 2;
         }
         memcpy(rpl_data_sr->iaddr + 16 * rpl_data_sr->ihops, transit->transit, 16);
@@ -804,24 +885,16 @@ static bool rpl_data_route_next_hop(const uint8_t *dest, ipv6_route_info_t *rout
 
 void rpl_data_sr_invalidate(void)
 {
-    if (rpl_data_sr) {
-        rpl_data_sr->target = NULL;
-        rpl_data_sr->ihops = 0;
-    }
+    /* Entries of the previous generations will be recycled by
+     * rpl_data_sr_cache_evict().
+     */
+    rpl_data_sr_generation++;
     /* We could invalidate the next hops remembered in the system routing table.
      * but it's not necessary - recomputation happens every time. Does mean that
      * the routing table printout may contain stale info, though.
      */
 }
 
-typedef struct rpl_srh_info {
-    uint8_t hlen;
-    uint8_t segments;
-    uint8_t cmprI;
-    uint8_t cmprE;
-    uint8_t pad;
-} rpl_srh_info_t;
-
 /* Count matching bytes (max 15) for SRH compression */
 static uint_fast8_t rpl_data_matching_addr_bytes(const uint8_t *a, const uint8_t *b, uint_fast8_t len)
 {
@@ -834,7 +907,7 @@ static uint_fast8_t rpl_data_matching_addr_bytes(const uint8_t *a, const uint8_t
 
 static const rpl_srh_info_t *rpl_data_sr_compute_header_size(const uint8_t final_dest[16], uint8_t hop_limit)
 {
-    static rpl_srh_info_t info;
+    rpl_srh_info_t *info = &rpl_data_sr->srh_info;
     uint8_t hops = 1 + rpl_data_sr->ihops;
     if (hops > hop_limit) {
         hops = hop_limit;
@@ -842,6 +915,11 @@ static const rpl_srh_info_t *rpl_data_sr_compute_header_size(const uint8_t final
     if (hops <= 1) {
         return NULL;
     }
+    /* The header only depends on the number of hops included */
+    if (rpl_data_sr->srh_hops == hops) {
+        return info;
+    }
+    rpl_data_sr->srh_hops = hops;
     memcpy(rpl_data_sr->final_dest, final_dest, 16);
     /* first_hop is the address that will go into the IP destination */
     const uint8_t *first_hop = rpl_data_sr->iaddr + 16 * (rpl_data_sr->ihops - 1);
@@ -849,13 +927,13 @@ static const rpl_srh_info_t *rpl_data_sr_compute_header_size(const uint8_t final
     const uint8_t *addr = first_hop - 16;
 
     /* Must be at least 2 hops, so at least 1 segment in the SRH */
-    info.segments = hops - 1;
+    info->segments = hops - 1;
 
     /* First, scan for compression of all except last against initial destination */
     /* (CmprI bytes will remain unchanged at each hop, rest can change) */
-    info.cmprI = 15;
-    for (uint8_t seg = 0; seg < info.segments - 1; seg++) {
-        info.cmprI = rpl_data_matching_addr_bytes(addr, first_hop, info.cmprI);
+    info->cmprI = 15;
+    for (uint8_t seg = 0; seg < info->segments - 1; seg++) {
+        info->cmprI = rpl_data_matching_addr_bytes(addr, first_hop, info->cmprI);
         hops--;
         addr -= 16;
     }
@@ -888,20 +966,20 @@ static const rpl_srh_info_t *rpl_data_sr_compute_header_size(const uint8_t final
      * IP destination).
      *
      */
-    info.cmprE = rpl_data_matching_addr_bytes(addr, addr + 16, 15 /* info.cmprI */);
+    info->cmprE = rpl_data_matching_addr_bytes(addr, addr + 16, 15 /* info.cmprI */);
 
     uint16_t total_size;
 
-    total_size = (16 - info.cmprE) + (16 - info.cmprI) * (info.segments - 1);
+    total_size = (16 - info->cmprE) + (16 - info->cmprI) * (info->segments - 1);
     if (total_size & 7) {
-        info.pad = 8 - (total_size & 7);
-        total_size += info.pad;
+        info->pad = 8 - (total_size & 7);
+        total_size += info->pad;
     } else {
-        info.pad = 0;
+        info->pad = 0;
     }
-    info.hlen = total_size >> 3;
+    info->hlen = total_size >> 3;
 
-    return &info;
+    return info;
 }
 
 /*
@@ -82,6 +82,7 @@
 #include "common/bits.h"
 #include "common/rand.h"
 #include "app_wsbrd/dbus.h"
+#include "app_wsbrd/tun.h"
 #include "app_wsbrd/wsbr.h"
 #include "stack-services/common_functions.h"
 #include "stack-services/ns_list.h"
@@ -107,8 +108,14 @@
 
 #ifdef HAVE_RPL_ROOT
 static void rpl_downward_topo_sort_invalidate(rpl_instance_t *instance);
+static void rpl_downward_root_transit_added(rpl_dao_root_transit_t *transit);
+static void rpl_downward_root_transit_cost_changed(rpl_dao_root_transit_t *transit);
+static void rpl_downward_remove_root_transit(rpl_dao_root_transit_t *transit);
+static void rpl_downward_clear_root_transits(rpl_dao_target_t *target);
 #endif
 
+//#define RPL_DOWNWARD_PATHS_CHECK // Compare incremental path updates to a full computation (see test/)
+
 #define DEFAULT_DAO_DELAY 10 /* *100ms ticks = 1s */
 
 /* Bit <n> of the PC mask */
@@ -270,8 +277,97 @@ void rpl_downward_process_dao_parent_changes(rpl_instance_t *instance)
     }
 }
 
+static rpl_dao_target_t **rpl_dao_target_index_chain(rpl_dao_target_index_t *index, const uint8_t *prefix, uint8_t prefix_len)
+{
+    uint32_t hash = 2166136261u;
+
+    if (prefix_len != 128) {
+        return &index->prefixes;
+    }
+    for (int i = 0; i < 16; i++) {
+        hash ^= prefix[i];
+        hash *= 16777619u;
+    }
+    return &index->addresses[hash & (index->size - 1)];
+}
+
+static void rpl_dao_target_index_add(rpl_dao_target_index_t *index, rpl_dao_target_t *target)
+{
+    rpl_dao_target_t **next = rpl_dao_target_index_chain(index, target->prefix, target->prefix_len);
+
+    while (*next) {
+        next = &(*next)->index_next;
+    }
+    *next = target;
+    target->index_next = NULL;
+    if (target->prefix_len == 128) {
+        index->count++;
+    }
+}
+
+static void rpl_dao_target_index_remove(rpl_dao_target_index_t *index, rpl_dao_target_t *target)
+{
+    rpl_dao_target_t **next = rpl_dao_target_index_chain(index, target->prefix, target->prefix_len);
+
+    while (*next != target) {
+        next = &(*next)->index_next;
+    }
+    *next = target->index_next;
+    if (target->prefix_len == 128) {
+        index->count--;
+    }
+}
+
+static rpl_dao_target_index_t *rpl_dao_target_index_alloc(rpl_instance_t *instance, uint16_t size)
+{
+    rpl_dao_target_index_t *index = rpl_alloc(RPL_DAO_TARGET_INDEX_ALLOC_SIZE(size));
+
+    if (!index) {
+        return NULL;
+    }
+    memset(index, 0, RPL_DAO_TARGET_INDEX_ALLOC_SIZE(size));
+    index->size = size;
+    ns_list_foreach(rpl_dao_target_t, target, &instance->dao_targets) {
+        rpl_dao_target_index_add(index, target);
+    }
+    return index;
+}
+
+/* Only roots get the index, other nodes have a handful of targets */
+static bool rpl_dao_target_index_create(rpl_instance_t *instance)
+{
+    if (instance->dao_target_index) {
+        return true;
+    }
+    instance->dao_target_index = rpl_dao_target_index_alloc(instance, RPL_DAO_TARGET_INDEX_SIZE_MIN);
+    return instance->dao_target_index;
+}
+
+/* Double the buckets when there are more /128 targets than buckets. On
+ * allocation failure, the current index is kept with longer chains. */
+static void rpl_dao_target_index_grow(rpl_instance_t *instance)
+{
+    rpl_dao_target_index_t *index = instance->dao_target_index;
+    rpl_dao_target_index_t *new_index;
+
+    if (index->count <= index->size || index->size >= RPL_DAO_TARGET_INDEX_SIZE_MAX) {
+        return;
+    }
+    new_index = rpl_dao_target_index_alloc(instance, index->size * 2);
+    if (!new_index) {
+        return;
+    }
+    rpl_free(index, RPL_DAO_TARGET_INDEX_ALLOC_SIZE(index->size));
+    instance->dao_target_index = new_index;
+}
+
 rpl_dao_target_t *rpl_create_dao_target(rpl_instance_t *instance, const uint8_t *prefix, uint8_t prefix_len, bool root)
 {
+    if (root && !rpl_dao_target_index_create(instance)) {
+        tr_warn("RPL DAO overflow (target=%s)", trace_ipv6_prefix(prefix, prefix_len));
+        return NULL;
+    }
+
     rpl_dao_target_t *target = rpl_alloc(sizeof(rpl_dao_target_t));
     if (!target) {
         tr_warn("RPL DAO overflow (target=%s)", trace_ipv6_prefix(prefix, prefix_len));
@@ -291,6 +387,10 @@ rpl_dao_target_t *rpl_create_dao_target(rpl_instance_t *instance, const uint8_t
 #endif
 
     ns_list_add_to_end(&instance->dao_targets, target);
+    if (instance->dao_target_index) {
+        rpl_dao_target_index_add(instance->dao_target_index, target);
+        rpl_dao_target_index_grow(instance);
+    }
     return target;
 }
 
@@ -301,6 +401,9 @@ void rpl_delete_dao_target(rpl_instance_t *instance, rpl_dao_target_t *target)
     /* TODO - should send a No-Path to root */
 
     ns_list_remove(&instance->dao_targets, target);
+    if (instance->dao_target_index) {
+        rpl_dao_target_index_remove(instance->dao_target_index, target);
+    }
 
 #ifdef HAVE_RPL_ROOT
     if (target->root) {
@@ -310,6 +413,10 @@ void rpl_delete_dao_target(rpl_instance_t *instance, rpl_dao_target_t *target)
         }
         ipv6_route_table_remove_info(-1, ROUTE_RPL_DAO_SR, target);
         rpl_downward_topo_sort_invalidate(target->instance);
+        // FIXME: do not include app_wsbrd
+        if (target->prefix_len == 128 && !target->published) {
+            tun_del_node(target->prefix);
+        }
     }
 #endif
     rpl_free(target, sizeof * target);
@@ -317,6 +424,16 @@ void rpl_delete_dao_target(rpl_instance_t *instance, rpl_dao_target_t *target)
 
 rpl_dao_target_t *rpl_instance_lookup_published_dao_target(rpl_instance_t *instance, const uint8_t *prefix, uint8_t prefix_len)
 {
+    if (instance->dao_target_index) {
+        for (rpl_dao_target_t *target = *rpl_dao_target_index_chain(instance->dao_target_index, prefix, prefix_len);
+                target; target = target->index_next) {
+            if (target->published && target->prefix_len == prefix_len &&
+                    !bitcmp(target->prefix, prefix, prefix_len)) {
+                return target;
+            }
+        }
+        return NULL;
+    }
     ns_list_foreach(rpl_dao_target_t, target, &instance->dao_targets) {
         if (target->published && target->prefix_len == prefix_len &&
                 !bitcmp(target->prefix, prefix, prefix_len)) {
@@ -328,6 +445,16 @@ rpl_dao_target_t *rpl_instance_lookup_published_dao_target(rpl_instance_t *insta
 
 rpl_dao_target_t *rpl_instance_lookup_dao_target(rpl_instance_t *instance, const uint8_t *prefix, uint8_t prefix_len)
 {
+    if (instance->dao_target_index) {
+        for (rpl_dao_target_t *target = *rpl_dao_target_index_chain(instance->dao_target_index, prefix, prefix_len);
+                target; target = target->index_next) {
+            if (target->prefix_len == prefix_len &&
+                    !bitcmp(target->prefix, prefix, prefix_len)) {
+                return target;
+            }
+        }
+        return NULL;
+    }
     ns_list_foreach(rpl_dao_target_t, target, &instance->dao_targets) {
         if (target->prefix_len == prefix_len &&
                 !bitcmp(target->prefix, prefix, prefix_len)) {
@@ -342,6 +469,23 @@ rpl_dao_target_t *rpl_instance_match_dao_target(rpl_instance_t *instance, const
     rpl_dao_target_t *longest = NULL;
     int_fast16_t longest_len = -1;
 
+    if (instance->dao_target_index) {
+        /* An exact /128 match is the longest, otherwise only shorter prefixes can match */
+        if (prefix_len == 128) {
+            longest = rpl_instance_lookup_dao_target(instance, prefix, prefix_len);
+            if (longest) {
+                return longest;
+            }
+        }
+        for (rpl_dao_target_t *target = instance->dao_target_index->prefixes; target; target = target->index_next) {
+            if (target->prefix_len >= longest_len && target->prefix_len <= prefix_len &&
+                    !bitcmp(target->prefix, prefix, target->prefix_len)) {
+                longest = target;
+                longest_len = target->prefix_len;
+            }
+        }
+        return longest;
+    }
     ns_list_foreach(rpl_dao_target_t, target, &instance->dao_targets) {
         if (target->prefix_len >= longest_len && target->prefix_len <= prefix_len &&
                 !bitcmp(target->prefix, prefix, target->prefix_len)) {
@@ -962,14 +1106,13 @@ static uint_fast8_t rpl_downward_path_control_to_preference(uint8_t pc)
 
 static rpl_dao_root_transit_t *rpl_downward_add_root_transit(rpl_dao_target_t *target, const uint8_t parent[16], uint8_t path_control)
 {
-    //rpl_dao_root_transit_t *old_first = ns_list_get_first(&target->info.root.transits);
     rpl_dao_root_transit_t *transit = NULL;
+    bool new_transit = false;
+    uint16_t cost;
+
     ns_list_foreach(rpl_dao_root_transit_t, t, &target->info.root.transits) {
         if (addr_ipv6_equal(t->transit, parent)) {
-            ns_list_remove(&target->info.root.transits, t);
             transit = t;
-            /* Updating existing transit - invalidates costs only */
-            rpl_downward_paths_invalidate(target->instance);
             break;
         }
     }
@@ -981,8 +1124,9 @@ static rpl_dao_root_transit_t *rpl_downward_add_root_transit(rpl_dao_target_t *t
             goto out;
         }
         transit->path_control = 0;
-        /* A new transit invalidates the topo sort */
-        rpl_downward_topo_sort_invalidate(target->instance);
+        transit->parent = NULL;
+        transit->linked = false;
+        new_transit = true;
     }
 
     transit->target = target;
@@ -992,10 +1136,18 @@ static rpl_dao_root_transit_t *rpl_downward_add_root_transit(rpl_dao_target_t *t
      * directly connected nodes, rpl_downward_compute_paths asks policy
      * to modify according to ETX (or whatever).
      */
-    transit->cost = rpl_downward_path_control_to_preference(transit->path_control);
+    cost = rpl_downward_path_control_to_preference(transit->path_control);
 
-    memcpy(transit->transit, parent, 16);
-    ns_list_add_to_end(&target->info.root.transits, transit);
+    if (new_transit) {
+        transit->cost = cost;
+        memcpy(transit->transit, parent, 16);
+        ns_list_add_to_end(&target->info.root.transits, transit);
+        rpl_downward_root_transit_added(transit);
+    } else if (transit->cost != cost) {
+        /* Updating existing transit - changes costs only */
+        transit->cost = cost;
+        rpl_downward_root_transit_cost_changed(transit);
+    }
 
 out:
     return ns_list_get_first(&target->info.root.transits);
@@ -1003,14 +1155,12 @@ out:
 
 static rpl_dao_target_t *rpl_downward_delete_root_transit(rpl_dao_target_t *target, rpl_dao_root_transit_t *transit)
 {
-    ns_list_remove(&target->info.root.transits, transit);
-    rpl_free(transit, sizeof * transit);
-    if (ns_list_is_empty(&target->info.root.transits)) {
+    if (ns_list_get_first(&target->info.root.transits) == ns_list_get_last(&target->info.root.transits)) {
         rpl_delete_dao_target(target->instance, target);
         return NULL;
     }
 
-    rpl_downward_topo_sort_invalidate(target->instance);
+    rpl_downward_remove_root_transit(transit);
     return target;
 }
 
@@ -1033,7 +1183,7 @@ void rpl_downward_transit_error(rpl_instance_t *instance, const uint8_t *target_
                 } else {
                     transit->cost = 0xFFFF;
                 }
-                rpl_downward_paths_invalidate(instance);
+                rpl_downward_root_transit_cost_changed(transit);
                 instance->srh_error_count++;
                 if (rpl_policy_dao_trigger_after_srh_error(instance->domain, (protocol_core_monotonic_time - instance->last_dao_trigger_time) / 10, instance->srh_error_count, ns_list_count(&instance->dao_targets))) {
                     rpl_instance_increment_dtsn(instance);
@@ -1149,10 +1299,7 @@ static bool rpl_downward_process_targets_for_transit(rpl_dodag_t *dodag, bool st
                     /* If path sequence is different, we clear existing transits for this target */
                     if (!(seq_cmp & RPL_CMP_EQUAL)) {
                         if (target->root) {
-                            ns_list_foreach_safe(rpl_dao_root_transit_t, transit, &target->info.root.transits) {
-                                ns_list_remove(&target->info.root.transits, transit);
-                                rpl_free(transit, sizeof * transit);
-                            }
+                            rpl_downward_clear_root_transits(target);
                         }
                         if (storing) {
                             ipv6_route_table_remove_info(-1, ROUTE_RPL_DAO, target);
@@ -1244,6 +1391,8 @@ static bool rpl_downward_process_targets_for_transit(rpl_dodag_t *dodag, bool st
  * and instance::root_children    := list of transits with this target/root as parent
  *
  *     target::info.root.cost := number of transits connected to parent targets (connections to root not included)
+ *
+ *     transit::linked   := true if the transit is in a children list
  */
 static void rpl_downward_link_transits_to_targets(rpl_instance_t *instance)
 {
@@ -1251,6 +1400,7 @@ static void rpl_downward_link_transits_to_targets(rpl_instance_t *instance)
     ns_list_foreach(rpl_dao_target_t, target, &instance->dao_targets) {
         target->info.root.cost = 0;
         target->connected = false;
+        target->path_affected = false;
         ns_list_init(&target->info.root.children);
     }
     ns_list_foreach(rpl_dao_target_t, target, &instance->dao_targets) {
@@ -1258,11 +1408,13 @@ static void rpl_downward_link_transits_to_targets(rpl_instance_t *instance)
             if (protocol_interface_address_compare(transit->transit) == 0) {
                 /* It points to us (the DODAG root) - mark this with NULL */
                 transit->parent = NULL;
+                transit->linked = true;
                 target->connected = true;
                 /* Links to the root don't count as incoming transits */
                 ns_list_add_to_end(&instance->root_children, transit);
             } else {
                 transit->parent = rpl_instance_match_dao_target(instance, transit->transit, 128);
+                transit->linked = transit->parent != NULL;
                 if (transit->parent) {
                     target->info.root.cost++;
                     ns_list_add_to_end(&transit->parent->info.root.children, transit);
@@ -1362,6 +1514,7 @@ kill_candidate:
 
     /* This removes it from our routing graph, but not from the master database */
     ns_list_remove(&kill_transit->parent->info.root.children, kill_transit);
+    kill_transit->linked = false;
     rpl_downward_topo_sort_edge_removed(kill_transit, graph, top_nodes);
 }
 
@@ -1373,6 +1526,8 @@ static void rpl_downward_topo_sort(rpl_instance_t *instance)
     }
 
     rpl_downward_link_transits_to_targets(instance);
+    instance->root_topo_sort_loop = false;
+    instance->root_topo_sort_stale = false;
 
     rpl_dao_target_list_t sorted = NS_LIST_INIT(sorted);
     rpl_dao_target_list_t top_nodes = NS_LIST_INIT(top_nodes);
@@ -1412,6 +1567,7 @@ retry_after_loop_break:
         do {
             rpl_downward_topo_sort_break_loop(&instance->dao_targets, &top_nodes);
         } while (ns_list_is_empty(&top_nodes));
+        instance->root_topo_sort_loop = true;
         goto retry_after_loop_break;
     }
 
@@ -1427,15 +1583,23 @@ static void rpl_downward_topo_sort_invalidate(rpl_instance_t *instance)
     rpl_downward_paths_invalidate(instance);
 }
 
-static void rpl_downward_update_path_cost_to_children(rpl_dao_root_transit_children_list_t *children, uint16_t parent_cost)
+static uint16_t rpl_downward_transit_cost(rpl_dao_root_transit_t *transit, uint32_t parent_cost)
+{
+    rpl_dao_target_t *child = transit->target;
+
+    /* For directly-connected paths, modify for ETX or similar */
+    if (parent_cost == 0 && child->prefix_len == 128) {
+        return rpl_policy_modify_downward_cost_to_root_neighbour(child->instance->domain, child->interface_id, child->prefix, transit->cost);
+    }
+    return transit->cost;
+}
+
+static void rpl_downward_update_path_cost_to_children(rpl_dao_root_transit_children_list_t *children, uint32_t parent_cost)
 {
     ns_list_foreach(rpl_dao_root_transit_t, transit, children) {
         rpl_dao_target_t *child = transit->target;
-        uint16_t transit_cost = transit->cost;
-        /* For directly-connected paths, modify for ETX or similar */
-        if (parent_cost == 0 && child->prefix_len == 128) {
-            transit_cost = rpl_policy_modify_downward_cost_to_root_neighbour(child->instance->domain, child->interface_id, child->prefix, transit->cost);
-        }
+        uint16_t transit_cost = rpl_downward_transit_cost(transit, parent_cost);
+
         if (child->info.root.cost > parent_cost + transit_cost) {
             /* Note new best cost to child, and make this transit the child's first/best */
             child->info.root.cost = parent_cost + transit_cost;
@@ -1454,6 +1618,9 @@ void rpl_downward_compute_paths(rpl_instance_t *instance)
     }
 
     /* First get targets into a topological sort - also breaks loops */
+    if (instance->root_topo_sort_stale) {
+        instance->root_topo_sort_valid = false;
+    }
     rpl_downward_topo_sort(instance);
 
     ns_list_foreach(rpl_dao_target_t, target, &instance->dao_targets) {
@@ -1475,14 +1642,387 @@ void rpl_downward_compute_paths(rpl_instance_t *instance)
     instance->root_paths_valid = true;
 }
 
+static void rpl_downward_paths_updated(rpl_instance_t *instance);
+
 /* Called when path costs may have changed (but not topo sort) */
 void rpl_downward_paths_invalidate(rpl_instance_t *instance)
 {
     instance->root_paths_valid = false;
+    rpl_downward_paths_updated(instance);
+}
+
+/* Incremental path computation
+ *
+ * Once the paths have been computed, a transit added, removed or whose cost
+ * changes only updates the targets whose best path may change, using a
+ * Dijkstra restricted to these targets. The result is the same as
+ * rpl_downward_compute_paths() on the same graph. The graph is only modified
+ * while it stays a DAG: if a new transit would create a loop, or if the last
+ * topo sort had to break loops (and could now choose other transits), we fall
+ * back to the full computation.
+ */
+typedef struct rpl_downward_heap_entry {
+    uint32_t cost;
+    rpl_dao_target_t *target;
+} rpl_downward_heap_entry_t;
+
+/* Scratch buffers, kept between the updates */
+static rpl_downward_heap_entry_t *rpl_downward_heap = NULL;
+static size_t rpl_downward_heap_len = 0;
+static size_t rpl_downward_heap_size = 0;
+static rpl_dao_target_t **rpl_downward_marked = NULL;
+static size_t rpl_downward_marked_len = 0;
+static size_t rpl_downward_marked_size = 0;
+
+static bool rpl_downward_paths_incremental(rpl_instance_t *instance)
+{
+    return instance->root_topo_sort_valid && instance->root_paths_valid;
+}
+
+static bool rpl_downward_grow(void **array, size_t *size, size_t elem_size)
+{
+    size_t new_size = *size ? *size * 2 : 64;
+    void *new_array = realloc(*array, new_size * elem_size);
+
+    if (!new_array) {
+        tr_warn("RPL path computation overflow");
+        return false;
+    }
+    *array = new_array;
+    *size = new_size;
+    return true;
+}
+
+static bool rpl_downward_heap_push(rpl_dao_target_t *target)
+{
+    size_t i;
+
+    if (rpl_downward_heap_len == rpl_downward_heap_size &&
+            !rpl_downward_grow((void **)&rpl_downward_heap, &rpl_downward_heap_size, sizeof(rpl_downward_heap_entry_t))) {
+        return false;
+    }
+    i = rpl_downward_heap_len++;
+    while (i > 0 && rpl_downward_heap[(i - 1) / 2].cost > target->info.root.cost) {
+        rpl_downward_heap[i] = rpl_downward_heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    rpl_downward_heap[i].cost = target->info.root.cost;
+    rpl_downward_heap[i].target = target;
+    return true;
+}
+
+/* Entries are not updated when a cost decreases, the outdated ones are skipped */
+static rpl_dao_target_t *rpl_downward_heap_pop(void)
+{
+    rpl_downward_heap_entry_t top, last;
+    size_t i, child;
+
+    do {
+        if (!rpl_downward_heap_len) {
+            return NULL;
+        }
+        top = rpl_downward_heap[0];
+        last = rpl_downward_heap[--rpl_downward_heap_len];
+        i = 0;
+        while ((child = 2 * i + 1) < rpl_downward_heap_len) {
+            if (child + 1 < rpl_downward_heap_len && rpl_downward_heap[child + 1].cost < rpl_downward_heap[child].cost) {
+                child++;
+            }
+            if (last.cost <= rpl_downward_heap[child].cost) {
+                break;
+            }
+            rpl_downward_heap[i] = rpl_downward_heap[child];
+            i = child;
+        }
+        rpl_downward_heap[i] = last;
+    } while (top.cost != top.target->info.root.cost);
+    return top.target;
+}
+
+static bool rpl_downward_mark(rpl_dao_target_t *target)
+{
+    if (rpl_downward_marked_len == rpl_downward_marked_size &&
+            !rpl_downward_grow((void **)&rpl_downward_marked, &rpl_downward_marked_size, sizeof(rpl_dao_target_t *))) {
+        return false;
+    }
+    target->path_affected = true;
+    rpl_downward_marked[rpl_downward_marked_len++] = target;
+    return true;
+}
+
+static void rpl_downward_unmark_all(void)
+{
+    for (size_t i = 0; i < rpl_downward_marked_len; i++) {
+        rpl_downward_marked[i]->path_affected = false;
+    }
+    rpl_downward_marked_len = 0;
+}
+
+/* Return true if "to" is a descendant of "from" (or if we can't tell) */
+static bool rpl_downward_paths_reachable(rpl_dao_target_t *from, rpl_dao_target_t *to)
+{
+    bool ret = false;
+
+    if (!rpl_downward_mark(from)) {
+        return true;
+    }
+    for (size_t i = 0; i < rpl_downward_marked_len && !ret; i++) {
+        ns_list_foreach(rpl_dao_root_transit_t, transit, &rpl_downward_marked[i]->info.root.children) {
+            if (transit->target->path_affected) {
+                continue;
+            }
+            if (transit->target == to || !rpl_downward_mark(transit->target)) {
+                ret = true;
+                break;
+            }
+        }
+    }
+    rpl_downward_unmark_all();
+    return ret || from == to;
+}
+
+static bool rpl_downward_paths_relax(rpl_dao_root_transit_t *transit, uint32_t parent_cost)
+{
+    rpl_dao_target_t *child = transit->target;
+    uint32_t cost = parent_cost + rpl_downward_transit_cost(transit, parent_cost);
+
+    if (child->info.root.cost <= cost) {
+        return true;
+    }
+    /* Note new best cost to child, and make this transit the child's first/best */
+    child->info.root.cost = cost;
+    child->connected = true;
+    if (transit != ns_list_get_first(&child->info.root.transits)) {
+        ns_list_remove(&child->info.root.transits, transit);
+        ns_list_add_to_start(&child->info.root.transits, transit);
+    }
+    return rpl_downward_heap_push(child);
+}
+
+static bool rpl_downward_paths_propagate(void)
+{
+    rpl_dao_target_t *target;
+
+    while ((target = rpl_downward_heap_pop())) {
+        ns_list_foreach(rpl_dao_root_transit_t, transit, &target->info.root.children) {
+            if (!rpl_downward_paths_relax(transit, target->info.root.cost)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* The best path of the target got worse, or was removed. Its cost and the
+ * costs of the targets whose best path goes through it are computed again
+ * from the other targets.
+ */
+static bool rpl_downward_paths_worsened(rpl_dao_target_t *target)
+{
+    bool ret = true;
+
+    if (!rpl_downward_mark(target)) {
+        return false;
+    }
+    for (size_t i = 0; i < rpl_downward_marked_len && ret; i++) {
+        ns_list_foreach(rpl_dao_root_transit_t, transit, &rpl_downward_marked[i]->info.root.children) {
+            rpl_dao_target_t *child = transit->target;
+
+            if (!child->path_affected && child->connected &&
+                    transit == ns_list_get_first(&child->info.root.transits) &&
+                    !rpl_downward_mark(child)) {
+                ret = false;
+                break;
+            }
+        }
+    }
+    for (size_t i = 0; i < rpl_downward_marked_len; i++) {
+        rpl_downward_marked[i]->info.root.cost = 0xFFFFFFFF;
+    }
+    for (size_t i = 0; i < rpl_downward_marked_len && ret; i++) {
+        ns_list_foreach(rpl_dao_root_transit_t, transit, &rpl_downward_marked[i]->info.root.transits) {
+            uint32_t parent_cost = transit->parent ? transit->parent->info.root.cost : 0;
+
+            if (!transit->linked || parent_cost == 0xFFFFFFFF) {
+                continue;
+            }
+            if (!rpl_downward_paths_relax(transit, parent_cost)) {
+                ret = false;
+                break;
+            }
+        }
+    }
+    if (ret) {
+        ret = rpl_downward_paths_propagate();
+    }
+    for (size_t i = 0; i < rpl_downward_marked_len; i++) {
+        rpl_downward_marked[i]->connected = rpl_downward_marked[i]->info.root.cost != 0xFFFFFFFF;
+    }
+    rpl_downward_unmark_all();
+    rpl_downward_heap_len = 0;
+    return ret;
+}
+
+#ifdef RPL_DOWNWARD_PATHS_CHECK
+static void rpl_downward_paths_check(rpl_instance_t *instance)
+{
+    int count = ns_list_count(&instance->dao_targets);
+    rpl_downward_heap_entry_t *saved;
+    int i = 0;
+
+    /* A new topo sort may break the loops differently */
+    if (instance->root_topo_sort_loop) {
+        return;
+    }
+    saved = malloc(count * sizeof(rpl_downward_heap_entry_t));
+    FATAL_ON(!saved, 2, "%s: malloc: %m", __func__);
+    ns_list_foreach(rpl_dao_target_t, target, &instance->dao_targets) {
+        saved[i].cost = target->info.root.cost;
+        saved[i].target = target;
+        i++;
+    }
+    instance->root_topo_sort_valid = false;
+    instance->root_paths_valid = false;
+    rpl_downward_compute_paths(instance);
+    for (i = 0; i < count; i++) {
+        BUG_ON(saved[i].cost != saved[i].target->info.root.cost, "%s: cost %"PRIu32" != %"PRIu32,
+               trace_ipv6_prefix(saved[i].target->prefix, saved[i].target->prefix_len),
+               saved[i].cost, saved[i].target->info.root.cost);
+    }
+    free(saved);
+}
+#endif
+
+/* Called when path costs have changed */
+static void rpl_downward_paths_updated(rpl_instance_t *instance)
+{
+#ifdef RPL_DOWNWARD_PATHS_CHECK
+    if (rpl_downward_paths_incremental(instance)) {
+        rpl_downward_paths_check(instance);
+    }
+#endif
     rpl_data_sr_invalidate();
     // FIXME: do not include app_wsbrd
     dbus_emit_nodes_change(&g_ctxt);
 }
+
+static void rpl_downward_root_transit_cost_changed(rpl_dao_root_transit_t *transit)
+{
+    rpl_dao_target_t *target = transit->target;
+    rpl_instance_t *instance = target->instance;
+    uint32_t parent_cost, cost;
+    bool ret;
+
+    if (!rpl_downward_paths_incremental(instance)) {
+        rpl_downward_paths_invalidate(instance);
+        return;
+    }
+    if (!transit->linked) {
+        return;
+    }
+    parent_cost = transit->parent ? transit->parent->info.root.cost : 0;
+    if (parent_cost == 0xFFFFFFFF) {
+        return;
+    }
+    cost = parent_cost + rpl_downward_transit_cost(transit, parent_cost);
+    if (cost < target->info.root.cost) {
+        ret = rpl_downward_paths_relax(transit, parent_cost) && rpl_downward_paths_propagate();
+        rpl_downward_heap_len = 0;
+    } else if (cost > target->info.root.cost && target->connected &&
+               transit == ns_list_get_first(&target->info.root.transits)) {
+        ret = rpl_downward_paths_worsened(target);
+    } else {
+        return;
+    }
+    if (ret) {
+        rpl_downward_paths_updated(instance);
+    } else {
+        rpl_downward_topo_sort_invalidate(instance);
+    }
+}
+
+static void rpl_downward_root_transit_added(rpl_dao_root_transit_t *transit)
+{
+    rpl_dao_target_t *target = transit->target;
+    rpl_instance_t *instance = target->instance;
+    rpl_dao_target_t *parent;
+
+    if (!rpl_downward_paths_incremental(instance) || instance->root_topo_sort_loop) {
+        rpl_downward_topo_sort_invalidate(instance);
+        return;
+    }
+    if (protocol_interface_address_compare(transit->transit) == 0) {
+        transit->parent = NULL;
+        ns_list_add_to_end(&instance->root_children, transit);
+    } else {
+        parent = rpl_instance_match_dao_target(instance, transit->transit, 128);
+        if (!parent) {
+            /* Out of the graph until a new target matches it, which redoes the topo sort */
+            return;
+        }
+        if (rpl_downward_paths_reachable(target, parent)) {
+            rpl_downward_topo_sort_invalidate(instance);
+            return;
+        }
+        transit->parent = parent;
+        ns_list_add_to_end(&parent->info.root.children, transit);
+        instance->root_topo_sort_stale = true;
+    }
+    transit->linked = true;
+    rpl_downward_root_transit_cost_changed(transit);
+}
+
+/* Unlink and free the transit. Return true if it was the best one of its target. */
+static bool rpl_downward_free_root_transit(rpl_dao_root_transit_t *transit)
+{
+    rpl_dao_target_t *target = transit->target;
+    rpl_instance_t *instance = target->instance;
+    bool best = target->connected && transit == ns_list_get_first(&target->info.root.transits);
+
+    /* Children lists are rebuilt from scratch when the topo sort is invalid */
+    if (instance->root_topo_sort_valid && transit->linked) {
+        if (transit->parent) {
+            ns_list_remove(&transit->parent->info.root.children, transit);
+        } else {
+            ns_list_remove(&instance->root_children, transit);
+        }
+    }
+    ns_list_remove(&target->info.root.transits, transit);
+    rpl_free(transit, sizeof * transit);
+    return best;
+}
+
+static void rpl_downward_root_transits_removed(rpl_dao_target_t *target, bool best)
+{
+    rpl_instance_t *instance = target->instance;
+
+    if (!rpl_downward_paths_incremental(instance) || instance->root_topo_sort_loop) {
+        rpl_downward_topo_sort_invalidate(instance);
+    } else if (best) {
+        if (rpl_downward_paths_worsened(target)) {
+            rpl_downward_paths_updated(instance);
+        } else {
+            rpl_downward_topo_sort_invalidate(instance);
+        }
+    }
+}
+
+static void rpl_downward_remove_root_transit(rpl_dao_root_transit_t *transit)
+{
+    rpl_dao_target_t *target = transit->target;
+
+    rpl_downward_root_transits_removed(target, rpl_downward_free_root_transit(transit));
+}
+
+static void rpl_downward_clear_root_transits(rpl_dao_target_t *target)
+{
+    bool best = false;
+
+    ns_list_foreach_safe(rpl_dao_root_transit_t, transit, &target->info.root.transits) {
+        best |= rpl_downward_free_root_transit(transit);
+    }
+    rpl_downward_root_transits_removed(target, best);
+}
 #endif // HAVE_RPL_ROOT
 
 #ifdef HAVE_RPL_DAO_HANDLING
@@ -1768,6 +2308,19 @@ void rpl_downward_dao_timer(rpl_instance_t *instance, uint16_t ticks)
     }
 }
 
+uint32_t rpl_downward_dao_timer_next_expiry(const rpl_instance_t *instance)
+{
+    uint32_t ret = UINT32_MAX;
+
+    if (instance->dao_retry_timer) {
+        ret = instance->dao_retry_timer;
+    }
+    if (instance->delay_dao_timer && instance->delay_dao_timer < ret) {
+        ret = instance->delay_dao_timer;
+    }
+    return ret;
+}
+
 void rpl_downward_print_instance(rpl_instance_t *instance, route_print_fn_t *print_fn)
 {
     if (ns_list_is_empty(&instance->dao_targets)) {
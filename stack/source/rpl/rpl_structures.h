@@ -113,6 +113,7 @@ typedef struct rpl_dao_root_transit {
     rpl_dao_target_t *target;
     uint8_t path_control;
     uint16_t cost;
+    bool linked;                        /* In the children list of the parent (or of the DODAG root) */
     ns_list_link_t parent_link;
     ns_list_link_t target_link;
 } rpl_dao_root_transit_t;
@@ -155,6 +156,7 @@ struct rpl_dao_target {
     bool descriptor_present: 1;         /* Target descriptor specified */
     bool need_seq_inc: 1;
     bool connected: 1;                  /* We know this target has a path to the root */
+    bool path_affected: 1;              /* Scratch mark for incremental path computation (root) */
     bool trig_confirmation_state: 1;         /* Enable confirmation to parent's */
     bool active_confirmation_state: 1;
     union {
@@ -164,10 +166,31 @@ struct rpl_dao_target {
         rpl_dao_non_root_t non_root;    /* Info for other nodes (any in storing, non-root in non-storing) */
     } info;
     ns_list_link_t link;
+    rpl_dao_target_t *index_next;       /* Next in its dao_target_index chain of the instance (if allocated) */
 };
 
 typedef NS_LIST_HEAD(rpl_dao_target_t, link) rpl_dao_target_list_t;
 
+/* Lookup index of the DAO targets of a root, which can have thousands of them.
+ * /128 targets are hashed by address, the few shorter prefixes are kept apart
+ * for longest-match. Order within a chain is the order of creation.
+ *
+ * The number of buckets follows the number of /128 targets, from
+ * RPL_DAO_TARGET_INDEX_SIZE_MIN to RPL_DAO_TARGET_INDEX_SIZE_MAX (bounded by
+ * the 16-bit size of rpl_alloc()).
+ */
+#define RPL_DAO_TARGET_INDEX_SIZE_MIN 16
+#define RPL_DAO_TARGET_INDEX_SIZE_MAX 4096
+#define RPL_DAO_TARGET_INDEX_ALLOC_SIZE(size) \
+    (sizeof(rpl_dao_target_index_t) + (size) * sizeof(rpl_dao_target_t *))
+
+typedef struct rpl_dao_target_index {
+    rpl_dao_target_t *prefixes;
+    uint16_t size;                      /* Number of buckets, a power of 2 */
+    uint32_t count;                     /* Number of /128 targets */
+    rpl_dao_target_t *addresses[];
+} rpl_dao_target_index_t;
+
 /* Descriptor for a RPL Instance. An instance can have multiple DODAGs.
  *
  * If top bit of instance_id is set then it's a local DODAG, and the dodags
@@ -183,6 +206,8 @@ struct rpl_instance {
     bool local_repair: 1;
     bool root_topo_sort_valid: 1;
     bool root_paths_valid: 1;
+    bool root_topo_sort_loop: 1;                    /* Topo sort had to break loops */
+    bool root_topo_sort_stale: 1;                   /* Transits added since the topo sort, dao_targets order may be wrong */
     bool dio_not_consistent: 1;                     /* Something changed - not consistent this period */
     bool dao_in_transit: 1;                         /* If we have a DAO in transit */
     bool requested_dao_ack: 1;                      /* If we requested an ACK (so we retry if no ACK, rather than assuming success) */
@@ -205,6 +230,7 @@ struct rpl_instance {
     trickle_t dio_timer;                            /* Trickle timer for DIO transmission */
     rpl_dao_root_transit_children_list_t root_children;
     rpl_dao_target_list_t dao_targets;              /* List of DAO targets */
+    rpl_dao_target_index_t *dao_target_index;       /* Allocated with the first root target, NULL otherwise */
     uint8_t dao_sequence;                           /* Next DAO sequence to use */
     uint8_t dao_sequence_in_transit;                /* DAO sequence in transit (if dao_in_transit) */
     uint16_t delay_dao_timer;
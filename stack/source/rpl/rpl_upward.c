@@ -1156,6 +1156,9 @@ void rpl_delete_instance(rpl_instance_t *instance)
     ns_list_foreach_safe(rpl_dao_target_t, target, &instance->dao_targets) {
         rpl_delete_dao_target(instance, target);
     }
+    if (instance->dao_target_index) {
+        rpl_free(instance->dao_target_index, RPL_DAO_TARGET_INDEX_ALLOC_SIZE(instance->dao_target_index->size));
+    }
     ns_list_remove(&domain->instances, instance);
     rpl_free(instance, sizeof * instance);
 }
@@ -1923,6 +1926,34 @@ void rpl_upward_dio_timer(rpl_instance_t *instance, uint16_t ticks)
     }
 }
 
+/* Conditions delaying the first DIO are ignored: if they still hold when the
+ * trickle timer expires, nothing is done and the expiry is reported again. */
+uint32_t rpl_upward_dio_timer_next_expiry(rpl_instance_t *instance)
+{
+    rpl_dodag_version_t *dodag_version = instance->current_dodag_version;
+    rpl_dodag_t *dodag;
+    if (dodag_version) {
+        dodag = dodag_version->dodag;
+    } else if (instance->poison_count) {
+        dodag = ns_list_get_first(&instance->dodags);
+        if (dodag) {
+            dodag_version = ns_list_get_first(&dodag->versions);
+        }
+    } else {
+        dodag = NULL;
+    }
+
+    if (!dodag || !dodag_version) {
+        return UINT32_MAX;
+    }
+
+    if (rpl_dodag_am_leaf(dodag) && !instance->poison_count) {
+        return UINT32_MAX;
+    }
+
+    return trickle_timer_next_expiry(&instance->dio_timer, &dodag->dio_timer_params);
+}
+
 void rpl_upward_print_neighbour(const rpl_neighbour_t *neighbour, route_print_fn_t *print_fn)
 {
     uint16_t path_cost;
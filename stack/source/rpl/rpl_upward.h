@@ -57,6 +57,7 @@ uint16_t rpl_rank_max_at_level(const rpl_dodag_t *dodag, uint16_t a);
 
 /* Internal APIs */
 void rpl_upward_dio_timer(rpl_instance_t *instance, uint16_t ticks);
+uint32_t rpl_upward_dio_timer_next_expiry(rpl_instance_t *instance);
 
 rpl_instance_t *rpl_lookup_instance(const rpl_domain_t *domain, uint8_t instance_id, const uint8_t *addr);
 rpl_instance_t *rpl_create_instance(rpl_domain_t *domain, uint8_t instance_id);
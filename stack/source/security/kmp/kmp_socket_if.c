@@ -249,7 +249,7 @@ int kmp_socket_if_get_pae_socket_fd()
     return -1;
 }
 
-void kmp_socket_if_pae_socket_cb(int fd)
+int kmp_socket_if_pae_socket_cb(int fd)
 {
     kmp_socket_if_t *socket_if = g_kmp_socket_if_instances[KMP_RELAY_INSTANCE_INDEX];
     uint8_t connection_num = 0;
@@ -257,17 +257,17 @@ void kmp_socket_if_pae_socket_cb(int fd)
     uint8_t data[2048];
     uint8_t *pdu = NULL;
 
-    data_len = recv(fd, data, sizeof(data), 0);
+    data_len = recv(fd, data, sizeof(data), MSG_DONTWAIT);
     if (data_len <= 0)
-        return;
+        return data_len;
 
     if (!socket_if) {
-        return;
+        return data_len;
     }
 
     pdu = malloc(data_len);
     if (!pdu)
-        return;
+        return data_len;
 
     memcpy(pdu, data, data_len);
 
@@ -288,12 +288,13 @@ void kmp_socket_if_pae_socket_cb(int fd)
         type = kmp_api_type_from_id_get(*data_ptr++);
         if (type == KMP_TYPE_NONE) {
             free(pdu);
-            return;
+            return data_len;
         }
     }
 
     kmp_service_msg_if_receive(socket_if->kmp_service, socket_if->instance_id, type, &addr, data_ptr, data_len, connection_num);
     free(pdu);
+    return data_len;
 }
 
 int kmp_socket_if_get_radius_sockfd()
@@ -304,7 +305,7 @@ int kmp_socket_if_get_radius_sockfd()
     return -1;
 }
 
-uint8_t kmp_socket_if_radius_socket_cb(int fd)
+int kmp_socket_if_radius_socket_cb(int fd)
 {
     ssize_t size;
     uint8_t radius_recv_buf[4096];
@@ -313,14 +314,14 @@ uint8_t kmp_socket_if_radius_socket_cb(int fd)
     kmp_addr_t addr = { };
     kmp_type_e type = KMP_TYPE_NONE;
 
+    size = recv(fd, radius_recv_buf, sizeof(radius_recv_buf), MSG_DONTWAIT);
+    if (size <= 0)
+        return size;
+
     if (!socket_if) {
-        return -1;
+        return size;
     }
 
-    size = recv(fd, radius_recv_buf, sizeof(radius_recv_buf), 0);
-    if (size < 0)
-        return -1;
-
     kmp_service_msg_if_receive(socket_if->kmp_service, socket_if->instance_id, type, &addr, radius_recv_buf, size, connection_num);
 
     return size;
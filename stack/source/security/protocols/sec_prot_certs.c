@@ -46,6 +46,7 @@ int8_t sec_prot_certs_init(sec_prot_certs_t *certs)
     ns_list_init(&certs->trusted_cert_chain_list);
     ns_list_init(&certs->cert_revocat_lists);
     certs->own_cert_chain_len = 0;
+    sec_prot_certs_updated(certs);
     certs->ext_cert_valid_enabled = false;
 
     return 0;
@@ -60,6 +61,15 @@ void sec_prot_certs_delete(sec_prot_certs_t *certs)
     sec_prot_certs_chain_entry_init(&certs->own_cert_chain);
     sec_prot_certs_chain_list_delete(&certs->trusted_cert_chain_list);
     sec_prot_certs_revocat_lists_delete(&certs->cert_revocat_lists);
+    sec_prot_certs_updated(certs);
+}
+
+void sec_prot_certs_updated(sec_prot_certs_t *certs)
+{
+    static uint32_t version = 0;
+
+    // Versions are unique among all the certificate sets
+    certs->version = ++version;
 }
 
 int8_t sec_prot_certs_ext_certificate_validation_set(sec_prot_certs_t *certs, bool enabled)
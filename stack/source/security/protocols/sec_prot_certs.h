@@ -61,6 +61,7 @@ typedef struct sec_prot_certs_s {
     cert_chain_list_t trusted_cert_chain_list;          /**< Trusted certificate chain lists */
     cert_revocat_lists_t cert_revocat_lists;            /**< Certificate Revocation Lists */
     uint16_t own_cert_chain_len;                        /**< Own certificate chain certificates length */
+    uint32_t version;                                   /**< Changed when certificates are modified */
     bool ext_cert_valid_enabled : 1;                    /**< Extended certificate validation enabled */
 } sec_prot_certs_t;
 
@@ -82,6 +83,15 @@ int8_t sec_prot_certs_init(sec_prot_certs_t *certs);
  */
 void sec_prot_certs_delete(sec_prot_certs_t *certs);
 
+/**
+ * sec_prot_certs_updated update the version of certificate information, must
+ * be called when the certificates are modified
+ *
+ * \param certs certificate information
+ *
+ */
+void sec_prot_certs_updated(sec_prot_certs_t *certs);
+
 /**
  * sec_prot_certs_ext_certificate_validation_set enable or disable extended certificate validation
  *
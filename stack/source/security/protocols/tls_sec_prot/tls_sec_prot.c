@@ -39,6 +39,7 @@
 
 #include "security/protocols/tls_sec_prot/tls_sec_prot.h"
 #include "security/protocols/tls_sec_prot/tls_sec_prot_lib.h"
+#include "security/protocols/tls_sec_prot/tls_sec_prot_worker.h"
 
 
 #define TRACE_GROUP "tlsp"
@@ -57,8 +58,6 @@ typedef enum {
     TLS_STATE_FINISHED = SEC_STATE_FINISHED
 } eap_tls_sec_prot_state_e;
 
-typedef struct tls_sec_prot_lib_int_s tls_sec_prot_lib_int_t;
-
 typedef struct {
     sec_prot_common_t             common;            /**< Common data */
     uint8_t                       new_pmk[PMK_LEN];  /**< New Pair Wise Master Key */
@@ -74,7 +73,10 @@ typedef struct {
     bool                          queued : 1;        /**< TLS is queued */
 #endif
     bool                          library_init : 1;  /**< TLS library has been initialized */
-    tls_sec_prot_lib_int_t        *tls_sec_inst;     /**< TLS security library storage, SHALL BE THE LAST FIELD */
+    bool                          job_done : 1;      /**< TLS worker job result is available */
+    int8_t                        job_result;        /**< TLS worker job result */
+    tls_sec_prot_worker_job_t     *job;              /**< TLS worker job, set while TLS library is processed by a worker */
+    tls_security_t                *tls_sec;          /**< TLS security library instance, owned by the worker job once cancelled */
 } tls_sec_prot_int_t;
 
 // TLS server EC queue is currently disabled, since EC calculation is made on server in one go
@@ -107,6 +109,17 @@ static void tls_sec_prot_tls_set_timer(void *handle, uint32_t inter, uint32_t fi
 static int8_t tls_sec_prot_tls_get_timer(void *handle);
 
 static int8_t tls_sec_prot_tls_configure_and_connect(sec_prot_t *prot, bool is_server);
+static int8_t tls_sec_prot_tls_process(sec_prot_t *prot);
+static void tls_sec_prot_tls_free(sec_prot_t *prot);
+
+// Callbacks of the library, restored once a worker is done
+static const tls_sec_prot_worker_cb_t tls_sec_prot_tls_cb = {
+    .send        = tls_sec_prot_tls_send,
+    .receive     = tls_sec_prot_tls_receive,
+    .export_keys = tls_sec_prot_tls_export_keys,
+    .set_timer   = tls_sec_prot_tls_set_timer,
+    .get_timer   = tls_sec_prot_tls_get_timer,
+};
 
 #ifdef SERVER_TLS_EC_CALC_QUEUE
 static bool tls_sec_prot_queue_check(sec_prot_t *prot);
@@ -153,7 +166,7 @@ int8_t server_tls_sec_prot_register(kmp_service_t *service)
 
 static uint16_t tls_sec_prot_size(void)
 {
-    return sizeof(tls_sec_prot_int_t) + tls_sec_prot_lib_size();
+    return sizeof(tls_sec_prot_int_t);
 }
 
 static int8_t client_tls_sec_prot_init(sec_prot_t *prot)
@@ -185,6 +198,9 @@ static int8_t client_tls_sec_prot_init(sec_prot_t *prot)
     data->queued = false;
 #endif
     data->library_init = false;
+    data->job_done = false;
+    data->job = NULL;
+    data->tls_sec = NULL;
     return 0;
 }
 
@@ -217,6 +233,9 @@ static int8_t server_tls_sec_prot_init(sec_prot_t *prot)
     data->queued = false;
 #endif
     data->library_init = false;
+    data->job_done = false;
+    data->job = NULL;
+    data->tls_sec = NULL;
     return 0;
 }
 
@@ -227,7 +246,7 @@ static void tls_sec_prot_delete(sec_prot_t *prot)
     eap_tls_sec_prot_lib_message_free(&data->tls_recv);
     if (data->library_init) {
         tr_info("TLS: free library");
-        tls_sec_prot_lib_free((tls_security_t *) &data->tls_sec_inst);
+        tls_sec_prot_tls_free(prot);
     }
     tls_sec_prot_queue_remove(prot);
 }
@@ -253,6 +272,13 @@ static int8_t tls_sec_prot_receive(sec_prot_t *prot, void *pdu, uint16_t size)
 {
     tls_sec_prot_int_t *data = tls_sec_prot_get(prot);
 
+    // Receive buffer is owned by the worker until it is done
+    if (data->job) {
+        tr_warn("TLS: busy, drop message");
+        free(pdu);
+        return -1;
+    }
+
     // Discards old data
     eap_tls_sec_prot_lib_message_free(&data->tls_recv);
 
@@ -275,7 +301,8 @@ static void tls_sec_prot_timer_timeout(sec_prot_t *prot, uint16_t ticks)
 {
     tls_sec_prot_int_t *data = tls_sec_prot_get(prot);
 
-    if (data->timer_running) {
+    // TLS timers are owned by the worker until it is done
+    if (data->timer_running && !data->job) {
         if (data->int_timer > ticks) {
             data->int_timer -= ticks;
         } else {
@@ -346,7 +373,11 @@ static void client_tls_sec_prot_state_machine(sec_prot_t *prot)
             break;
 
         case TLS_STATE_PROCESS:
-            result = tls_sec_prot_lib_process((tls_security_t *) &data->tls_sec_inst);
+            result = tls_sec_prot_tls_process(prot);
+            if (data->job) {
+                // Resumed by tls_sec_prot_tls_process_done()
+                return;
+            }
 
             if (result == TLS_SEC_PROT_LIB_CALCULATING) {
                 data->calculating = true;
@@ -383,14 +414,14 @@ static void client_tls_sec_prot_state_machine(sec_prot_t *prot)
             prot->finished_ind(prot, sec_prot_result_get(&data->common), prot->sec_keys);
             sec_prot_state_set(prot, &data->common, TLS_STATE_FINISHED);
 
-            tls_sec_prot_lib_free((tls_security_t *) &data->tls_sec_inst);
+            tls_sec_prot_tls_free(prot);
             data->library_init = false;
             break;
 
         case TLS_STATE_FINISHED:
             tr_debug("TLS: finished, free %s", data->library_init ? "T" : "F");
             if (data->library_init) {
-                tls_sec_prot_lib_free((tls_security_t *) &data->tls_sec_inst);
+                tls_sec_prot_tls_free(prot);
                 data->library_init = false;
             }
             prot->timer_stop(prot);
@@ -465,7 +496,11 @@ static void server_tls_sec_prot_state_machine(sec_prot_t *prot)
             }
 #endif
 
-            result = tls_sec_prot_lib_process((tls_security_t *) &data->tls_sec_inst);
+            result = tls_sec_prot_tls_process(prot);
+            if (data->job) {
+                // Resumed by tls_sec_prot_tls_process_done()
+                return;
+            }
 
             if (result == TLS_SEC_PROT_LIB_CALCULATING) {
                 data->calculating = true;
@@ -503,14 +538,14 @@ static void server_tls_sec_prot_state_machine(sec_prot_t *prot)
             sec_prot_state_set(prot, &data->common, TLS_STATE_FINISHED);
 
             tls_sec_prot_queue_remove(prot);
-            tls_sec_prot_lib_free((tls_security_t *) &data->tls_sec_inst);
+            tls_sec_prot_tls_free(prot);
             data->library_init = false;
             break;
 
         case TLS_STATE_FINISHED: {
             tr_debug("TLS: finished, eui-64: %s free %s", trace_array(sec_prot_remote_eui_64_addr_get(prot), 8), data->library_init ? "T" : "F");
             if (data->library_init) {
-                tls_sec_prot_lib_free((tls_security_t *) &data->tls_sec_inst);
+                tls_sec_prot_tls_free(prot);
                 data->library_init = false;
             }
             prot->timer_stop(prot);
@@ -645,16 +680,23 @@ static int8_t tls_sec_prot_tls_configure_and_connect(sec_prot_t *prot, bool is_s
 
     // Must be free if library initialize is done
     data->library_init = true;
-    if (tls_sec_prot_lib_init((tls_security_t *)&data->tls_sec_inst) < 0) {
+    // Allocated separately, a cancelled worker job may outlive the protocol
+    data->tls_sec = malloc(tls_sec_prot_lib_size());
+    if (!data->tls_sec) {
+        tr_error("TLS: library init fail");
+        return -1;
+    }
+    if (tls_sec_prot_lib_init(data->tls_sec) < 0) {
         tr_error("TLS: library init fail");
         return -1;
     }
 
-    tls_sec_prot_lib_set_cb_register((tls_security_t *)&data->tls_sec_inst, prot,
+    tls_sec_prot_lib_set_cb_register(data->tls_sec, prot,
                                      tls_sec_prot_tls_send, tls_sec_prot_tls_receive, tls_sec_prot_tls_export_keys,
                                      tls_sec_prot_tls_set_timer, tls_sec_prot_tls_get_timer);
 
-    if (tls_sec_prot_lib_connect((tls_security_t *)&data->tls_sec_inst, is_server, prot->sec_keys->certs) < 0) {
+    if (tls_sec_prot_lib_connect(data->tls_sec, is_server,
+                                 sec_prot_remote_eui_64_addr_get(prot), prot->sec_keys->certs) < 0) {
         tr_error("TLS: library connect fail");
         return -1;
     }
@@ -662,6 +704,60 @@ static int8_t tls_sec_prot_tls_configure_and_connect(sec_prot_t *prot, bool is_s
     return 0;
 }
 
+static void tls_sec_prot_tls_process_done(void *ctx, int8_t result)
+{
+    sec_prot_t *prot = ctx;
+    tls_sec_prot_int_t *data = tls_sec_prot_get(prot);
+
+    data->job = NULL;
+    data->job_done = true;
+    data->job_result = result;
+    prot->state_machine(prot);
+}
+
+/* Processes the TLS library inline, or on a worker thread if enabled. In the
+ * latter case, data->job is set and the state machine is called again with the
+ * result when the worker is done. */
+static int8_t tls_sec_prot_tls_process(sec_prot_t *prot)
+{
+    tls_sec_prot_int_t *data = tls_sec_prot_get(prot);
+
+    if (data->job) {
+        return TLS_SEC_PROT_LIB_CALCULATING;
+    }
+
+    if (data->job_done) {
+        data->job_done = false;
+        return data->job_result;
+    }
+
+    if (tls_sec_prot_worker_enabled()) {
+        data->job = tls_sec_prot_worker_submit(data->tls_sec, &tls_sec_prot_tls_cb,
+                                               tls_sec_prot_tls_process_done, prot);
+        if (data->job) {
+            return TLS_SEC_PROT_LIB_CALCULATING;
+        }
+    }
+
+    return tls_sec_prot_lib_process(data->tls_sec);
+}
+
+static void tls_sec_prot_tls_free(sec_prot_t *prot)
+{
+    tls_sec_prot_int_t *data = tls_sec_prot_get(prot);
+
+    data->job_done = false;
+    // The library is freed with the job if a worker uses it
+    if (data->job) {
+        tls_sec_prot_worker_cancel(data->job);
+        data->job = NULL;
+    } else if (data->tls_sec) {
+        tls_sec_prot_lib_free(data->tls_sec);
+        free(data->tls_sec);
+    }
+    data->tls_sec = NULL;
+}
+
 #ifdef SERVER_TLS_EC_CALC_QUEUE
 static bool tls_sec_prot_queue_check(sec_prot_t *prot)
 {
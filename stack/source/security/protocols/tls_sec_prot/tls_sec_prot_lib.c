@@ -16,9 +16,11 @@
  */
 
 #include "nsconfig.h"
+#include <pthread.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 #include <mbedtls/version.h>
 #include <mbedtls/sha256.h>
 #include <mbedtls/error.h>
@@ -39,6 +41,7 @@
 #include "security/protocols/sec_prot_certs.h"
 
 #include "security/protocols/tls_sec_prot/tls_sec_prot_lib.h"
+#include "security/protocols/tls_sec_prot/tls_sec_prot_worker.h"
 
 #define TRACE_GROUP "tlsl"
 
@@ -47,21 +50,60 @@
 
 //#define TLS_SEC_PROT_LIB_TLS_DEBUG       // Enable mbed TLS debug traces
 
-typedef int tls_sec_prot_lib_crt_verify_cb(tls_security_t *sec, mbedtls_x509_crt *crt, uint32_t *flags);
+// Session serialization is available since mbed TLS 2.19
+#if defined(HAVE_PAE_AUTH) && MBEDTLS_VERSION_NUMBER >= 0x02130000
+#define TLS_SEC_PROT_LIB_SESSION_CACHE
+#endif
 
-struct tls_security_s {
-    mbedtls_ssl_config             conf;                 /**< mbed TLS SSL configuration */
-    mbedtls_ssl_context            ssl;                  /**< mbed TLS SSL context */
+#define TLS_SEC_PROT_LIB_SESSION_CACHE_SIZE      256
+#define TLS_SEC_PROT_LIB_SESSION_CACHE_LIFETIME  (24 * 3600) // seconds
 
-    mbedtls_ctr_drbg_context       ctr_drbg;             /**< mbed TLS pseudo random number generator context */
-    mbedtls_entropy_context        entropy;              /**< mbed TLS entropy context */
+typedef int tls_sec_prot_lib_crt_verify_cb(tls_security_t *sec, mbedtls_x509_crt *crt, uint32_t *flags);
 
+/* Parsing the certificates and the private key is expensive, so they are
+ * parsed once and shared by all the TLS sessions. The credentials are parsed
+ * again only when the certificates are modified. The previous credentials are
+ * freed when the last session using them is freed.
+ *
+ * mbed TLS modifies the parsed keys while using them (e.g. the EC precomputed
+ * tables are filled on first use), so the credentials are not shared when the
+ * handshakes run on worker threads: each session parses its own copy.
+ */
+typedef struct tls_sec_prot_lib_creds {
+    uint32_t                       certs_version;        /**< Version of the certificates parsed */
+    unsigned int                   refcount;             /**< Number of sessions using the credentials */
     mbedtls_x509_crt               cacert;               /**< CA certificate(s) */
     mbedtls_x509_crl               *crl;                 /**< Certificate Revocation List */
     mbedtls_x509_crt               owncert;              /**< Own certificate(s) */
     mbedtls_pk_context             pkey;                 /**< Private key for own certificate */
+} tls_sec_prot_lib_creds_t;
+
+/* Sessions established by the authenticator, so a supplicant reconnecting
+ * after an outage can do an abbreviated handshake. A session can only be
+ * resumed by the supplicant (EUI-64) which has established it, and only with
+ * the certificates in use when it has been established.
+ */
+typedef struct tls_sec_prot_lib_session {
+    uint8_t                        eui_64[8];            /**< Supplicant EUI-64 */
+    uint8_t                        id[32];               /**< TLS session ID */
+    uint8_t                        id_len;               /**< TLS session ID length */
+    uint32_t                       certs_version;        /**< Version of the certificates */
+    time_t                         expiry;               /**< Expiration time (monotonic seconds) */
+    unsigned char                  *data;                /**< Serialized mbed TLS session */
+    size_t                         data_len;             /**< Serialized mbed TLS session length */
+    ns_list_link_t                 link;                 /**< Link */
+} tls_sec_prot_lib_session_t;
+
+struct tls_security_s {
+    mbedtls_ssl_config             conf;                 /**< mbed TLS SSL configuration */
+    mbedtls_ssl_context            ssl;                  /**< mbed TLS SSL context */
+
+    tls_sec_prot_lib_creds_t       *creds;               /**< Shared credentials */
     void                           *handle;              /**< Handle provided in callbacks (defined by library user) */
+    uint8_t                        eui_64[8];            /**< Remote EUI-64 */
     bool                           ext_cert_valid : 1;   /**< Extended certificate validation enabled */
+    bool                           server : 1;           /**< TLS server */
+    bool                           full_handshake : 1;   /**< Server certificate sent, the session is not resumed */
 #if (MBEDTLS_VERSION_MAJOR < 3)
     tls_sec_prot_lib_crt_verify_cb *crt_verify;          /**< Verify function for client/server certificate */
 #endif
@@ -113,6 +155,22 @@ static void *tls_sec_prot_lib_mem_calloc(size_t count, size_t size);
 static void tls_sec_prot_lib_mem_free(void *ptr);
 #endif
 
+/* The random number generator is shared by all the TLS sessions, which may be
+ * processed by worker threads (see tls_sec_prot_worker.h) */
+static mbedtls_ctr_drbg_context tls_sec_prot_lib_ctr_drbg;
+static mbedtls_entropy_context tls_sec_prot_lib_entropy;
+static bool tls_sec_prot_lib_ctr_drbg_seeded = false;
+static pthread_mutex_t tls_sec_prot_lib_ctr_drbg_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static tls_sec_prot_lib_creds_t *tls_sec_prot_lib_creds = NULL;
+
+/* Also accessed from the worker threads. Most recently used sessions first. */
+static NS_LIST_DEFINE(tls_sec_prot_lib_sessions, tls_sec_prot_lib_session_t, link);
+static pthread_mutex_t tls_sec_prot_lib_sessions_lock = PTHREAD_MUTEX_INITIALIZER;
+static int tls_sec_prot_lib_sessions_count = 0;
+static uint32_t tls_sec_prot_lib_full_handshakes = 0;
+static uint32_t tls_sec_prot_lib_resumed_handshakes = 0;
+
 #if defined(HAVE_PAE_AUTH)
 #define is_server_is_set (is_server == true)
 #define is_server_is_not_set (is_server == false)
@@ -121,44 +179,71 @@ static void tls_sec_prot_lib_mem_free(void *ptr);
 #define is_server_is_not_set true
 #endif
 
-int8_t tls_sec_prot_lib_init(tls_security_t *sec)
+static int8_t tls_sec_prot_lib_ctr_drbg_seed(void)
 {
     const char *pers = "ws_tls";
 
-#ifdef TLS_SEC_PROT_LIB_USE_MBEDTLS_PLATFORM_MEMORY
-    mbedtls_platform_set_calloc_free(tls_sec_prot_lib_mem_calloc, tls_sec_prot_lib_mem_free);
-#endif
+    if (tls_sec_prot_lib_ctr_drbg_seeded) {
+        return 0;
+    }
 
-    mbedtls_ssl_init(&sec->ssl);
-    mbedtls_ssl_config_init(&sec->conf);
-    mbedtls_ctr_drbg_init(&sec->ctr_drbg);
-    mbedtls_entropy_init(&sec->entropy);
+    mbedtls_ctr_drbg_init(&tls_sec_prot_lib_ctr_drbg);
+    mbedtls_entropy_init(&tls_sec_prot_lib_entropy);
     // mbedtls calls 'syscall(SYS_getrandom, ...)' in its default source.
     // This makes it difficult to wrap RNG for fuzzing or simulation so
     // the default source is disabled in favor of randlib which uses the C
     // wrapper 'getrandom'.
 #if (MBEDTLS_VERSION_MAJOR >= 3)
-    sec->entropy.private_source_count = 0;
+    tls_sec_prot_lib_entropy.private_source_count = 0;
 #else
-    sec->entropy.source_count = 0;
+    tls_sec_prot_lib_entropy.source_count = 0;
 #endif
 
-    mbedtls_x509_crt_init(&sec->cacert);
-
-    mbedtls_x509_crt_init(&sec->owncert);
-    mbedtls_pk_init(&sec->pkey);
-
-    sec->crl = NULL;
-
-    if (mbedtls_entropy_add_source(&sec->entropy, tls_sec_lib_entropy_poll, NULL,
+    if (mbedtls_entropy_add_source(&tls_sec_prot_lib_entropy, tls_sec_lib_entropy_poll, NULL,
                                    128, MBEDTLS_ENTROPY_SOURCE_STRONG) < 0) {
         tr_error("Entropy add fail");
-        return -1;
+        goto error;
     }
 
-    if ((mbedtls_ctr_drbg_seed(&sec->ctr_drbg, mbedtls_entropy_func, &sec->entropy,
+    if ((mbedtls_ctr_drbg_seed(&tls_sec_prot_lib_ctr_drbg, mbedtls_entropy_func, &tls_sec_prot_lib_entropy,
                                (const unsigned char *) pers, strlen(pers))) != 0) {
         tr_error("drbg seed fail");
+        goto error;
+    }
+
+    tls_sec_prot_lib_ctr_drbg_seeded = true;
+    return 0;
+
+error:
+    mbedtls_entropy_free(&tls_sec_prot_lib_entropy);
+    mbedtls_ctr_drbg_free(&tls_sec_prot_lib_ctr_drbg);
+    return -1;
+}
+
+static int tls_sec_prot_lib_ctr_drbg_random(void *ctx, unsigned char *output, size_t len)
+{
+    int ret;
+
+    pthread_mutex_lock(&tls_sec_prot_lib_ctr_drbg_lock);
+    ret = mbedtls_ctr_drbg_random(ctx, output, len);
+    pthread_mutex_unlock(&tls_sec_prot_lib_ctr_drbg_lock);
+    return ret;
+}
+
+int8_t tls_sec_prot_lib_init(tls_security_t *sec)
+{
+#ifdef TLS_SEC_PROT_LIB_USE_MBEDTLS_PLATFORM_MEMORY
+    mbedtls_platform_set_calloc_free(tls_sec_prot_lib_mem_calloc, tls_sec_prot_lib_mem_free);
+#endif
+
+    mbedtls_ssl_init(&sec->ssl);
+    mbedtls_ssl_config_init(&sec->conf);
+
+    sec->creds = NULL;
+    sec->server = false;
+    sec->full_handshake = false;
+
+    if (tls_sec_prot_lib_ctr_drbg_seed() < 0) {
         return -1;
     }
 
@@ -187,22 +272,36 @@ void tls_sec_prot_lib_set_cb_register(tls_security_t *sec, void *handle,
     sec->get_timer = get_timer;
 }
 
-void tls_sec_prot_lib_free(tls_security_t *sec)
+static void tls_sec_prot_lib_creds_release(tls_sec_prot_lib_creds_t *creds)
 {
-    mbedtls_x509_crt_free(&sec->cacert);
-    if (sec->crl) {
-        mbedtls_x509_crl_free(sec->crl);
-        free(sec->crl);
+    if (--creds->refcount) {
+        return;
     }
-    mbedtls_x509_crt_free(&sec->owncert);
-    mbedtls_pk_free(&sec->pkey);
-    mbedtls_entropy_free(&sec->entropy);
-    mbedtls_ctr_drbg_free(&sec->ctr_drbg);
-    mbedtls_ssl_config_free(&sec->conf);
+    if (creds == tls_sec_prot_lib_creds) {
+        tls_sec_prot_lib_creds = NULL;
+    }
+    mbedtls_x509_crt_free(&creds->cacert);
+    if (creds->crl) {
+        mbedtls_x509_crl_free(creds->crl);
+        free(creds->crl);
+    }
+    mbedtls_x509_crt_free(&creds->owncert);
+    mbedtls_pk_free(&creds->pkey);
+    free(creds);
+}
+
+void tls_sec_prot_lib_free(tls_security_t *sec)
+{
+    // Release before the configuration that references the credentials
     mbedtls_ssl_free(&sec->ssl);
+    mbedtls_ssl_config_free(&sec->conf);
+    if (sec->creds) {
+        tls_sec_prot_lib_creds_release(sec->creds);
+        sec->creds = NULL;
+    }
 }
 
-static int tls_sec_prot_lib_configure_certificates(tls_security_t *sec, const sec_prot_certs_t *certs)
+static int tls_sec_prot_lib_creds_parse(tls_sec_prot_lib_creds_t *creds, const sec_prot_certs_t *certs)
 {
     if (!certs->own_cert_chain.cert[0]) {
         tr_error("no own cert");
@@ -221,7 +320,7 @@ static int tls_sec_prot_lib_configure_certificates(tls_security_t *sec, const se
             }
             break;
         }
-        if (mbedtls_x509_crt_parse(&sec->owncert, cert, cert_len) < 0) {
+        if (mbedtls_x509_crt_parse(&creds->owncert, cert, cert_len) < 0) {
             tr_error("Own cert parse eror");
             return -1;
         }
@@ -237,20 +336,14 @@ static int tls_sec_prot_lib_configure_certificates(tls_security_t *sec, const se
     }
 
 #if (MBEDTLS_VERSION_MAJOR >= 3)
-    if (mbedtls_pk_parse_key(&sec->pkey, key, key_len, NULL, 0, mbedtls_ctr_drbg_random, &sec->ctr_drbg) < 0) {
+    if (mbedtls_pk_parse_key(&creds->pkey, key, key_len, NULL, 0, tls_sec_prot_lib_ctr_drbg_random, &tls_sec_prot_lib_ctr_drbg) < 0) {
 #else
-    if (mbedtls_pk_parse_key(&sec->pkey, key, key_len, NULL, 0) < 0) {
+    if (mbedtls_pk_parse_key(&creds->pkey, key, key_len, NULL, 0) < 0) {
 #endif
         tr_error("Private key parse error");
         return -1;
     }
 
-    // Configure own certificate chain and private key
-    if (mbedtls_ssl_conf_own_cert(&sec->conf, &sec->owncert, &sec->pkey) != 0) {
-        tr_error("Own cert and private key conf error");
-        return -1;
-    }
-
     // Parse trusted certificate chains
     ns_list_foreach(cert_chain_entry_t, entry, &certs->trusted_cert_chain_list) {
         index = 0;
@@ -264,7 +357,7 @@ static int tls_sec_prot_lib_configure_certificates(tls_security_t *sec, const se
                 }
                 break;
             }
-            if (mbedtls_x509_crt_parse(&sec->cacert, cert, cert_len) < 0) {
+            if (mbedtls_x509_crt_parse(&creds->cacert, cert, cert_len) < 0) {
                 tr_error("Trusted cert parse error");
                 return -1;
             }
@@ -279,23 +372,77 @@ static int tls_sec_prot_lib_configure_certificates(tls_security_t *sec, const se
         if (!crl) {
             break;
         }
-        if (!sec->crl) {
-            sec->crl = malloc(sizeof(mbedtls_x509_crl));
-            if (!sec->crl) {
+        if (!creds->crl) {
+            creds->crl = malloc(sizeof(mbedtls_x509_crl));
+            if (!creds->crl) {
                 tr_error("No memory for CRL");
                 return -1;
             }
-            mbedtls_x509_crl_init(sec->crl);
+            mbedtls_x509_crl_init(creds->crl);
         }
 
-        if (mbedtls_x509_crl_parse(sec->crl, crl, crl_len) < 0) {
+        if (mbedtls_x509_crl_parse(creds->crl, crl, crl_len) < 0) {
             tr_error("CRL parse error");
             return -1;
         }
     }
 
+    return 0;
+}
+
+static tls_sec_prot_lib_creds_t *tls_sec_prot_lib_creds_get(const sec_prot_certs_t *certs)
+{
+    tls_sec_prot_lib_creds_t *creds = tls_sec_prot_lib_creds;
+    bool shared = !tls_sec_prot_worker_enabled();
+
+    if (shared && creds && creds->certs_version == certs->version) {
+        creds->refcount++;
+        return creds;
+    }
+
+    creds = malloc(sizeof(tls_sec_prot_lib_creds_t));
+    if (!creds) {
+        tr_error("No memory for credentials");
+        return NULL;
+    }
+    creds->certs_version = certs->version;
+    creds->refcount = 1;
+    mbedtls_x509_crt_init(&creds->cacert);
+    mbedtls_x509_crt_init(&creds->owncert);
+    mbedtls_pk_init(&creds->pkey);
+    creds->crl = NULL;
+    if (tls_sec_prot_lib_creds_parse(creds, certs) != 0) {
+        tls_sec_prot_lib_creds_release(creds);
+        return NULL;
+    }
+    if (!shared) {
+        return creds;
+    }
+
+    // Sessions still using the previous credentials keep a reference on them
+    if (tls_sec_prot_lib_creds) {
+        tls_sec_prot_lib_creds_release(tls_sec_prot_lib_creds);
+    }
+    tls_sec_prot_lib_creds = creds;
+    creds->refcount++;
+    return creds;
+}
+
+static int tls_sec_prot_lib_configure_certificates(tls_security_t *sec, const sec_prot_certs_t *certs)
+{
+    sec->creds = tls_sec_prot_lib_creds_get(certs);
+    if (!sec->creds) {
+        return -1;
+    }
+
+    // Configure own certificate chain and private key
+    if (mbedtls_ssl_conf_own_cert(&sec->conf, &sec->creds->owncert, &sec->creds->pkey) != 0) {
+        tr_error("Own cert and private key conf error");
+        return -1;
+    }
+
     // Configure trusted certificates and certificate revocation lists
-    mbedtls_ssl_conf_ca_chain(&sec->conf, &sec->cacert, sec->crl);
+    mbedtls_ssl_conf_ca_chain(&sec->conf, &sec->creds->cacert, sec->creds->crl);
 
     // Certificate verify required on both client and server
     mbedtls_ssl_conf_authmode(&sec->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
@@ -306,7 +453,147 @@ static int tls_sec_prot_lib_configure_certificates(tls_security_t *sec, const se
     return 0;
 }
 
-int8_t tls_sec_prot_lib_connect(tls_security_t *sec, bool is_server, const sec_prot_certs_t *certs)
+static tls_sec_prot_lib_session_t *tls_sec_prot_lib_session_find(const uint8_t *eui_64)
+{
+    ns_list_foreach(tls_sec_prot_lib_session_t, entry, &tls_sec_prot_lib_sessions) {
+        if (!memcmp(entry->eui_64, eui_64, 8)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void tls_sec_prot_lib_session_free(tls_sec_prot_lib_session_t *entry)
+{
+    ns_list_remove(&tls_sec_prot_lib_sessions, entry);
+    tls_sec_prot_lib_sessions_count--;
+    free(entry->data);
+    free(entry);
+}
+
+void tls_sec_prot_lib_session_delete(const uint8_t *eui_64)
+{
+    tls_sec_prot_lib_session_t *entry;
+
+    pthread_mutex_lock(&tls_sec_prot_lib_sessions_lock);
+    entry = tls_sec_prot_lib_session_find(eui_64);
+    if (entry) {
+        tls_sec_prot_lib_session_free(entry);
+    }
+    pthread_mutex_unlock(&tls_sec_prot_lib_sessions_lock);
+}
+
+void tls_sec_prot_lib_handshakes_get(uint32_t *full, uint32_t *resumed)
+{
+    pthread_mutex_lock(&tls_sec_prot_lib_sessions_lock);
+    *full = tls_sec_prot_lib_full_handshakes;
+    *resumed = tls_sec_prot_lib_resumed_handshakes;
+    pthread_mutex_unlock(&tls_sec_prot_lib_sessions_lock);
+}
+
+#ifdef TLS_SEC_PROT_LIB_SESSION_CACHE
+static time_t tls_sec_prot_lib_time(void)
+{
+    struct timespec tp;
+
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return tp.tv_sec;
+}
+
+#if (MBEDTLS_VERSION_MAJOR >= 3)
+static int tls_sec_prot_lib_session_cache_get(void *ctx, const unsigned char *id, size_t id_len,
+                                              mbedtls_ssl_session *session)
+{
+#else
+static int tls_sec_prot_lib_session_cache_get(void *ctx, mbedtls_ssl_session *session)
+{
+    const unsigned char *id = session->id;
+    size_t id_len = session->id_len;
+#endif
+    tls_security_t *sec = (tls_security_t *)ctx;
+    tls_sec_prot_lib_session_t *entry;
+    int ret = -1;
+
+    pthread_mutex_lock(&tls_sec_prot_lib_sessions_lock);
+    entry = tls_sec_prot_lib_session_find(sec->eui_64);
+    if (entry && entry->expiry <= tls_sec_prot_lib_time()) {
+        tls_sec_prot_lib_session_free(entry);
+        entry = NULL;
+    }
+    if (entry && entry->id_len == id_len && !memcmp(entry->id, id, id_len) &&
+            entry->certs_version == sec->creds->certs_version) {
+        ret = mbedtls_ssl_session_load(session, entry->data, entry->data_len);
+    }
+    pthread_mutex_unlock(&tls_sec_prot_lib_sessions_lock);
+
+    // mbed TLS may still do a full handshake with a loaded session (e.g. if
+    // its ciphersuite is no longer allowed), tls_sec_prot_lib_process()
+    // finds out which handshake was done
+    return ret;
+}
+
+#if (MBEDTLS_VERSION_MAJOR >= 3)
+static int tls_sec_prot_lib_session_cache_set(void *ctx, const unsigned char *id, size_t id_len,
+                                              const mbedtls_ssl_session *session)
+{
+#else
+static int tls_sec_prot_lib_session_cache_set(void *ctx, const mbedtls_ssl_session *session)
+{
+    const unsigned char *id = session->id;
+    size_t id_len = session->id_len;
+#endif
+    tls_security_t *sec = (tls_security_t *)ctx;
+    tls_sec_prot_lib_session_t *entry;
+    unsigned char *data;
+    size_t data_len;
+
+    if (id_len > sizeof(entry->id)) {
+        return -1;
+    }
+    if (mbedtls_ssl_session_save(session, NULL, 0, &data_len) != MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL) {
+        return -1;
+    }
+    data = malloc(data_len);
+    if (!data) {
+        return -1;
+    }
+    if (mbedtls_ssl_session_save(session, data, data_len, &data_len) != 0) {
+        free(data);
+        return -1;
+    }
+
+    pthread_mutex_lock(&tls_sec_prot_lib_sessions_lock);
+    entry = tls_sec_prot_lib_session_find(sec->eui_64);
+    if (!entry && tls_sec_prot_lib_sessions_count >= TLS_SEC_PROT_LIB_SESSION_CACHE_SIZE) {
+        // Recycle the least recently used session
+        entry = ns_list_get_last(&tls_sec_prot_lib_sessions);
+    }
+    if (entry) {
+        ns_list_remove(&tls_sec_prot_lib_sessions, entry);
+        free(entry->data);
+    } else {
+        entry = malloc(sizeof(tls_sec_prot_lib_session_t));
+        if (!entry) {
+            pthread_mutex_unlock(&tls_sec_prot_lib_sessions_lock);
+            free(data);
+            return -1;
+        }
+        tls_sec_prot_lib_sessions_count++;
+    }
+    memcpy(entry->eui_64, sec->eui_64, 8);
+    memcpy(entry->id, id, id_len);
+    entry->id_len = id_len;
+    entry->certs_version = sec->creds->certs_version;
+    entry->expiry = tls_sec_prot_lib_time() + TLS_SEC_PROT_LIB_SESSION_CACHE_LIFETIME;
+    entry->data = data;
+    entry->data_len = data_len;
+    ns_list_add_to_start(&tls_sec_prot_lib_sessions, entry);
+    pthread_mutex_unlock(&tls_sec_prot_lib_sessions_lock);
+    return 0;
+}
+#endif
+
+int8_t tls_sec_prot_lib_connect(tls_security_t *sec, bool is_server, const uint8_t *eui_64, const sec_prot_certs_t *certs)
 {
 #if !defined(HAVE_PAE_AUTH)
     (void) is_server;
@@ -336,7 +623,7 @@ int8_t tls_sec_prot_lib_connect(tls_security_t *sec, bool is_server, const sec_p
 
 #if !defined(MBEDTLS_SSL_CONF_RNG)
     // Configure random number generator
-    mbedtls_ssl_conf_rng(&sec->conf, mbedtls_ctr_drbg_random, &sec->ctr_drbg);
+    mbedtls_ssl_conf_rng(&sec->conf, tls_sec_prot_lib_ctr_drbg_random, &tls_sec_prot_lib_ctr_drbg);
 #endif
 
 #ifdef MBEDTLS_ECP_RESTARTABLE
@@ -372,6 +659,15 @@ int8_t tls_sec_prot_lib_connect(tls_security_t *sec, bool is_server, const sec_p
         return -1;
     }
 
+    sec->server = is_server_is_set;
+    memcpy(sec->eui_64, eui_64, 8);
+#ifdef TLS_SEC_PROT_LIB_SESSION_CACHE
+    if (is_server_is_set) {
+        mbedtls_ssl_conf_session_cache(&sec->conf, sec, tls_sec_prot_lib_session_cache_get,
+                                       tls_sec_prot_lib_session_cache_set);
+    }
+#endif
+
 #if !defined(MBEDTLS_SSL_CONF_SINGLE_CIPHERSUITE)
     // Configure ciphersuites
     static const int sec_suites[] = {
@@ -444,10 +740,27 @@ int8_t tls_sec_prot_lib_process(tls_security_t *sec)
         }
 
 #if (MBEDTLS_VERSION_MAJOR >= 3)
-        if (sec->ssl.private_state == MBEDTLS_SSL_HANDSHAKE_OVER) {
+        int state = sec->ssl.private_state;
 #else
-        if (sec->ssl.state == MBEDTLS_SSL_HANDSHAKE_OVER) {
+        int state = sec->ssl.state;
 #endif
+        // After the ServerHello, an abbreviated handshake goes straight to
+        // ChangeCipherSpec, only a full one sends the server certificate
+        if (state == MBEDTLS_SSL_SERVER_CERTIFICATE) {
+            sec->full_handshake = true;
+        }
+        if (state == MBEDTLS_SSL_HANDSHAKE_OVER) {
+            if (sec->server) {
+                pthread_mutex_lock(&tls_sec_prot_lib_sessions_lock);
+                if (sec->full_handshake) {
+                    tls_sec_prot_lib_full_handshakes++;
+                } else {
+                    tls_sec_prot_lib_resumed_handshakes++;
+                }
+                pthread_mutex_unlock(&tls_sec_prot_lib_sessions_lock);
+                tr_debug("TLS: %s handshake, eui-64: %s", sec->full_handshake ? "full" : "resumed",
+                         trace_array(sec->eui_64, 8));
+            }
             return TLS_SEC_PROT_LIB_HANDSHAKE_OVER;
         }
     }
@@ -146,12 +146,30 @@ void tls_sec_prot_lib_free(tls_security_t *sec);
  *
  * \param sec security library instance
  * \param is_server TRUE if TLS server, FALSE for TLS client
+ * \param eui_64 remote EUI-64, the server resumes only the sessions of the same EUI-64
  * \param certs certificates
  *
  * \return < 0 failure
  * \return >= 0 success
  */
-int8_t tls_sec_prot_lib_connect(tls_security_t *sec, bool is_server, const sec_prot_certs_t *certs);
+int8_t tls_sec_prot_lib_connect(tls_security_t *sec, bool is_server, const uint8_t *eui_64, const sec_prot_certs_t *certs);
+
+/**
+ * tls_sec_prot_lib_session_delete delete the cached TLS session of a remote
+ *
+ * \param eui_64 remote EUI-64
+ *
+ */
+void tls_sec_prot_lib_session_delete(const uint8_t *eui_64);
+
+/**
+ * tls_sec_prot_lib_handshakes_get get the number of handshakes completed by the server
+ *
+ * \param full number of full handshakes
+ * \param resumed number of handshakes resuming a cached session
+ *
+ */
+void tls_sec_prot_lib_handshakes_get(uint32_t *full, uint32_t *resumed);
 
 /**
  * tls_sec_prot_lib_process process TLS (call e.g. after incoming message)
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2022 Silicon Laboratories Inc. (www.silabs.com)
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of the Silicon Labs Master Software License
+ * Agreement (MSLA) available at [1].  This software is distributed to you in
+ * Object Code format and/or Source Code format and is governed by the sections
+ * of the MSLA applicable to Object Code, Source Code and Modified Open Source
+ * Code. By using this software, you agree to the terms of the MSLA.
+ *
+ * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
+ */
+#include "nsconfig.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common/log.h"
+#include "stack-services/ns_list.h"
+#include "stack-services/ns_trace.h"
+#include "stack-scheduler/eventOS_event.h"
+#include "stack-scheduler/eventOS_scheduler.h"
+
+#include "security/protocols/sec_prot_certs.h"
+#include "security/protocols/tls_sec_prot/tls_sec_prot_lib.h"
+
+#include "security/protocols/tls_sec_prot/tls_sec_prot_worker.h"
+
+#define TRACE_GROUP "tlsw"
+
+#define TLS_SEC_PROT_WORKER_INIT 0
+#define TLS_SEC_PROT_WORKER_DONE 1
+
+enum tls_sec_prot_worker_state {
+    TLS_SEC_PROT_JOB_QUEUED,
+    TLS_SEC_PROT_JOB_RUNNING,
+    TLS_SEC_PROT_JOB_DONE,
+};
+
+struct tls_sec_prot_worker_job {
+    tls_security_t *sec;
+    const tls_sec_prot_worker_cb_t *cb;
+    tls_sec_prot_worker_done *done;
+    void *ctx;                      // NULL once cancelled, protected by the lock
+    int8_t result;
+    enum tls_sec_prot_worker_state state;
+    ns_list_link_t link;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t queue_cond;      // Signaled when a job is queued
+    pthread_mutex_t trace_lock;
+    NS_LIST_HEAD(tls_sec_prot_worker_job_t, link) queue;
+    int8_t tasklet_id;
+    int count;
+} tls_sec_prot_worker = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .queue_cond = PTHREAD_COND_INITIALIZER,
+    .tasklet_id = -1,
+};
+
+static void tls_sec_prot_worker_trace_lock(void)
+{
+    pthread_mutex_lock(&tls_sec_prot_worker.trace_lock);
+}
+
+static void tls_sec_prot_worker_trace_unlock(void)
+{
+    pthread_mutex_unlock(&tls_sec_prot_worker.trace_lock);
+}
+
+/*
+ * The callbacks of the library are called by the worker through these ones,
+ * with the lock held. Once the job is cancelled, the session data they access
+ * may be freed: the messages are dropped and the step ends as soon as the
+ * library waits for data.
+ */
+static int16_t tls_sec_prot_worker_send(void *handle, const void *buf, size_t len)
+{
+    tls_sec_prot_worker_job_t *job = handle;
+    int16_t ret = len;
+
+    pthread_mutex_lock(&tls_sec_prot_worker.lock);
+    if (job->ctx)
+        ret = job->cb->send(job->ctx, buf, len);
+    pthread_mutex_unlock(&tls_sec_prot_worker.lock);
+    return ret;
+}
+
+static int16_t tls_sec_prot_worker_receive(void *handle, unsigned char *buf, size_t len)
+{
+    tls_sec_prot_worker_job_t *job = handle;
+    int16_t ret = TLS_SEC_PROT_LIB_NO_DATA;
+
+    pthread_mutex_lock(&tls_sec_prot_worker.lock);
+    if (job->ctx)
+        ret = job->cb->receive(job->ctx, buf, len);
+    pthread_mutex_unlock(&tls_sec_prot_worker.lock);
+    return ret;
+}
+
+static void tls_sec_prot_worker_export_keys(void *handle, const uint8_t *master_secret,
+                                            const uint8_t *eap_tls_key_material)
+{
+    tls_sec_prot_worker_job_t *job = handle;
+
+    pthread_mutex_lock(&tls_sec_prot_worker.lock);
+    if (job->ctx)
+        job->cb->export_keys(job->ctx, master_secret, eap_tls_key_material);
+    pthread_mutex_unlock(&tls_sec_prot_worker.lock);
+}
+
+static void tls_sec_prot_worker_set_timer(void *handle, uint32_t inter, uint32_t fin)
+{
+    tls_sec_prot_worker_job_t *job = handle;
+
+    pthread_mutex_lock(&tls_sec_prot_worker.lock);
+    if (job->ctx)
+        job->cb->set_timer(job->ctx, inter, fin);
+    pthread_mutex_unlock(&tls_sec_prot_worker.lock);
+}
+
+static int8_t tls_sec_prot_worker_get_timer(void *handle)
+{
+    tls_sec_prot_worker_job_t *job = handle;
+    int8_t ret = TLS_SEC_PROT_LIB_TIMER_CANCELLED;
+
+    pthread_mutex_lock(&tls_sec_prot_worker.lock);
+    if (job->ctx)
+        ret = job->cb->get_timer(job->ctx);
+    pthread_mutex_unlock(&tls_sec_prot_worker.lock);
+    return ret;
+}
+
+// Must be called from the event loop, the credentials are not thread safe
+static void tls_sec_prot_worker_job_free(tls_sec_prot_worker_job_t *job)
+{
+    tls_sec_prot_lib_free(job->sec);
+    free(job->sec);
+    free(job);
+}
+
+static void *tls_sec_prot_worker_thread(void *arg)
+{
+    tls_sec_prot_worker_job_t *job;
+    arm_event_t event = {
+        .receiver = tls_sec_prot_worker.tasklet_id,
+        .sender = 0,
+        .event_type = TLS_SEC_PROT_WORKER_DONE,
+        .priority = ARM_LIB_LOW_PRIORITY_EVENT,
+    };
+
+    pthread_mutex_lock(&tls_sec_prot_worker.lock);
+    for (;;) {
+        while (ns_list_is_empty(&tls_sec_prot_worker.queue))
+            pthread_cond_wait(&tls_sec_prot_worker.queue_cond, &tls_sec_prot_worker.lock);
+        job = ns_list_get_first(&tls_sec_prot_worker.queue);
+        ns_list_remove(&tls_sec_prot_worker.queue, job);
+        job->state = TLS_SEC_PROT_JOB_RUNNING;
+        pthread_mutex_unlock(&tls_sec_prot_worker.lock);
+
+        job->result = tls_sec_prot_lib_process(job->sec);
+
+        pthread_mutex_lock(&tls_sec_prot_worker.lock);
+        job->state = TLS_SEC_PROT_JOB_DONE;
+        // Event queue is protected by platform_enter_critical(). The event
+        // storage is owned by the event core, the job is freed by the tasklet.
+        event.data_ptr = job;
+        FATAL_ON(eventOS_event_send(&event), 2, "eventOS_event_send");
+    }
+    return NULL;
+}
+
+static void tls_sec_prot_worker_tasklet(arm_event_t *event)
+{
+    tls_sec_prot_worker_job_t *job = event->data_ptr;
+
+    if (event->event_type != TLS_SEC_PROT_WORKER_DONE)
+        return;
+    pthread_mutex_lock(&tls_sec_prot_worker.lock);
+    BUG_ON(job->state != TLS_SEC_PROT_JOB_DONE);
+    pthread_mutex_unlock(&tls_sec_prot_worker.lock);
+    if (!job->ctx) {
+        tls_sec_prot_worker_job_free(job);
+        return;
+    }
+    tls_sec_prot_lib_set_cb_register(job->sec, job->ctx, job->cb->send, job->cb->receive,
+                                     job->cb->export_keys, job->cb->set_timer, job->cb->get_timer);
+    job->done(job->ctx, job->result);
+    free(job);
+}
+
+int tls_sec_prot_worker_init(int count)
+{
+    pthread_mutexattr_t attr;
+    pthread_t thread;
+    int ret;
+
+    ns_list_init(&tls_sec_prot_worker.queue);
+    if (!count)
+        return 0;
+
+    // mbed trace requires a recursive lock to be thread safe
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&tls_sec_prot_worker.trace_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    mbed_trace_mutex_wait_function_set(tls_sec_prot_worker_trace_lock);
+    mbed_trace_mutex_release_function_set(tls_sec_prot_worker_trace_unlock);
+
+    tls_sec_prot_worker.tasklet_id = eventOS_event_handler_create(tls_sec_prot_worker_tasklet, TLS_SEC_PROT_WORKER_INIT);
+    if (tls_sec_prot_worker.tasklet_id < 0)
+        return -1;
+
+    for (int i = 0; i < count; i++) {
+        ret = pthread_create(&thread, NULL, tls_sec_prot_worker_thread, NULL);
+        FATAL_ON(ret, 2, "pthread_create: %s", strerror(ret));
+        pthread_detach(thread);
+    }
+    tls_sec_prot_worker.count = count;
+    tr_info("TLS handshakes offloaded to %d workers", count);
+    return 0;
+}
+
+bool tls_sec_prot_worker_enabled(void)
+{
+    return tls_sec_prot_worker.count > 0;
+}
+
+tls_sec_prot_worker_job_t *tls_sec_prot_worker_submit(tls_security_t *sec, const tls_sec_prot_worker_cb_t *cb,
+                                                      tls_sec_prot_worker_done *done, void *ctx)
+{
+    tls_sec_prot_worker_job_t *job;
+
+    BUG_ON(!tls_sec_prot_worker_enabled());
+    BUG_ON(!ctx);
+    job = malloc(sizeof(tls_sec_prot_worker_job_t));
+    if (!job)
+        return NULL;
+    job->sec = sec;
+    job->cb = cb;
+    job->done = done;
+    job->ctx = ctx;
+    job->state = TLS_SEC_PROT_JOB_QUEUED;
+    tls_sec_prot_lib_set_cb_register(sec, job, tls_sec_prot_worker_send, tls_sec_prot_worker_receive,
+                                     tls_sec_prot_worker_export_keys, tls_sec_prot_worker_set_timer,
+                                     tls_sec_prot_worker_get_timer);
+
+    pthread_mutex_lock(&tls_sec_prot_worker.lock);
+    ns_list_add_to_end(&tls_sec_prot_worker.queue, job);
+    pthread_cond_signal(&tls_sec_prot_worker.queue_cond);
+    pthread_mutex_unlock(&tls_sec_prot_worker.lock);
+    return job;
+}
+
+void tls_sec_prot_worker_cancel(tls_sec_prot_worker_job_t *job)
+{
+    pthread_mutex_lock(&tls_sec_prot_worker.lock);
+    if (job->state == TLS_SEC_PROT_JOB_QUEUED) {
+        ns_list_remove(&tls_sec_prot_worker.queue, job);
+        pthread_mutex_unlock(&tls_sec_prot_worker.lock);
+        tls_sec_prot_worker_job_free(job);
+        return;
+    }
+    // The completion event is (or will be) queued, it will free the job
+    job->ctx = NULL;
+    pthread_mutex_unlock(&tls_sec_prot_worker.lock);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2022 Silicon Laboratories Inc. (www.silabs.com)
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of the Silicon Labs Master Software License
+ * Agreement (MSLA) available at [1].  This software is distributed to you in
+ * Object Code format and/or Source Code format and is governed by the sections
+ * of the MSLA applicable to Object Code, Source Code and Modified Open Source
+ * Code. By using this software, you agree to the terms of the MSLA.
+ *
+ * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
+ */
+#ifndef TLS_SEC_PROT_WORKER_H_
+#define TLS_SEC_PROT_WORKER_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "security/protocols/sec_prot_certs.h"
+#include "security/protocols/tls_sec_prot/tls_sec_prot_lib.h"
+
+/*
+ * Run the TLS handshake steps (and their public key computations) on worker
+ * threads, so they do not block the main loop.
+ *
+ * Only the mbed TLS context of the session is processed by the worker. While
+ * the step runs, the library calls the callbacks given to
+ * tls_sec_prot_worker_submit() from the worker thread, with ctx as handle.
+ * They must only access data owned by the session. The caller must not touch
+ * the session until the completion callback is called. The completion
+ * callback is called from the event loop, once the callbacks of the session
+ * have been registered again.
+ */
+
+typedef struct tls_sec_prot_worker_job tls_sec_prot_worker_job_t;
+
+typedef struct tls_sec_prot_worker_cb {
+    tls_sec_prot_lib_send        *send;
+    tls_sec_prot_lib_receive     *receive;
+    tls_sec_prot_lib_export_keys *export_keys;
+    tls_sec_prot_lib_set_timer   *set_timer;
+    tls_sec_prot_lib_get_timer   *get_timer;
+} tls_sec_prot_worker_cb_t;
+
+typedef void tls_sec_prot_worker_done(void *ctx, int8_t result);
+
+// Start count worker threads. With 0, the handshake steps run inline.
+int tls_sec_prot_worker_init(int count);
+bool tls_sec_prot_worker_enabled(void);
+
+// Queue a call to tls_sec_prot_lib_process(sec). Return NULL on failure.
+tls_sec_prot_worker_job_t *tls_sec_prot_worker_submit(tls_security_t *sec, const tls_sec_prot_worker_cb_t *cb,
+                                                      tls_sec_prot_worker_done *done, void *ctx);
+// Does not wait for the job. The completion callback won't be called and the
+// session (allocated with malloc()) is freed once the worker is done with it.
+void tls_sec_prot_worker_cancel(tls_sec_prot_worker_job_t *job);
+
+#endif
@@ -28,8 +28,28 @@
 
 #include "core/ns_address_internal.h"
 
-mac_neighbor_table_t *mac_neighbor_table_create(uint8_t table_size, neighbor_entry_remove_notify *remove_cb, neighbor_entry_nud_notify *nud_cb, void *user_indentifier)
+#define TRACE_GROUP "mnbt"
+
+#define mac_neighbor_table_mac16_bucket(table_class, mac16) \
+    (&(table_class)->mac16_index[(mac16) % MAC_NEIGHBOR_TABLE_INDEX_SIZE])
+
+static mac_neighbor_table_mac64_list_t *mac_neighbor_table_mac64_bucket(mac_neighbor_table_t *table_class, const uint8_t *mac64)
 {
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < 8; i++) {
+        hash ^= mac64[i];
+        hash *= 16777619u;
+    }
+    return &table_class->mac64_index[hash % MAC_NEIGHBOR_TABLE_INDEX_SIZE];
+}
+
+mac_neighbor_table_t *mac_neighbor_table_create(uint16_t table_size, neighbor_entry_remove_notify *remove_cb, neighbor_entry_nud_notify *nud_cb, void *user_indentifier)
+{
+    if (table_size > MAC_NEIGHBOR_TABLE_SIZE_MAX) {
+        tr_error("Neighbor table size %u exceeds %u", table_size, MAC_NEIGHBOR_TABLE_SIZE_MAX);
+        return NULL;
+    }
     mac_neighbor_table_t *table_class = malloc(sizeof(mac_neighbor_table_t) + sizeof(mac_neighbor_table_entry_t) * table_size);
     if (!table_class) {
         return NULL;
@@ -43,7 +63,11 @@ mac_neighbor_table_t *mac_neighbor_table_create(uint8_t table_size, neighbor_ent
     table_class->user_remove_notify_cb = remove_cb;
     ns_list_init(&table_class->neighbour_list);
     ns_list_init(&table_class->free_list);
-    for (uint8_t i = 0; i < table_size; i++) {
+    for (int i = 0; i < MAC_NEIGHBOR_TABLE_INDEX_SIZE; i++) {
+        ns_list_init(&table_class->mac64_index[i]);
+        ns_list_init(&table_class->mac16_index[i]);
+    }
+    for (uint16_t i = 0; i < table_size; i++) {
         memset(cur_ptr, 0, sizeof(mac_neighbor_table_entry_t));
         cur_ptr->index = i;
         //Add to list
@@ -64,6 +88,10 @@ void mac_neighbor_table_delete(mac_neighbor_table_t *table_class)
 static void neighbor_table_class_remove_entry(mac_neighbor_table_t *table_class, mac_neighbor_table_entry_t *entry)
 {
     ns_list_remove(&table_class->neighbour_list, entry);
+    ns_list_remove(mac_neighbor_table_mac64_bucket(table_class, entry->mac64), entry);
+    if (entry->mac16 != 0xffff) {
+        ns_list_remove(mac_neighbor_table_mac16_bucket(table_class, entry->mac16), entry);
+    }
     table_class->neighbour_list_size--;
     if (entry->nud_active) {
         entry->nud_active = false;
@@ -75,7 +103,7 @@ static void neighbor_table_class_remove_entry(mac_neighbor_table_t *table_class,
     }
     topo_trace(TOPOLOGY_MLE, entry->mac64, TOPO_REMOVE);
 
-    uint8_t index = entry->index;
+    uint16_t index = entry->index;
     memset(entry, 0, sizeof(mac_neighbor_table_entry_t));
     entry->index = index;
     ns_list_add_to_end(&table_class->free_list, entry);
@@ -138,6 +166,8 @@ mac_neighbor_table_entry_t *mac_neighbor_table_entry_allocate(mac_neighbor_table
     ns_list_add_to_end(&table_class->neighbour_list, entry);
     table_class->neighbour_list_size++;
     memcpy(entry->mac64, mac64, 8);
+    ns_list_add_to_end(mac_neighbor_table_mac64_bucket(table_class, entry->mac64), entry);
+    entry->in_use = true;
     entry->mac16 = 0xffff;
     entry->rx_on_idle = true;
     entry->ffd_device = true;
@@ -154,13 +184,12 @@ mac_neighbor_table_entry_t *mac_neighbor_table_entry_allocate(mac_neighbor_table
 
 static mac_neighbor_table_entry_t *neighbor_table_class_entry_validate(mac_neighbor_table_t *table_class, mac_neighbor_table_entry_t *neighbor_entry)
 {
-    ns_list_foreach(mac_neighbor_table_entry_t, cur, &table_class->neighbour_list) {
-        if (cur == neighbor_entry) {
-            return cur;
-        }
+    if (neighbor_entry < table_class->neighbor_entry_buffer ||
+            neighbor_entry >= table_class->neighbor_entry_buffer + table_class->list_total_size ||
+            !neighbor_entry->in_use) {
+        return NULL;
     }
-    return NULL;
-
+    return neighbor_entry;
 }
 
 void mac_neighbor_table_neighbor_remove(mac_neighbor_table_t *table_class, mac_neighbor_table_entry_t *neighbor_entry)
@@ -198,6 +227,20 @@ void mac_neighbor_table_trusted_neighbor(mac_neighbor_table_t *table_class, mac_
     neighbor_entry->trusted_device = trusted_device;
 }
 
+void mac_neighbor_table_mac16_set(mac_neighbor_table_t *table_class, mac_neighbor_table_entry_t *neighbor_entry, uint16_t mac16)
+{
+    if (neighbor_entry->mac16 == mac16) {
+        return;
+    }
+    if (neighbor_entry->mac16 != 0xffff) {
+        ns_list_remove(mac_neighbor_table_mac16_bucket(table_class, neighbor_entry->mac16), neighbor_entry);
+    }
+    neighbor_entry->mac16 = mac16;
+    if (neighbor_entry->mac16 != 0xffff) {
+        ns_list_add_to_end(mac_neighbor_table_mac16_bucket(table_class, neighbor_entry->mac16), neighbor_entry);
+    }
+}
+
 mac_neighbor_table_entry_t *mac_neighbor_table_address_discover(mac_neighbor_table_t *table_class, const uint8_t *address, uint8_t address_type)
 {
     if (!table_class) {
@@ -206,18 +249,16 @@ mac_neighbor_table_entry_t *mac_neighbor_table_address_discover(mac_neighbor_tab
     uint16_t short_address;
     if (address_type == ADDR_802_15_4_SHORT) {
         short_address = common_read_16_bit(address);
-    } else if (address_type == ADDR_802_15_4_LONG) {
-
-    } else {
-        return NULL;
-    }
-
-    ns_list_foreach(mac_neighbor_table_entry_t, cur, &table_class->neighbour_list) {
-        if (address_type == ADDR_802_15_4_SHORT) {
-            if (cur->mac16 != 0xffff && cur->mac16 == short_address) {
+        if (short_address == 0xffff) {
+            return NULL;
+        }
+        ns_list_foreach(mac_neighbor_table_entry_t, cur, mac_neighbor_table_mac16_bucket(table_class, short_address)) {
+            if (cur->mac16 == short_address) {
                 return cur;
             }
-        } else {
+        }
+    } else if (address_type == ADDR_802_15_4_LONG) {
+        ns_list_foreach(mac_neighbor_table_entry_t, cur, mac_neighbor_table_mac64_bucket(table_class, address)) {
             if (memcmp(cur->mac64, address, 8) == 0) {
                 return cur;
             }
@@ -227,15 +268,12 @@ mac_neighbor_table_entry_t *mac_neighbor_table_address_discover(mac_neighbor_tab
     return NULL;
 }
 
-mac_neighbor_table_entry_t *mac_neighbor_table_attribute_discover(mac_neighbor_table_t *table_class, uint8_t index)
+mac_neighbor_table_entry_t *mac_neighbor_table_attribute_discover(mac_neighbor_table_t *table_class, uint16_t index)
 {
-    ns_list_foreach(mac_neighbor_table_entry_t, cur, &table_class->neighbour_list) {
-
-        if (cur->index == index) {
-            return cur;
-        }
+    if (index >= table_class->list_total_size || !table_class->neighbor_entry_buffer[index].in_use) {
+        return NULL;
     }
-    return NULL;
+    return &table_class->neighbor_entry_buffer[index];
 }
 
 mac_neighbor_table_entry_t *mac_neighbor_entry_get_by_ll64(mac_neighbor_table_t *table_class, const uint8_t *ipv6Address, bool allocateNew, bool *new_entry_allocated)
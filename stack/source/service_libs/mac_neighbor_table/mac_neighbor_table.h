@@ -31,11 +31,16 @@
 #define SECONDARY_PARENT_NEIGHBOUR      1
 #define CHILD_NEIGHBOUR                 2
 #define PRIORITY_PARENT_NEIGHBOUR       3
+
+#define MAC_NEIGHBOR_TABLE_INDEX_SIZE   128 //Hash buckets for the address lookups
+// The entry index is 16-bit, but ws_neighbor_class, etx and the RCP device
+// table still use 8-bit indexes
+#define MAC_NEIGHBOR_TABLE_SIZE_MAX     UINT8_MAX
 /**
  * Generic Neighbor table entry
  */
 typedef struct mac_neighbor_table_entry {
-    uint8_t         index;                  /*!< Unique Neighbour index */
+    uint16_t        index;                  /*!< Unique Neighbour index */
     uint8_t         mac64[8];               /*!< MAC64 */
     uint16_t        mac16;                  /*!< MAC16 address for neighbor 0xffff when no 16-bit address is unknown */
     uint32_t        lifetime;               /*!< Life time in seconds which goes down */
@@ -49,11 +54,16 @@ typedef struct mac_neighbor_table_entry {
     bool            connected_device: 1;    /*!< True Link is connected and data rx is accepted , False RX data is not accepted*/
     bool            trusted_device: 1;      /*!< True mean use normal group key, false for enable pairwise key */
     bool            nud_active: 1;          /*!< True Neighbor NUD process is active, false not active process */
+    bool            in_use: 1;              /*!< True entry is in neighbour_list, false in free_list */
     unsigned        link_role: 2;           /*!< Link role: NORMAL_NEIGHBOUR, PRIORITY_PARENT_NEIGHBOUR, SECONDARY_PARENT_NEIGHBOUR, CHILD_NEIGHBOUR */
     ns_list_link_t  link;
+    ns_list_link_t  mac64_link;             /*!< Link in mac64_index of the table */
+    ns_list_link_t  mac16_link;             /*!< Link in mac16_index of the table, only if mac16 is set */
 } mac_neighbor_table_entry_t;
 
 typedef NS_LIST_HEAD(mac_neighbor_table_entry_t, link) mac_neighbor_table_list_t;
+typedef NS_LIST_HEAD(mac_neighbor_table_entry_t, mac64_link) mac_neighbor_table_mac64_list_t;
+typedef NS_LIST_HEAD(mac_neighbor_table_entry_t, mac16_link) mac_neighbor_table_mac16_list_t;
 
 #define mac_neighbor_info(interface) ((interface)->mac_parameters.mac_neighbor_table) /*!< Helper macro for give mac neighbor class pointer from interface pointer. */
 
@@ -83,10 +93,12 @@ typedef bool neighbor_entry_nud_notify(mac_neighbor_table_entry_t *entry_ptr, vo
 typedef struct mac_neighbor_table {
     mac_neighbor_table_list_t neighbour_list;               /*!< List of active neighbors */
     mac_neighbor_table_list_t free_list;                    /*!< List of free neighbors entries */
+    mac_neighbor_table_mac64_list_t mac64_index[MAC_NEIGHBOR_TABLE_INDEX_SIZE]; /*!< Active neighbors by hash of MAC64 */
+    mac_neighbor_table_mac16_list_t mac16_index[MAC_NEIGHBOR_TABLE_INDEX_SIZE]; /*!< Active neighbors with a MAC16, by MAC16 */
     uint32_t nud_threshold;                                 /*!< NUD threshold time which generates keep alive message */
-    uint8_t list_total_size;                                /*!< Total number allocated neighbor entries */
+    uint16_t list_total_size;                               /*!< Total number allocated neighbor entries */
     uint8_t active_nud_process;                             /*!< Indicate Active NUD Process */
-    uint8_t neighbour_list_size;                            /*!< Active Neighbor list size */
+    uint16_t neighbour_list_size;                           /*!< Active Neighbor list size */
     void *table_user_identifier;                            /*!< Table user identifier like interface pointer */
     neighbor_entry_remove_notify *user_remove_notify_cb;    /*!< Neighbor Remove Callback notify */
     neighbor_entry_nud_notify *user_nud_notify_cb;          /*!< Trig NUD process for neighbor */
@@ -105,10 +117,10 @@ typedef struct mac_neighbor_table {
  * \param user_indentifier user identifier pointer like interface pointer
  *
  * \return pointer to neighbor table class when create is OK
- * \return NULL when memory allocation happen
+ * \return NULL when memory allocation happen or table_size exceeds MAC_NEIGHBOR_TABLE_SIZE_MAX
  *
  */
-mac_neighbor_table_t *mac_neighbor_table_create(uint8_t table_size, neighbor_entry_remove_notify *remove_cb, neighbor_entry_nud_notify *nud_cb, void *user_indentifier);
+mac_neighbor_table_t *mac_neighbor_table_create(uint16_t table_size, neighbor_entry_remove_notify *remove_cb, neighbor_entry_nud_notify *nud_cb, void *user_indentifier);
 
 /**
  * mac_neighbor_table_delete Delete Neigbor table class
@@ -182,6 +194,15 @@ void mac_neighbor_table_neighbor_connected(mac_neighbor_table_t *table_class, ma
  */
 void mac_neighbor_table_trusted_neighbor(mac_neighbor_table_t *table_class, mac_neighbor_table_entry_t *neighbor_entry, bool trusted_device);
 
+/**
+ * mac_neighbor_table_mac16_set Set the 16-bit MAC address of a neighbor
+ *
+ * \param table_class pointer to table class
+ * \param neighbor_entry pointer to updated entry
+ * \param mac16 16-bit MAC address, 0xffff when unknown
+ */
+void mac_neighbor_table_mac16_set(mac_neighbor_table_t *table_class, mac_neighbor_table_entry_t *neighbor_entry, uint16_t mac16);
+
 /**
  * mac_neighbor_table_address_discover Discover neighbor from list by address
  *
@@ -201,7 +222,7 @@ mac_neighbor_table_entry_t *mac_neighbor_table_address_discover(mac_neighbor_tab
  *
  *  \return pointer to discover neighbor entry if it exist
  */
-mac_neighbor_table_entry_t *mac_neighbor_table_attribute_discover(mac_neighbor_table_t *table_class, uint8_t index);
+mac_neighbor_table_entry_t *mac_neighbor_table_attribute_discover(mac_neighbor_table_t *table_class, uint16_t index);
 
 mac_neighbor_table_entry_t *mac_neighbor_entry_get_by_ll64(mac_neighbor_table_t *table_class, const uint8_t *ipv6Address, bool allocateNew, bool *new_entry_allocated);
 
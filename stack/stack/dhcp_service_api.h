@@ -121,7 +121,7 @@ typedef void (dhcp_relay_neighbour_cb)(int8_t interface, uint8_t ll_addr[static
 
 #ifdef HAVE_WS_BORDER_ROUTER
 int dhcp_service_get_server_socket_fd();
-void recv_dhcp_server_msg();
+int recv_dhcp_server_msg();
 #endif
 
 /**
@@ -71,6 +71,14 @@ typedef struct nwk_stats_t {
     uint16_t adapt_layer_tx_queue_peak; /**< Adaptation layer direct TX queue size peak. */
     uint32_t adapt_layer_tx_congestion_drop; /**< Adaptation layer direct TX randon early detection drop packet. */
     uint16_t adapt_layer_tx_latency_max; /**< Adaptation layer latency between TX request and TX ready in seconds (MAX). */
+    /* MPL */
+    uint32_t mpl_total_memory;      /**< MPL message storage allocated, free blocks included. */
+    uint32_t mpl_used_memory;       /**< MPL message storage holding buffered messages. */
+    uint32_t mpl_message_evicted;   /**< MPL buffered messages evicted for space count. */
+    /* LLC */
+    uint16_t llc_message_pool_used;     /**< LLC message pool entries in use. */
+    uint16_t llc_message_pool_peak;     /**< LLC message pool entries in use (MAX). */
+    uint32_t llc_message_pool_overflow; /**< LLC messages allocated from the heap count. */
 } nwk_stats_t;
 
 /**
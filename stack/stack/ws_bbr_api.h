@@ -392,8 +392,8 @@ int ws_bbr_key_storage_settings_set(int8_t interface_id, uint8_t alloc_max_numbe
 
 int ws_bbr_eapol_relay_get_socket_fd();
 int ws_bbr_eapol_auth_relay_get_socket_fd();
-void ws_bbr_eapol_relay_socket_cb(int fd);
-void ws_bbr_eapol_auth_relay_socket_cb(int fd);
+int ws_bbr_eapol_relay_socket_cb(int fd);
+int ws_bbr_eapol_auth_relay_socket_cb(int fd);
 
 /**
  * Set RADIUS server IPv6 address
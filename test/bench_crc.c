@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2022 Silicon Laboratories Inc. (www.silabs.com)
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of the Silicon Labs Master Software License
+ * Agreement (MSLA) available at [1].  This software is distributed to you in
+ * Object Code format and/or Source Code format and is governed by the sections
+ * of the MSLA applicable to Object Code, Source Code and Modified Open Source
+ * Code. By using this software, you agree to the terms of the MSLA.
+ *
+ * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
+ */
+#include "common/crc.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "common/utils.h"
+#include "common/log.h"
+
+/*
+ * Check crc16() and crc16_update() against a bitwise reference, then compare
+ * the throughput of the bitwise, byte-wise and slicing-by-8 variants.
+ *
+ *   bench_crc [MBYTES]
+ */
+
+static uint16_t crc16_bitwise(const uint8_t *data, int len)
+{
+    uint16_t crc = 0xFFFF;
+    int i;
+
+    while (len--) {
+        crc ^= *data++;
+        for (i = 0; i < 8; i++)
+            crc = crc & 1 ? (crc >> 1) ^ 0x8408 : crc >> 1;
+    }
+    return crc ^ 0xFFFF;
+}
+
+static uint16_t crc16_bytewise(const uint8_t *data, int len)
+{
+    uint16_t crc = 0xFFFF;
+
+    while (len--)
+        crc = crc_table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xFFFF;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void check(void)
+{
+    uint8_t buf[1024];
+    int i, len, split;
+
+    FATAL_ON(crc16((const uint8_t *)"123456789", 9) != 0x906e, 1, "bad check value");
+    for (i = 0; i < 10000; i++) {
+        len = rand() % sizeof(buf);
+        split = len ? rand() % len : 0;
+        for (int j = 0; j < len; j++)
+            buf[j] = rand();
+        FATAL_ON(crc16(buf, len) != crc16_bitwise(buf, len), 1, "crc16 len %d", len);
+        FATAL_ON(crc16_bytewise(buf, len) != crc16_bitwise(buf, len), 1, "crc16_bytewise len %d", len);
+        FATAL_ON(crc16_update(crc16_update(0, buf, split), buf + split, len - split) != crc16(buf, len),
+                 1, "crc16_update len %d split %d", len, split);
+    }
+}
+
+static void bench(const char *name, uint16_t (*fn)(const uint8_t *, int), int len, size_t total)
+{
+    static volatile uint16_t sink;
+    uint8_t buf[2048];
+    uint64_t start, elapsed;
+    size_t i, count = total / len;
+
+    for (i = 0; i < sizeof(buf); i++)
+        buf[i] = rand();
+    start = now_ns();
+    for (i = 0; i < count; i++)
+        sink ^= fn(buf, len);
+    elapsed = now_ns() - start;
+    printf("%-10s %5d bytes: %8.1f MB/s\n", name, len, (double)count * len * 1000 / (elapsed ? elapsed : 1));
+}
+
+int main(int argc, char **argv)
+{
+    size_t total = (argc > 1 ? atoi(argv[1]) : 4) * 1000000ULL;
+    static const int lens[] = { 16, 256, 2048 };
+    int i;
+
+    srand(1);
+    check();
+    for (i = 0; i < ARRAY_SIZE(lens); i++) {
+        bench("bitwise", crc16_bitwise, lens[i], total / 8);
+        bench("bytewise", crc16_bytewise, lens[i], total);
+        bench("slice-by-8", crc16, lens[i], total);
+    }
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2022 Silicon Laboratories Inc. (www.silabs.com)
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of the Silicon Labs Master Software License
+ * Agreement (MSLA) available at [1].  This software is distributed to you in
+ * Object Code format and/or Source Code format and is governed by the sections
+ * of the MSLA applicable to Object Code, Source Code and Modified Open Source
+ * Code. By using this software, you agree to the terms of the MSLA.
+ *
+ * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
+ */
+#include "ipv6_stack/ipv6_routing_table.c"
+#include <time.h>
+
+/*
+ * Cost of the next hop selection of the border router: ROUTES /128 routes
+ * (one per RPL target), an on-link /64 and a default route. The results of
+ * ipv6_route_choose_next_hop() are checked against a walk of the whole
+ * routing table, which is also timed for comparison.
+ *
+ *   bench_ipv6_routing_table [ROUTES [LOOKUPS]]
+ */
+
+#define INTERFACE_ID 1
+
+int protocol_core_buffers_in_event_queue;
+
+static ipv6_neighbour_cache_t ncache = {
+    .interface_id = INTERFACE_ID,
+};
+
+ipv6_neighbour_cache_t *ipv6_neighbour_cache_by_interface_id(int8_t interface_id)
+{
+    return interface_id == INTERFACE_ID ? &ncache : NULL;
+}
+
+bool addr_ipv6_equal(const uint8_t a[16], const uint8_t b[16])
+{
+    return !memcmp(a, b, 16);
+}
+
+static const uint8_t prefix[16] = { 0x20, 0x01, 0x0d, 0xb8 };
+
+static void target_addr(uint8_t addr[16], int i)
+{
+    memcpy(addr, prefix, 16);
+    addr[8] = 0x02;
+    addr[13] = i >> 16;
+    addr[14] = i >> 8;
+    addr[15] = i;
+}
+
+static void next_hop_addr(uint8_t addr[16], int i)
+{
+    memset(addr, 0, 16);
+    addr[0] = 0xfe;
+    addr[1] = 0x80;
+    addr[15] = i % 50 + 1;
+}
+
+// Destination number i of the lookups: a target, or an address of the /64
+// without route, or an address outside of the /64
+static void dest_addr(uint8_t addr[16], int i, int routes)
+{
+    switch (i % 4) {
+    case 0:
+        memcpy(addr, prefix, 16);
+        addr[8] = 0x04;
+        addr[15] = i;
+        break;
+    case 1:
+        memset(addr, 0, 16);
+        addr[0] = 0x2a;
+        addr[15] = i;
+        break;
+    default:
+        target_addr(addr, i % routes);
+        break;
+    }
+}
+
+// Longest prefix match over the whole table, like the lookups used to do
+static ipv6_route_t *linear_lookup(const uint8_t *addr)
+{
+    ipv6_route_t *best = NULL;
+
+    ns_list_foreach(ipv6_route_t, route, &ipv6_routing_table) {
+        if (route->search_skip || bitcmp(addr, route->prefix, route->prefix_len))
+            continue;
+        if (!best || ipv6_route_is_better(route, best))
+            best = route;
+    }
+    return best;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    int routes = argc > 1 ? atoi(argv[1]) : 10000;
+    int lookups = argc > 2 ? atoi(argv[2]) : 100000;
+    int linear_lookups = lookups / 100 ? lookups / 100 : 1;
+    static volatile uintptr_t sink;
+    uint8_t addr[16], next_hop[16];
+    uint64_t start, indexed_ns, linear_ns;
+    int i;
+
+    FATAL_ON(routes < 1, 1, "at least 1 route is needed");
+    next_hop_addr(next_hop, 0);
+    FATAL_ON(!ipv6_route_add(prefix, 0, INTERFACE_ID, next_hop, ROUTE_STATIC, 0xFFFFFFFF, 0), 1, "default route");
+    FATAL_ON(!ipv6_route_add(prefix, 64, INTERFACE_ID, NULL, ROUTE_STATIC, 0xFFFFFFFF, 0), 1, "on-link route");
+    for (i = 0; i < routes; i++) {
+        target_addr(addr, i);
+        next_hop_addr(next_hop, i);
+        FATAL_ON(!ipv6_route_add(addr, 128, INTERFACE_ID, next_hop, ROUTE_RPL_DAO_SR, 0xFFFFFFFF, 0),
+                 1, "route %d", i);
+    }
+
+    for (i = 0; i < 1000; i++) {
+        dest_addr(addr, i, routes);
+        FATAL_ON(ipv6_route_choose_next_hop(addr, -1, NULL) != linear_lookup(addr), 1, "lookup %d", i);
+    }
+
+    start = now_ns();
+    for (i = 0; i < lookups; i++) {
+        dest_addr(addr, i, routes);
+        sink ^= (uintptr_t)ipv6_route_choose_next_hop(addr, -1, NULL);
+    }
+    indexed_ns = now_ns() - start;
+    start = now_ns();
+    for (i = 0; i < linear_lookups; i++) {
+        dest_addr(addr, i, routes);
+        sink ^= (uintptr_t)linear_lookup(addr);
+    }
+    linear_ns = now_ns() - start;
+    printf("%d routes: %llu ns per lookup (whole table walk: %llu ns)\n", routes,
+           (unsigned long long)indexed_ns / lookups, (unsigned long long)linear_ns / linear_lookups);
+
+    // Remove half of the targets, check the index against the table
+    for (i = 0; i < routes; i += 2) {
+        target_addr(addr, i);
+        next_hop_addr(next_hop, i);
+        FATAL_ON(ipv6_route_delete(addr, 128, INTERFACE_ID, next_hop, ROUTE_RPL_DAO_SR), 1, "delete %d", i);
+    }
+    for (i = 0; i < routes; i++) {
+        target_addr(addr, i);
+        FATAL_ON(ipv6_route_choose_next_hop(addr, -1, NULL) != linear_lookup(addr), 1, "lookup %d after delete", i);
+    }
+
+    ipv6_route_table_remove_interface(INTERFACE_ID);
+    FATAL_ON(!ns_list_is_empty(&ipv6_routing_table), 1, "routes left");
+    for (i = 0; i <= 128; i++)
+        FATAL_ON(ipv6_route_index_len_count[i], 1, "/%d routes left in the index", i);
+    return 0;
+}
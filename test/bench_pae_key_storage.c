@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2022 Silicon Laboratories Inc. (www.silabs.com)
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of the Silicon Labs Master Software License
+ * Agreement (MSLA) available at [1].  This software is distributed to you in
+ * Object Code format and/or Source Code format and is governed by the sections
+ * of the MSLA applicable to Object Code, Source Code and Modified Open Source
+ * Code. By using this software, you agree to the terms of the MSLA.
+ *
+ * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
+ */
+#include "6lowpan/ws/ws_pae_key_storage.c"
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "common/log.h"
+
+/*
+ * Startup time of the authenticator key storage with SUPPLICANTS stored
+ * supplicants: the key storage journal is written, then read back as after a
+ * restart of the border router. All the supplicants are then looked up and
+ * their keys are checked.
+ *
+ *   bench_pae_key_storage [SUPPLICANTS]
+ */
+
+static void supp_init(supp_entry_t *supp, int i)
+{
+    memset(supp, 0, sizeof(*supp));
+    supp->addr.eui_64[0] = 0x02;
+    supp->addr.eui_64[6] = i >> 8;
+    supp->addr.eui_64[7] = i;
+    supp->sec_keys.pmk_set = true;
+    supp->sec_keys.ptk_set = true;
+    supp->sec_keys.ptk_eui_64_set = true;
+    supp->sec_keys.pmk_lifetime = 3600 * 24 * 30;
+    supp->sec_keys.ptk_lifetime = 3600 * 24 * 7;
+    memset(supp->sec_keys.pmk, i, PMK_LEN);
+    memset(supp->sec_keys.ptk, ~i, PTK_LEN);
+    memcpy(supp->sec_keys.ptk_eui_64, supp->addr.eui_64, 8);
+}
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// Same state as a new process
+static void key_storage_restart(void)
+{
+    ws_pae_key_storage_delete();
+    memset(&key_storage_params, 0, sizeof(key_storage_params));
+}
+
+int main(int argc, char **argv)
+{
+    int supplicants = argc > 1 ? atoi(argv[1]) : 5000;
+    key_storage_array_t *key_storage_array;
+    sec_prot_keys_storage_t *key_storage;
+    uint64_t start, startup, lookups;
+    char dir[64], path[128];
+    supp_entry_t supp;
+    struct stat st;
+    int i, ret;
+
+    FATAL_ON(supplicants > DEFAULT_NUMBER_OF_STORAGES * DEFAULT_NUMBER_OF_ENTRIES_IN_ONE_STORAGE,
+             1, "at most %d supplicants", DEFAULT_NUMBER_OF_STORAGES * DEFAULT_NUMBER_OF_ENTRIES_IN_ONE_STORAGE);
+    snprintf(dir, sizeof(dir), "/tmp/bench_pae_key_storage-%d/", getpid());
+    ret = mkdir(dir, 0700);
+    FATAL_ON(ret < 0, 1, "mkdir: %s: %m", dir);
+    ns_file_system_set_root_path(dir);
+
+    ws_pae_key_storage_init();
+    ws_pae_key_storage_read(0);
+    for (i = 0; i < supplicants; i++) {
+        supp_init(&supp, i);
+        FATAL_ON(ws_pae_key_storage_supp_write(NULL, &supp) < 0, 1, "write %d", i);
+    }
+    ws_pae_key_storage_store();
+    key_storage_restart();
+    snprintf(path, sizeof(path), "%s%s", dir, KEY_STORAGE_JOURNAL_FILE);
+    ret = stat(path, &st);
+    FATAL_ON(ret < 0, 1, "stat: %s: %m", path);
+
+    start = now_us();
+    ws_pae_key_storage_init();
+    ws_pae_key_storage_read(1);
+    startup = now_us() - start;
+
+    start = now_us();
+    for (i = 0; i < supplicants; i++) {
+        supp_init(&supp, i);
+        key_storage = ws_pae_key_storage_get(NULL, supp.addr.eui_64, &key_storage_array, false);
+        FATAL_ON(!key_storage, 1, "supplicant %d not found", i);
+        FATAL_ON(!key_storage->pmk_set || memcmp(key_storage->pmk, supp.sec_keys.pmk, PMK_LEN),
+                 1, "supplicant %d: bad PMK", i);
+        FATAL_ON(!key_storage->ptk_set || memcmp(key_storage->ptk, supp.sec_keys.ptk, PTK_LEN),
+                 1, "supplicant %d: bad PTK", i);
+    }
+    lookups = now_us() - start;
+
+    printf("%d supplicants, journal %lld bytes: startup in %llu us, %llu ns per lookup\n",
+           supplicants, (long long)st.st_size, (unsigned long long)startup,
+           (unsigned long long)lookups * 1000 / (supplicants ? supplicants : 1));
+
+    key_storage_restart();
+    ws_pae_key_journal_remove();
+    ws_pae_key_journal_init(NULL, 0);
+    ret = rmdir(dir);
+    FATAL_ON(ret < 0, 1, "rmdir: %s: %m", dir);
+    return 0;
+}
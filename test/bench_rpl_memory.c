@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2022 Silicon Laboratories Inc. (www.silabs.com)
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of the Silicon Labs Master Software License
+ * Agreement (MSLA) available at [1].  This software is distributed to you in
+ * Object Code format and/or Source Code format and is governed by the sections
+ * of the MSLA applicable to Object Code, Source Code and Modified Open Source
+ * Code. By using this software, you agree to the terms of the MSLA.
+ *
+ * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
+ */
+#include "rpl/rpl_downward.c"
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Memory used by the RPL root per node, and the cost of the DAO target lookups.
+ * NODES targets are created, each with one transit towards a random node
+ * created before it (or the root). The indexed lookups are checked against
+ * the linear walk of the target list.
+ *
+ *   bench_rpl_memory [NODES]
+ */
+
+struct wsbr_ctxt g_ctxt;
+uint32_t protocol_core_monotonic_time;
+
+static const uint8_t root_addr[16] = { 0x20, 0x01, [15] = 0x01 };
+static size_t alloc_total;
+
+void *rpl_alloc(uint16_t size)
+{
+    alloc_total += size;
+    return malloc(size);
+}
+
+void rpl_free(void *p, uint16_t size)
+{
+    if (p)
+        alloc_total -= size;
+    free(p);
+}
+
+int8_t protocol_interface_address_compare(const uint8_t *addr)
+{
+    return memcmp(addr, root_addr, 16) ? -1 : 0;
+}
+
+uint16_t rpl_policy_modify_downward_cost_to_root_neighbour(rpl_domain_t *domain, int8_t interface_id,
+                                                           const uint8_t *next_hop, uint16_t cost)
+{
+    return cost;
+}
+
+bool rpl_policy_dao_trigger_after_srh_error(rpl_domain_t *domain, uint32_t seconds_since_last_dao_trigger,
+                                            uint16_t errors_since_last_dao_trigger, uint_fast16_t targets)
+{
+    return false;
+}
+
+uint8_t rpl_seq_init(void)
+{
+    return 0;
+}
+
+void ipv6_route_table_remove_info(int8_t interface_id, ipv6_route_src_t source, void *info)
+{
+}
+
+void rpl_data_sr_invalidate(void)
+{
+}
+
+void tun_del_node(const uint8_t address[16])
+{
+}
+
+static void node_addr(uint8_t addr[16], int i)
+{
+    memcpy(addr, root_addr, 16);
+    addr[13] = i >> 16;
+    addr[14] = i >> 8;
+    addr[15] = i + 2;
+}
+
+static rpl_dao_target_t *linear_lookup(rpl_instance_t *instance, const uint8_t *prefix, uint8_t prefix_len)
+{
+    ns_list_foreach(rpl_dao_target_t, target, &instance->dao_targets)
+        if (target->prefix_len == prefix_len && !bitcmp(target->prefix, prefix, prefix_len))
+            return target;
+    return NULL;
+}
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+int main(int argc, char **argv)
+{
+    int nodes = argc > 1 ? atoi(argv[1]) : 1000;
+    rpl_dao_target_t **targets;
+    rpl_instance_t instance = { };
+    rpl_domain_t domain = { };
+    size_t alloc_targets;
+    uint64_t start;
+    uint8_t addr[16];
+    int i, parent;
+
+    srand(1);
+    targets = malloc(nodes * sizeof(*targets));
+    FATAL_ON(!targets, 1, "malloc: %m");
+    ns_list_init(&instance.dao_targets);
+    instance.domain = &domain;
+
+    for (i = 0; i < nodes; i++) {
+        node_addr(addr, i);
+        targets[i] = rpl_create_dao_target(&instance, addr, 128, true);
+        FATAL_ON(!targets[i], 1, "rpl_create_dao_target");
+    }
+    alloc_targets = alloc_total;
+    for (i = 0; i < nodes; i++) {
+        parent = rand() % (i + 1) - 1;
+        if (parent < 0)
+            memcpy(addr, root_addr, 16);
+        else
+            node_addr(addr, parent);
+        rpl_downward_add_root_transit(targets[i], addr, PCBIT(0));
+    }
+    rpl_downward_compute_paths(&instance);
+    FATAL_ON(!instance.root_paths_valid, 1, "paths not computed");
+    for (i = 0; i < nodes; i++)
+        FATAL_ON(targets[i]->info.root.cost == 0xFFFFFFFF, 1, "node %d unreachable", i);
+
+    printf("%d nodes: %zu bytes per node (targets and index %zu, transits %zu), index %u buckets\n",
+           nodes, alloc_total / nodes, alloc_targets / nodes, (alloc_total - alloc_targets) / nodes,
+           instance.dao_target_index->size);
+
+    start = now_us();
+    for (i = 0; i < nodes; i++) {
+        node_addr(addr, i);
+        FATAL_ON(rpl_instance_lookup_dao_target(&instance, addr, 128) != targets[i], 1, "lookup %d", i);
+    }
+    printf("%d lookups in %llu us\n", nodes, (unsigned long long)(now_us() - start));
+
+    // Remove half of the nodes, check the index against the list
+    for (i = 0; i < nodes; i += 2)
+        rpl_delete_dao_target(&instance, targets[i]);
+    for (i = 0; i < nodes; i++) {
+        node_addr(addr, i);
+        FATAL_ON(rpl_instance_lookup_dao_target(&instance, addr, 128) != linear_lookup(&instance, addr, 128),
+                 1, "lookup %d after delete", i);
+        FATAL_ON(rpl_instance_match_dao_target(&instance, addr, 128) != linear_lookup(&instance, addr, 128),
+                 1, "match %d after delete", i);
+    }
+
+    ns_list_foreach_safe(rpl_dao_target_t, target, &instance.dao_targets)
+        rpl_delete_dao_target(&instance, target);
+    rpl_free(instance.dao_target_index, RPL_DAO_TARGET_INDEX_ALLOC_SIZE(instance.dao_target_index->size));
+    FATAL_ON(alloc_total, 1, "%zu bytes leaked", alloc_total);
+    free(targets);
+    return 0;
+}
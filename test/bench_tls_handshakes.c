@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2022 Silicon Laboratories Inc. (www.silabs.com)
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of the Silicon Labs Master Software License
+ * Agreement (MSLA) available at [1].  This software is distributed to you in
+ * Object Code format and/or Source Code format and is governed by the sections
+ * of the MSLA applicable to Object Code, Source Code and Modified Open Source
+ * Code. By using this software, you agree to the terms of the MSLA.
+ *
+ * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
+ */
+#include "security/protocols/tls_sec_prot/tls_sec_prot_lib.c"
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*
+ * EAP-TLS handshakes per second of the authenticator, with the credentials
+ * parsed once and shared by the sessions, then with the credentials parsed
+ * again for each session (as if the certificates had changed). The
+ * supplicants run in the same process with the certificates of examples/.
+ * Sessions are started by batches of BATCH, like when many nodes join at
+ * once.
+ *
+ *   bench_tls_handshakes [HANDSHAKES [EXAMPLES_DIR]]
+ */
+
+#define BATCH 16
+
+struct peer {
+    tls_security_t *sec;
+    struct peer *remote;
+    uint8_t rx[16384];
+    size_t rx_len;
+    size_t rx_off;
+    bool done;
+};
+
+// No worker threads here
+bool tls_sec_prot_worker_enabled(void)
+{
+    return false;
+}
+
+static int16_t peer_send(void *handle, const void *buf, size_t len)
+{
+    struct peer *peer = handle;
+    struct peer *remote = peer->remote;
+
+    if (remote->rx_off == remote->rx_len)
+        remote->rx_off = remote->rx_len = 0;
+    FATAL_ON(remote->rx_len + len > sizeof(remote->rx), 1, "rx buffer overflow");
+    memcpy(remote->rx + remote->rx_len, buf, len);
+    remote->rx_len += len;
+    return len;
+}
+
+static int16_t peer_receive(void *handle, unsigned char *buf, size_t len)
+{
+    struct peer *peer = handle;
+
+    if (peer->rx_off == peer->rx_len)
+        return TLS_SEC_PROT_LIB_NO_DATA;
+    if (len > peer->rx_len - peer->rx_off)
+        len = peer->rx_len - peer->rx_off;
+    memcpy(buf, peer->rx + peer->rx_off, len);
+    peer->rx_off += len;
+    return len;
+}
+
+static void peer_export_keys(void *handle, const uint8_t *master_secret, const uint8_t *eap_tls_key_material)
+{
+}
+
+static void peer_set_timer(void *handle, uint32_t inter, uint32_t fin)
+{
+}
+
+static int8_t peer_get_timer(void *handle)
+{
+    return TLS_SEC_PROT_LIB_TIMER_NO_EXPIRY;
+}
+
+static void peer_connect(struct peer *peer, struct peer *remote, bool is_server,
+                         const uint8_t *eui_64, const sec_prot_certs_t *certs)
+{
+    memset(peer, 0, sizeof(*peer));
+    peer->remote = remote;
+    peer->sec = malloc(tls_sec_prot_lib_size());
+    FATAL_ON(!peer->sec, 1, "malloc: %m");
+    FATAL_ON(tls_sec_prot_lib_init(peer->sec) < 0, 1, "tls_sec_prot_lib_init");
+    tls_sec_prot_lib_set_cb_register(peer->sec, peer, peer_send, peer_receive,
+                                     peer_export_keys, peer_set_timer, peer_get_timer);
+    FATAL_ON(tls_sec_prot_lib_connect(peer->sec, is_server, eui_64, certs) < 0, 1, "tls_sec_prot_lib_connect");
+}
+
+static void peer_process(struct peer *peer)
+{
+    int8_t ret;
+
+    if (peer->done)
+        return;
+    ret = tls_sec_prot_lib_process(peer->sec);
+    FATAL_ON(ret == TLS_SEC_PROT_LIB_ERROR, 1, "handshake error");
+    if (ret == TLS_SEC_PROT_LIB_HANDSHAKE_OVER)
+        peer->done = true;
+}
+
+static void peer_free(struct peer *peer)
+{
+    tls_sec_prot_lib_free(peer->sec);
+    free(peer->sec);
+}
+
+// Same as read_cert() of app_wsbrd/commandline.c: the PEM data given to
+// mbed TLS must include the terminating null byte.
+static uint8_t *read_pem(const char *dir, const char *name, uint16_t *len)
+{
+    char path[4096];
+    struct stat st;
+    uint8_t *buf;
+    int fd, ret;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    fd = open(path, O_RDONLY);
+    FATAL_ON(fd < 0, 1, "open: %s: %m", path);
+    ret = fstat(fd, &st);
+    FATAL_ON(ret < 0, 1, "fstat: %s: %m", path);
+    buf = malloc(st.st_size + 1);
+    FATAL_ON(!buf, 1, "malloc: %m");
+    ret = read(fd, buf, st.st_size);
+    FATAL_ON(ret != st.st_size, 1, "read: %s: %m", path);
+    close(fd);
+    buf[st.st_size] = 0;
+    *len = st.st_size + 1;
+    return buf;
+}
+
+static void certs_load(sec_prot_certs_t *certs, const char *dir, const char *cert, const char *key)
+{
+    cert_chain_entry_t *trusted;
+    uint16_t len;
+    uint8_t *buf;
+
+    sec_prot_certs_init(certs);
+    buf = read_pem(dir, cert, &len);
+    sec_prot_certs_cert_set(&certs->own_cert_chain, 0, buf, len);
+    buf = read_pem(dir, key, &len);
+    FATAL_ON(len > UINT8_MAX, 1, "%s: key too long", key);
+    sec_prot_certs_priv_key_set(&certs->own_cert_chain, buf, len);
+    certs->own_cert_chain_len = sec_prot_certs_cert_chain_entry_len_get(&certs->own_cert_chain);
+    trusted = sec_prot_certs_chain_entry_create();
+    FATAL_ON(!trusted, 1, "sec_prot_certs_chain_entry_create");
+    buf = read_pem(dir, "ca_cert.pem", &len);
+    sec_prot_certs_cert_set(trusted, 0, buf, len);
+    sec_prot_certs_chain_list_add(&certs->trusted_cert_chain_list, trusted);
+    sec_prot_certs_updated(certs);
+}
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void run(sec_prot_certs_t *br_certs, sec_prot_certs_t *node_certs, int handshakes, bool reparse)
+{
+    static struct peer servers[BATCH], clients[BATCH];
+    uint32_t full_start, full, resumed;
+    uint8_t eui_64[8] = { };
+    uint64_t start, elapsed;
+    int i, n, step, count;
+
+    tls_sec_prot_lib_handshakes_get(&full_start, &resumed);
+    start = now_us();
+    for (n = 0; n < handshakes; n += count) {
+        count = handshakes - n < BATCH ? handshakes - n : BATCH;
+        for (i = 0; i < count; i++) {
+            if (reparse)
+                sec_prot_certs_updated(br_certs);
+            // The supplicants never offer a session to resume
+            eui_64[7] = n + i;
+            eui_64[6] = (n + i) >> 8;
+            peer_connect(&servers[i], &clients[i], true, eui_64, br_certs);
+        }
+        for (i = 0; i < count; i++)
+            peer_connect(&clients[i], &servers[i], false, eui_64, node_certs);
+        for (i = 0; i < count; i++) {
+            for (step = 0; step < 100 && !(clients[i].done && servers[i].done); step++) {
+                peer_process(&clients[i]);
+                peer_process(&servers[i]);
+            }
+            FATAL_ON(step == 100, 1, "handshake %d did not complete", n + i);
+        }
+        for (i = 0; i < count; i++) {
+            peer_free(&servers[i]);
+            peer_free(&clients[i]);
+        }
+    }
+    elapsed = now_us() - start;
+    tls_sec_prot_lib_handshakes_get(&full, &resumed);
+    FATAL_ON(full - full_start != handshakes, 1, "%u full handshakes counted", full - full_start);
+    // Both sides run in this process, so this is a lower bound of the
+    // handshakes per second of the authenticator alone
+    printf("%s credentials: %d handshakes in %llu ms: %.1f handshakes/s\n",
+           reparse ? "parsed" : "shared", handshakes, (unsigned long long)elapsed / 1000,
+           handshakes * 1000000.0 / (elapsed ? elapsed : 1));
+}
+
+int main(int argc, char **argv)
+{
+    int handshakes = argc > 1 ? atoi(argv[1]) : 32;
+    const char *dir = argc > 2 ? argv[2] : "examples";
+    sec_prot_certs_t br_certs, node_certs;
+
+    certs_load(&br_certs, dir, "br_cert.pem", "br_key.pem");
+    certs_load(&node_certs, dir, "node_cert.pem", "node_key.pem");
+    run(&br_certs, &node_certs, handshakes, false);
+    run(&br_certs, &node_certs, handshakes, true);
+    FATAL_ON(tls_sec_prot_lib_creds && tls_sec_prot_lib_creds->refcount != 1, 1, "credentials leaked");
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2022 Silicon Laboratories Inc. (www.silabs.com)
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of the Silicon Labs Master Software License
+ * Agreement (MSLA) available at [1].  This software is distributed to you in
+ * Object Code format and/or Source Code format and is governed by the sections
+ * of the MSLA applicable to Object Code, Source Code and Modified Open Source
+ * Code. By using this software, you agree to the terms of the MSLA.
+ *
+ * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
+ */
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include "common/log.h"
+
+/*
+ * Throughput of wssimserver in a full mesh: NODES clients send FRAMES frames
+ * each, and every frame must be received by all the other clients.
+ *
+ *   bench_wssimserver WSSIMSERVER [NODES [FRAMES]]
+ */
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static pid_t server_start(const char *server, const char *path)
+{
+    pid_t pid;
+    int i;
+
+    pid = fork();
+    FATAL_ON(pid < 0, 1, "fork: %m");
+    if (!pid) {
+        execl(server, server, path, NULL);
+        FATAL(1, "execl: %s: %m", server);
+    }
+    // Wait for the socket to be created
+    for (i = 0; i < 500 && access(path, F_OK); i++)
+        usleep(10000);
+    FATAL_ON(i == 500, 1, "%s did not start", server);
+    return pid;
+}
+
+static int node_connect(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int fd, ret;
+
+    strcpy(addr.sun_path, path);
+    fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    FATAL_ON(fd < 0, 1, "socket: %m");
+    ret = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+    FATAL_ON(ret < 0, 1, "connect: %s: %m", path);
+    return fd;
+}
+
+// Receive the frames of one round, check that each node got one frame from
+// each of the others
+static void round_recv(struct pollfd *pfds, int nodes, int round, uint8_t *seen)
+{
+    uint8_t buf[256];
+    int missing = nodes * (nodes - 1);
+    int i, ret, src;
+
+    memset(seen, 0, nodes * nodes);
+    while (missing) {
+        ret = poll(pfds, nodes, 5000);
+        FATAL_ON(ret < 0, 1, "poll: %m");
+        FATAL_ON(!ret, 1, "round %d: %d frames lost", round, missing);
+        for (i = 0; i < nodes; i++) {
+            if (!(pfds[i].revents & POLLIN))
+                continue;
+            ret = recv(pfds[i].fd, buf, sizeof(buf), MSG_DONTWAIT);
+            FATAL_ON(ret < 8, 1, "recv: %m");
+            memcpy(&src, buf, sizeof(src));
+            FATAL_ON(memcmp(buf + 4, &round, sizeof(round)), 1, "frame from another round");
+            FATAL_ON(src == i || src >= nodes || seen[i * nodes + src], 1, "unexpected frame");
+            seen[i * nodes + src] = 1;
+            missing--;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    int nodes = argc > 2 ? atoi(argv[2]) : 16;
+    int frames = argc > 3 ? atoi(argv[3]) : 200;
+    uint8_t buf[128] = { };
+    struct pollfd *pfds;
+    uint64_t start, elapsed;
+    uint8_t *seen;
+    pid_t pid;
+    int i, round, ret;
+
+    FATAL_ON(argc < 2, 1, "usage: %s WSSIMSERVER [NODES [FRAMES]]", argv[0]);
+    FATAL_ON(nodes < 2, 1, "at least 2 nodes are needed");
+    snprintf(path, sizeof(path), "/tmp/bench_wssimserver-%d", getpid());
+    pid = server_start(argv[1], path);
+    pfds = calloc(nodes, sizeof(struct pollfd));
+    seen = malloc(nodes * nodes);
+    FATAL_ON(!pfds || !seen, 1, "malloc: %m");
+    for (i = 0; i < nodes; i++) {
+        pfds[i].fd = node_connect(path);
+        pfds[i].events = POLLIN;
+    }
+    // Let the server accept all the connections
+    usleep(100000);
+
+    start = now_us();
+    for (round = 0; round < frames; round++) {
+        for (i = 0; i < nodes; i++) {
+            memcpy(buf, &i, sizeof(i));
+            memcpy(buf + 4, &round, sizeof(round));
+            ret = send(pfds[i].fd, buf, sizeof(buf), 0);
+            FATAL_ON(ret != sizeof(buf), 1, "send: %m");
+        }
+        round_recv(pfds, nodes, round, seen);
+    }
+    elapsed = now_us() - start;
+
+    printf("%d nodes, %d frames sent, %llu frames delivered in %llu ms: %llu frames/s\n",
+           nodes, nodes * frames, (unsigned long long)nodes * (nodes - 1) * frames,
+           (unsigned long long)elapsed / 1000,
+           (unsigned long long)nodes * (nodes - 1) * frames * 1000000 / (elapsed ? elapsed : 1));
+
+    for (i = 0; i < nodes; i++)
+        close(pfds[i].fd);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    unlink(path);
+    free(pfds);
+    free(seen);
+    return 0;
+}
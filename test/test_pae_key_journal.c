@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2022 Silicon Laboratories Inc. (www.silabs.com)
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of the Silicon Labs Master Software License
+ * Agreement (MSLA) available at [1].  This software is distributed to you in
+ * Object Code format and/or Source Code format and is governed by the sections
+ * of the MSLA applicable to Object Code, Source Code and Modified Open Source
+ * Code. By using this software, you agree to the terms of the MSLA.
+ *
+ * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
+ */
+#include "6lowpan/ws/ws_pae_key_journal.c"
+#include <signal.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include "common/log.h"
+
+/*
+ * Crash safety of the key journal. The journal is damaged as after a power
+ * loss (truncated or corrupted tail) and reloaded: the replay must stop at the
+ * last valid record, the file must be truncated there and the next appends
+ * must be replayed. A rewrite must replace the journal atomically, and a
+ * failed rewrite or append must leave the previous journal readable.
+ *
+ *   test_pae_key_journal
+ */
+
+#define JOURNAL_VERSION 1
+#define RECORD_TYPE     1
+
+static struct {
+    uint32_t records[256];
+    int len;
+} replayed;
+
+static char path[128];
+static char tmp_path[160];
+
+static int replay(void *ctx, uint16_t type, const uint8_t *data, uint16_t len)
+{
+    FATAL_ON(type != RECORD_TYPE || len != 4, 1, "unexpected record type %u len %u", type, len);
+    FATAL_ON(replayed.len == ARRAY_SIZE(replayed.records), 1, "too many records");
+    replayed.records[replayed.len++] = common_read_32_bit(data);
+    return 0;
+}
+
+static void append(uint32_t first, uint32_t count)
+{
+    uint8_t data[4];
+
+    for (uint32_t i = first; i < first + count; i++) {
+        common_write_32_bit(i, data);
+        ws_pae_key_journal_append(RECORD_TYPE, data, sizeof(data));
+    }
+}
+
+static off_t file_size(const char *file)
+{
+    struct stat st;
+
+    if (stat(file, &st) < 0)
+        return -1;
+    return st.st_size;
+}
+
+// Reload the journal as after a restart, and check it contains the records
+// [0, count)
+static void check_load(uint32_t count)
+{
+    ws_pae_key_journal_init(path, JOURNAL_VERSION);
+    replayed.len = 0;
+    FATAL_ON(ws_pae_key_journal_load(replay, NULL) < 0, 1, "load failed");
+    FATAL_ON(replayed.len != count, 1, "replayed %d records, expected %u", replayed.len, count);
+    for (int i = 0; i < replayed.len; i++)
+        FATAL_ON(replayed.records[i] != i, 1, "record %d: found %u", i, replayed.records[i]);
+    FATAL_ON(file_size(path) != ws_pae_key_journal_size(), 1, "journal not truncated after the last record");
+}
+
+static void damage(off_t truncate_by, off_t corrupt_at_end)
+{
+    off_t size = file_size(path);
+    uint8_t byte;
+    int fd;
+
+    fd = open(path, O_RDWR);
+    FATAL_ON(fd < 0, 1, "open: %s: %m", path);
+    if (corrupt_at_end) {
+        FATAL_ON(pread(fd, &byte, 1, size - corrupt_at_end) != 1, 1, "pread: %m");
+        byte ^= 0xff;
+        FATAL_ON(pwrite(fd, &byte, 1, size - corrupt_at_end) != 1, 1, "pwrite: %m");
+    }
+    if (truncate_by)
+        FATAL_ON(ftruncate(fd, size - truncate_by) < 0, 1, "ftruncate: %m");
+    close(fd);
+}
+
+static void test_torn_tail(void)
+{
+    // Partial record: half of the payload of record 9 is missing
+    append(0, 4);
+    ws_pae_key_journal_commit(true);
+    append(4, 6);
+    ws_pae_key_journal_commit(false);
+    FATAL_ON(ws_pae_key_journal_sync() < 0, 1, "sync failed");
+    check_load(10);
+    damage(5, 0);
+    check_load(9);
+    append(9, 3);
+    ws_pae_key_journal_commit(false);
+    FATAL_ON(ws_pae_key_journal_sync() < 0, 1, "sync failed");
+    check_load(12);
+}
+
+static void test_corrupted_tail(void)
+{
+    // Valid length but bad CRC in the payload of the last record
+    damage(0, 3);
+    check_load(11);
+    // Only the type and the length of the last record are left
+    damage(4 + 2, 0);
+    check_load(10);
+    append(10, 2);
+    ws_pae_key_journal_commit(false);
+    FATAL_ON(ws_pae_key_journal_sync() < 0, 1, "sync failed");
+    check_load(12);
+}
+
+static void test_rewrite(void)
+{
+    append(0, 5);
+    ws_pae_key_journal_commit(true);
+    FATAL_ON(ws_pae_key_journal_sync() < 0, 1, "sync failed");
+    FATAL_ON(file_size(tmp_path) >= 0, 1, "%s left behind", tmp_path);
+    check_load(5);
+    // The appends after a rewrite reopen the new journal
+    append(5, 2);
+    ws_pae_key_journal_commit(false);
+    FATAL_ON(ws_pae_key_journal_sync() < 0, 1, "sync failed");
+    check_load(7);
+}
+
+static void test_failed_rewrite(void)
+{
+    // The temporary file cannot be created
+    FATAL_ON(mkdir(tmp_path, 0700) < 0, 1, "mkdir: %s: %m", tmp_path);
+    append(100, 3);
+    ws_pae_key_journal_commit(true);
+    FATAL_ON(ws_pae_key_journal_sync() == 0, 1, "rewrite did not fail");
+    FATAL_ON(!ws_pae_key_journal_failed(), 1, "journal not marked as failed");
+    // Appending after a lost commit would leave a hole
+    append(100, 1);
+    ws_pae_key_journal_commit(false);
+    ws_pae_key_journal_sync();
+    FATAL_ON(rmdir(tmp_path) < 0, 1, "rmdir: %s: %m", tmp_path);
+    // The previous journal is untouched
+    check_load(7);
+}
+
+static void test_failed_append(void)
+{
+    struct rlimit limit, saved;
+    off_t size = file_size(path);
+
+    // The file size limit lets the append write a partial record only
+    FATAL_ON(getrlimit(RLIMIT_FSIZE, &saved) < 0, 1, "getrlimit: %m");
+    limit = saved;
+    limit.rlim_cur = size + KEY_JOURNAL_RECORD_OVERHEAD + 4 + 3;
+    FATAL_ON(setrlimit(RLIMIT_FSIZE, &limit) < 0, 1, "setrlimit: %m");
+    append(7, 3);
+    ws_pae_key_journal_commit(false);
+    FATAL_ON(ws_pae_key_journal_sync() == 0, 1, "append did not fail");
+    FATAL_ON(setrlimit(RLIMIT_FSIZE, &saved) < 0, 1, "setrlimit: %m");
+    FATAL_ON(file_size(path) != size, 1, "journal not truncated after a failed append");
+    FATAL_ON(!ws_pae_key_journal_failed(), 1, "journal not marked as failed");
+    // Only a rewrite can recover
+    append(0, 8);
+    ws_pae_key_journal_commit(true);
+    FATAL_ON(ws_pae_key_journal_sync() < 0, 1, "sync failed");
+    FATAL_ON(ws_pae_key_journal_failed(), 1, "rewrite did not reset the failure");
+    append(8, 1);
+    ws_pae_key_journal_commit(false);
+    FATAL_ON(ws_pae_key_journal_sync() < 0, 1, "sync failed");
+    check_load(9);
+}
+
+int main(int argc, char **argv)
+{
+    char dir[64];
+    int ret;
+
+    // Writes beyond RLIMIT_FSIZE must fail with EFBIG
+    signal(SIGXFSZ, SIG_IGN);
+    snprintf(dir, sizeof(dir), "/tmp/test_pae_key_journal-%d", getpid());
+    ret = mkdir(dir, 0700);
+    FATAL_ON(ret < 0, 1, "mkdir: %s: %m", dir);
+    snprintf(path, sizeof(path), "%s/journal", dir);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    ws_pae_key_journal_init(path, JOURNAL_VERSION);
+    test_torn_tail();
+    test_corrupted_tail();
+    ws_pae_key_journal_remove();
+    ws_pae_key_journal_init(path, JOURNAL_VERSION);
+    test_rewrite();
+    test_failed_rewrite();
+    test_failed_append();
+
+    ws_pae_key_journal_remove();
+    ws_pae_key_journal_init(NULL, 0);
+    ret = rmdir(dir);
+    FATAL_ON(ret < 0, 1, "rmdir: %s: %m", dir);
+    return 0;
+}
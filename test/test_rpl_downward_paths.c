@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2022 Silicon Laboratories Inc. (www.silabs.com)
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of the Silicon Labs Master Software License
+ * Agreement (MSLA) available at [1].  This software is distributed to you in
+ * Object Code format and/or Source Code format and is governed by the sections
+ * of the MSLA applicable to Object Code, Source Code and Modified Open Source
+ * Code. By using this software, you agree to the terms of the MSLA.
+ *
+ * [1]: https://www.silabs.com/about-us/legal/master-software-license-agreement
+ */
+// Each incremental update of the paths is compared to a full computation
+#define RPL_DOWNWARD_PATHS_CHECK
+#include "rpl/rpl_downward.c"
+#include <stdio.h>
+
+/*
+ * Random transit additions, removals, errors and invalidations on a small
+ * graph (loops included). rpl_downward_paths_check() aborts if an incremental
+ * update gives other costs than a full computation.
+ *
+ *   test_rpl_downward_paths [SEEDS [STEPS]]
+ */
+
+#define NODES 60
+
+struct wsbr_ctxt g_ctxt;
+uint32_t protocol_core_monotonic_time;
+
+static const uint8_t root_addr[16] = { 0x20, 0x01, [15] = 0x01 };
+
+void *rpl_alloc(uint16_t size)
+{
+    return malloc(size);
+}
+
+void rpl_free(void *p, uint16_t size)
+{
+    free(p);
+}
+
+int8_t protocol_interface_address_compare(const uint8_t *addr)
+{
+    return memcmp(addr, root_addr, 16) ? -1 : 0;
+}
+
+// Give different costs to the links of the root
+uint16_t rpl_policy_modify_downward_cost_to_root_neighbour(rpl_domain_t *domain, int8_t interface_id,
+                                                           const uint8_t *next_hop, uint16_t cost)
+{
+    return cost * 3 + (next_hop[15] & 3);
+}
+
+bool rpl_policy_dao_trigger_after_srh_error(rpl_domain_t *domain, uint32_t seconds_since_last_dao_trigger,
+                                            uint16_t errors_since_last_dao_trigger, uint_fast16_t targets)
+{
+    return false;
+}
+
+uint8_t rpl_seq_init(void)
+{
+    return 0;
+}
+
+bool addr_ipv6_equal(const uint8_t a[16], const uint8_t b[16])
+{
+    return !memcmp(a, b, 16);
+}
+
+void ipv6_route_table_remove_info(int8_t interface_id, ipv6_route_src_t source, void *info)
+{
+}
+
+void rpl_data_sr_invalidate(void)
+{
+}
+
+void tun_del_node(const uint8_t address[16])
+{
+}
+
+static void node_addr(uint8_t addr[16], int i)
+{
+    memcpy(addr, root_addr, 16);
+    addr[14] = i >> 8;
+    addr[15] = i + 2;
+}
+
+static void run(unsigned int seed, int steps, int *incremental, int *full)
+{
+    rpl_dao_target_t *targets[NODES];
+    rpl_instance_t instance = { };
+    rpl_domain_t domain = { };
+    rpl_dao_root_transit_t *transit;
+    rpl_dao_target_t *target;
+    uint8_t addr[16];
+    int step, i, j, op;
+    bool valid;
+
+    srand(seed);
+    ns_list_init(&instance.dao_targets);
+    instance.domain = &domain;
+    for (i = 0; i < NODES; i++) {
+        node_addr(addr, i);
+        targets[i] = rpl_create_dao_target(&instance, addr, 128, true);
+        FATAL_ON(!targets[i], 1, "rpl_create_dao_target");
+    }
+    for (step = 0; step < steps; step++) {
+        i = rand() % NODES;
+        j = rand() % (NODES + 1);
+        op = rand() % 10;
+        // Mostly towards nodes created before (or the root), sometimes a loop
+        if (rand() % 50 && j < NODES && j >= i)
+            j = i ? rand() % i : NODES;
+        target = targets[i];
+        if (j == NODES)
+            memcpy(addr, root_addr, 16);
+        else
+            node_addr(addr, j);
+        valid = instance.root_paths_valid && instance.root_topo_sort_valid;
+        if (op < 4) {
+            rpl_downward_add_root_transit(target, addr, PCBIT(rand() % 8));
+        } else if (op < 6) {
+            ns_list_foreach(rpl_dao_root_transit_t, cur, &target->info.root.transits) {
+                if (rand() % 2 && ns_list_get_first(&target->info.root.transits) != ns_list_get_last(&target->info.root.transits)) {
+                    rpl_downward_delete_root_transit(target, cur);
+                    break;
+                }
+            }
+        } else if (op < 8) {
+            transit = ns_list_get_first(&target->info.root.transits);
+            if (transit)
+                rpl_downward_transit_error(&instance, target->prefix, transit->transit);
+        } else if (op < 9) {
+            rpl_downward_clear_root_transits(target);
+        } else {
+            rpl_downward_paths_invalidate(&instance);
+        }
+        if (valid && instance.root_paths_valid)
+            (*incremental)++;
+        if (rand() % 3 == 0 || !instance.root_paths_valid) {
+            if (!instance.root_paths_valid)
+                (*full)++;
+            rpl_downward_compute_paths(&instance);
+        }
+    }
+    ns_list_foreach_safe(rpl_dao_target_t, cur, &instance.dao_targets)
+        rpl_delete_dao_target(&instance, cur);
+    rpl_free(instance.dao_target_index, RPL_DAO_TARGET_INDEX_ALLOC_SIZE(instance.dao_target_index->size));
+}
+
+int main(int argc, char **argv)
+{
+    int seeds = argc > 1 ? atoi(argv[1]) : 20;
+    int steps = argc > 2 ? atoi(argv[2]) : 5000;
+    int incremental = 0, full = 0;
+    int seed;
+
+    for (seed = 1; seed <= seeds; seed++)
+        run(seed, steps, &incremental, &full);
+    printf("%d seeds: %d incremental updates checked, %d full computations\n", seeds, incremental, full);
+    // Make sure the incremental paths have been exercised
+    FATAL_ON(!incremental, 1, "no incremental update");
+    return 0;
+}